@@ -98,11 +98,15 @@ static QString libraryForAdapter(const QString &adapterName)
 
 PassThruCanBackend::PassThruCanBackend(const QString &name, QObject *parent)
     : QCanBusDevice(parent)
+    , QCanBusDeviceHooks(this)
     , m_deviceName (name)
     , m_canIO (new PassThruCanIO())
 {
     m_canIO->moveToThread(&m_ioThread);
 
+    // The pass-thru interface applies the message filters.
+    setHardwareFiltering(true);
+
     // Signals emitted by the I/O thread, to be queued.
     connect(m_canIO, &PassThruCanIO::errorOccurred,
             this, &PassThruCanBackend::setError);
@@ -110,8 +114,8 @@ PassThruCanBackend::PassThruCanBackend(const QString &name, QObject *parent)
             this, &PassThruCanBackend::ackOpenFinished);
     connect(m_canIO, &PassThruCanIO::closeFinished,
             this, &PassThruCanBackend::ackCloseFinished);
-    connect(m_canIO, &PassThruCanIO::messagesReceived,
-            this, &PassThruCanBackend::enqueueReceivedFrames);
+    connect(m_canIO, &PassThruCanIO::messagesReceived, this,
+            qOverload<const QList<QCanBusFrame> &>(&PassThruCanBackend::enqueueReceivedFrames));
     connect(m_canIO, &PassThruCanIO::messagesSent,
             this, &QCanBusDevice::framesWritten);
 }
@@ -133,12 +137,13 @@ PassThruCanBackend::~PassThruCanBackend()
     m_canIO->deleteLater();
 }
 
-void PassThruCanBackend::setConfigurationParameter(ConfigurationKey key, const QVariant &value)
+bool PassThruCanBackend::setPluginConfigurationParameter(ConfigurationKey key,
+                                                         const QVariant &value)
 {
-    QCanBusDevice::setConfigurationParameter(key, value);
-
     if (state() == ConnectedState)
         applyConfig(key, value);
+
+    return true;
 }
 
 bool PassThruCanBackend::writeFrame(const QCanBusFrame &frame)
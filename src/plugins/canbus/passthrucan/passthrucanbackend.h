@@ -42,6 +42,7 @@
 
 #include <QtSerialBus/qcanbusdevice.h>
 #include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/private/qcanbusdevicehooks_p.h>
 
 #include <QList>
 #include <QString>
@@ -51,7 +52,7 @@ QT_BEGIN_NAMESPACE
 
 class PassThruCanIO;
 
-class PassThruCanBackend : public QCanBusDevice
+class PassThruCanBackend : public QCanBusDevice, private QCanBusDeviceHooks
 {
     Q_OBJECT
     Q_DISABLE_COPY(PassThruCanBackend)
@@ -59,7 +60,6 @@ public:
     explicit PassThruCanBackend(const QString &name, QObject *parent = nullptr);
     virtual ~PassThruCanBackend();
 
-    void setConfigurationParameter(ConfigurationKey key, const QVariant &value) override;
     bool writeFrame(const QCanBusFrame &frame) override;
     QString interpretErrorFrame(const QCanBusFrame &errorFrame) override;
 
@@ -71,6 +71,8 @@ protected:
     void close() override;
 
 private:
+    bool setPluginConfigurationParameter(ConfigurationKey key, const QVariant &value) override;
+
     void ackOpenFinished(bool success);
     void ackCloseFinished();
     void applyConfig(QCanBusDevice::ConfigurationKey key, const QVariant &value);
@@ -44,6 +44,7 @@
 #include "peakcan_symbols_p.h"
 
 #include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/private/qcanbusdevice_p.h>
 
 #include <QtCore/qtimer.h>
 #include <QtCore/qcoreevent.h>
@@ -535,6 +536,8 @@ bool PeakCanBackendPrivate::setConfigurationParameter(QCanBusDevice::Configurati
     switch (key) {
     case QCanBusDevice::BitRateKey:
         return verifyBitRate(value.toInt());
+    case QCanBusDevice::RawFilterKey:
+        return true; // applied by QCanBusDevice
     case QCanBusDevice::CanFdKey:
         isFlexibleDatarateEnabled = value.toBool();
         return true;
@@ -655,16 +658,10 @@ static int dlcToSize(CanFrameDlc dlc)
     return 0;
 }
 
-void PeakCanBackendPrivate::startWrite()
+bool PeakCanBackendPrivate::writeMessage(const QCanBusFrame &frame)
 {
     Q_Q(PeakCanBackend);
 
-    if (!q->hasOutgoingFrames()) {
-        writeNotifier->stop();
-        return;
-    }
-
-    const QCanBusFrame frame = q->dequeueOutgoingFrame();
     const QByteArray payload = frame.payload();
     const qsizetype payloadSize = payload.size();
     TPCANStatus st = PCAN_ERROR_OK;
@@ -690,6 +687,7 @@ void PeakCanBackendPrivate::startWrite()
         const char errorString[] = "Cannot send CAN FD frame format as CAN FD is not enabled.";
         qCWarning(QT_CANBUS_PLUGINS_PEAKCAN(), errorString);
         q->setError(PeakCanBackend::tr(errorString), QCanBusDevice::WriteError);
+        return false;
     } else {
         TPCANMsg message = {};
         message.ID = frame.frameId();
@@ -709,8 +707,38 @@ void PeakCanBackendPrivate::startWrite()
         qCWarning(QT_CANBUS_PLUGINS_PEAKCAN, "Cannot write frame: %ls",
                   qUtf16Printable(errorString));
         q->setError(errorString, QCanBusDevice::WriteError);
-    } else {
-        emit q->framesWritten(qint64(1));
+        return false;
+    }
+
+    return true;
+}
+
+void PeakCanBackendPrivate::startWrite()
+{
+    Q_Q(PeakCanBackend);
+
+    if (!q->hasOutgoingFrames()) {
+        writeNotifier->stop();
+        return;
+    }
+
+    // Hand all pending frames to the driver in one go, stopping at the first
+    // failure (e.g. a full transmit queue); the rest is retried on the next tick.
+    qint64 framesWritten = 0;
+    qint64 bytesWritten = 0;
+    while (q->hasOutgoingFrames()) {
+        const QCanBusFrame frame = q->dequeueOutgoingFrame();
+        if (!frame.isValid()) // the remaining frames expired
+            break;
+        if (!writeMessage(frame))
+            break;
+        ++framesWritten;
+        bytesWritten += frame.payloadView().size();
+    }
+
+    if (framesWritten > 0) {
+        QCanBusDevicePrivate::get(q)->countWrittenBytes(bytesWritten);
+        emit q->framesWritten(framesWritten);
     }
 
     if (q->hasOutgoingFrames() && !writeNotifier->isActive())
@@ -782,7 +810,7 @@ void PeakCanBackendPrivate::startRead()
         }
     }
 
-    q->enqueueReceivedFrames(newFrames);
+    q->enqueueReceivedFrames(std::move(newFrames));
 }
 
 bool PeakCanBackendPrivate::verifyBitRate(int bitrate)
@@ -813,6 +841,7 @@ bool PeakCanBackendPrivate::verifyBitRate(int bitrate)
 
 PeakCanBackend::PeakCanBackend(const QString &name, QObject *parent)
     : QCanBusDevice(parent)
+    , QCanBusDeviceHooks(this)
     , d_ptr(new PeakCanBackendPrivate(this))
 {
     Q_D(PeakCanBackend);
@@ -841,7 +870,7 @@ bool PeakCanBackend::open()
 
         // Apply all stored configurations except bitrate, because
         // the bitrate cannot be changed after opening the device
-        const auto keys = configurationKeys();
+        const auto keys = pluginConfigurationKeys();
         for (ConfigurationKey key : keys) {
             if (key == QCanBusDevice::BitRateKey || key == QCanBusDevice::DataBitRateKey)
                 continue;
@@ -867,15 +896,19 @@ void PeakCanBackend::close()
     setState(QCanBusDevice::UnconnectedState);
 }
 
-void PeakCanBackend::setConfigurationParameter(ConfigurationKey key, const QVariant &value)
+bool PeakCanBackend::setPluginConfigurationParameter(ConfigurationKey key, const QVariant &value)
 {
     Q_D(PeakCanBackend);
 
-    if (d->setConfigurationParameter(key, value))
-        QCanBusDevice::setConfigurationParameter(key, value);
+    return d->setConfigurationParameter(key, value);
 }
 
 bool PeakCanBackend::writeFrame(const QCanBusFrame &newData)
+{
+    return writeExpiringFrame(newData, NoDeadline);
+}
+
+bool PeakCanBackend::writeExpiringFrame(const QCanBusFrame &newData, qint64 deadline)
 {
     Q_D(PeakCanBackend);
 
@@ -894,7 +927,7 @@ bool PeakCanBackend::writeFrame(const QCanBusFrame &newData)
         return false;
     }
 
-    enqueueOutgoingFrame(newData);
+    enqueueExpiringFrame(newData, deadline);
 
     if (!d->writeNotifier->isActive())
         d->writeNotifier->start();
@@ -902,6 +935,14 @@ bool PeakCanBackend::writeFrame(const QCanBusFrame &newData)
     return true;
 }
 
+void PeakCanBackend::writeOutgoingFrames()
+{
+    Q_D(PeakCanBackend);
+
+    if (d->writeNotifier && !d->writeNotifier->isActive())
+        d->writeNotifier->start();
+}
+
 // TODO: Implement me
 QString PeakCanBackend::interpretErrorFrame(const QCanBusFrame &errorFrame)
 {
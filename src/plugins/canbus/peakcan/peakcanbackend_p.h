@@ -79,6 +79,7 @@ public:
     void setupChannel(const QByteArray &interfaceName);
     void setupDefaultConfigurations();
     QString systemErrorString(TPCANStatus errorCode);
+    bool writeMessage(const QCanBusFrame &frame);
     void startWrite();
     void startRead();
     bool verifyBitRate(int bitrate);
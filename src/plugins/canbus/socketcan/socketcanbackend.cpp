@@ -40,16 +40,24 @@
 #include "socketcanbackend.h"
 
 #include "libsocketcan.h"
+#include "socketcanfilter.h"
 
 #include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/private/qcanbusdevice_p.h>
 
 #include <QtCore/qdatastream.h>
+#include <QtCore/qdeadlinetimer.h>
 #include <QtCore/qdebug.h>
 #include <QtCore/qdiriterator.h>
 #include <QtCore/qfile.h>
 #include <QtCore/qloggingcategory.h>
 #include <QtCore/qsocketnotifier.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qtimer.h>
 
+#include <chrono>
+
+#include <linux/can/bcm.h>
 #include <linux/can/error.h>
 #include <linux/can/raw.h>
 #include <linux/sockios.h>
@@ -65,6 +73,12 @@
 #ifndef CANFD_ESI
 #   define CANFD_ESI 0x02 /* error state indicator of the transmitting node */
 #endif
+#ifndef SO_RXQ_OVFL
+#   define SO_RXQ_OVFL 40 /* report frames dropped by the socket receive queue */
+#endif
+#ifndef CAN_FD_FRAME
+#   define CAN_FD_FRAME 0x0800 /* broadcast manager operation on CAN FD frames */
+#endif
 
 QT_BEGIN_NAMESPACE
 
@@ -130,6 +144,73 @@ static int deviceChannel(const QString &canDevice)
     return content.toInt(nullptr, 0);
 }
 
+static QCanBusFrame fromSocketFrame(const canfd_frame &frame, bool flexibleDataRate)
+{
+    QCanBusFrame result;
+    result.setFlexibleDataRateFormat(flexibleDataRate);
+    result.setExtendedFrameFormat(frame.can_id & CAN_EFF_FLAG);
+    Q_ASSERT(frame.len <= CANFD_MAX_DLEN);
+
+    if (frame.can_id & CAN_RTR_FLAG)
+        result.setFrameType(QCanBusFrame::RemoteRequestFrame);
+    if (frame.can_id & CAN_ERR_FLAG)
+        result.setFrameType(QCanBusFrame::ErrorFrame);
+    if (frame.flags & CANFD_BRS)
+        result.setBitrateSwitch(true);
+    if (frame.flags & CANFD_ESI)
+        result.setErrorStateIndicator(true);
+
+    result.setFrameId(frame.can_id & CAN_EFF_MASK);
+    result.setPayload(QByteArray(reinterpret_cast<const char *>(frame.data), frame.len));
+    return result;
+}
+
+// A message to or from the broadcast manager, with at most one frame.
+// The kernel expects the frames right after the header, which ends with
+// a flexible array member.
+struct BroadcastMessage
+{
+    alignas(bcm_msg_head) alignas(canfd_frame)
+    char data[sizeof(bcm_msg_head) + sizeof(canfd_frame)] = {};
+
+    bcm_msg_head &head() { return *reinterpret_cast<bcm_msg_head *>(data); }
+    const bcm_msg_head &head() const
+    { return *reinterpret_cast<const bcm_msg_head *>(data); }
+    canfd_frame &frame() { return *reinterpret_cast<canfd_frame *>(data + sizeof(bcm_msg_head)); }
+};
+static_assert(sizeof(bcm_msg_head) % alignof(canfd_frame) == 0);
+
+static void setInterval(bcm_timeval *interval, int msecs)
+{
+    interval->tv_sec = msecs / 1000;
+    interval->tv_usec = (msecs % 1000) * 1000;
+}
+
+static bool writeBroadcastMessage(int socket, const BroadcastMessage &message, size_t frameSize)
+{
+    const size_t size = sizeof(bcm_msg_head) + (message.head().nframes > 0 ? frameSize : 0);
+    return ::write(socket, message.data, size) == ssize_t(size);
+}
+
+// Software timestamps are delivered with nanosecond resolution via
+// SO_TIMESTAMPNS, controller timestamps require SO_TIMESTAMPING.
+static bool setTimeStampOptions(int socket, QCanBusDevice::TimeStampSource source)
+{
+    int timeStampingFlags = 0;
+    int softwareTimeStamps = 0;
+    if (source == QCanBusDevice::TimeStampSource::Software) {
+        softwareTimeStamps = 1;
+    } else {
+        timeStampingFlags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE
+                | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    }
+
+    return setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPING,
+                      &timeStampingFlags, sizeof(timeStampingFlags)) == 0
+            && setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPNS,
+                          &softwareTimeStamps, sizeof(softwareTimeStamps)) == 0;
+}
+
 QCanBusDeviceInfo SocketCanBackend::socketCanDeviceInfo(const QString &deviceName)
 {
     const QString serial; // exists for code readability purposes only
@@ -175,6 +256,7 @@ QCanBusDeviceInfo SocketCanBackend::deviceInfo() const
 }
 
 SocketCanBackend::SocketCanBackend(const QString &name) :
+    QCanBusDeviceHooks(this),
     canSocketName(name)
 {
     QString errorString;
@@ -185,6 +267,12 @@ SocketCanBackend::SocketCanBackend(const QString &name) :
                qUtf16Printable(errorString));
     }
 
+    writeRetryTimer = new QTimer(this);
+    writeRetryTimer->setSingleShot(true);
+    connect(writeRetryTimer, &QTimer::timeout, this, &SocketCanBackend::writeSocket);
+
+    // The kernel applies the filters, see applyConfigurationParameter()
+    setHardwareFiltering(true);
     resetConfigurations();
 }
 
@@ -206,6 +294,8 @@ void SocketCanBackend::resetConfigurations()
                 QCanBusDevice::CanFdKey, false);
     QCanBusDevice::setConfigurationParameter(
                 QCanBusDevice::BitRateKey, 500000);
+    QCanBusDevice::setConfigurationParameter(
+                QCanBusDevice::ReceiveBatchSizeKey, int(DefaultReceiveBatchSize));
 }
 
 bool SocketCanBackend::open()
@@ -223,8 +313,38 @@ bool SocketCanBackend::open()
 
 void SocketCanBackend::close()
 {
+    writeBlocked = false;
+    writeRetryTimer->stop();
+    writeRetryInterval = WriteRetryInterval;
+    if (writeNotifier)
+        writeNotifier->setEnabled(false);
+
+    if (notifier && notifier->thread() != thread()) {
+        notifier->deleteLater();
+        notifier = nullptr;
+        stopIoThread();
+    }
+
     ::close(canSocket);
     canSocket = -1;
+    filterProgramAttached = false;
+
+    // closing the socket deletes the operations of the broadcast manager, they
+    // are set up again by connectBroadcastManager()
+    delete bcmNotifier;
+    bcmNotifier = nullptr;
+    {
+        QMutexLocker locker(&broadcastManagerGuard);
+        if (bcmSocket != -1)
+            ::close(bcmSocket);
+        bcmSocket = -1;
+        receiveMonitorsActive = false;
+    }
+
+    {
+        QMutexLocker locker(&pendingConfirmationsGuard);
+        pendingConfirmations.clear();
+    }
 
     setState(QCanBusDevice::UnconnectedState);
 }
@@ -247,15 +367,25 @@ bool SocketCanBackend::applyConfigurationParameter(ConfigurationKey key, const Q
         break;
     }
     case QCanBusDevice::ReceiveOwnKey:
+        success = setupReceiveOwnMessages(value.toBool());
+        break;
+    case QCanBusDevice::TransmitConfirmationKey:
     {
-        const int receiveOwnMessages = value.toBool() ? 1 : 0;
-        if (Q_UNLIKELY(setsockopt(canSocket, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS,
-                                  &receiveOwnMessages, sizeof(receiveOwnMessages)) < 0)) {
-            setError(qt_error_string(errno),
-                     QCanBusDevice::CanBusError::ConfigurationError);
-            break;
+        const bool enabled = value.toBool();
+        {
+            QMutexLocker locker(&pendingConfirmationsGuard);
+            pendingConfirmations.clear();
+        }
+        const bool wasEnabled = transmitConfirmation.exchange(enabled);
+        success = setupReceiveOwnMessages(
+                    configurationParameter(QCanBusDevice::ReceiveOwnKey).toBool());
+        if (!success) {
+            transmitConfirmation = wasEnabled;
+        } else if (enabled
+                   && !configurationParameter(QCanBusDevice::LoopbackKey).toBool()) {
+            qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN,
+                      "Transmit confirmations need QCanBusDevice::LoopbackKey to be enabled.");
         }
-        success = true;
         break;
     }
     case QCanBusDevice::ErrorFilterKey:
@@ -285,7 +415,7 @@ bool SocketCanBackend::applyConfigurationParameter(ConfigurationKey key, const Q
                          QCanBusDevice::CanBusError::ConfigurationError);
                 break;
             }
-            success = true;
+            success = detachFilterProgram();
             break;
         }
 
@@ -330,13 +460,28 @@ bool SocketCanBackend::applyConfigurationParameter(ConfigurationKey key, const Q
 
             filters[i] = filter;
         }
+
+        // large filter lists are checked faster by a compiled filter program
+        if (compiledFilterEnabled && filters.size() >= CompiledFilterThreshold
+                && attachFilterProgram(filters)) {
+            success = true;
+            break;
+        }
+
         if (Q_UNLIKELY(setsockopt(canSocket, SOL_CAN_RAW, CAN_RAW_FILTER,
                        filters.constData(), sizeof(filters[0]) * filters.size()) < 0)) {
             setError(qt_error_string(errno),
                      QCanBusDevice::CanBusError::ConfigurationError);
             break;
         }
-        success = true;
+        success = detachFilterProgram();
+        break;
+    }
+    case QCanBusDevice::CompiledFilterKey:
+    {
+        compiledFilterEnabled = value.toBool();
+        success = applyConfigurationParameter(QCanBusDevice::RawFilterKey,
+                                              configurationParameter(QCanBusDevice::RawFilterKey));
         break;
     }
     case QCanBusDevice::CanFdKey:
@@ -357,6 +502,36 @@ bool SocketCanBackend::applyConfigurationParameter(ConfigurationKey key, const Q
         success = libSocketCan->setBitrate(canSocketName, bitRate);
         break;
     }
+    case QCanBusDevice::ReceiveBatchSizeKey:
+    {
+        const int batchSize = value.toInt();
+        runInReadThread([this, batchSize]() {
+            receiveBatchSize = batchSize;
+            setupReceiveBuffers();
+        });
+        success = true;
+        break;
+    }
+    case QCanBusDevice::TimeStampSourceKey:
+    {
+        timeStampSource = value.isValid() ? value.value<TimeStampSource>()
+                                          : TimeStampSource::Software;
+        success = setupTimeStamping();
+        if (Q_UNLIKELY(!success)) {
+            setError(qt_error_string(errno),
+                     QCanBusDevice::CanBusError::ConfigurationError);
+        }
+        break;
+    }
+    case QCanBusDevice::IoThreadKey:
+    case QCanBusDevice::IoThreadAffinityKey:
+    case QCanBusDevice::IoThreadPriorityKey:
+        // takes effect when the socket is connected again
+        success = true;
+        break;
+    case QCanBusDevice::ReceiveBufferSizeKey:
+        success = !value.isValid() || setupReceiveBufferSize(value.toInt());
+        break;
     default:
         setError(tr("Unsupported configuration key: %1").arg(key),
                  QCanBusDevice::CanBusError::ConfigurationError);
@@ -392,20 +567,48 @@ bool SocketCanBackend::connectSocket()
         return false;
     }
 
-    m_iov.iov_base = &m_frame;
-    m_msg.msg_name = &m_address;
-    m_msg.msg_iov = &m_iov;
-    m_msg.msg_iovlen = 1;
-    m_msg.msg_control = &m_ctrlmsg;
+    if (Q_UNLIKELY(!setupTimeStamping())) {
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "Cannot enable receive timestamps: %ls.",
+                  qUtf16Printable(qt_error_string(errno)));
+    }
+
+    const int reportDroppedFrames = 1;
+    if (Q_UNLIKELY(setsockopt(canSocket, SOL_SOCKET, SO_RXQ_OVFL,
+                              &reportDroppedFrames, sizeof(reportDroppedFrames)) < 0)) {
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "Cannot enable the count of dropped frames.");
+    }
+    kernelDroppedFrames = 0;
+
+    setupReceiveBuffers();
 
     delete notifier;
 
-    notifier = new QSocketNotifier(canSocket, QSocketNotifier::Read, this);
+    // With IoThreadKey, the frames are read in the I/O thread of QCanBusDevice.
+    // Writing stays in the thread of the device.
+    notifier = new QSocketNotifier(canSocket, QSocketNotifier::Read);
+    if (QThread *readThread = ioThread())
+        notifier->moveToThread(readThread);
+    else
+        notifier->setParent(this);
     connect(notifier, &QSocketNotifier::activated,
-            this, &SocketCanBackend::readSocket);
+            this, &SocketCanBackend::readSocket, Qt::DirectConnection);
+
+    delete writeNotifier;
+
+    writeNotifier = new QSocketNotifier(canSocket, QSocketNotifier::Write, this);
+    writeNotifier->setEnabled(false);
+    connect(writeNotifier, &QSocketNotifier::activated,
+            this, &SocketCanBackend::writeSocket);
+
+    if (Q_UNLIKELY(!connectBroadcastManager())) {
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN,
+                  "Cannot open the CAN broadcast manager: %ls. Cyclic frames are written "
+                  "by QCanBusDevice and receive monitors are not available.",
+                  qUtf16Printable(qt_error_string(errno)));
+    }
 
     //apply all stored configurations
-    const auto keys = configurationKeys();
+    const auto keys = pluginConfigurationKeys();
     for (ConfigurationKey key : keys) {
         const QVariant param = configurationParameter(key);
         bool success = applyConfigurationParameter(key, param);
@@ -418,7 +621,8 @@ bool SocketCanBackend::connectSocket()
     return true;
 }
 
-void SocketCanBackend::setConfigurationParameter(ConfigurationKey key, const QVariant &value)
+bool SocketCanBackend::setPluginConfigurationParameter(ConfigurationKey key,
+                                                       const QVariant &value)
 {
     if (key == QCanBusDevice::RawFilterKey) {
         //verify valid/supported filters
@@ -431,7 +635,7 @@ void SocketCanBackend::setConfigurationParameter(ConfigurationKey key, const QVa
             default:
                 setError(tr("Cannot set filter for frame type: %1").arg(f.type),
                          QCanBusDevice::CanBusError::ConfigurationError);
-                return;
+                return false;
             case QCanBusFrame::InvalidFrame:
             case QCanBusFrame::DataFrame:
             case QCanBusFrame::ErrorFrame:
@@ -442,7 +646,7 @@ void SocketCanBackend::setConfigurationParameter(ConfigurationKey key, const QVa
             if (f.frameId > 0x1FFFFFFFU) {
                 setError(tr("FrameId %1 larger than 29 bit.").arg(f.frameId),
                          QCanBusDevice::CanBusError::ConfigurationError);
-                return;
+                return false;
             }
         }
     } else if (key == QCanBusDevice::ProtocolKey) {
@@ -452,26 +656,64 @@ void SocketCanBackend::setConfigurationParameter(ConfigurationKey key, const QVa
             const QString errorString = tr("Cannot set protocol to value %1.").arg(value.toString());
             setError(errorString, QCanBusDevice::ConfigurationError);
             qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "%ls", qUtf16Printable(errorString));
-            return;
+            return false;
         }
         protocol = newProtocol;
+    } else if (key == QCanBusDevice::TimeStampSourceKey && value.isValid()) {
+        bool ok = false;
+        const int source = value.toInt(&ok);
+        if (Q_UNLIKELY(!ok || source < int(TimeStampSource::Software)
+                       || source > int(TimeStampSource::RawHardware))) {
+            const QString errorString = tr("Cannot set timestamp source to value %1.")
+                    .arg(value.toString());
+            setError(errorString, QCanBusDevice::ConfigurationError);
+            qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "%ls", qUtf16Printable(errorString));
+            return false;
+        }
+    } else if (key == QCanBusDevice::ReceiveBufferSizeKey && value.isValid()) {
+        bool ok = false;
+        const int bufferSize = value.toInt(&ok);
+        if (Q_UNLIKELY(!ok || bufferSize <= 0)) {
+            const QString errorString = tr("Cannot set receive buffer size to value %1.")
+                    .arg(value.toString());
+            setError(errorString, QCanBusDevice::ConfigurationError);
+            qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "%ls", qUtf16Printable(errorString));
+            return false;
+        }
+    } else if (key == QCanBusDevice::ReceiveBatchSizeKey) {
+        bool ok = false;
+        const int batchSize = value.toInt(&ok);
+        if (Q_UNLIKELY(!ok || batchSize < 1 || batchSize > MaximumReceiveBatchSize)) {
+            const QString errorString = tr("Cannot set receive batch size to value %1.")
+                    .arg(value.toString());
+            setError(errorString, QCanBusDevice::ConfigurationError);
+            qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "%ls", qUtf16Printable(errorString));
+            return false;
+        }
     }
     // connected & params not applyable/invalid
     if (canSocket != -1 && !applyConfigurationParameter(key, value))
-        return;
-
-    QCanBusDevice::setConfigurationParameter(key, value);
+        return false;
 
     // we need to check CAN FD option a lot -> cache it and avoid QList lookup
     if (key == QCanBusDevice::CanFdKey)
-        canFdOptionEnabled = value.toBool();
+        canFdOptionEnabled.store(value.toBool(), std::memory_order_relaxed);
+    else if (key == QCanBusDevice::ReceiveBatchSizeKey && canSocket == -1)
+        receiveBatchSize = value.toInt(); // otherwise set in the read thread
+    else if (key == QCanBusDevice::CompiledFilterKey)
+        compiledFilterEnabled = value.toBool();
+    else if (key == QCanBusDevice::TimeStampSourceKey)
+        timeStampSource = value.isValid() ? value.value<TimeStampSource>()
+                                          : TimeStampSource::Software;
+
+    return true;
 }
 
-bool SocketCanBackend::writeFrame(const QCanBusFrame &newData)
+// Classic CAN frames share the layout of canfd_frame up to the eighth data
+// byte, so both formats are converted into a canfd_frame. The number of bytes
+// to pass to the socket (CAN_MTU or CANFD_MTU) is returned in size.
+bool SocketCanBackend::toSocketFrame(const QCanBusFrame &newData, canfd_frame *frame, size_t *size)
 {
-    if (state() != ConnectedState)
-        return false;
-
     if (Q_UNLIKELY(!newData.isValid())) {
         setError(tr("Cannot write invalid QCanBusFrame"), QCanBusDevice::WriteError);
         return false;
@@ -488,43 +730,188 @@ bool SocketCanBackend::writeFrame(const QCanBusFrame &newData)
         canId |= CAN_ERR_FLAG;
     }
 
-    if (Q_UNLIKELY(!canFdOptionEnabled && newData.hasFlexibleDataRateFormat())) {
+    if (Q_UNLIKELY(!canFdOptionEnabled.load(std::memory_order_relaxed)
+                   && newData.hasFlexibleDataRateFormat())) {
         const QString error = tr("Cannot write CAN FD frame because CAN FD option is not enabled.");
         qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "%ls", qUtf16Printable(error));
         setError(error, QCanBusDevice::WriteError);
         return false;
     }
 
-    qint64 bytesWritten = 0;
+    const QByteArrayView payload = newData.payloadView();
+    *frame = {};
+    frame->can_id = canId;
+    frame->len = payload.size();
     if (newData.hasFlexibleDataRateFormat()) {
-        canfd_frame frame = {};
-        frame.len = newData.payload().size();
-        frame.can_id = canId;
-        frame.flags = newData.hasBitrateSwitch() ? CANFD_BRS : 0;
-        frame.flags |= newData.hasErrorStateIndicator() ? CANFD_ESI : 0;
-        ::memcpy(frame.data, newData.payload().constData(), frame.len);
-
-        bytesWritten = ::write(canSocket, &frame, sizeof(frame));
+        frame->flags = newData.hasBitrateSwitch() ? CANFD_BRS : 0;
+        frame->flags |= newData.hasErrorStateIndicator() ? CANFD_ESI : 0;
+        *size = CANFD_MTU;
     } else {
-        can_frame frame = {};
-        frame.can_dlc = newData.payload().size();
-        frame.can_id = canId;
-        ::memcpy(frame.data, newData.payload().constData(), frame.can_dlc);
-
-        bytesWritten = ::write(canSocket, &frame, sizeof(frame));
+        *size = CAN_MTU;
     }
+    ::memcpy(frame->data, payload.data(), frame->len);
 
-    if (Q_UNLIKELY(bytesWritten < 0)) {
-        setError(qt_error_string(errno),
-                 QCanBusDevice::CanBusError::WriteError);
+    return true;
+}
+
+// Returns whether toSocketFrame() accepts the frame, without reporting errors.
+bool SocketCanBackend::isWritable(const QCanBusFrame &frame) const
+{
+    return frame.isValid() && (!frame.hasFlexibleDataRateFormat()
+                               || canFdOptionEnabled.load(std::memory_order_relaxed));
+}
+
+bool SocketCanBackend::writeFrame(const QCanBusFrame &newData)
+{
+    return writeExpiringFrame(newData, NoDeadline);
+}
+
+// Returns true once the frame is queued; the kernel may take it later, see
+// flushOutgoingFrames().
+bool SocketCanBackend::writeExpiringFrame(const QCanBusFrame &newData, qint64 deadline)
+{
+    if (state() != ConnectedState)
+        return false;
+
+    canfd_frame frame;
+    size_t size = 0;
+    if (!toSocketFrame(newData, &frame, &size))
         return false;
-    }
 
-    emit framesWritten(1);
+    enqueueExpiringFrame(newData, deadline);
+    flushOutgoingFrames();
 
     return true;
 }
 
+void SocketCanBackend::writeOutgoingFrames()
+{
+    flushOutgoingFrames();
+}
+
+qint64 SocketCanBackend::writeFrameBatch(const QList<QCanBusFrame> &frames)
+{
+    if (state() != ConnectedState)
+        return 0;
+
+    qint64 accepted = 0;
+    for (const QCanBusFrame &newData : frames) {
+        canfd_frame frame;
+        size_t size = 0;
+        if (!toSocketFrame(newData, &frame, &size))
+            break;
+        enqueueOutgoingFrame(newData);
+        ++accepted;
+    }
+
+    if (accepted > 0)
+        flushOutgoingFrames();
+
+    return accepted;
+}
+
+/*
+    Writes the queued outgoing frames to the socket, in chunks of one
+    sendmmsg() call each. Frames are only removed from the queue once the
+    kernel took them. If the socket cannot take more frames, the rest of
+    the queue is written when the socket becomes writable again.
+
+    A frame at the head of the queue that cannot be converted anymore, for
+    example because CAN FD was disabled meanwhile, is dropped with a write
+    error. Any other error of sendmmsg() drops the frame the kernel refused
+    and stops writing; the remaining frames are written with the next write.
+*/
+void SocketCanBackend::flushOutgoingFrames()
+{
+    canfd_frame batch[WriteBatchSize];
+    iovec vectors[WriteBatchSize];
+    mmsghdr messages[WriteBatchSize];
+
+    qint64 written = 0;
+
+    while (!writeBlocked) {
+        dropExpiredFrames();
+        if (!hasOutgoingFrames())
+            break;
+
+        const qint64 pending = qMin(outgoingFrameCount(), qint64(WriteBatchSize));
+        int count = 0;
+        for (; count < pending; ++count) {
+            // the head frame is checked by toSocketFrame(), which reports errors
+            const QCanBusFrame frame = peekOutgoingFrame(count);
+            if (count > 0 && !isWritable(frame))
+                break;
+
+            size_t size = 0;
+            if (!toSocketFrame(frame, &batch[count], &size))
+                break;
+            vectors[count].iov_base = &batch[count];
+            vectors[count].iov_len = size;
+            messages[count] = {};
+            messages[count].msg_hdr.msg_iov = &vectors[count];
+            messages[count].msg_hdr.msg_iovlen = 1;
+        }
+
+        if (Q_UNLIKELY(count == 0)) {
+            removeOutgoingFrames(1);
+            qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN,
+                      "Dropped a queued frame that cannot be written anymore.");
+            continue;
+        }
+
+        const int result = ::sendmmsg(canSocket, messages, count, 0);
+        if (Q_UNLIKELY(result < 0)) {
+            if (errno == EINTR)
+                continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // socket send buffer is full, wait until it is writable again
+                writeBlocked = true;
+                writeNotifier->setEnabled(true);
+                break;
+            }
+
+            if (errno == ENOBUFS) {
+                // The queue of the network device is full. The socket still
+                // polls as writable in this case, so retry after a delay that
+                // grows while the queue stays full.
+                writeBlocked = true;
+                writeRetryTimer->start(writeRetryInterval);
+                writeRetryInterval = qMin(writeRetryInterval * 2,
+                                          int(MaximumWriteRetryInterval));
+                break;
+            }
+
+            setError(qt_error_string(errno),
+                     QCanBusDevice::CanBusError::WriteError);
+            removeOutgoingFrames(1);
+            break;
+        }
+
+        writeRetryInterval = WriteRetryInterval;
+        if (transmitConfirmation.load(std::memory_order_relaxed))
+            addPendingConfirmations(batch, result);
+        removeOutgoingFrames(result);
+        qint64 bytes = 0;
+        for (int i = 0; i < result; ++i)
+            bytes += batch[i].len;
+        QCanBusDevicePrivate::get(this)->countWrittenBytes(bytes);
+        written += result;
+    }
+
+    if (written > 0)
+        emit framesWritten(written);
+}
+
+void SocketCanBackend::writeSocket()
+{
+    writeBlocked = false;
+    writeNotifier->setEnabled(false);
+    writeRetryTimer->stop();
+
+    flushOutgoingFrames();
+}
+
 QString SocketCanBackend::interpretErrorFrame(const QCanBusFrame &errorFrame)
 {
     if (errorFrame.frameType() != QCanBusFrame::ErrorFrame)
@@ -688,66 +1075,661 @@ QString SocketCanBackend::interpretErrorFrame(const QCanBusFrame &errorFrame)
     return errorMsg;
 }
 
+// While the frames are read in the I/O thread, the receive buffers belong to
+// that thread and are only changed there.
+template <typename Functor>
+void SocketCanBackend::runInReadThread(Functor &&function)
+{
+    if (notifier && notifier->thread() != thread())
+        QMetaObject::invokeMethod(notifier, std::forward<Functor>(function), Qt::QueuedConnection);
+    else
+        function();
+}
+
+void SocketCanBackend::setupReceiveBuffers()
+{
+    if (m_receiveMessages.size() == receiveBatchSize)
+        return;
+
+    m_receiveBuffers.resize(receiveBatchSize);
+    m_receiveMessages.resize(receiveBatchSize);
+
+    for (int i = 0; i < receiveBatchSize; ++i) {
+        ReceiveBuffer &buffer = m_receiveBuffers[i];
+        buffer.iov.iov_base = &buffer.frame;
+        buffer.iov.iov_len = sizeof(buffer.frame);
+
+        msghdr &message = m_receiveMessages[i].msg_hdr;
+        message = {};
+        message.msg_name = &buffer.address;
+        message.msg_iov = &buffer.iov;
+        message.msg_iovlen = 1;
+        message.msg_control = buffer.control;
+    }
+}
+
+// The BPF program is attached before CAN_RAW_FILTER is opened, so that no
+// unwanted frame is received while switching. Returns false if the program
+// cannot be used, the caller then falls back to CAN_RAW_FILTER.
+bool SocketCanBackend::attachFilterProgram(const QList<can_filter> &filters)
+{
+    QList<sock_filter> program;
+    if (Q_UNLIKELY(!SocketCanFilter::compile(filters, &program))) {
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN,
+                  "Filter list is too large for a filter program, using CAN_RAW_FILTER.");
+        return false;
+    }
+
+    sock_fprog filterProgram = {};
+    filterProgram.len = static_cast<unsigned short>(program.size());
+    filterProgram.filter = program.data();
+    if (Q_UNLIKELY(setsockopt(canSocket, SOL_SOCKET, SO_ATTACH_FILTER,
+                              &filterProgram, sizeof(filterProgram)) < 0)) {
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "Cannot attach filter program: %ls",
+                  qUtf16Printable(qt_error_string(errno)));
+        return false;
+    }
+    filterProgramAttached = true;
+
+    const can_filter acceptAll = {0, 0};
+    if (Q_UNLIKELY(setsockopt(canSocket, SOL_CAN_RAW, CAN_RAW_FILTER,
+                              &acceptAll, sizeof(acceptAll)) < 0)) {
+        setError(qt_error_string(errno),
+                 QCanBusDevice::CanBusError::ConfigurationError);
+        return false;
+    }
+
+    return true;
+}
+
+// Removes a previously attached BPF program. Must be called after
+// CAN_RAW_FILTER has been set up, for the same reason as above.
+bool SocketCanBackend::detachFilterProgram()
+{
+    if (!filterProgramAttached)
+        return true;
+
+    const int unused = 0;
+    if (Q_UNLIKELY(setsockopt(canSocket, SOL_SOCKET, SO_DETACH_FILTER,
+                              &unused, sizeof(unused)) < 0)) {
+        setError(qt_error_string(errno),
+                 QCanBusDevice::CanBusError::ConfigurationError);
+        return false;
+    }
+    filterProgramAttached = false;
+
+    return true;
+}
+
+// Falls back to software timestamps if the driver does not support controller
+// timestamps, the requested source is kept for the next connection. Returns
+// false with errno set if not even software timestamps can be enabled.
+bool SocketCanBackend::setupTimeStamping()
+{
+    TimeStampSource source = timeStampSource;
+    if (Q_UNLIKELY(!setTimeStampOptions(canSocket, source))) {
+        if (source == TimeStampSource::Software)
+            return false;
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN,
+                  "Cannot enable hardware receive timestamps: %ls. Using software timestamps.",
+                  qUtf16Printable(qt_error_string(errno)));
+        source = TimeStampSource::Software;
+        if (!setTimeStampOptions(canSocket, source))
+            return false;
+    }
+
+    // the broadcast manager passes on the timestamps of the frames it delivers
+    if (bcmSocket != -1 && Q_UNLIKELY(!setTimeStampOptions(bcmSocket, source))) {
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN,
+                  "Cannot enable receive timestamps of the broadcast manager: %ls.",
+                  qUtf16Printable(qt_error_string(errno)));
+    }
+
+    return true;
+}
+
+// The kernel reports the number of frames it dropped so far with every
+// received frame, checking the last frame of a batch is sufficient.
+void SocketCanBackend::updateKernelDroppedFrames(msghdr *message)
+{
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(message); cmsg; cmsg = CMSG_NXTHDR(message, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_RXQ_OVFL)
+            continue;
+
+        __u32 droppedFrames;
+        ::memcpy(&droppedFrames, CMSG_DATA(cmsg), sizeof(droppedFrames));
+        if (droppedFrames != kernelDroppedFrames) {
+            // the counter of the kernel wraps around
+            const quint32 newlyDropped = droppedFrames - kernelDroppedFrames;
+            kernelDroppedFrames = droppedFrames;
+            setPluginCounter(QStringLiteral("kernelDroppedFrames"), qint64(droppedFrames));
+            QCanBusDevicePrivate::get(this)->reportDroppedFrames(qint64(newlyDropped));
+        }
+        return;
+    }
+}
+
+// SO_RCVBUF is limited by net.core.rmem_max, SO_RCVBUFFORCE overrides the
+// limit but needs CAP_NET_ADMIN. The kernel doubles the value for its
+// bookkeeping, so the size read back is compared against twice the request.
+bool SocketCanBackend::setupReceiveBufferSize(int bufferSize)
+{
+    if (setsockopt(canSocket, SOL_SOCKET, SO_RCVBUFFORCE, &bufferSize, sizeof(bufferSize)) < 0
+            && Q_UNLIKELY(setsockopt(canSocket, SOL_SOCKET, SO_RCVBUF,
+                                     &bufferSize, sizeof(bufferSize)) < 0)) {
+        setError(qt_error_string(errno),
+                 QCanBusDevice::CanBusError::ConfigurationError);
+        return false;
+    }
+
+    int actualSize = 0;
+    socklen_t length = sizeof(actualSize);
+    if (getsockopt(canSocket, SOL_SOCKET, SO_RCVBUF, &actualSize, &length) == 0
+            && actualSize / 2 < bufferSize) {
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN,
+                  "Receive buffer size is limited to %d bytes, see net.core.rmem_max.",
+                  actualSize / 2);
+    }
+
+    return true;
+}
+
+// The echoes of the frames written by this socket are needed for the
+// transmit confirmations, but only delivered if ReceiveOwnKey is enabled.
+bool SocketCanBackend::setupReceiveOwnMessages(bool receiveOwn)
+{
+    const int receiveOwnOption = (receiveOwn || transmitConfirmation) ? 1 : 0;
+    if (Q_UNLIKELY(setsockopt(canSocket, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS,
+                              &receiveOwnOption, sizeof(receiveOwnOption)) < 0)) {
+        setError(qt_error_string(errno),
+                 QCanBusDevice::CanBusError::ConfigurationError);
+        return false;
+    }
+
+    receiveOwnMessages = receiveOwn;
+    return true;
+}
+
+// Remembers the frames the kernel took, to match them with their echoes.
+// If echoes never arrive, e.g. because the loopback is disabled, the oldest
+// frames are given up.
+void SocketCanBackend::addPendingConfirmations(const canfd_frame *frames, int count)
+{
+    using namespace std::chrono;
+    const qint64 now = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+
+    QMutexLocker locker(&pendingConfirmationsGuard);
+    for (int i = 0; i < count; ++i)
+        pendingConfirmations.append({frames[i], now});
+
+    const qsizetype surplus = pendingConfirmations.size() - MaximumPendingConfirmations;
+    if (surplus > 0)
+        pendingConfirmations.remove(0, surplus);
+}
+
+// Echoes arrive in the order the frames were sent, so the match is usually
+// the first pending frame. Frames in front of the match were not sent,
+// for example because the controller aborted them, and are given up.
+bool SocketCanBackend::takePendingConfirmation(const canfd_frame &echo, qint64 *sendTime)
+{
+    QMutexLocker locker(&pendingConfirmationsGuard);
+
+    const qsizetype depth = qMin<qsizetype>(pendingConfirmations.size(),
+                                            ConfirmationSearchDepth);
+    for (qsizetype i = 0; i < depth; ++i) {
+        const canfd_frame &frame = pendingConfirmations.at(i).frame;
+        if (frame.can_id != echo.can_id || frame.len != echo.len
+                || ::memcmp(frame.data, echo.data, frame.len) != 0) {
+            continue;
+        }
+
+        *sendTime = pendingConfirmations.at(i).sendTime;
+        pendingConfirmations.remove(0, i + 1);
+        return true;
+    }
+
+    return false;
+}
+
+QCanBusFrame::TimeStamp SocketCanBackend::frameTimeStamp(msghdr *message) const
+{
+    timespec timeStamp = {};
+
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(message); cmsg; cmsg = CMSG_NXTHDR(message, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            ::memcpy(&timeStamp, CMSG_DATA(cmsg), sizeof(timeStamp));
+        } else if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            // ts[0] is the software, ts[2] the raw hardware timestamp
+            scm_timestamping stamps;
+            ::memcpy(&stamps, CMSG_DATA(cmsg), sizeof(stamps));
+            const timespec &hardware = stamps.ts[2];
+            if (timeStampSource == TimeStampSource::RawHardware
+                    || hardware.tv_sec != 0 || hardware.tv_nsec != 0) {
+                timeStamp = hardware;
+            } else {
+                timeStamp = stamps.ts[0];
+            }
+        }
+    }
+
+    return QCanBusFrame::TimeStamp(timeStamp.tv_sec, timeStamp.tv_nsec / 1000);
+}
+
+// readSocket() may run in the I/O thread, errors are reported in the thread of
+// the device.
+void SocketCanBackend::setReadError(const QString &errorText)
+{
+    if (QThread::currentThread() == thread()) {
+        setError(errorText, QCanBusDevice::CanBusError::ReadError);
+        return;
+    }
+
+    QMetaObject::invokeMethod(this, [this, errorText]() {
+        setError(errorText, QCanBusDevice::CanBusError::ReadError);
+    }, Qt::QueuedConnection);
+}
+
 void SocketCanBackend::readSocket()
 {
     QList<QCanBusFrame> newFrames;
+    QList<QPair<QCanBusFrame, qint64>> confirmedFrames;
+    const bool confirmTransmissions = transmitConfirmation.load(std::memory_order_relaxed);
+    const bool deliverEchoes = receiveOwnMessages.load(std::memory_order_relaxed);
+
+    // the broadcast manager delivers the monitored frames, see readBroadcastManager()
+    QHash<canid_t, ReceiveMonitor> monitors;
+    if (receiveMonitorsActive.load(std::memory_order_relaxed)) {
+        QMutexLocker locker(&broadcastManagerGuard);
+        monitors = receiveMonitors;
+    }
 
+    const int batchSize = int(m_receiveMessages.size());
     for (;;) {
-        m_frame = {};
-        m_iov.iov_len = sizeof(m_frame);
-        m_msg.msg_namelen = sizeof(m_addr);
-        m_msg.msg_controllen = sizeof(m_ctrlmsg);
-        m_msg.msg_flags = 0;
+        for (int i = 0; i < batchSize; ++i) {
+            msghdr &message = m_receiveMessages[i].msg_hdr;
+            message.msg_namelen = sizeof(sockaddr_can);
+            message.msg_controllen = sizeof(ReceiveBuffer::control);
+            message.msg_flags = 0;
+        }
+
+        const int messagesReceived = ::recvmmsg(canSocket, m_receiveMessages.data(),
+                                                batchSize, 0, nullptr);
+        if (messagesReceived <= 0)
+            break;
+
+        newFrames.reserve(newFrames.size() + messagesReceived);
+
+        for (int i = 0; i < messagesReceived; ++i) {
+            const canfd_frame &frame = m_receiveBuffers.at(i).frame;
+            msghdr &message = m_receiveMessages[i].msg_hdr;
+            const unsigned int bytesReceived = m_receiveMessages.at(i).msg_len;
+
+            if (Q_UNLIKELY(bytesReceived != CANFD_MTU && bytesReceived != CAN_MTU)) {
+                setReadError(tr("ERROR SocketCanBackend: incomplete CAN frame"));
+                continue;
+            } else if (Q_UNLIKELY(frame.len > bytesReceived - offsetof(canfd_frame, data))) {
+                setReadError(tr("ERROR SocketCanBackend: invalid CAN frame length"));
+                continue;
+            }
+
+            const bool echo = message.msg_flags & MSG_CONFIRM;
+            if (!echo && !monitors.isEmpty()) {
+                const auto monitor = monitors.constFind(frame.can_id);
+                if (monitor != monitors.cend()
+                        && monitor->flexibleDataRate() == (bytesReceived == CANFD_MTU)) {
+                    continue;
+                }
+            }
+
+            QCanBusFrame bufferedFrame = fromSocketFrame(frame, bytesReceived == CANFD_MTU);
+            bufferedFrame.setTimeStamp(frameTimeStamp(&message));
+            if (echo)
+                bufferedFrame.setLocalEcho(true);
+
+            qint64 sendTime = 0;
+            if (echo && confirmTransmissions && takePendingConfirmation(frame, &sendTime)) {
+                // The latency reaches up to the reception of the echo. Only
+                // software timestamps share the clock with the send time.
+                const QCanBusFrame::TimeStamp stamp = bufferedFrame.timeStamp();
+                const qint64 echoed = stamp.seconds() * 1000000 + stamp.microSeconds();
+                const qint64 latency = timeStampSource == TimeStampSource::Software
+                        ? echoed - sendTime : -1;
+                confirmedFrames.append({bufferedFrame, latency});
+            }
+
+            if (echo && !deliverEchoes)
+                continue;
 
-        const int bytesReceived = ::recvmsg(canSocket, &m_msg, 0);
+            newFrames.append(std::move(bufferedFrame));
+        }
+
+        updateKernelDroppedFrames(&m_receiveMessages[messagesReceived - 1].msg_hdr);
 
-        if (bytesReceived <= 0) {
+        // the socket is drained, avoid another system call
+        if (messagesReceived < batchSize)
             break;
-        } else if (Q_UNLIKELY(bytesReceived != CANFD_MTU && bytesReceived != CAN_MTU)) {
-            setError(tr("ERROR SocketCanBackend: incomplete CAN frame"),
-                     QCanBusDevice::CanBusError::ReadError);
-            continue;
-        } else if (Q_UNLIKELY(m_frame.len > bytesReceived - offsetof(canfd_frame, data))) {
-            setError(tr("ERROR SocketCanBackend: invalid CAN frame length"),
-                     QCanBusDevice::CanBusError::ReadError);
-            continue;
+    }
+
+    enqueueReceivedFrames(std::move(newFrames));
+
+    for (const auto &confirmedFrame : std::as_const(confirmedFrames))
+        confirmFrame(confirmedFrame.first, confirmedFrame.second);
+}
+
+/*
+    Opens the socket of the broadcast manager on the interface of the raw
+    socket and sets up the cyclic frames and receive monitors again.
+    Returns false and leaves errno set if the socket cannot be opened.
+*/
+bool SocketCanBackend::connectBroadcastManager()
+{
+    const int socket = ::socket(PF_CAN, SOCK_DGRAM | SOCK_NONBLOCK, CAN_BCM);
+    if (Q_UNLIKELY(socket < 0))
+        return false;
+
+    if (Q_UNLIKELY(::connect(socket, reinterpret_cast<struct sockaddr *>(&m_address),
+                             sizeof(m_address)) < 0)) {
+        const int error = errno;
+        ::close(socket);
+        errno = error;
+        return false;
+    }
+
+    if (Q_UNLIKELY(!setTimeStampOptions(socket, timeStampSource))) {
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN,
+                  "Cannot enable receive timestamps of the broadcast manager: %ls.",
+                  qUtf16Printable(qt_error_string(errno)));
+    }
+
+    bool restored = true;
+    {
+        QMutexLocker locker(&broadcastManagerGuard);
+        bcmSocket = socket;
+        for (const CyclicTransmission &transmission : std::as_const(cyclicTransmissions))
+            restored &= setupCyclicTransmission(transmission, true);
+        for (const ReceiveMonitor &monitor : std::as_const(receiveMonitors))
+            restored &= setupReceiveMonitor(monitor);
+        receiveMonitorsActive = !receiveMonitors.isEmpty();
+    }
+    if (Q_UNLIKELY(!restored)) {
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN,
+                  "Cannot restore all cyclic frames and receive monitors: %ls.",
+                  qUtf16Printable(qt_error_string(errno)));
+    }
+
+    bcmNotifier = new QSocketNotifier(socket, QSocketNotifier::Read, this);
+    connect(bcmNotifier, &QSocketNotifier::activated,
+            this, &SocketCanBackend::readBroadcastManager);
+    return true;
+}
+
+// Starts the transmission with the next frame of its schedule, or at once if
+// that is due now. Without startTimer, only the frame is replaced and the
+// timer keeps running. Must be called with broadcastManagerGuard locked.
+bool SocketCanBackend::setupCyclicTransmission(const CyclicTransmission &transmission,
+                                               bool startTimer)
+{
+    BroadcastMessage message = {};
+    message.head().opcode = TX_SETUP;
+    message.head().can_id = transmission.frame.can_id;
+    message.head().nframes = 1;
+    if (transmission.size == CANFD_MTU)
+        message.head().flags |= CAN_FD_FRAME;
+    if (startTimer) {
+        message.head().flags |= SETTIMER | STARTTIMER;
+        const qint64 elapsed = QDeadlineTimer::current().deadline()
+                - transmission.firstTransmission;
+        const int phase = elapsed < 0
+                ? int(-elapsed)
+                : int((transmission.period - elapsed % transmission.period)
+                      % transmission.period);
+        if (phase > 0) {
+            message.head().count = 1;
+            setInterval(&message.head().ival1, phase);
+        } else {
+            message.head().flags |= TX_ANNOUNCE;
         }
+        setInterval(&message.head().ival2, transmission.period);
+    }
+    message.frame() = transmission.frame;
 
-        struct timeval timeStamp = {};
-        if (Q_UNLIKELY(ioctl(canSocket, SIOCGSTAMP, &timeStamp) < 0)) {
-            setError(qt_error_string(errno),
-                     QCanBusDevice::CanBusError::ReadError);
-            timeStamp = {};
+    return writeBroadcastMessage(bcmSocket, message, transmission.size);
+}
+
+// Must be called with broadcastManagerGuard locked.
+bool SocketCanBackend::setupReceiveMonitor(const ReceiveMonitor &monitor)
+{
+    BroadcastMessage message = {};
+    message.head().opcode = RX_SETUP;
+    message.head().can_id = monitor.canId;
+    if (monitor.flexibleDataRate())
+        message.head().flags |= CAN_FD_FRAME;
+    if (monitor.timeout > 0) {
+        message.head().flags |= SETTIMER | STARTTIMER | RX_ANNOUNCE_RESUME;
+        setInterval(&message.head().ival1, monitor.timeout);
+    }
+
+    if (monitor.contentMask.isEmpty()) {
+        message.head().flags |= RX_FILTER_ID;
+    } else {
+        message.head().flags |= RX_CHECK_DLC;
+        message.head().nframes = 1;
+        message.frame().len = monitor.contentMask.size();
+        ::memcpy(message.frame().data, monitor.contentMask.constData(), message.frame().len);
+    }
+
+    return writeBroadcastMessage(bcmSocket, message,
+                                 monitor.flexibleDataRate() ? CANFD_MTU : CAN_MTU);
+}
+
+// Must be called with broadcastManagerGuard locked.
+bool SocketCanBackend::deleteBroadcastOperation(quint32 opcode, canid_t canId,
+                                                bool flexibleDataRate)
+{
+    BroadcastMessage message = {};
+    message.head().opcode = opcode;
+    message.head().can_id = canId;
+    message.head().flags = flexibleDataRate ? CAN_FD_FRAME : 0;
+
+    return writeBroadcastMessage(bcmSocket, message, 0);
+}
+
+// The broadcast manager has one transmission per frame identifier and format.
+// Returns 0 if there is none. Must be called with broadcastManagerGuard locked.
+int SocketCanBackend::cyclicTransmissionId(canid_t canId, size_t size) const
+{
+    for (auto it = cyclicTransmissions.cbegin(); it != cyclicTransmissions.cend(); ++it) {
+        if (it->frame.can_id == canId && it->size == size)
+            return it.key();
+    }
+    return 0;
+}
+
+bool SocketCanBackend::startCyclicTransmission(int id, const QCanBusFrame &frame, int period,
+                                               int phase)
+{
+    CyclicTransmission transmission = {{}, 0, period,
+                                       QDeadlineTimer::current().deadline() + phase};
+    if (!toSocketFrame(frame, &transmission.frame, &transmission.size))
+        return false;
+
+    QMutexLocker locker(&broadcastManagerGuard);
+    if (bcmSocket == -1
+            || cyclicTransmissionId(transmission.frame.can_id, transmission.size) != 0) {
+        return false;
+    }
+    if (Q_UNLIKELY(!setupCyclicTransmission(transmission, true))) {
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN,
+                  "Cannot start the cyclic transmission in the broadcast manager: %ls.",
+                  qUtf16Printable(qt_error_string(errno)));
+        return false;
+    }
+
+    cyclicTransmissions.insert(id, transmission);
+    return true;
+}
+
+// May be called from any thread, so the frame is checked here instead of
+// toSocketFrame(), which reports errors.
+bool SocketCanBackend::updateCyclicTransmission(int id, const QCanBusFrame &frame)
+{
+    if (Q_UNLIKELY(!canFdOptionEnabled.load(std::memory_order_relaxed)
+                   && frame.hasFlexibleDataRateFormat())) {
+        return false;
+    }
+
+    canfd_frame socketFrame;
+    size_t size = 0;
+    if (!toSocketFrame(frame, &socketFrame, &size))
+        return false;
+
+    QMutexLocker locker(&broadcastManagerGuard);
+    const auto transmission = cyclicTransmissions.find(id);
+    if (transmission == cyclicTransmissions.end())
+        return false;
+
+    const bool sameOperation = transmission->frame.can_id == socketFrame.can_id
+            && transmission->size == size;
+    if (!sameOperation && cyclicTransmissionId(socketFrame.can_id, size) != 0)
+        return false;
+
+    if (bcmSocket != -1 && !sameOperation) {
+        deleteBroadcastOperation(TX_DELETE, transmission->frame.can_id,
+                                 transmission->size == CANFD_MTU);
+    }
+    transmission->frame = socketFrame;
+    transmission->size = size;
+
+    return bcmSocket == -1 || setupCyclicTransmission(*transmission, !sameOperation);
+}
+
+void SocketCanBackend::stopCyclicTransmission(int id)
+{
+    QMutexLocker locker(&broadcastManagerGuard);
+    const auto transmission = cyclicTransmissions.find(id);
+    if (transmission == cyclicTransmissions.end())
+        return;
+
+    if (bcmSocket != -1) {
+        deleteBroadcastOperation(TX_DELETE, transmission->frame.can_id,
+                                 transmission->size == CANFD_MTU);
+    }
+    cyclicTransmissions.erase(transmission);
+}
+
+bool SocketCanBackend::startReceiveMonitor(QCanBusFrame::FrameId frameId,
+                                           const QByteArray &contentMask, int timeout,
+                                           bool extendedFrameFormat)
+{
+    const QCanBusFrame::FrameId maximum = extendedFrameFormat ? CAN_EFF_MASK : CAN_SFF_MASK;
+    if (Q_UNLIKELY(frameId > maximum || contentMask.size() > CANFD_MAX_DLEN || timeout < 0)) {
+        const QString error = tr("Cannot add a receive monitor with an invalid frame "
+                                 "identifier, content mask or timeout.");
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "%ls", qUtf16Printable(error));
+        setError(error, QCanBusDevice::ConfigurationError);
+        return false;
+    }
+
+    const ReceiveMonitor monitor = {frameId | (extendedFrameFormat ? CAN_EFF_FLAG : 0U),
+                                    contentMask, timeout};
+
+    QMutexLocker locker(&broadcastManagerGuard);
+    if (Q_UNLIKELY(bcmSocket == -1 && state() == ConnectedState)) {
+        locker.unlock();
+        const QString error = tr("Cannot add a receive monitor, because the CAN broadcast "
+                                 "manager is not available.");
+        qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "%ls", qUtf16Printable(error));
+        setError(error, QCanBusDevice::ConfigurationError);
+        return false;
+    }
+
+    if (bcmSocket != -1) {
+        // the previous operation may have another format or number of frames
+        const auto previous = receiveMonitors.constFind(monitor.canId);
+        if (previous != receiveMonitors.cend())
+            deleteBroadcastOperation(RX_DELETE, monitor.canId, previous->flexibleDataRate());
+
+        if (Q_UNLIKELY(!setupReceiveMonitor(monitor))) {
+            const QString error = tr("Cannot add a receive monitor: %1")
+                    .arg(qt_error_string(errno));
+            receiveMonitors.remove(monitor.canId);
+            receiveMonitorsActive = !receiveMonitors.isEmpty();
+            locker.unlock();
+            qCWarning(QT_CANBUS_PLUGINS_SOCKETCAN, "%ls", qUtf16Printable(error));
+            setError(error, QCanBusDevice::ConfigurationError);
+            return false;
         }
+    }
 
-        const QCanBusFrame::TimeStamp stamp(timeStamp.tv_sec, timeStamp.tv_usec);
-        QCanBusFrame bufferedFrame;
-        bufferedFrame.setTimeStamp(stamp);
-        bufferedFrame.setFlexibleDataRateFormat(bytesReceived == CANFD_MTU);
+    receiveMonitors.insert(monitor.canId, monitor);
+    receiveMonitorsActive = bcmSocket != -1;
+    return true;
+}
 
-        bufferedFrame.setExtendedFrameFormat(m_frame.can_id & CAN_EFF_FLAG);
-        Q_ASSERT(m_frame.len <= CANFD_MAX_DLEN);
+bool SocketCanBackend::stopReceiveMonitor(QCanBusFrame::FrameId frameId,
+                                          bool extendedFrameFormat)
+{
+    const canid_t canId = frameId | (extendedFrameFormat ? CAN_EFF_FLAG : 0U);
 
-        if (m_frame.can_id & CAN_RTR_FLAG)
-            bufferedFrame.setFrameType(QCanBusFrame::RemoteRequestFrame);
-        if (m_frame.can_id & CAN_ERR_FLAG)
-            bufferedFrame.setFrameType(QCanBusFrame::ErrorFrame);
-        if (m_frame.flags & CANFD_BRS)
-            bufferedFrame.setBitrateSwitch(true);
-        if (m_frame.flags & CANFD_ESI)
-            bufferedFrame.setErrorStateIndicator(true);
-        if (m_msg.msg_flags & MSG_CONFIRM)
-            bufferedFrame.setLocalEcho(true);
+    QMutexLocker locker(&broadcastManagerGuard);
+    const auto monitor = receiveMonitors.find(canId);
+    if (monitor == receiveMonitors.end())
+        return false;
 
-        bufferedFrame.setFrameId(m_frame.can_id & CAN_EFF_MASK);
+    if (bcmSocket != -1)
+        deleteBroadcastOperation(RX_DELETE, canId, monitor->flexibleDataRate());
+    receiveMonitors.erase(monitor);
+    receiveMonitorsActive = bcmSocket != -1 && !receiveMonitors.isEmpty();
+    return true;
+}
 
-        const QByteArray load(reinterpret_cast<char *>(m_frame.data), m_frame.len);
-        bufferedFrame.setPayload(load);
+// Delivers the frames of the receive monitors that changed, and their timeouts.
+// The broadcast manager keeps the receive timestamp of the frame that changed,
+// it is read like in readSocket().
+void SocketCanBackend::readBroadcastManager()
+{
+    QList<QCanBusFrame> newFrames;
+    BroadcastMessage message;
+    iovec iov = {message.data, sizeof(message.data)};
+    alignas(cmsghdr) char control[sizeof(ReceiveBuffer::control)];
+
+    for (;;) {
+        msghdr header = {};
+        header.msg_iov = &iov;
+        header.msg_iovlen = 1;
+        header.msg_control = control;
+        header.msg_controllen = sizeof(control);
+
+        const ssize_t bytesRead = ::recvmsg(bcmSocket, &header, 0);
+        if (bytesRead < ssize_t(sizeof(bcm_msg_head)))
+            break;
+
+        const canid_t canId = message.head().can_id;
+        if (message.head().opcode == RX_TIMEOUT) {
+            emit receiveTimeout(canId & CAN_EFF_MASK, canId & CAN_EFF_FLAG);
+            continue;
+        }
+        if (message.head().opcode != RX_CHANGED || message.head().nframes != 1)
+            continue;
+
+        const size_t frameSize = size_t(bytesRead) - sizeof(bcm_msg_head);
+        if (Q_UNLIKELY(frameSize != CANFD_MTU && frameSize != CAN_MTU)) {
+            setReadError(tr("ERROR SocketCanBackend: incomplete CAN frame"));
+            continue;
+        } else if (Q_UNLIKELY(message.frame().len > frameSize - offsetof(canfd_frame, data))) {
+            setReadError(tr("ERROR SocketCanBackend: invalid CAN frame length"));
+            continue;
+        }
 
-        newFrames.append(std::move(bufferedFrame));
+        QCanBusFrame frame = fromSocketFrame(message.frame(), frameSize == CANFD_MTU);
+        frame.setTimeStamp(frameTimeStamp(&header));
+        newFrames.append(std::move(frame));
     }
 
-    enqueueReceivedFrames(newFrames);
+    enqueueReceivedFrames(std::move(newFrames));
 }
 
 void SocketCanBackend::resetController()
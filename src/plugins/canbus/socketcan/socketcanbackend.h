@@ -43,7 +43,10 @@
 #include <QtSerialBus/qcanbusframe.h>
 #include <QtSerialBus/qcanbusdevice.h>
 #include <QtSerialBus/qcanbusdeviceinfo.h>
+#include <QtSerialBus/private/qcanbusdevicehooks_p.h>
 
+#include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
 #include <QtCore/qsocketnotifier.h>
 #include <QtCore/qstring.h>
 #include <QtCore/qvariant.h>
@@ -53,8 +56,11 @@
 #include <sys/socket.h>
 #include <sys/uio.h>
 #include <linux/can.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 #include <sys/time.h>
 
+#include <atomic>
 #include <memory>
 
 #ifndef CANFD_MTU
@@ -84,8 +90,9 @@ struct canfd_frame {
 QT_BEGIN_NAMESPACE
 
 class LibSocketCan;
+class QTimer;
 
-class SocketCanBackend : public QCanBusDevice
+class SocketCanBackend : public QCanBusDevice, private QCanBusDeviceHooks
 {
     Q_OBJECT
 public:
@@ -95,9 +102,8 @@ public:
     bool open() override;
     void close() override;
 
-    void setConfigurationParameter(ConfigurationKey key, const QVariant &value) override;
-
     bool writeFrame(const QCanBusFrame &newData) override;
+    qint64 writeFrameBatch(const QList<QCanBusFrame> &frames) override;
 
     QString interpretErrorFrame(const QCanBusFrame &errorFrame) override;
 
@@ -109,27 +115,121 @@ public:
     CanBusStatus busStatus() override;
     QCanBusDeviceInfo deviceInfo() const override;
 
+private:
+    bool startCyclicTransmission(int id, const QCanBusFrame &frame, int period,
+                                 int phase) override;
+    bool updateCyclicTransmission(int id, const QCanBusFrame &frame) override;
+    void stopCyclicTransmission(int id) override;
+    bool startReceiveMonitor(QCanBusFrame::FrameId frameId, const QByteArray &contentMask,
+                             int timeout, bool extendedFrameFormat) override;
+    bool stopReceiveMonitor(QCanBusFrame::FrameId frameId, bool extendedFrameFormat) override;
+    bool writeExpiringFrame(const QCanBusFrame &frame, qint64 deadline) override;
+    void writeOutgoingFrames() override;
+    bool setPluginConfigurationParameter(ConfigurationKey key, const QVariant &value) override;
+
 private Q_SLOTS:
     void readSocket();
+    void writeSocket();
+    void readBroadcastManager();
 
 private:
     void resetConfigurations();
     bool connectSocket();
     bool applyConfigurationParameter(ConfigurationKey key, const QVariant &value);
+    bool toSocketFrame(const QCanBusFrame &newData, canfd_frame *frame, size_t *size);
+    bool isWritable(const QCanBusFrame &frame) const;
+    void flushOutgoingFrames();
+    bool attachFilterProgram(const QList<can_filter> &filters);
+    bool detachFilterProgram();
+    void setupReceiveBuffers();
+    bool setupTimeStamping();
+    bool setupReceiveBufferSize(int bufferSize);
+    bool setupReceiveOwnMessages(bool receiveOwn);
+    void addPendingConfirmations(const canfd_frame *frames, int count);
+    bool takePendingConfirmation(const canfd_frame &echo, qint64 *sendTime);
+    QCanBusFrame::TimeStamp frameTimeStamp(msghdr *message) const;
+    void updateKernelDroppedFrames(msghdr *message);
+    void setReadError(const QString &errorText);
+
+    // operations of the kernel broadcast manager (CAN_BCM), which runs the
+    // cyclic frames and receive monitors while the device is connected
+    struct CyclicTransmission {
+        canfd_frame frame;
+        size_t size;
+        int period; // ms
+        qint64 firstTransmission; // ms of QDeadlineTimer::current()
+    };
+    struct ReceiveMonitor {
+        canid_t canId;
+        QByteArray contentMask;
+        int timeout; // ms
+        // an operation of the broadcast manager watches either classic or CAN FD frames
+        bool flexibleDataRate() const { return contentMask.size() > CAN_MAX_DLEN; }
+    };
+    bool connectBroadcastManager();
+    bool setupCyclicTransmission(const CyclicTransmission &transmission, bool startTimer);
+    bool setupReceiveMonitor(const ReceiveMonitor &monitor);
+    bool deleteBroadcastOperation(quint32 opcode, canid_t canId, bool flexibleDataRate);
+    int cyclicTransmissionId(canid_t canId, size_t size) const;
+    template <typename Functor>
+    void runInReadThread(Functor &&function);
+
+    enum {
+        WriteBatchSize = 64,
+        WriteRetryInterval = 1, // ms, doubled while the interface queue stays full
+        MaximumWriteRetryInterval = 64, // ms
+        CompiledFilterThreshold = 16,
+        DefaultReceiveBatchSize = 32,
+        MaximumReceiveBatchSize = 1024,
+        MaximumPendingConfirmations = 4096,
+        ConfirmationSearchDepth = 64
+    };
+
+    // storage for one message of a recvmmsg() batch
+    struct ReceiveBuffer {
+        canfd_frame frame;
+        sockaddr_can address;
+        iovec iov;
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(scm_timestamping))
+                                      + CMSG_SPACE(sizeof(__u32))];
+    };
 
     int protocol = CAN_RAW;
-    canfd_frame m_frame;
     sockaddr_can m_address;
-    msghdr m_msg;
-    iovec m_iov;
-    sockaddr_can m_addr;
-    char m_ctrlmsg[CMSG_SPACE(sizeof(timeval)) + CMSG_SPACE(sizeof(__u32))];
+    QList<ReceiveBuffer> m_receiveBuffers;
+    QList<mmsghdr> m_receiveMessages;
+    int receiveBatchSize = DefaultReceiveBatchSize;
+    std::atomic<TimeStampSource> timeStampSource = TimeStampSource::Software;
+    quint32 kernelDroppedFrames = 0;
+
+    // a written frame waiting for its echo, see TransmitConfirmationKey
+    struct PendingConfirmation {
+        canfd_frame frame;
+        qint64 sendTime; // microseconds since the epoch
+    };
+    std::atomic<bool> receiveOwnMessages = false;
+    std::atomic<bool> transmitConfirmation = false;
+    QMutex pendingConfirmationsGuard;
+    QList<PendingConfirmation> pendingConfirmations;
+
+    QMutex broadcastManagerGuard;
+    QHash<int, CyclicTransmission> cyclicTransmissions;
+    QHash<canid_t, ReceiveMonitor> receiveMonitors;
+    std::atomic<bool> receiveMonitorsActive = false;
+    int bcmSocket = -1;
+    QSocketNotifier *bcmNotifier = nullptr;
 
     qint64 canSocket = -1;
     QSocketNotifier *notifier = nullptr;
+    QSocketNotifier *writeNotifier = nullptr;
+    QTimer *writeRetryTimer = nullptr;
+    int writeRetryInterval = WriteRetryInterval;
+    bool writeBlocked = false;
+    bool compiledFilterEnabled = false;
+    bool filterProgramAttached = false;
     std::unique_ptr<LibSocketCan> libSocketCan;
     QString canSocketName;
-    bool canFdOptionEnabled = false;
+    std::atomic<bool> canFdOptionEnabled = false; // read by updateCyclicTransmission()
 };
 
 QT_END_NAMESPACE
@@ -0,0 +1,266 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "socketcanfilter.h"
+
+#include <QtCore/qendian.h>
+
+#include <algorithm>
+#include <cstddef>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Compiles a list of CAN_RAW_FILTER entries into a classic BPF program for
+    SO_ATTACH_FILTER. A frame passes the program if it matches any filter,
+    i.e. if (can_id & mask) == (filter.can_id & filter.mask).
+
+    The filters are first reduced to a minimal set of (id, mask) pairs. The
+    remaining filters are grouped by mask, and each group is evaluated with a
+    binary search over its sorted ids, so a frame is checked with a number of
+    instructions that grows with the logarithm of the filter count.
+
+    Classic BPF conditional jumps have an 8 bit offset only. Every conditional
+    jump in the program therefore skips at most one instruction, and all
+    longer jumps use BPF_JA, which has a 32 bit offset.
+*/
+
+namespace {
+
+// The program loads can_id with a BPF_ABS word load, which always reads in
+// network byte order. All constants are converted the same way, which keeps
+// AND and equality intact (byte swapping only permutes the bits).
+inline quint32 loadedValue(quint32 value)
+{
+    return qToBigEndian(value);
+}
+
+// leaves with at most this many ids are tested linearly
+constexpr qsizetype LinearSearchLimit = 4;
+
+class ProgramBuilder
+{
+public:
+    qsizetype emit(quint16 code, quint32 k, quint8 jt = 0, quint8 jf = 0)
+    {
+        program.append(sock_filter{code, jt, jf, k});
+        return program.size() - 1;
+    }
+
+    // emits a long jump whose target is set later with setTarget()
+    qsizetype emitJump() { return emit(BPF_JMP | BPF_JA, 0); }
+
+    void setTarget(qsizetype jump, qsizetype target)
+    {
+        program[jump].k = quint32(target - jump - 1);
+    }
+
+    qsizetype size() const { return program.size(); }
+
+    QList<sock_filter> program;
+    QList<qsizetype> acceptJumps;
+};
+
+void emitSearch(ProgramBuilder &builder, const quint32 *ids, qsizetype count,
+                QList<qsizetype> &missJumps)
+{
+    if (count <= LinearSearchLimit) {
+        for (qsizetype i = 0; i < count; ++i) {
+            // equal: take the next instruction (jump to accept), else skip it
+            builder.emit(BPF_JMP | BPF_JEQ | BPF_K, ids[i], 0, 1);
+            builder.acceptJumps.append(builder.emitJump());
+        }
+        missJumps.append(builder.emitJump());
+        return;
+    }
+
+    const qsizetype middle = count / 2;
+    // greater or equal: take the next instruction (jump to upper half)
+    builder.emit(BPF_JMP | BPF_JGE | BPF_K, ids[middle], 0, 1);
+    const qsizetype upperJump = builder.emitJump();
+    emitSearch(builder, ids, middle, missJumps);
+    builder.setTarget(upperJump, builder.size());
+    emitSearch(builder, ids + middle, count - middle, missJumps);
+}
+
+} // namespace
+
+namespace SocketCanFilter {
+
+/*
+    Returns an equivalent but smaller filter list. Filters that are matched
+    by a more general filter are removed, and pairs of filters with the same
+    mask whose ids differ in a single masked bit are merged into one filter
+    that ignores this bit. This is repeated until no further merge is possible.
+*/
+QList<can_filter> optimize(const QList<can_filter> &filters)
+{
+    QList<can_filter> result;
+    result.reserve(filters.size());
+    for (can_filter filter : filters) {
+        filter.can_id &= filter.can_mask;
+        result.append(filter);
+    }
+
+    const auto lessThan = [](const can_filter &a, const can_filter &b) {
+        return a.can_mask != b.can_mask ? a.can_mask < b.can_mask : a.can_id < b.can_id;
+    };
+    const auto equal = [](const can_filter &a, const can_filter &b) {
+        return a.can_mask == b.can_mask && a.can_id == b.can_id;
+    };
+
+    bool merged = true;
+    while (merged) {
+        merged = false;
+
+        std::sort(result.begin(), result.end(), lessThan);
+        result.erase(std::unique(result.begin(), result.end(), equal), result.end());
+
+        // drop filters covered by a filter with a subset of the mask bits
+        QList<can_filter> reduced;
+        reduced.reserve(result.size());
+        for (const can_filter &filter : std::as_const(result)) {
+            const bool covered = std::any_of(result.cbegin(), result.cend(),
+                                             [&filter](const can_filter &other) {
+                return (other.can_mask & ~filter.can_mask) == 0
+                        && other.can_mask != filter.can_mask
+                        && (filter.can_id & other.can_mask) == other.can_id;
+            });
+            if (!covered)
+                reduced.append(filter);
+        }
+        result.swap(reduced);
+
+        // merge filters with the same mask that differ in a single id bit
+        QList<bool> used(result.size(), false);
+        QList<can_filter> combined;
+        for (qsizetype i = 0; i < result.size(); ++i) {
+            if (used.at(i))
+                continue;
+            const can_filter filter = result.at(i);
+            for (quint32 mask = filter.can_mask; mask; mask &= mask - 1) {
+                const quint32 bit = mask & (~mask + 1);
+                if (filter.can_id & bit)
+                    continue;
+                const can_filter partner = {filter.can_id | bit, filter.can_mask};
+                const auto it = std::lower_bound(result.cbegin() + i + 1, result.cend(),
+                                                 partner, lessThan);
+                if (it == result.cend() || !equal(*it, partner))
+                    continue;
+                const qsizetype j = it - result.cbegin();
+                if (used.at(j))
+                    continue;
+                used[i] = used[j] = true;
+                combined.append(can_filter{filter.can_id, filter.can_mask & ~bit});
+                merged = true;
+                break;
+            }
+            if (!used.at(i))
+                combined.append(filter);
+        }
+        result.swap(combined);
+    }
+
+    return result;
+}
+
+/*
+    Compiles the filters into a BPF program. Returns false if the resulting
+    program exceeds the kernel limit of BPF_MAXINSNS instructions.
+
+    Error frames are not subject to CAN_RAW_FILTER but to CAN_RAW_ERR_FILTER.
+    To keep this behavior the program accepts all error frames, and filters
+    for error frames are ignored.
+*/
+bool compile(const QList<can_filter> &filters, QList<sock_filter> *program)
+{
+    QList<can_filter> dataFilters;
+    dataFilters.reserve(filters.size());
+    for (const can_filter &filter : filters) {
+        if (!(filter.can_id & filter.can_mask & CAN_ERR_FLAG))
+            dataFilters.append(filter);
+    }
+    dataFilters = optimize(dataFilters);
+
+    ProgramBuilder builder;
+
+    // A = can_id, X = can_id
+    builder.emit(BPF_LD | BPF_W | BPF_ABS, offsetof(can_frame, can_id));
+    builder.emit(BPF_MISC | BPF_TAX, 0);
+    // error frames: take the next instruction (jump to accept)
+    builder.emit(BPF_JMP | BPF_JSET | BPF_K, loadedValue(CAN_ERR_FLAG), 0, 1);
+    builder.acceptJumps.append(builder.emitJump());
+
+    // optimize() sorts by mask, so every group is a contiguous range
+    QList<quint32> ids;
+    for (qsizetype first = 0; first < dataFilters.size(); ) {
+        const quint32 mask = dataFilters.at(first).can_mask;
+        ids.clear();
+        qsizetype last = first;
+        for (; last < dataFilters.size() && dataFilters.at(last).can_mask == mask; ++last)
+            ids.append(loadedValue(dataFilters.at(last).can_id));
+        first = last;
+
+        std::sort(ids.begin(), ids.end());
+
+        QList<qsizetype> missJumps;
+        builder.emit(BPF_MISC | BPF_TXA, 0);
+        builder.emit(BPF_ALU | BPF_AND | BPF_K, loadedValue(mask));
+        emitSearch(builder, ids.constData(), ids.size(), missJumps);
+
+        // frames not matching this group continue with the next group
+        for (qsizetype jump : std::as_const(missJumps))
+            builder.setTarget(jump, builder.size());
+    }
+
+    builder.emit(BPF_RET | BPF_K, 0); // reject
+    const qsizetype accept = builder.emit(BPF_RET | BPF_K, 0xFFFFFFFFU);
+    for (qsizetype jump : std::as_const(builder.acceptJumps))
+        builder.setTarget(jump, accept);
+
+    if (builder.size() > BPF_MAXINSNS)
+        return false;
+
+    *program = std::move(builder.program);
+    return true;
+}
+
+} // namespace SocketCanFilter
+
+QT_END_NAMESPACE
@@ -42,6 +42,7 @@
 #include "systeccan_symbols_p.h"
 
 #include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/private/qcanbusdevice_p.h>
 
 #include <QtCore/qcoreapplication.h>
 #include <QtCore/qcoreevent.h>
@@ -264,6 +265,8 @@ bool SystecCanBackendPrivate::setConfigurationParameter(QCanBusDevice::Configura
     switch (key) {
     case QCanBusDevice::BitRateKey:
         return verifyBitRate(value.toInt());
+    case QCanBusDevice::RawFilterKey:
+        return true; // applied by QCanBusDevice
     case QCanBusDevice::ReceiveOwnKey:
         if (Q_UNLIKELY(q->state() != QCanBusDevice::UnconnectedState)) {
             q->setError(SystecCanBackend::tr("Cannot configure TxEcho for open device"),
@@ -366,16 +369,10 @@ void SystecCanBackendPrivate::enableWriteNotification(bool enable)
     }
 }
 
-void SystecCanBackendPrivate::startWrite()
+bool SystecCanBackendPrivate::writeMessage(const QCanBusFrame &frame)
 {
     Q_Q(SystecCanBackend);
 
-    if (!q->hasOutgoingFrames()) {
-        enableWriteNotification(false);
-        return;
-    }
-
-    const QCanBusFrame frame = q->dequeueOutgoingFrame();
     const QByteArray payload = frame.payload();
     const qsizetype payloadSize = payload.size();
 
@@ -392,10 +389,39 @@ void SystecCanBackendPrivate::startWrite()
         ::memcpy(message.m_bData, payload.constData(), payloadSize);
 
     const UCANRET result = ::UcanWriteCanMsgEx(handle, channel, &message, nullptr);
-    if (Q_UNLIKELY(result != USBCAN_SUCCESSFUL))
+    if (Q_UNLIKELY(result != USBCAN_SUCCESSFUL)) {
         q->setError(systemErrorString(result), QCanBusDevice::WriteError);
-    else
-        emit q->framesWritten(qint64(1));
+        return false;
+    }
+
+    return true;
+}
+
+void SystecCanBackendPrivate::startWrite()
+{
+    Q_Q(SystecCanBackend);
+
+    if (!q->hasOutgoingFrames()) {
+        enableWriteNotification(false);
+        return;
+    }
+
+    qint64 framesWritten = 0;
+    qint64 bytesWritten = 0;
+    while (q->hasOutgoingFrames()) {
+        const QCanBusFrame frame = q->dequeueOutgoingFrame();
+        if (!frame.isValid()) // the remaining frames expired
+            break;
+        if (!writeMessage(frame))
+            break;
+        ++framesWritten;
+        bytesWritten += frame.payloadView().size();
+    }
+
+    if (framesWritten > 0) {
+        QCanBusDevicePrivate::get(q)->countWrittenBytes(bytesWritten);
+        emit q->framesWritten(framesWritten);
+    }
 
     if (q->hasOutgoingFrames())
         enableWriteNotification(true);
@@ -436,7 +462,7 @@ void SystecCanBackendPrivate::readAllReceivedMessages()
         newFrames.append(std::move(frame));
     }
 
-    q->enqueueReceivedFrames(newFrames);
+    q->enqueueReceivedFrames(std::move(newFrames));
 }
 
 bool SystecCanBackendPrivate::verifyBitRate(int bitrate)
@@ -493,6 +519,7 @@ QCanBusDevice::CanBusStatus SystecCanBackendPrivate::busStatus()
 
 SystecCanBackend::SystecCanBackend(const QString &name, QObject *parent) :
     QCanBusDevice(parent),
+    QCanBusDeviceHooks(this),
     d_ptr(new SystecCanBackendPrivate(this))
 {
     Q_D(SystecCanBackend);
@@ -518,7 +545,7 @@ bool SystecCanBackend::open()
 
     // Apply all stored configurations except bitrate and receive own,
     // because these cannot be applied after opening the device
-    const auto keys = configurationKeys();
+    const auto keys = pluginConfigurationKeys();
     for (ConfigurationKey key : keys) {
         if (key == BitRateKey || key == ReceiveOwnKey)
             continue;
@@ -543,15 +570,19 @@ void SystecCanBackend::close()
     setState(QCanBusDevice::UnconnectedState);
 }
 
-void SystecCanBackend::setConfigurationParameter(ConfigurationKey key, const QVariant &value)
+bool SystecCanBackend::setPluginConfigurationParameter(ConfigurationKey key, const QVariant &value)
 {
     Q_D(SystecCanBackend);
 
-    if (d->setConfigurationParameter(key, value))
-        QCanBusDevice::setConfigurationParameter(key, value);
+    return d->setConfigurationParameter(key, value);
 }
 
 bool SystecCanBackend::writeFrame(const QCanBusFrame &newData)
+{
+    return writeExpiringFrame(newData, NoDeadline);
+}
+
+bool SystecCanBackend::writeExpiringFrame(const QCanBusFrame &newData, qint64 deadline)
 {
     Q_D(SystecCanBackend);
 
@@ -576,12 +607,19 @@ bool SystecCanBackend::writeFrame(const QCanBusFrame &newData)
         return false;
     }
 
-    enqueueOutgoingFrame(newData);
+    enqueueExpiringFrame(newData, deadline);
     d->enableWriteNotification(true);
 
     return true;
 }
 
+void SystecCanBackend::writeOutgoingFrames()
+{
+    Q_D(SystecCanBackend);
+
+    d->enableWriteNotification(true);
+}
+
 // TODO: Implement me
 QString SystecCanBackend::interpretErrorFrame(const QCanBusFrame &errorFrame)
 {
@@ -43,6 +43,7 @@
 #include <QtSerialBus/qcanbusframe.h>
 #include <QtSerialBus/qcanbusdevice.h>
 #include <QtSerialBus/qcanbusdeviceinfo.h>
+#include <QtSerialBus/private/qcanbusdevicehooks_p.h>
 
 #include <QtCore/qvariant.h>
 #include <QtCore/qlist.h>
@@ -51,7 +52,7 @@ QT_BEGIN_NAMESPACE
 
 class SystecCanBackendPrivate;
 
-class SystecCanBackend : public QCanBusDevice
+class SystecCanBackend : public QCanBusDevice, private QCanBusDeviceHooks
 {
     Q_OBJECT
     Q_DECLARE_PRIVATE(SystecCanBackend)
@@ -63,8 +64,6 @@ public:
     bool open() override;
     void close() override;
 
-    void setConfigurationParameter(ConfigurationKey key, const QVariant &value) override;
-
     bool writeFrame(const QCanBusFrame &newData) override;
 
     QString interpretErrorFrame(const QCanBusFrame &errorFrame) override;
@@ -84,6 +83,10 @@ public:
     QCanBusDeviceInfo deviceInfo() const override;
 
 private:
+    bool writeExpiringFrame(const QCanBusFrame &newData, qint64 deadline) override;
+    void writeOutgoingFrames() override;
+    bool setPluginConfigurationParameter(ConfigurationKey key, const QVariant &value) override;
+
     SystecCanBackendPrivate * const d_ptr;
 };
 
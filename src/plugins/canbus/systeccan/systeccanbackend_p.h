@@ -92,6 +92,7 @@ public:
     void setupDefaultConfigurations();
     QString systemErrorString(int errorCode);
     void enableWriteNotification(bool enable);
+    bool writeMessage(const QCanBusFrame &frame);
     void startWrite();
     void readAllReceivedMessages();
     bool verifyBitRate(int bitrate);
@@ -44,6 +44,7 @@
 #include "tinycan_symbols_p.h"
 
 #include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/private/qcanbusdevice_p.h>
 
 #include <QtCore/qtimer.h>
 #include <QtCore/qmutex.h>
@@ -244,6 +245,8 @@ bool TinyCanBackendPrivate::setConfigurationParameter(QCanBusDevice::Configurati
     switch (key) {
     case QCanBusDevice::BitRateKey:
         return setBitRate(value.toInt());
+    case QCanBusDevice::RawFilterKey:
+        return true; // applied by QCanBusDevice
     default:
         q->setError(TinyCanBackend::tr("Unsupported configuration key: %1").arg(key),
                     QCanBusDevice::ConfigurationError);
@@ -349,30 +352,57 @@ void TinyCanBackendPrivate::startWrite()
 {
     Q_Q(TinyCanBackend);
 
+    // frames are peeked below, so discard the expired ones beforehand
+    q->dropExpiredFrames();
     if (!q->hasOutgoingFrames()) {
         writeNotifier->stop();
         return;
     }
 
-    const QCanBusFrame frame = q->dequeueOutgoingFrame();
-    const QByteArray payload = frame.payload();
-    const qsizetype payloadSize = payload.size();
-
-    TCanMsg message = {};
-    message.Id = frame.frameId();
-    message.Flags.Flag.Len = payloadSize;
-    message.Flags.Flag.Error = (frame.frameType() == QCanBusFrame::ErrorFrame);
-    message.Flags.Flag.RTR = (frame.frameType() == QCanBusFrame::RemoteRequestFrame);
-    message.Flags.Flag.TxD = 1;
-    message.Flags.Flag.EFF = frame.hasExtendedFrameFormat();
-
-    const qint32 messagesToWrite = 1;
-    ::memcpy(message.Data.Bytes, payload.constData(), payloadSize);
-    const int ret = ::CanTransmit(channelIndex, &message, messagesToWrite);
-    if (Q_UNLIKELY(ret < 0))
+    // CanTransmit() accepts several messages at once, so pass all pending
+    // frames (up to the size of the local buffer) with a single call. The
+    // frames stay queued until the driver took them.
+    enum { MaxMessagesToWrite = 64 };
+    TCanMsg messages[MaxMessagesToWrite] = {};
+    const qint32 messagesToWrite = qint32(qMin(q->outgoingFrameCount(),
+                                               qint64(MaxMessagesToWrite)));
+
+    for (qint32 i = 0; i < messagesToWrite; ++i) {
+        const QCanBusFrame frame = q->peekOutgoingFrame(i);
+        const QByteArray payload = frame.payload();
+        const qsizetype payloadSize = payload.size();
+
+        TCanMsg &message = messages[i];
+        message.Id = frame.frameId();
+        message.Flags.Flag.Len = payloadSize;
+        message.Flags.Flag.Error = (frame.frameType() == QCanBusFrame::ErrorFrame);
+        message.Flags.Flag.RTR = (frame.frameType() == QCanBusFrame::RemoteRequestFrame);
+        message.Flags.Flag.TxD = 1;
+        message.Flags.Flag.EFF = frame.hasExtendedFrameFormat();
+
+        ::memcpy(message.Data.Bytes, payload.constData(), payloadSize);
+    }
+
+    // CanTransmit() returns the number of messages put into the transmit
+    // FIFO, the remaining frames are written on the next round
+    const int ret = ::CanTransmit(channelIndex, messages, messagesToWrite);
+    if (Q_UNLIKELY(ret < 0)) {
+        // keep the frames, they are retried with the next frame written
+        // instead of polling a failing driver
         q->setError(systemErrorString(ret), QCanBusDevice::CanBusError::WriteError);
-    else
-        emit q->framesWritten(messagesToWrite);
+        writeNotifier->stop();
+        return;
+    }
+
+    const qint32 written = qMin(qint32(ret), messagesToWrite);
+    if (written > 0) {
+        qint64 bytesWritten = 0;
+        for (qint32 i = 0; i < written; ++i)
+            bytesWritten += messages[i].Flags.Flag.Len;
+        q->removeOutgoingFrames(written);
+        QCanBusDevicePrivate::get(q)->countWrittenBytes(bytesWritten);
+        emit q->framesWritten(written);
+    }
 
     if (q->hasOutgoingFrames() && !writeNotifier->isActive())
         writeNotifier->start();
@@ -425,7 +455,7 @@ void TinyCanBackendPrivate::startRead()
         newFrames.append(std::move(frame));
     }
 
-    q->enqueueReceivedFrames(newFrames);
+    q->enqueueReceivedFrames(std::move(newFrames));
 }
 
 void TinyCanBackendPrivate::startupDriver()
@@ -501,6 +531,7 @@ bool TinyCanBackendPrivate::setBitRate(int bitrate)
 
 TinyCanBackend::TinyCanBackend(const QString &name, QObject *parent)
     : QCanBusDevice(parent)
+    , QCanBusDeviceHooks(this)
     , d_ptr(new TinyCanBackendPrivate(this))
 {
     Q_D(TinyCanBackend);
@@ -526,7 +557,7 @@ bool TinyCanBackend::open()
         }
 
         // apply all stored configurations
-        const auto keys = configurationKeys();
+        const auto keys = pluginConfigurationKeys();
         for (ConfigurationKey key : keys) {
             const QVariant param = configurationParameter(key);
             const bool success = d->setConfigurationParameter(key, param);
@@ -550,15 +581,19 @@ void TinyCanBackend::close()
     setState(QCanBusDevice::UnconnectedState);
 }
 
-void TinyCanBackend::setConfigurationParameter(ConfigurationKey key, const QVariant &value)
+bool TinyCanBackend::setPluginConfigurationParameter(ConfigurationKey key, const QVariant &value)
 {
     Q_D(TinyCanBackend);
 
-    if (d->setConfigurationParameter(key, value))
-        QCanBusDevice::setConfigurationParameter(key, value);
+    return d->setConfigurationParameter(key, value);
 }
 
 bool TinyCanBackend::writeFrame(const QCanBusFrame &newData)
+{
+    return writeExpiringFrame(newData, NoDeadline);
+}
+
+bool TinyCanBackend::writeExpiringFrame(const QCanBusFrame &newData, qint64 deadline)
 {
     Q_D(TinyCanBackend);
 
@@ -584,7 +619,7 @@ bool TinyCanBackend::writeFrame(const QCanBusFrame &newData)
         return false;
     }
 
-    enqueueOutgoingFrame(newData);
+    enqueueExpiringFrame(newData, deadline);
 
     if (!d->writeNotifier->isActive())
         d->writeNotifier->start();
@@ -592,6 +627,14 @@ bool TinyCanBackend::writeFrame(const QCanBusFrame &newData)
     return true;
 }
 
+void TinyCanBackend::writeOutgoingFrames()
+{
+    Q_D(TinyCanBackend);
+
+    if (d->writeNotifier && !d->writeNotifier->isActive())
+        d->writeNotifier->start();
+}
+
 // TODO: Implement me
 QString TinyCanBackend::interpretErrorFrame(const QCanBusFrame &errorFrame)
 {
@@ -44,6 +44,7 @@
 #include <QtSerialBus/qcanbusdevice.h>
 #include <QtSerialBus/qcanbusdeviceinfo.h>
 #include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/private/qcanbusdevicehooks_p.h>
 
 #include <QtCore/qlist.h>
 #include <QtCore/qvariant.h>
@@ -52,7 +53,7 @@ QT_BEGIN_NAMESPACE
 
 class TinyCanBackendPrivate;
 
-class TinyCanBackend : public QCanBusDevice
+class TinyCanBackend : public QCanBusDevice, private QCanBusDeviceHooks
 {
     Q_OBJECT
     Q_DECLARE_PRIVATE(TinyCanBackend)
@@ -64,8 +65,6 @@ public:
     bool open() override;
     void close() override;
 
-    void setConfigurationParameter(ConfigurationKey key, const QVariant &value) override;
-
     bool writeFrame(const QCanBusFrame &newData) override;
 
     QString interpretErrorFrame(const QCanBusFrame &errorFrame) override;
@@ -77,6 +76,10 @@ public:
     QCanBusDeviceInfo deviceInfo() const override;
 
 private:
+    bool writeExpiringFrame(const QCanBusFrame &newData, qint64 deadline) override;
+    void writeOutgoingFrames() override;
+    bool setPluginConfigurationParameter(ConfigurationKey key, const QVariant &value) override;
+
     TinyCanBackendPrivate * const d_ptr;
 };
 
@@ -42,6 +42,7 @@
 #include "vectorcan_symbols_p.h"
 
 #include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/private/qcanbusdevice_p.h>
 
 #include <QtCore/qtimer.h>
 #include <QtCore/qcoreevent.h>
@@ -265,6 +266,8 @@ bool VectorCanBackendPrivate::setConfigurationParameter(QCanBusDevice::Configura
     switch (key) {
     case QCanBusDevice::BitRateKey:
         return setBitRate(value.toUInt());
+    case QCanBusDevice::RawFilterKey:
+        return true; // applied by QCanBusDevice
     case QCanBusDevice::ReceiveOwnKey:
         transmitEcho = value.toBool();
         return true;
@@ -340,6 +343,11 @@ void VectorCanBackendPrivate::startWrite()
     }
 
     const QCanBusFrame frame = q->dequeueOutgoingFrame();
+    if (!frame.isValid()) { // the remaining frames expired
+        writeNotifier->stop();
+        return;
+    }
+
     const QByteArray payload = frame.payload();
     const qsizetype payloadSize = payload.size();
 
@@ -388,6 +396,7 @@ void VectorCanBackendPrivate::startWrite()
         q->setError(systemErrorString(status),
                     QCanBusDevice::WriteError);
     } else {
+        QCanBusDevicePrivate::get(q)->countWrittenBytes(payloadSize);
         emit q->framesWritten(qint64(eventCount));
     }
 
@@ -463,7 +472,7 @@ void VectorCanBackendPrivate::startRead()
         }
     }
 
-    q->enqueueReceivedFrames(newFrames);
+    q->enqueueReceivedFrames(std::move(newFrames));
 }
 
 XLstatus VectorCanBackendPrivate::loadDriver()
@@ -546,6 +555,7 @@ bool VectorCanBackendPrivate::setDataBitRate(quint32 bitrate)
 
 VectorCanBackend::VectorCanBackend(const QString &name, QObject *parent)
     : QCanBusDevice(parent)
+    , QCanBusDeviceHooks(this)
     , d_ptr(new VectorCanBackendPrivate(this))
 {
     Q_D(VectorCanBackend);
@@ -571,7 +581,7 @@ bool VectorCanBackend::open()
         return false;
     }
 
-    const auto keys = configurationKeys();
+    const auto keys = pluginConfigurationKeys();
     for (ConfigurationKey key : keys) {
         const QVariant param = configurationParameter(key);
         const bool success = d->setConfigurationParameter(key, param);
@@ -594,15 +604,19 @@ void VectorCanBackend::close()
     setState(QCanBusDevice::UnconnectedState);
 }
 
-void VectorCanBackend::setConfigurationParameter(ConfigurationKey key, const QVariant &value)
+bool VectorCanBackend::setPluginConfigurationParameter(ConfigurationKey key, const QVariant &value)
 {
     Q_D(VectorCanBackend);
 
-    if (d->setConfigurationParameter(key, value))
-        QCanBusDevice::setConfigurationParameter(key, value);
+    return d->setConfigurationParameter(key, value);
 }
 
 bool VectorCanBackend::writeFrame(const QCanBusFrame &newData)
+{
+    return writeExpiringFrame(newData, NoDeadline);
+}
+
+bool VectorCanBackend::writeExpiringFrame(const QCanBusFrame &newData, qint64 deadline)
 {
     Q_D(VectorCanBackend);
 
@@ -629,7 +643,7 @@ bool VectorCanBackend::writeFrame(const QCanBusFrame &newData)
         return false;
     }
 
-    enqueueOutgoingFrame(newData);
+    enqueueExpiringFrame(newData, deadline);
 
     if (!d->writeNotifier->isActive())
         d->writeNotifier->start();
@@ -637,6 +651,14 @@ bool VectorCanBackend::writeFrame(const QCanBusFrame &newData)
     return true;
 }
 
+void VectorCanBackend::writeOutgoingFrames()
+{
+    Q_D(VectorCanBackend);
+
+    if (d->writeNotifier && !d->writeNotifier->isActive())
+        d->writeNotifier->start();
+}
+
 // TODO: Implement me
 QString VectorCanBackend::interpretErrorFrame(const QCanBusFrame &errorFrame)
 {
@@ -39,9 +39,12 @@
 
 #include "virtualcanbackend.h"
 
+#include <QtSerialBus/private/qcanbusdevice_p.h>
+
 #include <QtCore/qdatetime.h>
 #include <QtCore/qloggingcategory.h>
 #include <QtCore/qregularexpression.h>
+#include <QtCore/qthread.h>
 
 #include <QtNetwork/qtcpserver.h>
 #include <QtNetwork/qtcpsocket.h>
@@ -169,7 +172,7 @@ void VirtualCanServer::readyRead()
 Q_GLOBAL_STATIC(VirtualCanServer, g_server)
 
 VirtualCanBackend::VirtualCanBackend(const QString &interface, QObject *parent)
-    : QCanBusDevice(parent)
+    : QCanBusDevice(parent), QCanBusDeviceHooks(this)
 {
     m_url = QUrl(interface);
     const QString canDevice = m_url.fileName();
@@ -197,6 +200,11 @@ VirtualCanBackend::VirtualCanBackend(const QString &interface, QObject *parent)
 
 VirtualCanBackend::~VirtualCanBackend()
 {
+    if (m_clientSocket && m_clientSocket->thread() != thread()) {
+        m_clientSocket->deleteLater();
+        stopIoThread();
+    }
+
     qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN, "Client [%p] socket destructed.", this);
 }
 
@@ -211,11 +219,23 @@ bool VirtualCanBackend::open()
     if (address.isLoopback())
         g_server->start(port);
 
-    m_clientSocket = new QTcpSocket(this);
-    m_clientSocket->connectToHost(address, port, QIODevice::ReadWrite);
-    connect(m_clientSocket, &QAbstractSocket::connected, this, &VirtualCanBackend::clientConnected);
-    connect(m_clientSocket, &QAbstractSocket::disconnected, this, &VirtualCanBackend::clientDisconnected);
-    connect(m_clientSocket, &QIODevice::readyRead, this, &VirtualCanBackend::clientReadyRead);
+    // With IoThreadKey, the client socket is handled in the I/O thread of
+    // QCanBusDevice and received frames are enqueued from there.
+    QTcpSocket *socket = new QTcpSocket;
+    if (QThread *socketThread = ioThread())
+        socket->moveToThread(socketThread);
+    else
+        socket->setParent(this);
+    m_clientSocket = socket;
+
+    connect(socket, &QAbstractSocket::connected, this, &VirtualCanBackend::clientConnected);
+    connect(socket, &QAbstractSocket::disconnected, this, &VirtualCanBackend::clientDisconnected);
+    connect(socket, &QIODevice::readyRead, this, [this, socket]() {
+        clientReadyRead(socket);
+    }, Qt::DirectConnection);
+    runInSocketThread([socket, address, port]() {
+        socket->connectToHost(address, port, QIODevice::ReadWrite);
+    });
     qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN, "Client [%p] socket created.", this);
     return true;
 }
@@ -224,13 +244,42 @@ void VirtualCanBackend::close()
 {
     qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN, "Client [%p] sends disconnect to server.", this);
 
-    m_clientSocket->write("disconnect:can" + QByteArray::number(m_channel) + '\n');
+    writeCommand("disconnect:can" + QByteArray::number(m_channel) + '\n');
 }
 
-void VirtualCanBackend::setConfigurationParameter(ConfigurationKey key, const QVariant &value)
+bool VirtualCanBackend::setPluginConfigurationParameter(ConfigurationKey key,
+                                                        const QVariant &)
 {
-    if (key == QCanBusDevice::ReceiveOwnKey || key == QCanBusDevice::CanFdKey)
-        QCanBusDevice::setConfigurationParameter(key, value);
+    switch (key) {
+    case QCanBusDevice::RawFilterKey:
+    case QCanBusDevice::ReceiveOwnKey:
+    case QCanBusDevice::CanFdKey:
+    case QCanBusDevice::IoThreadKey:
+    case QCanBusDevice::IoThreadAffinityKey:
+    case QCanBusDevice::IoThreadPriorityKey:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// With IoThreadKey, the client socket must only be used in the I/O thread.
+template <typename Functor>
+void VirtualCanBackend::runInSocketThread(Functor &&function)
+{
+    if (m_clientSocket->thread() != thread())
+        QMetaObject::invokeMethod(m_clientSocket, std::forward<Functor>(function),
+                                  Qt::QueuedConnection);
+    else
+        function();
+}
+
+void VirtualCanBackend::writeCommand(const QByteArray &command)
+{
+    QTcpSocket *socket = m_clientSocket;
+    runInSocketThread([socket, command]() {
+        socket->write(command);
+    });
 }
 
 /*
@@ -253,18 +302,13 @@ void VirtualCanBackend::setConfigurationParameter(ConfigurationKey key, const QV
     Afterwards the CAN-ID and the data follows, both separated by '#'.
 */
 
-bool VirtualCanBackend::writeFrame(const QCanBusFrame &frame)
+QByteArray VirtualCanBackend::frameCommand(const QCanBusFrame &frame) const
 {
-    if (Q_UNLIKELY(state() != ConnectedState)) {
-        qCWarning(QT_CANBUS_PLUGINS_VIRTUALCAN, "Error: Cannot write frame as client is not connected!");
-        return false;
-    }
-
     bool canFdEnabled = configurationParameter(QCanBusDevice::CanFdKey).toBool();
     if (Q_UNLIKELY(frame.hasFlexibleDataRateFormat() && !canFdEnabled)) {
         qCWarning(QT_CANBUS_PLUGINS_VIRTUALCAN,
                 "Error: Cannot write CAN FD frame as CAN FD is not enabled!");
-        return false;
+        return QByteArray();
     }
 
     QByteArray flags;
@@ -281,22 +325,80 @@ bool VirtualCanBackend::writeFrame(const QCanBusFrame &frame)
     if (frame.hasLocalEcho())
         flags.append(LocalEchoFlag);
     const QByteArray frameId = QByteArray::number(frame.frameId());
-    const QByteArray command = "can" + QByteArray::number(m_channel)
+    return "can" + QByteArray::number(m_channel)
             + ':' + frameId + '#' + flags + '#' + frame.payload().toHex() + '\n';
-    m_clientSocket->write(command);
+}
+
+static QCanBusFrame echoFrame(const QCanBusFrame &frame, qint64 timeStamp)
+{
+    QCanBusFrame echoFrame = frame;
+    echoFrame.setLocalEcho(true);
+    echoFrame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(timeStamp * 1000));
+    return echoFrame;
+}
+
+bool VirtualCanBackend::writeFrame(const QCanBusFrame &frame)
+{
+    if (Q_UNLIKELY(state() != ConnectedState)) {
+        qCWarning(QT_CANBUS_PLUGINS_VIRTUALCAN, "Error: Cannot write frame as client is not connected!");
+        return false;
+    }
+
+    const QByteArray command = frameCommand(frame);
+    if (Q_UNLIKELY(command.isEmpty()))
+        return false;
+
+    writeCommand(command);
 
     if (configurationParameter(QCanBusDevice::ReceiveOwnKey).toBool()) {
         const qint64 timeStamp = QDateTime::currentDateTime().toMSecsSinceEpoch();
-        QCanBusFrame echoFrame = frame;
-        echoFrame.setLocalEcho(true);
-        echoFrame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(timeStamp * 1000));
-        enqueueReceivedFrames({echoFrame});
+        enqueueReceivedFrames({echoFrame(frame, timeStamp)});
     }
 
+    QCanBusDevicePrivate::get(this)->countWrittenBytes(frame.payloadView().size());
     emit framesWritten(qint64(1));
     return true;
 }
 
+qint64 VirtualCanBackend::writeFrameBatch(const QList<QCanBusFrame> &frames)
+{
+    if (Q_UNLIKELY(state() != ConnectedState)) {
+        qCWarning(QT_CANBUS_PLUGINS_VIRTUALCAN, "Error: Cannot write frame as client is not connected!");
+        return 0;
+    }
+
+    // all commands of the batch are sent with a single socket write
+    QByteArray commands;
+    qint64 written = 0;
+    qint64 bytes = 0;
+    for (const QCanBusFrame &frame : frames) {
+        const QByteArray command = frameCommand(frame);
+        if (Q_UNLIKELY(command.isEmpty()))
+            break;
+        commands += command;
+        bytes += frame.payloadView().size();
+        ++written;
+    }
+
+    if (written == 0)
+        return 0;
+
+    writeCommand(commands);
+
+    if (configurationParameter(QCanBusDevice::ReceiveOwnKey).toBool()) {
+        const qint64 timeStamp = QDateTime::currentDateTime().toMSecsSinceEpoch();
+        QList<QCanBusFrame> echoFrames;
+        echoFrames.reserve(written);
+        for (qint64 i = 0; i < written; ++i)
+            echoFrames.append(echoFrame(frames.at(i), timeStamp));
+        enqueueReceivedFrames(std::move(echoFrames));
+    }
+
+    QCanBusDevicePrivate::get(this)->countWrittenBytes(bytes);
+    emit framesWritten(written);
+    return written;
+}
+
 QString VirtualCanBackend::interpretErrorFrame(const QCanBusFrame &errorFrame)
 {
     Q_UNUSED(errorFrame);
@@ -330,7 +432,7 @@ QCanBusDeviceInfo VirtualCanBackend::deviceInfo() const
 void VirtualCanBackend::clientConnected()
 {
     qCInfo(QT_CANBUS_PLUGINS_VIRTUALCAN, "Client [%p] socket connected.", this);
-    m_clientSocket->write("connect:can" + QByteArray::number(m_channel) + '\n');
+    writeCommand("connect:can" + QByteArray::number(m_channel) + '\n');
 
     setState(QCanBusDevice::ConnectedState);
 }
@@ -339,18 +441,25 @@ void VirtualCanBackend::clientDisconnected()
 {
     qCInfo(QT_CANBUS_PLUGINS_VIRTUALCAN, "Client [%p] socket disconnected.", this);
 
+    if (m_clientSocket && m_clientSocket->thread() != thread()) {
+        m_clientSocket->deleteLater();
+        m_clientSocket = nullptr;
+        stopIoThread();
+    }
+
     setState(UnconnectedState);
 }
 
-void VirtualCanBackend::clientReadyRead()
+// Runs in the I/O thread if IoThreadKey is enabled.
+void VirtualCanBackend::clientReadyRead(QTcpSocket *socket)
 {
-    while (m_clientSocket->canReadLine()) {
-        const QByteArray answer = m_clientSocket->readLine().trimmed();
+    while (socket->canReadLine()) {
+        const QByteArray answer = socket->readLine().trimmed();
         qCDebug(QT_CANBUS_PLUGINS_VIRTUALCAN, "Client [%p] received: '%s'.",
                 this, answer.constData());
 
         if (answer.startsWith("disconnect:can" + QByteArray::number(m_channel))) {
-            m_clientSocket->disconnectFromHost();
+            socket->disconnectFromHost();
             continue;
         }
 
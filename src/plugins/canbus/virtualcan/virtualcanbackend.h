@@ -42,6 +42,7 @@
 
 #include <QtSerialBus/qcanbusdevice.h>
 #include <QtSerialBus/qcanbusdeviceinfo.h>
+#include <QtSerialBus/private/qcanbusdevicehooks_p.h>
 #include <QtSerialBus/qcanbusframe.h>
 
 #include <QtCore/qlist.h>
@@ -73,7 +74,7 @@ private:
     QList<QTcpSocket *> m_serverSockets;
 };
 
-class VirtualCanBackend : public QCanBusDevice
+class VirtualCanBackend : public QCanBusDevice, private QCanBusDeviceHooks
 {
     Q_OBJECT
     Q_DISABLE_COPY(VirtualCanBackend)
@@ -85,9 +86,8 @@ public:
     bool open() override;
     void close() override;
 
-    void setConfigurationParameter(ConfigurationKey key, const QVariant &value) override;
-
     bool writeFrame(const QCanBusFrame &frame) override;
+    qint64 writeFrameBatch(const QList<QCanBusFrame> &frames) override;
 
     QString interpretErrorFrame(const QCanBusFrame &errorFrame) override;
 
@@ -96,11 +96,18 @@ public:
     QCanBusDeviceInfo deviceInfo() const override;
 
 private:
+    bool setPluginConfigurationParameter(ConfigurationKey key, const QVariant &value) override;
+
     static QCanBusDeviceInfo virtualCanDeviceInfo(uint channel);
 
     void clientConnected();
     void clientDisconnected();
-    void clientReadyRead();
+    void clientReadyRead(QTcpSocket *socket);
+
+    QByteArray frameCommand(const QCanBusFrame &frame) const;
+    void writeCommand(const QByteArray &command);
+    template <typename Functor>
+    void runInSocketThread(Functor &&function);
 
     QUrl m_url;
     uint m_channel = 0;
@@ -0,0 +1,108 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcanbuschangefilter_p.h"
+
+#include <cstring>
+
+QT_BEGIN_NAMESPACE
+
+void QCanBusChangeFilter::clear()
+{
+    m_baseStates.reset();
+    m_extendedStates.clear();
+}
+
+/*
+    Returns \c true if \a frame must be delivered: it is no data frame, its
+    payload differs from the one delivered last for its identifier, or the
+    heartbeat interval passed since then. \a now is a monotonic time in
+    milliseconds.
+*/
+bool QCanBusChangeFilter::accepts(const QCanBusFrame &frame, qint64 now)
+{
+    const QByteArrayView payload = frame.payloadView();
+    const qsizetype length = payload.size();
+    if (frame.frameType() != QCanBusFrame::DataFrame
+            || Q_UNLIKELY(length > MaximumPayloadSize)) {
+        return true;
+    }
+
+    State *current = state(frame);
+    if (Q_UNLIKELY(!current))
+        return true;
+
+    quint8 flags = Seen;
+    if (frame.hasFlexibleDataRateFormat())
+        flags |= FlexibleDataRate;
+    if (frame.hasBitrateSwitch())
+        flags |= BitrateSwitch;
+
+    const bool changed = current->flags != flags || current->length != length
+            || (length && ::memcmp(current->payload, payload.data(), size_t(length)) != 0);
+
+    if (!changed && (m_heartbeatInterval <= 0 || now - current->deliveredAt < m_heartbeatInterval))
+        return false;
+
+    if (changed) {
+        current->flags = flags;
+        current->length = quint8(length);
+        if (length)
+            ::memcpy(current->payload, payload.data(), size_t(length));
+    }
+    current->deliveredAt = now;
+    return true;
+}
+
+// Returns nullptr for base frames with an identifier beyond 11 bits, they
+// are always delivered.
+QCanBusChangeFilter::State *QCanBusChangeFilter::state(const QCanBusFrame &frame)
+{
+    const QCanBusFrame::FrameId frameId = frame.frameId();
+    if (frame.hasExtendedFrameFormat())
+        return &m_extendedStates[frameId];
+    if (Q_UNLIKELY(frameId >= BaseIdCount))
+        return nullptr;
+
+    if (!m_baseStates)
+        m_baseStates = std::make_unique<State[]>(BaseIdCount);
+    return &m_baseStates[frameId];
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,107 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSCHANGEFILTER_P_H
+#define QCANBUSCHANGEFILTER_P_H
+
+#include <QtSerialBus/qcanbusframe.h>
+
+#include <QtCore/qhash.h>
+
+#include <memory>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Drops data frames whose payload equals the payload last delivered for
+    the same frame identifier, see QCanBusDevice::ChangedFramesOnlyKey.
+
+    The state of base frame identifiers is indexed directly, extended
+    identifiers are hashed. Payloads, including CAN FD payloads, are kept
+    inline, so that tracking a frame never allocates. A frame only counts
+    as unchanged if its CAN FD and bitrate switch flags are unchanged, too.
+*/
+class QCanBusChangeFilter
+{
+public:
+    void setHeartbeatInterval(qint64 msecs) noexcept { m_heartbeatInterval = msecs; }
+    void clear();
+
+    bool accepts(const QCanBusFrame &frame, qint64 now);
+
+private:
+    enum {
+        BaseIdCount = 2048,
+        MaximumPayloadSize = 64
+    };
+
+    enum Flag : quint8 {
+        Seen = 0x01,
+        FlexibleDataRate = 0x02,
+        BitrateSwitch = 0x04
+    };
+
+    struct State {
+        qint64 deliveredAt = 0; // milliseconds
+        quint8 flags = 0;
+        quint8 length = 0;
+        char payload[MaximumPayloadSize];
+    };
+
+    State *state(const QCanBusFrame &frame);
+
+    std::unique_ptr<State[]> m_baseStates;
+    QHash<QCanBusFrame::FrameId, State> m_extendedStates;
+    qint64 m_heartbeatInterval = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSCHANGEFILTER_P_H
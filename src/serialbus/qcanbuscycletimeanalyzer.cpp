@@ -0,0 +1,332 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcanbuscycletimeanalyzer.h"
+#include "qcanbuscycletimeanalyzer_p.h"
+#include "qcanbusdevice.h"
+#include "qcanbusdevice_p.h"
+
+#include <algorithm>
+#include <cmath>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QCanBusCycleTimeAnalyzer
+    \inmodule QtSerialBus
+    \since 6.4
+
+    \brief QCanBusCycleTimeAnalyzer measures the cycle times of received
+    CAN frames.
+
+    Most frames on a CAN bus are sent cyclically. QCanBusCycleTimeAnalyzer
+    keeps incremental statistics of the periods between consecutive data
+    frames of every frame identifier: the number of frames, the mean,
+    minimum and maximum period, and the jitter as standard deviation of the
+    periods. The memory needed per frame identifier is constant.
+
+    The periods are computed from the \l{QCanBusFrame::timeStamp()}{timestamps}
+    of the frames, so the results do not depend on when the application
+    handles them. Frames without timestamp are counted, but do not
+    contribute periods.
+
+    The analyzer can be fed with frames by \l addFrames(), or attached to a
+    device with \l setDevice(). An attached analyzer sees every frame the
+    device receives, in the thread that receives it, without taking frames
+    from the receive queue:
+
+    \code
+        auto analyzer = new QCanBusCycleTimeAnalyzer(device);
+        analyzer->setDevice(device);
+        ...
+        for (const QCanBusCycleTimeAnalyzer::Statistics &entry : analyzer->snapshot())
+            qDebug() << Qt::hex << entry.frameId << Qt::dec << entry.meanPeriod << entry.jitter;
+    \endcode
+
+    All functions may be called from any thread.
+*/
+
+/*!
+    \class QCanBusCycleTimeAnalyzer::Statistics
+    \inmodule QtSerialBus
+    \since 6.4
+
+    \brief The Statistics struct holds the cycle time statistics of one
+    frame identifier.
+
+    All periods are in microseconds.
+*/
+
+/*!
+    \variable QCanBusCycleTimeAnalyzer::Statistics::frameId
+
+    The frame identifier the statistics belong to.
+*/
+
+/*!
+    \variable QCanBusCycleTimeAnalyzer::Statistics::extendedFrameFormat
+
+    \c true if the statistics belong to frames in extended frame format.
+*/
+
+/*!
+    \variable QCanBusCycleTimeAnalyzer::Statistics::frameCount
+
+    The number of data frames received with the identifier.
+*/
+
+/*!
+    \variable QCanBusCycleTimeAnalyzer::Statistics::periodCount
+
+    The number of periods measured between two consecutive frames.
+*/
+
+/*!
+    \variable QCanBusCycleTimeAnalyzer::Statistics::meanPeriod
+
+    The mean period in microseconds.
+*/
+
+/*!
+    \variable QCanBusCycleTimeAnalyzer::Statistics::minimumPeriod
+
+    The shortest period in microseconds.
+*/
+
+/*!
+    \variable QCanBusCycleTimeAnalyzer::Statistics::maximumPeriod
+
+    The longest period in microseconds.
+*/
+
+/*!
+    \variable QCanBusCycleTimeAnalyzer::Statistics::jitter
+
+    The standard deviation of the periods in microseconds.
+*/
+
+/*!
+    \variable QCanBusCycleTimeAnalyzer::Statistics::lastSeen
+
+    The latest timestamp of the frames received with the identifier. Frames
+    with an older timestamp than a previous frame are counted, but do not
+    contribute a period.
+*/
+
+/*!
+    Constructs an analyzer with the given \a parent.
+*/
+QCanBusCycleTimeAnalyzer::QCanBusCycleTimeAnalyzer(QObject *parent)
+    : QObject(*new QCanBusCycleTimeAnalyzerPrivate, parent)
+{
+}
+
+/*!
+    Detaches the analyzer from its device and destroys it.
+*/
+QCanBusCycleTimeAnalyzer::~QCanBusCycleTimeAnalyzer()
+{
+    Q_D(QCanBusCycleTimeAnalyzer);
+
+    d->detach();
+}
+
+/*!
+    Attaches the analyzer to \a device. From now on, all frames \a device
+    receives are added to the statistics. Passing \c nullptr detaches the
+    analyzer from its current device.
+
+    Frames are added after the filters set with
+    QCanBusDevice::RawFilterKey are applied, but before frames are dropped
+    because of QCanBusDevice::ChangedFramesOnlyKey.
+*/
+void QCanBusCycleTimeAnalyzer::setDevice(QCanBusDevice *device)
+{
+    Q_D(QCanBusCycleTimeAnalyzer);
+
+    if (d->device == device)
+        return;
+
+    d->detach();
+    d->device = device;
+    if (device) {
+        QCanBusDevicePrivate::get(device)->addFrameObserver(
+                    d, [d](const QList<QCanBusFrame> &frames) { d->addFrames(frames); });
+    }
+}
+
+/*!
+    Returns the device the analyzer is attached to, or \c nullptr.
+*/
+QCanBusDevice *QCanBusCycleTimeAnalyzer::device() const
+{
+    Q_D(const QCanBusCycleTimeAnalyzer);
+
+    return d->device;
+}
+
+/*!
+    Adds \a frames to the statistics. Only data frames are taken into
+    account. The frames must be in the order they were received.
+*/
+void QCanBusCycleTimeAnalyzer::addFrames(const QList<QCanBusFrame> &frames)
+{
+    Q_D(QCanBusCycleTimeAnalyzer);
+
+    d->addFrames(frames);
+}
+
+/*!
+    Returns the statistics of the frame identifier \a frameId in the format
+    selected by \a extendedFrameFormat. If no such frame was received, all
+    counts are zero.
+*/
+QCanBusCycleTimeAnalyzer::Statistics
+QCanBusCycleTimeAnalyzer::statistics(QCanBusFrame::FrameId frameId, bool extendedFrameFormat) const
+{
+    Q_D(const QCanBusCycleTimeAnalyzer);
+
+    const quint32 key = QCanBusCycleTimeAnalyzerPrivate::key(frameId, extendedFrameFormat);
+    QMutexLocker locker(&d->guard);
+    return QCanBusCycleTimeAnalyzerPrivate::toStatistics(key, d->states.value(key));
+}
+
+/*!
+    Returns the statistics of all frame identifiers received so far. Frames
+    in base format come first, each format is sorted by frame identifier.
+*/
+QList<QCanBusCycleTimeAnalyzer::Statistics> QCanBusCycleTimeAnalyzer::snapshot() const
+{
+    Q_D(const QCanBusCycleTimeAnalyzer);
+
+    QList<Statistics> result;
+    {
+        QMutexLocker locker(&d->guard);
+        result.reserve(d->states.size());
+        for (auto it = d->states.cbegin(); it != d->states.cend(); ++it)
+            result.append(QCanBusCycleTimeAnalyzerPrivate::toStatistics(it.key(), it.value()));
+    }
+
+    std::sort(result.begin(), result.end(), [](const Statistics &a, const Statistics &b) {
+        return a.extendedFrameFormat != b.extendedFrameFormat ? b.extendedFrameFormat
+                                                              : a.frameId < b.frameId;
+    });
+    return result;
+}
+
+/*!
+    Clears the statistics of all frame identifiers.
+*/
+void QCanBusCycleTimeAnalyzer::reset()
+{
+    Q_D(QCanBusCycleTimeAnalyzer);
+
+    QMutexLocker locker(&d->guard);
+    d->states.clear();
+}
+
+void QCanBusCycleTimeAnalyzerPrivate::addFrames(const QList<QCanBusFrame> &frames)
+{
+    QMutexLocker locker(&guard);
+
+    // cyclic traffic often repeats the same identifier, avoid the lookup
+    quint32 lastKey = 0;
+    State *state = nullptr;
+
+    for (const QCanBusFrame &frame : frames) {
+        if (frame.frameType() != QCanBusFrame::DataFrame)
+            continue;
+
+        const quint32 frameKey = key(frame.frameId(), frame.hasExtendedFrameFormat());
+        if (!state || frameKey != lastKey) {
+            state = &states[frameKey];
+            lastKey = frameKey;
+        }
+
+        const QCanBusFrame::TimeStamp stamp = frame.timeStamp();
+        const qint64 timeStamp = stamp.seconds() * 1000000 + stamp.microSeconds();
+
+        ++state->frameCount;
+        // frames that arrive out of order give no period and keep lastSeen
+        if (timeStamp < state->lastSeen)
+            continue;
+        if (timeStamp > 0 && state->lastSeen > 0) {
+            const qint64 period = timeStamp - state->lastSeen;
+            ++state->periodCount;
+            if (state->periodCount == 1) {
+                state->minimumPeriod = period;
+                state->maximumPeriod = period;
+            } else {
+                state->minimumPeriod = qMin(state->minimumPeriod, period);
+                state->maximumPeriod = qMax(state->maximumPeriod, period);
+            }
+
+            const double delta = double(period) - state->meanPeriod;
+            state->meanPeriod += delta / double(state->periodCount);
+            state->squaredDeviations += delta * (double(period) - state->meanPeriod);
+        }
+        state->lastSeen = timeStamp;
+    }
+}
+
+void QCanBusCycleTimeAnalyzerPrivate::detach()
+{
+    if (device)
+        QCanBusDevicePrivate::get(device)->removeFrameObserver(this);
+    device.clear();
+}
+
+QCanBusCycleTimeAnalyzer::Statistics
+QCanBusCycleTimeAnalyzerPrivate::toStatistics(quint32 key, const State &state)
+{
+    QCanBusCycleTimeAnalyzer::Statistics result;
+    result.frameId = key & 0x1FFFFFFFU;
+    result.extendedFrameFormat = key & 0x80000000U;
+    result.frameCount = state.frameCount;
+    result.periodCount = state.periodCount;
+    result.meanPeriod = state.meanPeriod;
+    result.minimumPeriod = state.minimumPeriod;
+    result.maximumPeriod = state.maximumPeriod;
+    if (state.periodCount > 1)
+        result.jitter = std::sqrt(state.squaredDeviations / double(state.periodCount - 1));
+    result.lastSeen = QCanBusFrame::TimeStamp::fromMicroSeconds(state.lastSeen);
+    return result;
+}
+
+QT_END_NAMESPACE
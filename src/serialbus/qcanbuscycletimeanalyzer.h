@@ -0,0 +1,92 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSCYCLETIMEANALYZER_H
+#define QCANBUSCYCLETIMEANALYZER_H
+
+#include <QtCore/qlist.h>
+#include <QtCore/qobject.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+class QCanBusDevice;
+class QCanBusCycleTimeAnalyzerPrivate;
+
+class Q_SERIALBUS_EXPORT QCanBusCycleTimeAnalyzer : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(QCanBusCycleTimeAnalyzer)
+
+public:
+    struct Statistics
+    {
+        QCanBusFrame::FrameId frameId = 0;
+        bool extendedFrameFormat = false;
+        qint64 frameCount = 0;
+        qint64 periodCount = 0;
+        double meanPeriod = 0;      // microseconds
+        qint64 minimumPeriod = 0;   // microseconds
+        qint64 maximumPeriod = 0;   // microseconds
+        double jitter = 0;          // microseconds
+        QCanBusFrame::TimeStamp lastSeen;
+    };
+
+    explicit QCanBusCycleTimeAnalyzer(QObject *parent = nullptr);
+    ~QCanBusCycleTimeAnalyzer() override;
+
+    void setDevice(QCanBusDevice *device);
+    QCanBusDevice *device() const;
+
+    void addFrames(const QList<QCanBusFrame> &frames);
+
+    Statistics statistics(QCanBusFrame::FrameId frameId, bool extendedFrameFormat = false) const;
+    QList<Statistics> snapshot() const;
+    void reset();
+
+private:
+    Q_DISABLE_COPY(QCanBusCycleTimeAnalyzer)
+};
+
+Q_DECLARE_TYPEINFO(QCanBusCycleTimeAnalyzer::Statistics, Q_RELOCATABLE_TYPE);
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSCYCLETIMEANALYZER_H
@@ -0,0 +1,96 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSCYCLETIMEANALYZER_P_H
+#define QCANBUSCYCLETIMEANALYZER_P_H
+
+#include <QtSerialBus/qcanbuscycletimeanalyzer.h>
+
+#include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qpointer.h>
+
+#include <private/qobject_p.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QCanBusCycleTimeAnalyzerPrivate : public QObjectPrivate
+{
+    Q_DECLARE_PUBLIC(QCanBusCycleTimeAnalyzer)
+public:
+    // incremental state of one frame identifier, the variance of the
+    // periods is updated with Welford's algorithm
+    struct State {
+        qint64 frameCount = 0;
+        qint64 periodCount = 0;
+        qint64 lastSeen = 0; // microseconds
+        qint64 minimumPeriod = 0;
+        qint64 maximumPeriod = 0;
+        double meanPeriod = 0;
+        double squaredDeviations = 0;
+    };
+
+    static quint32 key(QCanBusFrame::FrameId frameId, bool extendedFrameFormat)
+    {
+        return frameId | (extendedFrameFormat ? 0x80000000U : 0U);
+    }
+
+    void addFrames(const QList<QCanBusFrame> &frames);
+    void detach();
+    static QCanBusCycleTimeAnalyzer::Statistics toStatistics(quint32 key, const State &state);
+
+    mutable QMutex guard;
+    QHash<quint32, State> states;
+    QPointer<QCanBusDevice> device;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSCYCLETIMEANALYZER_P_H
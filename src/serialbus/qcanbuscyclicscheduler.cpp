@@ -0,0 +1,258 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcanbuscyclicscheduler_p.h"
+
+#include <numeric>
+#include <utility>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Adds \a frame with \a id, which is due every \a period ticks starting at
+    \a firstTick. A \a firstTick before the current tick is due at once.
+    Removed frames may still be referenced by the slots, so \a id must not
+    have been used before.
+*/
+void QCanBusCyclicScheduler::add(int id, const QCanBusFrame &frame, quint64 period,
+                                 quint64 firstTick)
+{
+    Q_ASSERT(!m_entries.contains(id));
+    const quint64 expires = qMax(firstTick, m_current);
+    m_entries.insert(id, {frame, qMax(period, Q_UINT64_C(1)), expires, 0});
+    insert(id, expires);
+}
+
+bool QCanBusCyclicScheduler::update(int id, const QCanBusFrame &frame)
+{
+    const auto entry = m_entries.find(id);
+    if (entry == m_entries.end())
+        return false;
+
+    entry->frame = frame;
+    ++entry->revision;
+    return true;
+}
+
+bool QCanBusCyclicScheduler::remove(int id)
+{
+    return m_entries.remove(id) > 0;
+}
+
+/*
+    Removes the frame with \a id like remove() and returns its schedule in
+    \a schedule.
+*/
+bool QCanBusCyclicScheduler::take(int id, Schedule *schedule)
+{
+    const auto entry = m_entries.constFind(id);
+    if (entry == m_entries.cend())
+        return false;
+
+    *schedule = {id, entry->frame, entry->period, entry->expires, entry->revision};
+    m_entries.erase(entry);
+    return true;
+}
+
+/*
+    Returns the frames and the tick at which each of them is due next.
+*/
+QList<QCanBusCyclicScheduler::Schedule> QCanBusCyclicScheduler::schedules() const
+{
+    QList<Schedule> result;
+    result.reserve(m_entries.size());
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+        result.append({it.key(), it->frame, it->period, it->expires, it->revision});
+    return result;
+}
+
+void QCanBusCyclicScheduler::clear()
+{
+    m_entries.clear();
+    for (QList<int> &slot : m_level0)
+        slot.clear();
+    for (QList<int> &slot : m_level1)
+        slot.clear();
+    for (QList<int> &slot : m_level2)
+        slot.clear();
+    m_overflow.clear();
+    m_level0Count = 0;
+}
+
+/*
+    Returns the first tick for a frame with \a period that is due at
+    \a earliest or within the following period, but at most 256 ticks later.
+    The tick is chosen so that the frame coincides with as few other frames
+    as possible. Two frames ever coincide if the distance of their ticks is a
+    multiple of the greatest common divisor of their periods.
+*/
+quint64 QCanBusCyclicScheduler::spreadFirstTick(quint64 period, quint64 earliest) const
+{
+    earliest = qMax(earliest, m_current);
+    const quint64 candidates = qMin(qMax(period, Q_UINT64_C(1)), Level0Slots);
+
+    quint64 best = earliest;
+    qsizetype bestCollisions = std::numeric_limits<qsizetype>::max();
+    for (quint64 tick = earliest; tick < earliest + candidates; ++tick) {
+        qsizetype collisions = 0;
+        for (const Entry &entry : m_entries) {
+            const quint64 distance = tick > entry.expires ? tick - entry.expires
+                                                          : entry.expires - tick;
+            if (distance % std::gcd(period, entry.period) == 0)
+                ++collisions;
+        }
+
+        if (collisions < bestCollisions) {
+            best = tick;
+            bestCollisions = collisions;
+            if (collisions == 0)
+                break;
+        }
+    }
+    return best;
+}
+
+/*
+    Processes all ticks up to and including \a now and returns the frames
+    that were due, in the order of their ticks. Cycles that passed more than
+    once, for example while the event loop was blocked, are skipped.
+*/
+QList<QCanBusCyclicScheduler::Due> QCanBusCyclicScheduler::advance(quint64 now)
+{
+    QList<Due> due;
+    while (m_current <= now) {
+        if (m_level0Count == 0) {
+            // nothing is due in this block, continue with the next one
+            const quint64 next = (m_current | (Level0Slots - 1)) + 1;
+            m_current = qMin(next, now + 1);
+            if (m_current == next)
+                cascade();
+            continue;
+        }
+
+        const QList<int> ids = std::exchange(m_level0[m_current & (Level0Slots - 1)], {});
+        m_level0Count -= ids.size();
+        for (int id : ids) {
+            const auto entry = m_entries.find(id);
+            if (entry == m_entries.end())
+                continue;
+
+            due.append({entry->frame, entry->expires});
+            entry->expires += entry->period;
+            if (entry->expires <= now)
+                entry->expires += ((now - entry->expires) / entry->period + 1) * entry->period;
+            insert(id, entry->expires);
+        }
+
+        ++m_current;
+        if ((m_current & (Level0Slots - 1)) == 0)
+            cascade();
+    }
+    return due;
+}
+
+/*
+    Returns the tick at which advance() has to be called next, or NoExpiry if
+    no frame is scheduled. This is the first tick of the current block with
+    a frame, or the beginning of the next block that has to be moved down.
+*/
+quint64 QCanBusCyclicScheduler::nextExpiry() const
+{
+    if (m_entries.isEmpty())
+        return NoExpiry;
+
+    if (m_level0Count > 0) {
+        for (quint64 tick = m_current; (tick >> Level1Shift) == (m_current >> Level1Shift); ++tick) {
+            if (!m_level0[tick & (Level0Slots - 1)].isEmpty())
+                return tick;
+        }
+    }
+
+    const quint64 block = m_current >> Level1Shift;
+    for (quint64 index = (block & (LevelSlots - 1)) + 1; index < LevelSlots; ++index) {
+        if (!m_level1[index].isEmpty())
+            return ((block >> LevelBits) << Level2Shift) | (index << Level1Shift);
+    }
+    return (m_current | ((Q_UINT64_C(1) << Level2Shift) - 1)) + 1;
+}
+
+/*
+    Puts \a id into the slot of the lowest level whose block contains both the
+    current tick and \a expires, which must not be before the current tick.
+*/
+void QCanBusCyclicScheduler::insert(int id, quint64 expires)
+{
+    if ((expires >> Level1Shift) == (m_current >> Level1Shift)) {
+        m_level0[expires & (Level0Slots - 1)].append(id);
+        ++m_level0Count;
+    } else if ((expires >> Level2Shift) == (m_current >> Level2Shift)) {
+        m_level1[(expires >> Level1Shift) & (LevelSlots - 1)].append(id);
+    } else if ((expires >> OverflowShift) == (m_current >> OverflowShift)) {
+        m_level2[(expires >> Level2Shift) & (LevelSlots - 1)].append(id);
+    } else {
+        m_overflow.append(id);
+    }
+}
+
+void QCanBusCyclicScheduler::reinsert(QList<int> &slot)
+{
+    const QList<int> ids = std::exchange(slot, {});
+    for (int id : ids) {
+        const auto entry = m_entries.constFind(id);
+        if (entry != m_entries.cend())
+            insert(id, entry->expires);
+    }
+}
+
+/*
+    Moves the frames of the block that begins at the current tick down to the
+    lower levels. Higher levels are moved first, so that their frames reach
+    the first level if they are due in this block.
+*/
+void QCanBusCyclicScheduler::cascade()
+{
+    if ((m_current & ((Q_UINT64_C(1) << Level2Shift) - 1)) == 0) {
+        if ((m_current & ((Q_UINT64_C(1) << OverflowShift) - 1)) == 0)
+            reinsert(m_overflow);
+        reinsert(m_level2[(m_current >> Level2Shift) & (LevelSlots - 1)]);
+    }
+    reinsert(m_level1[(m_current >> Level1Shift) & (LevelSlots - 1)]);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,144 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSCYCLICSCHEDULER_P_H
+#define QCANBUSCYCLICSCHEDULER_P_H
+
+#include <QtSerialBus/qcanbusframe.h>
+
+#include <QtCore/qhash.h>
+#include <QtCore/qlist.h>
+
+#include <array>
+#include <limits>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+/*
+    The frames that QCanBusDevice writes periodically, see
+    QCanBusDevice::addCyclicFrame().
+
+    The frames are kept in a hierarchical timer wheel with a resolution of one
+    tick. The first level has a slot for every tick of the current block of
+    256 ticks; the higher levels have a slot for every block of the level below
+    within their own block. Slots of a higher level are moved down when their
+    block begins, so that adding, removing and firing a frame takes constant
+    time. Frames due later than the highest level are kept in an overflow list.
+
+    The scheduler has no timer of its own. QCanBusDevice calls advance() at
+    the tick returned by nextExpiry().
+*/
+class QCanBusCyclicScheduler
+{
+public:
+    static constexpr quint64 NoExpiry = std::numeric_limits<quint64>::max();
+
+    struct Due {
+        QCanBusFrame frame;
+        quint64 tick;
+    };
+
+    struct Schedule {
+        int id;
+        QCanBusFrame frame;
+        quint64 period;
+        quint64 nextTick;
+        quint32 revision; // changed by update()
+    };
+
+    void add(int id, const QCanBusFrame &frame, quint64 period, quint64 firstTick);
+    bool update(int id, const QCanBusFrame &frame);
+    bool remove(int id);
+    bool take(int id, Schedule *schedule);
+    void clear();
+
+    QList<Schedule> schedules() const;
+
+    quint64 spreadFirstTick(quint64 period, quint64 earliest) const;
+    QList<Due> advance(quint64 now);
+    quint64 nextExpiry() const;
+
+    quint64 currentTick() const noexcept { return m_current; }
+    qsizetype size() const noexcept { return m_entries.size(); }
+    bool isEmpty() const noexcept { return m_entries.isEmpty(); }
+
+private:
+    static constexpr int Level0Bits = 8;
+    static constexpr int LevelBits = 6;
+    static constexpr quint64 Level0Slots = Q_UINT64_C(1) << Level0Bits;
+    static constexpr quint64 LevelSlots = Q_UINT64_C(1) << LevelBits;
+    static constexpr int Level1Shift = Level0Bits;
+    static constexpr int Level2Shift = Level0Bits + LevelBits;
+    static constexpr int OverflowShift = Level0Bits + 2 * LevelBits;
+
+    struct Entry {
+        QCanBusFrame frame;
+        quint64 period;
+        quint64 expires;
+        quint32 revision;
+    };
+
+    void insert(int id, quint64 expires);
+    void reinsert(QList<int> &slot);
+    void cascade();
+
+    QHash<int, Entry> m_entries;
+    // removed frames stay in the slots until their slot is processed
+    std::array<QList<int>, Level0Slots> m_level0;
+    std::array<QList<int>, LevelSlots> m_level1;
+    std::array<QList<int>, LevelSlots> m_level2;
+    QList<int> m_overflow;
+    qsizetype m_level0Count = 0;
+    quint64 m_current = 0; // all ticks before were processed
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSCYCLICSCHEDULER_P_H
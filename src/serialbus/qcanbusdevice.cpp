@@ -47,13 +47,59 @@
 #include <QtCore/qdatastream.h>
 #include <QtCore/qeventloop.h>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qscopeguard.h>
 #include <QtCore/qscopedvaluerollback.h>
+#include <QtCore/qthread.h>
 #include <QtCore/qtimer.h>
 
+#include <chrono>
+#include <limits>
+
+#if defined(Q_OS_LINUX)
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+
 QT_BEGIN_NAMESPACE
 
 Q_LOGGING_CATEGORY(QT_CANBUS, "qt.canbus")
 
+// Called in the I/O thread when it starts.
+static void applyIoThreadScheduling(const QList<int> &cpus, int priority)
+{
+#if defined(Q_OS_LINUX)
+    if (!cpus.isEmpty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        }
+        const int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (Q_UNLIKELY(result != 0)) {
+            qCWarning(QT_CANBUS, "Cannot set the CPU affinity of the I/O thread: %ls",
+                      qUtf16Printable(qt_error_string(result)));
+        }
+    }
+
+    if (priority > 0) {
+        sched_param param = {};
+        param.sched_priority = qBound(sched_get_priority_min(SCHED_FIFO), priority,
+                                      sched_get_priority_max(SCHED_FIFO));
+        const int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (Q_UNLIKELY(result != 0)) {
+            qCWarning(QT_CANBUS, "Cannot set the real-time priority of the I/O thread: %ls",
+                      qUtf16Printable(qt_error_string(result)));
+        }
+    }
+#else
+    if (!cpus.isEmpty())
+        qCWarning(QT_CANBUS, "Setting the CPU affinity of the I/O thread is not supported.");
+    if (priority > 0)
+        QThread::currentThread()->setPriority(QThread::TimeCriticalPriority);
+#endif
+}
+
 /*!
     \class QCanBusDevice
     \inmodule QtSerialBus
@@ -129,6 +175,124 @@ Q_LOGGING_CATEGORY(QT_CANBUS, "qt.canbus")
     \value ProtocolKey      This key allows to specify another protocol. For now, this
                             parameter can only be set and used in the SocketCAN plugin.
                             This enum value was introduced in Qt 5.14.
+    \value ReceiveBatchSizeKey This key defines the maximum number of frames that are read
+                            from the device with a single system call. The expected value
+                            for this key is \c int. For now, this parameter can only be set
+                            and used in the SocketCAN plugin.
+                            This enum value was introduced in Qt 6.4.
+    \value TimeStampSourceKey This key defines the clock that is used for the
+                            \l {QCanBusFrame::timeStamp()}{timestamps} of received frames.
+                            The expected value for this key is
+                            \l QCanBusDevice::TimeStampSource. For now, this parameter can
+                            only be set and used in the SocketCAN plugin.
+                            This enum value was introduced in Qt 6.4.
+    \value CompiledFilterKey This key defines whether large filter lists set with
+                            \c QCanBusDevice::RawFilterKey are compiled into a filter
+                            program that the operating system runs for every received
+                            frame. The expected value for this key is \c bool. For now,
+                            this parameter can only be set and used in the SocketCAN plugin.
+                            This enum value was introduced in Qt 6.4.
+    \value IoThreadKey      This key defines whether the plugin reads from the CAN bus in an
+                            internal thread instead of the thread of the device. Frames
+                            are then received even while the device's event loop is busy.
+                            The expected value for this key is \c bool. The setting takes
+                            effect when the device is connected. For now, this parameter
+                            can only be set and used in the SocketCAN and VirtualCAN plugins.
+                            This enum value was introduced in Qt 6.4.
+    \value IoThreadAffinityKey This key defines the CPUs the thread enabled with
+                            \c QCanBusDevice::IoThreadKey may run on. The expected value
+                            for this key is \c QList<int> with the CPU indexes. Setting
+                            the CPU affinity is only supported on Linux.
+                            This enum value was introduced in Qt 6.4.
+    \value IoThreadPriorityKey This key defines the real-time priority of the thread
+                            enabled with \c QCanBusDevice::IoThreadKey. The expected value
+                            for this key is \c int. A value greater than zero runs the
+                            thread with the \c SCHED_FIFO policy on Linux, which usually
+                            requires the \c CAP_SYS_NICE capability. On other platforms,
+                            the thread gets QThread::TimeCriticalPriority.
+                            This enum value was introduced in Qt 6.4.
+    \value NotificationFrameCountKey This key defines how many received frames
+                            trigger the \l framesReceived() signal when
+                            \c QCanBusDevice::NotificationIntervalKey is set. The expected
+                            value for this key is \c int. The default is 1.
+                            This enum value was introduced in Qt 6.4.
+    \value NotificationIntervalKey This key defines the time in microseconds that
+                            received frames may wait for the \l framesReceived() signal.
+                            The signal is emitted when
+                            \c QCanBusDevice::NotificationFrameCountKey frames are waiting
+                            or when the interval has passed since the first of them was
+                            received, whichever comes first. The interval is rounded up
+                            to milliseconds. The expected value for this key is \c int.
+                            The default of 0 emits the signal immediately for every group
+                            of frames the plugin receives.
+                            This enum value was introduced in Qt 6.4.
+    \value ReceiveBufferSizeKey This key defines the size in bytes of the receive
+                            buffer the operating system keeps for the device. A larger
+                            buffer lets the device survive longer bursts of frames before
+                            the system drops them. The expected value for this key is
+                            \c int. For now, this parameter can only be set and used in
+                            the SocketCAN plugin.
+                            This enum value was introduced in Qt 6.4.
+    \value LastValueCacheKey This key defines whether the device keeps the most
+                            recent data frame of every frame identifier, see
+                            \l lastFrame(). The expected value for this key is \c bool.
+                            By default, the cache is disabled. Disabling the cache
+                            discards the recorded frames.
+                            This enum value was introduced in Qt 6.4.
+    \value ChangedFramesOnlyKey This key defines whether a received data frame
+                            is dropped if its payload equals the payload of the frame
+                            last delivered with the same frame identifier. Cyclic
+                            frames then only reach the application when their content
+                            changes. Remote request and error frames are always
+                            delivered. Dropped frames are counted as filtered frames in
+                            \l statistics(). The expected value for this key is \c bool.
+                            This enum value was introduced in Qt 6.4.
+    \value ChangeHeartbeatIntervalKey This key defines the time in milliseconds
+                            after which an unchanged frame is delivered again when
+                            \c QCanBusDevice::ChangedFramesOnlyKey is enabled. The
+                            expected value for this key is \c int. The default of 0
+                            never delivers unchanged frames. Setting either key forgets
+                            the payloads seen so far.
+                            This enum value was introduced in Qt 6.4.
+    \value TransmitConfirmationKey This key defines whether the device reports
+                            every frame that was actually sent on the bus with the
+                            \l frameConfirmed() signal, and records the time between
+                            handing the frame to the operating system and the
+                            confirmation of its transmission in \l statistics(). The expected value for this
+                            key is \c bool. By default, confirmations are disabled. For
+                            now, this parameter can only be set and used in the SocketCAN
+                            plugin.
+                            This enum value was introduced in Qt 6.4.
+    \value WriteQueuePriorityKey This key defines whether frames waiting to be
+                            written are sent in the order of their bus arbitration
+                            priority instead of the order of the writes. The frame
+                            with the lowest identifier is sent first, like the CAN bus
+                            arbitration would decide; frames with the same identifier
+                            keep their order. This prevents urgent frames from waiting
+                            behind a long bulk transfer. The expected value for this
+                            key is \c bool. By default, the order of the writes is kept.
+                            Only plugins that buffer outgoing frames in the device are
+                            affected.
+                            This enum value was introduced in Qt 6.4.
+    \value TransmitShapingKey This key defines how many frames may be written
+                            per second for groups of frame identifiers. Frames
+                            written faster are held back in the device until the
+                            rate allows them. The expected value for this key is
+                            \c QList<QCanBusDevice::ShapingRule>; a frame is limited by
+                            the first rule that matches its identifier. Passing an
+                            empty list removes the limits. Only plugins that buffer
+                            outgoing frames in the device are affected.
+                            This enum value was introduced in Qt 6.4.
+    \value TransmitBusLoadLimitKey This key defines the share of the bus time in
+                            percent that written frames may use. The bus time of a
+                            frame is calculated from \c QCanBusDevice::BitRateKey and
+                            \c QCanBusDevice::DataBitRateKey, so the limit only applies
+                            if the bit rate is set. Frames that would exceed the limit
+                            are held back; up to 10 milliseconds of bus time at the
+                            limit may be sent at once. The expected value for this key
+                            is \c int between 1 and 100. Only plugins that buffer
+                            outgoing frames in the device are affected.
+                            This enum value was introduced in Qt 6.4.
     \value UserKey          This key defines the range where custom keys start. Its most
                             common purpose is to permit platform-specific configuration
                             options.
@@ -136,6 +300,42 @@ Q_LOGGING_CATEGORY(QT_CANBUS, "qt.canbus")
     \sa configurationParameter()
 */
 
+/*!
+    \since 6.4
+    \enum QCanBusDevice::OverflowPolicy
+    This enum describes what happens when a frame is received while the
+    receive queue is full. It only applies if the receive queue is bounded,
+    see setReceiveQueueCapacity().
+
+    \value DropOldest   The oldest frame in the queue is discarded to make
+                        room for the new frame.
+    \value DropNewest   The new frame is discarded. This is the default.
+    \value Block        The CAN plugin waits until the application has read
+                        frames from the queue. Blocking is only possible if the
+                        plugin delivers frames from a thread other than the
+                        one the device lives in; otherwise the new frame is
+                        discarded as with \l DropNewest.
+
+    \sa setOverflowPolicy(), setReceiveQueueCapacity(), droppedFramesCount()
+*/
+
+/*!
+    \since 6.4
+    \enum QCanBusDevice::TimeStampSource
+    This enum describes where the timestamps of received frames come from.
+    It is used as value for \l TimeStampSourceKey.
+
+    \value Software     The frame is stamped by the operating system when it
+                        is received. This is the default.
+    \value Hardware     The frame is stamped by the CAN controller, if the
+                        driver supports it. Frames without a controller
+                        timestamp fall back to the software timestamp.
+    \value RawHardware  The frame carries the unmodified CAN controller
+                        timestamp, which is based on the controller's own
+                        clock. Frames without a controller timestamp have a
+                        zero timestamp.
+*/
+
 /*!
     \class QCanBusDevice::Filter
     \inmodule QtSerialBus
@@ -147,6 +347,11 @@ Q_LOGGING_CATEGORY(QT_CANBUS, "qt.canbus")
     \l QCanBusDevice::setConfigurationParameter() to enable filtering. If a received CAN frame
     matches at least one of the filters in the list, the QCanBusDevice will accept it.
 
+    If the CAN plugin cannot filter in hardware, the filters are applied by
+    QCanBusDevice itself, so that rejected frames never enter the receive
+    queue. Error frames are not affected by the filters; they are selected
+    with \l {QCanBusDevice::}{ErrorFilterKey}.
+
     The example below demonstrates how to use the struct:
 
     \snippet snippetmain.cpp Filter Examples
@@ -234,6 +439,94 @@ Q_LOGGING_CATEGORY(QT_CANBUS, "qt.canbus")
     By default this field is set to \l QCanBusDevice::Filter::MatchBaseAndExtendedFormat.
 */
 
+/*!
+    \class QCanBusDevice::ShapingRule
+    \inmodule QtSerialBus
+    \since 6.4
+
+    \brief The QCanBusDevice::ShapingRule struct limits the rate of written
+    CAN bus frames.
+
+    A list of QCanBusDevice::ShapingRule instances is passed to
+    \l QCanBusDevice::setConfigurationParameter() with
+    \l {QCanBusDevice::}{TransmitShapingKey}. Every rule is a token bucket:
+    it holds up to \l burst tokens and gains \l rate tokens per second.
+    Writing a frame takes one token from the bucket of the first rule whose
+    frame id matches; if the bucket is empty, the frame waits in the device
+    until a token is available. Frames that match no rule are not limited.
+
+    The example below allows 100 frames per second with bursts of 10 frames
+    for the frame ids 0x100 to 0x1FF:
+
+    \code
+        QCanBusDevice::ShapingRule rule;
+        rule.frameId = 0x100;
+        rule.frameIdMask = 0x700;
+        rule.rate = 100;
+        rule.burst = 10;
+        device->setConfigurationParameter(QCanBusDevice::TransmitShapingKey,
+                                          QVariant::fromValue(QList{rule}));
+    \endcode
+*/
+
+/*!
+    \fn bool QCanBusDevice::ShapingRule::operator==(const QCanBusDevice::ShapingRule &a, const QCanBusDevice::ShapingRule &b)
+
+    Returns \c true, if the rule \a a is equal to the rule \a b,
+    otherwise returns \c false.
+*/
+
+/*!
+    \fn bool QCanBusDevice::ShapingRule::operator!=(const QCanBusDevice::ShapingRule &a, const QCanBusDevice::ShapingRule &b)
+
+    Returns \c true, if the rule \a a is not equal to the rule \a b,
+    otherwise returns \c false.
+*/
+
+/*!
+    \variable QCanBusDevice::ShapingRule::frameId
+
+    \brief The frame id of the frames limited by the rule.
+
+    The frameId is used in conjunction with \a frameIdMask.
+    A written frame is limited by the rule if the following evaluates to \c true:
+
+    \code
+        (writtenFrameId & frameIdMask) == (frameId & frameIdMask)
+    \endcode
+
+    By default this field is set to \c 0x0.
+
+    \sa frameIdMask
+*/
+
+/*!
+    \variable QCanBusDevice::ShapingRule::frameIdMask
+
+    \brief The bit mask that is applied to the frame id of the rule and the written frame.
+
+    By default this field is set to \c 0x0, which matches all frames.
+
+    \sa frameId
+*/
+
+/*!
+    \variable QCanBusDevice::ShapingRule::rate
+
+    \brief The number of frames per second the rule allows on average.
+
+    Rules without a positive rate are ignored. By default this field is set to \c 0.
+*/
+
+/*!
+    \variable QCanBusDevice::ShapingRule::burst
+
+    \brief The number of frames that may be written at once after the rule
+    allowed no frames for a while.
+
+    By default this field is set to \c 1.
+*/
+
 /*!
     \fn void QCanBusDevice::errorOccurred(CanBusError)
 
@@ -246,6 +539,11 @@ Q_LOGGING_CATEGORY(QT_CANBUS, "qt.canbus")
 QCanBusDevice::QCanBusDevice(QObject *parent) :
     QObject(*new QCanBusDevicePrivate, parent)
 {
+    Q_D(QCanBusDevice);
+
+    connect(this, &QCanBusDevice::framesWritten, this, [d](qint64 framesCount) {
+        d->statistics.writtenFrames.fetch_add(framesCount, std::memory_order_relaxed);
+    }, Qt::DirectConnection);
 }
 
 
@@ -264,6 +562,10 @@ void QCanBusDevice::setError(const QString &errorText, CanBusError errorId)
 
     d->errorText = errorText;
     d->lastError = errorId;
+    ++d->errorCount;
+
+    if (errorId == WriteError)
+        d->statistics.writeErrors.fetch_add(1, std::memory_order_relaxed);
 
     emit errorOccurred(errorId);
 }
@@ -291,6 +593,14 @@ void QCanBusDevice::clearError()
     accessed using \l readFrame() and emits the \l framesReceived()
     signal.
 
+    If a capacity was set for the receive queue and the queue is full,
+    frames are discarded or the caller is blocked according to
+    overflowPolicy().
+
+    Frames that do not match the filters set with \l RawFilterKey are
+    discarded before they enter the receive queue, unless the plugin
+    filters in hardware. See \l setHardwareFiltering().
+
     Subclasses must call this function when they receive frames.
 
 */
@@ -301,48 +611,282 @@ void QCanBusDevice::enqueueReceivedFrames(const QList<QCanBusFrame> &newFrames)
     if (Q_UNLIKELY(newFrames.isEmpty()))
         return;
 
-    d->incomingFramesGuard.lock();
-    d->incomingFrames.append(newFrames);
-    d->incomingFramesGuard.unlock();
-    emit framesReceived();
+    if (d->frameFilterActive.load(std::memory_order_relaxed)
+            || d->changeFilterActive.load(std::memory_order_relaxed)) {
+        enqueueReceivedFrames(QList<QCanBusFrame>(newFrames));
+        return;
+    }
+
+    d->countReceivedFrames(newFrames);
+    d->updateLastValues(newFrames);
+    if (d->hasFrameObservers.load(std::memory_order_acquire))
+        d->notifyFrameObservers(newFrames);
+
+    const bool mayBlock = QThread::currentThread() != thread();
+    const qint64 droppedBefore = d->incomingFrames.droppedFrames();
+    qsizetype enqueued = 0;
+    for (const QCanBusFrame &frame : newFrames)
+        enqueued += d->incomingFrames.enqueue(frame, mayBlock);
+
+    const qint64 dropped = d->incomingFrames.droppedFrames() - droppedBefore;
+    if (Q_UNLIKELY(dropped > 0))
+        d->reportDroppedFrames(dropped);
+    if (Q_LIKELY(enqueued))
+        d->notifyFramesReceived(enqueued);
+}
+
+/*!
+    \since 6.4
+    \overload
+
+    Moves \a newFrames to the internal list of frames which can be
+    accessed using \l readFrame() and emits the \l framesReceived()
+    signal. Subclasses should prefer this overload when they pass a
+    list of frames they no longer need, as it avoids copying the frames.
+*/
+void QCanBusDevice::enqueueReceivedFrames(QList<QCanBusFrame> &&newFrames)
+{
+    Q_D(QCanBusDevice);
+
+    if (Q_UNLIKELY(newFrames.isEmpty()))
+        return;
+
+    d->countReceivedFrames(newFrames);
+
+    if (d->frameFilterActive.load(std::memory_order_relaxed)
+            && !d->filterReceivedFrames(newFrames)) {
+        return;
+    }
+
+    d->updateLastValues(newFrames);
+    if (d->hasFrameObservers.load(std::memory_order_acquire))
+        d->notifyFrameObservers(newFrames);
+
+    if (d->changeFilterActive.load(std::memory_order_relaxed)
+            && !d->dropUnchangedFrames(newFrames)) {
+        return;
+    }
+
+    const bool mayBlock = QThread::currentThread() != thread();
+    const qint64 droppedBefore = d->incomingFrames.droppedFrames();
+    qsizetype enqueued = 0;
+    for (QCanBusFrame &frame : newFrames)
+        enqueued += d->incomingFrames.enqueue(std::move(frame), mayBlock);
+    newFrames.clear();
+
+    const qint64 dropped = d->incomingFrames.droppedFrames() - droppedBefore;
+    if (Q_UNLIKELY(dropped > 0))
+        d->reportDroppedFrames(dropped);
+    if (Q_LIKELY(enqueued))
+        d->notifyFramesReceived(enqueued);
 }
 
 /*!
     Appends \a newFrame to the internal list of outgoing frames which
     can be accessed by \l writeFrame().
 
+    If \l TransmitShapingKey or \l TransmitBusLoadLimitKey hold the frame
+    back, it is appended later.
+
     Subclasses must call this function when they write a new frame.
 */
 void QCanBusDevice::enqueueOutgoingFrame(const QCanBusFrame &newFrame)
 {
     Q_D(QCanBusDevice);
 
-    d->outgoingFrames.append(newFrame);
+    d->enqueueOutgoingFrame(newFrame, QCanBusOutgoingQueue::NoDeadline);
 }
 
 /*!
     Returns the next \l QCanBusFrame from the internal list of outgoing frames;
     otherwise returns an invalid QCanBusFrame. The returned frame is removed
     from the internal list.
+
+    Frames whose deadline passed, see writeFrameWithDeadline(), are removed
+    from the list by this function instead of being returned.
 */
 QCanBusFrame QCanBusDevice::dequeueOutgoingFrame()
 {
     Q_D(QCanBusDevice);
 
+    d->dropExpiredOutgoingFrames();
     if (Q_UNLIKELY(d->outgoingFrames.isEmpty()))
         return QCanBusFrame(QCanBusFrame::InvalidFrame);
-    return d->outgoingFrames.takeFirst();
+
+    return d->outgoingFrames.dequeue();
+}
+
+/*!
+    \since 6.4
+
+    Returns the outgoing frame at position \a index of the internal list of
+    outgoing frames without removing it; otherwise returns an invalid
+    QCanBusFrame if \a index is out of range.
+
+    Subclasses can use this function to hand several queued frames to the
+    transport layer at once, and call \l dequeueOutgoingFrame() only for the
+    frames that were actually written.
+*/
+QCanBusFrame QCanBusDevice::peekOutgoingFrame(qint64 index) const
+{
+    Q_D(const QCanBusDevice);
+
+    const QCanBusFrame *frame = d->outgoingFrames.peek(index);
+    if (Q_UNLIKELY(!frame))
+        return QCanBusFrame(QCanBusFrame::InvalidFrame);
+    return *frame;
+}
+
+/*!
+    \since 6.4
+
+    Returns the number of frames in the internal list of outgoing frames,
+    that is the valid range of indexes for \l peekOutgoingFrame().
+
+    Unlike framesToWrite(), frames held back by \l TransmitShapingKey are not
+    counted, and frames whose deadline passed are counted until
+    dequeueOutgoingFrame() removes them.
+*/
+qint64 QCanBusDevice::outgoingFrameCount() const
+{
+    Q_D(const QCanBusDevice);
+
+    return d->outgoingFrames.size();
+}
+
+/*!
+    \since 6.4
+
+    Declares whether the plugin applies the filters set with
+    \l RawFilterKey itself, for example in the CAN controller or in the
+    operating system. If \a enabled is \c false, which is the default,
+    QCanBusDevice drops frames that do not match the filters in
+    \l enqueueReceivedFrames().
+
+    Subclasses that filter in hardware should call this function in their
+    constructor.
+*/
+void QCanBusDevice::setHardwareFiltering(bool enabled)
+{
+    Q_D(QCanBusDevice);
+
+    if (d->hardwareFiltering == enabled)
+        return;
+
+    d->hardwareFiltering = enabled;
+    d->updateFrameFilter();
+}
+
+/*!
+    \since 6.4
+
+    Sets the plugin specific counter \a name of \l statistics() to \a value,
+    for example the number of frames dropped by the operating system.
+
+    This function may be called from any thread.
+*/
+void QCanBusDevice::setPluginCounter(const QString &name, qint64 value)
+{
+    Q_D(QCanBusDevice);
+
+    QMutexLocker locker(&d->pluginCountersGuard);
+    d->pluginCounters.insert(name, value);
+}
+
+/*!
+    \since 6.4
+
+    Reports that the written \a frame was sent on the CAN bus. \a latency is
+    the time in microseconds from handing the frame to the operating system
+    or the driver until the plugin received the confirmation of the
+    transmission. A negative \a latency means that it is unknown. The latency is added to
+    QCanBusDeviceStatistics::transmitLatencyHistogram() and
+    frameConfirmed() is emitted.
+
+    Plugins call this function if \l TransmitConfirmationKey is enabled. It
+    may be called from any thread.
+*/
+void QCanBusDevice::confirmFrame(const QCanBusFrame &frame, qint64 latency)
+{
+    Q_D(QCanBusDevice);
+
+    d->recordLatency(&d->statistics.transmitLatency, latency);
+    emit frameConfirmed(frame);
+}
+
+/*!
+    \since 6.4
+
+    Returns the thread in which the plugin should read from the CAN bus if
+    \l IoThreadKey is enabled; otherwise returns \c nullptr.
+
+    The thread is started on the first call, with the CPU affinity set by
+    \l IoThreadAffinityKey and the priority set by \l IoThreadPriorityKey.
+    Subclasses move the objects that watch their connection, for example a
+    QSocketNotifier, to the thread and call \l enqueueReceivedFrames() from
+    there. The \l framesReceived() signal is still emitted in the thread of
+    the device, once for all frames that arrived until the device's event
+    loop handles the notification.
+
+    \sa stopIoThread()
+*/
+QThread *QCanBusDevice::ioThread()
+{
+    Q_D(QCanBusDevice);
+
+    if (d->ioThread && d->ioThread->isRunning())
+        return d->ioThread.get();
+
+    if (!configurationParameter(IoThreadKey).toBool())
+        return nullptr;
+
+    if (!d->ioThread) {
+        d->ioThread = std::make_unique<QThread>();
+        d->ioThread->setObjectName(QStringLiteral("QCanBusDevice I/O"));
+        connect(d->ioThread.get(), &QThread::started, d->ioThread.get(), [d]() {
+            applyIoThreadScheduling(d->ioThreadCpus, d->ioThreadPriority);
+        }, Qt::DirectConnection);
+    }
+
+    d->ioThreadCpus = configurationParameter(IoThreadAffinityKey).value<QList<int>>();
+    d->ioThreadPriority = configurationParameter(IoThreadPriorityKey).toInt();
+    d->ioThread->start();
+    return d->ioThread.get();
+}
+
+/*!
+    \since 6.4
+
+    Stops the thread returned by \l ioThread() and waits until it has
+    finished. Subclasses should call \l {QObject::}{deleteLater()} for the
+    objects they moved to the thread before; these objects are deleted when
+    the thread finishes.
+*/
+void QCanBusDevice::stopIoThread()
+{
+    Q_D(QCanBusDevice);
+
+    if (!d->ioThread || !d->ioThread->isRunning())
+        return;
+
+    // a producer blocked by a full receive queue would never finish
+    d->incomingFrames.setWaitsInterrupted(true);
+    d->ioThread->quit();
+    d->ioThread->wait();
 }
 
 /*!
     Returns \c true if the internal list of outgoing frames is not
     empty; otherwise returns \c false.
+
+    Frames whose deadline passed, see writeFrameWithDeadline(), are not
+    taken into account.
 */
 bool QCanBusDevice::hasOutgoingFrames() const
 {
     Q_D(const QCanBusDevice);
 
-    return !d->outgoingFrames.isEmpty();
+    return d->pendingOutgoingFrames() > 0;
 }
 
 /*!
@@ -362,6 +906,27 @@ void QCanBusDevice::setConfigurationParameter(ConfigurationKey key, const QVaria
 {
     Q_D(QCanBusDevice);
 
+    if (d->hooks && !QCanBusDevicePrivate::isDeviceConfigurationKey(key)
+            && !d->hooks->setPluginConfigurationParameter(key, value)) {
+        return;
+    }
+
+    const auto updateSettings = qScopeGuard([d, key, &value] {
+        if (key == RawFilterKey)
+            d->updateFrameFilter();
+        else if (key == NotificationFrameCountKey || key == NotificationIntervalKey)
+            d->updateNotificationPolicy();
+        else if (key == LastValueCacheKey)
+            d->updateLastValueCache();
+        else if (key == ChangedFramesOnlyKey || key == ChangeHeartbeatIntervalKey)
+            d->updateChangeFilter();
+        else if (key == WriteQueuePriorityKey)
+            d->outgoingFrames.setPriorityOrder(value.toBool());
+        else if (key == TransmitShapingKey || key == TransmitBusLoadLimitKey
+                 || key == BitRateKey || key == DataBitRateKey)
+            d->updateTransmitShaper(key);
+    });
+
     for (int i = 0; i < d->configOptions.size(); i++) {
         if (d->configOptions.at(i).first == key) {
             if (value.isValid()) {
@@ -456,96 +1021,531 @@ qint64 QCanBusDevice::framesAvailable() const
 }
 
 /*!
-    For buffered devices, this function returns the number of frames waiting to be written.
-    For unbuffered devices, this function always returns zero.
+    \since 6.4
+    Sets the maximum number of received frames that are queued until they
+    are read by the application to \a capacity. The capacity is rounded up
+    to the next power of two.
 
-    \note There may be additional buffering in the CAN driver and CAN hardware layer.
-    Therefore, if this function returns zero, that does not mean all CAN frames are
-    already written to the CAN bus.
+    By default, and if \a capacity is 0, the receive queue is unbounded. It
+    grows as needed, and no received frame is ever dropped because the
+    application reads frames too slowly.
 
-    \sa clear(), writeFrame()
+    A bounded receive queue does not grow beyond its capacity, which limits
+    the memory used when the application falls behind. If it is full, new
+    frames are discarded or the plugin is blocked according to
+    overflowPolicy().
+
+    The capacity can only be changed while the device is unconnected.
+
+    \sa receiveQueueCapacity(), setOverflowPolicy(), framesAvailable()
 */
-qint64 QCanBusDevice::framesToWrite() const
+void QCanBusDevice::setReceiveQueueCapacity(qint64 capacity)
 {
-    return d_func()->outgoingFrames.size();
+    Q_D(QCanBusDevice);
+
+    if (Q_UNLIKELY(d->state != UnconnectedState)) {
+        const QString error = tr("Cannot change the receive queue capacity "
+                                 "as device is not unconnected.");
+        qCWarning(QT_CANBUS, "%ls", qUtf16Printable(error));
+        setError(error, CanBusError::OperationError);
+        return;
+    }
+
+    d->incomingFrames.resize(capacity > 0 ? qsizetype(capacity)
+                                          : qsizetype(QCanBusFrameQueue::Unbounded));
 }
 
 /*!
-    \since 5.14
-
-    Performs a CAN controller reset to release the CAN controller from
-    bus off state, if possible.
+    \since 6.4
+    Returns the maximum number of frames the receive queue can hold, or 0
+    if the receive queue is unbounded, which is the default.
 
-    \note CAN controller resets disturb the running communication and
-    may take up to one second to complete. Only call this function to
-    recover from bus errors.
+    \sa setReceiveQueueCapacity()
+*/
+qint64 QCanBusDevice::receiveQueueCapacity() const
+{
+    const QCanBusFrameQueue &queue = d_func()->incomingFrames;
+    return queue.isBounded() ? queue.capacity() : 0;
+}
 
-    \note This function may not be implemented in all CAN plugins.
-    Please refer to the plugins help pages for more information.
+/*!
+    \since 6.4
+    Sets the policy which is applied when a frame is received while the
+    receive queue is full to \a policy. The policy only has an effect if a
+    receive queue capacity was set, see setReceiveQueueCapacity().
 
-    \sa busStatus()
+    \sa overflowPolicy(), droppedFramesCount()
 */
-void QCanBusDevice::resetController()
+void QCanBusDevice::setOverflowPolicy(OverflowPolicy policy)
 {
-    const char error[] = QT_TRANSLATE_NOOP("QCanBusDevice",
-            "This CAN bus plugin does not support hardware controller reset.");
-    qCWarning(QT_CANBUS, error);
-    setError(tr(error), QCanBusDevice::CanBusError::ConfigurationError);
+    d_func()->incomingFrames.setOverflowPolicy(policy);
 }
 
 /*!
-    \since 5.14
-
-    Return true, if the CAN plugin supports requesting the CAN bus status.
+    \since 6.4
+    Returns the policy which is applied when a frame is received while the
+    receive queue is full. The default is \l OverflowPolicy::DropNewest.
 
-    \sa busStatus()
- */
-bool QCanBusDevice::hasBusStatus() const
+    \sa setOverflowPolicy()
+*/
+QCanBusDevice::OverflowPolicy QCanBusDevice::overflowPolicy() const
 {
-    return false;
+    return d_func()->incomingFrames.overflowPolicy();
 }
 
 /*!
-    \since 5.14
-    \enum QCanBusDevice::CanBusStatus
+    \since 6.4
+    Returns the number of received frames that were discarded because
+    the receive queue was full.
 
-    This enum describes possible CAN bus status values.
+    \sa setOverflowPolicy(), setReceiveQueueCapacity()
+*/
+qint64 QCanBusDevice::droppedFramesCount() const
+{
+    return d_func()->incomingFrames.droppedFrames();
+}
 
-    \value Unknown  The CAN bus status is unknown
-                    (e.g. not supported by the CAN plugin).
-    \value Good     The CAN controller is fully operational
-    \value Warning  The CAN controller is in warning status
-    \value Error    The CAN controller is in error status
-                    (no longer sending CAN frames)
-    \value BusOff   The CAN controller is in bus off status
-                    (disconnected from the CAN bus)
+/*!
+    \since 6.4
+    Returns the largest number of frames that were waiting in the receive
+    queue at the same time. This value helps to choose a suitable
+    receiveQueueCapacity().
+
+    \sa framesAvailable()
 */
+qint64 QCanBusDevice::receiveQueueHighWaterMark() const
+{
+    return d_func()->incomingFrames.highWaterMark();
+}
 
 /*!
-    \since 5.14
+    \since 6.4
 
-    Returns the current CAN bus status. If the status cannot be requested,
-    QCanBusDevice::UnknownStatus is returned.
+    Returns a snapshot of the runtime statistics of this device: the number
+    of frames and payload bytes received and written, the frames that were
+    filtered or dropped, write errors, the high-water mark of the receive
+    queue, and a histogram of the time frames waited before the application
+    read them. CAN plugins may add their own counters.
 
-    \note This function may not be implemented in all CAN plugins.
-    Please refer to the plugins help pages for more information.
-    The function hasBusStatus() can be used at runtime to check if
-    the used CAN plugin has support for requesting the CAN bus status.
+    The statistics are always collected. They are updated with relaxed
+    atomic operations, so the cost is negligible even on busy buses.
 
-    \sa hasBusStatus(), resetController()
+    \sa resetStatistics()
 */
-QCanBusDevice::CanBusStatus QCanBusDevice::busStatus()
+QCanBusDeviceStatistics QCanBusDevice::statistics() const
 {
-    return QCanBusDevice::CanBusStatus::Unknown;
+    Q_D(const QCanBusDevice);
+
+    auto result = new QCanBusDeviceStatisticsPrivate;
+    result->receivedFrames = d->statistics.receivedFrames.load(std::memory_order_relaxed);
+    result->receivedBytes = d->statistics.receivedBytes.load(std::memory_order_relaxed);
+    result->filteredFrames = d->statistics.filteredFrames.load(std::memory_order_relaxed);
+    result->droppedFrames = d->incomingFrames.droppedFrames();
+    result->receiveQueueHighWaterMark = d->incomingFrames.highWaterMark();
+    result->writtenFrames = d->statistics.writtenFrames.load(std::memory_order_relaxed);
+    result->writtenBytes = d->statistics.writtenBytes.load(std::memory_order_relaxed);
+    result->writeErrors = d->statistics.writeErrors.load(std::memory_order_relaxed);
+    result->expiredFrames = d->outgoingFrames.expiredFrames();
+
+    result->readLatencyHistogram.reserve(QCanBusDeviceStatistics::ReadLatencyBuckets);
+    for (const auto &bucket : d->statistics.readLatency)
+        result->readLatencyHistogram.append(bucket.load(std::memory_order_relaxed));
+    result->transmitLatencyHistogram.reserve(QCanBusDeviceStatistics::ReadLatencyBuckets);
+    for (const auto &bucket : d->statistics.transmitLatency)
+        result->transmitLatencyHistogram.append(bucket.load(std::memory_order_relaxed));
+    result->cyclicJitterHistogram.reserve(QCanBusDeviceStatistics::ReadLatencyBuckets);
+    for (const auto &bucket : d->statistics.cyclicJitter)
+        result->cyclicJitterHistogram.append(bucket.load(std::memory_order_relaxed));
+
+    {
+        QMutexLocker locker(&d->pluginCountersGuard);
+        result->pluginCounters = d->pluginCounters;
+    }
+
+    return QCanBusDeviceStatistics(*result);
 }
 
 /*!
-    \since 5.12
-    \enum QCanBusDevice::Direction
+    \since 6.4
 
-    This enum describes possible data transmission directions.
+    Sets all counters of \l statistics() to zero. The high-water mark of the
+    receive queue restarts at the number of frames currently queued.
+    Counters maintained by the CAN plugin are not affected.
 
-    \value Input            Input direction.
+    \sa droppedFramesCount(), receiveQueueHighWaterMark()
+*/
+void QCanBusDevice::resetStatistics()
+{
+    Q_D(QCanBusDevice);
+
+    d->statistics.receivedFrames.store(0, std::memory_order_relaxed);
+    d->statistics.receivedBytes.store(0, std::memory_order_relaxed);
+    d->statistics.filteredFrames.store(0, std::memory_order_relaxed);
+    d->statistics.writtenFrames.store(0, std::memory_order_relaxed);
+    d->statistics.writtenBytes.store(0, std::memory_order_relaxed);
+    d->statistics.writeErrors.store(0, std::memory_order_relaxed);
+    d->outgoingFrames.resetExpiredFrames();
+    for (auto &bucket : d->statistics.readLatency)
+        bucket.store(0, std::memory_order_relaxed);
+    for (auto &bucket : d->statistics.transmitLatency)
+        bucket.store(0, std::memory_order_relaxed);
+    for (auto &bucket : d->statistics.cyclicJitter)
+        bucket.store(0, std::memory_order_relaxed);
+    d->incomingFrames.resetStatistics();
+}
+
+/*!
+    \since 6.4
+
+    Returns the most recent data frame with the identifier \a frameId that
+    the device received, or an invalid frame if there is none. Base and
+    extended frame formats are distinguished, \a extendedFrameFormat selects
+    the format. If \a updateCount is not \c nullptr, it is set to the number
+    of frames with this identifier received so far.
+
+    Frames are recorded after the filters of \l RawFilterKey are applied,
+    independent of whether the application reads them from the receive
+    queue. The cache must be enabled with \l LastValueCacheKey. It holds all
+    base frame identifiers and up to 3072 extended frame identifiers.
+
+    This function may be called from any thread. It never waits for the
+    thread that receives frames.
+
+    \sa lastFrameUpdateCount(), lastFrames()
+*/
+QCanBusFrame QCanBusDevice::lastFrame(QCanBusFrame::FrameId frameId, bool extendedFrameFormat,
+                                      quint64 *updateCount) const
+{
+    Q_D(const QCanBusDevice);
+
+    QCanBusFrame frame(QCanBusFrame::InvalidFrame);
+    const QCanBusLastValueCache *cache = d->lastValueCache.load(std::memory_order_acquire);
+    if (cache)
+        cache->read(frameId, extendedFrameFormat, &frame, updateCount);
+    else if (updateCount)
+        *updateCount = 0;
+    return frame;
+}
+
+/*!
+    \since 6.4
+
+    Returns the number of data frames with the identifier \a frameId in the
+    format selected by \a extendedFrameFormat the device received while
+    the last value cache was enabled. A reader can compare the count with
+    the one it saw before to find out whether the frame changed, without
+    copying the frame.
+
+    This function may be called from any thread.
+
+    \sa lastFrame()
+*/
+quint64 QCanBusDevice::lastFrameUpdateCount(QCanBusFrame::FrameId frameId,
+                                            bool extendedFrameFormat) const
+{
+    Q_D(const QCanBusDevice);
+
+    const QCanBusLastValueCache *cache = d->lastValueCache.load(std::memory_order_acquire);
+    return cache ? cache->updateCount(frameId, extendedFrameFormat) : 0;
+}
+
+/*!
+    \since 6.4
+
+    Returns the most recent data frame of every frame identifier in the
+    last value cache. Frames in base format come first, each format is
+    sorted by frame identifier.
+
+    This function may be called from any thread.
+
+    \sa lastFrame(), LastValueCacheKey
+*/
+QList<QCanBusFrame> QCanBusDevice::lastFrames() const
+{
+    Q_D(const QCanBusDevice);
+
+    const QCanBusLastValueCache *cache = d->lastValueCache.load(std::memory_order_acquire);
+    return cache ? cache->frames() : QList<QCanBusFrame>();
+}
+
+/*!
+    \since 6.4
+
+    Writes \a frame every \a period milliseconds with writeFrame() while the
+    device is connected, and returns an id for updateCyclicFrame() and
+    removeCyclicFrame(). Returns \c -1 if \a frame is invalid or \a period
+    is not positive.
+
+    The first transmission happens \a phase milliseconds from now. If
+    \a phase is negative, which is the default, QCanBusDevice chooses it
+    within the first period such that the frame coincides with as few other
+    cyclic frames as possible, so that the frames are spread over time.
+
+    All cyclic frames of the device share one precise timer. The schedule
+    does not drift: a late transmission does not delay the next one. The
+    deviation of the transmissions from the schedule is recorded in
+    QCanBusDeviceStatistics::cyclicJitterHistogram().
+
+    If the CAN plugin can transmit the frame periodically itself, the frame
+    is handed to the plugin instead and does not use the timer of
+    QCanBusDevice. Frames added while the device is not connected are handed
+    to the plugin when the device connects, keeping their schedule.
+    Please refer to the plugins help pages for more information.
+
+    This function must be called from the thread of the device.
+
+    \sa updateCyclicFrame(), removeCyclicFrame()
+*/
+int QCanBusDevice::addCyclicFrame(const QCanBusFrame &frame, int period, int phase)
+{
+    Q_D(QCanBusDevice);
+
+    if (Q_UNLIKELY(!frame.isValid() || period <= 0)) {
+        const QString error = tr("Cannot add a cyclic frame that is invalid "
+                                 "or has no positive period.");
+        qCWarning(QT_CANBUS, "%ls", qUtf16Printable(error));
+        setError(error, CanBusError::OperationError);
+        return -1;
+    }
+
+    if (!d->cyclicTimer) {
+        d->cyclicEpoch = QDeadlineTimer::current().deadlineNSecs();
+        d->cyclicTimer = new QTimer(this);
+        d->cyclicTimer->setSingleShot(true);
+        d->cyclicTimer->setTimerType(Qt::PreciseTimer);
+        connect(d->cyclicTimer, &QTimer::timeout, this, [d]() { d->writeCyclicFrames(); });
+    }
+
+    const qint64 now = QDeadlineTimer::current().deadlineNSecs();
+    const quint64 tick = d->cyclicTick(now);
+    const int id = d->nextCyclicFrameId++;
+    quint64 firstTick;
+    {
+        QMutexLocker locker(&d->cyclicFramesGuard);
+        firstTick = phase < 0 ? d->cyclicFrames.spreadFirstTick(period, tick)
+                              : tick + quint64(phase);
+    }
+
+    if (d->state == ConnectedState && d->hooks
+            && d->hooks->startCyclicTransmission(id, frame, period, int(firstTick - tick))) {
+        QMutexLocker locker(&d->cyclicFramesGuard);
+        d->offloadedCyclicFrames.insert(id);
+        return id;
+    }
+
+    {
+        QMutexLocker locker(&d->cyclicFramesGuard);
+        d->cyclicFrames.add(id, frame, quint64(period), firstTick);
+    }
+    d->startCyclicTimer(now);
+    return id;
+}
+
+/*!
+    \since 6.4
+
+    Replaces the cyclic frame with \a id by \a frame. The next transmission
+    sends \a frame; the schedule is not changed. Returns \c false if there
+    is no cyclic frame with \a id or \a frame is invalid.
+
+    The frame is replaced as a whole, so a transmission never mixes the
+    identifier or payload of the old and the new frame. This function may
+    be called from any thread.
+
+    \sa addCyclicFrame()
+*/
+bool QCanBusDevice::updateCyclicFrame(int id, const QCanBusFrame &frame)
+{
+    Q_D(QCanBusDevice);
+
+    if (Q_UNLIKELY(!frame.isValid()))
+        return false;
+
+    {
+        QMutexLocker locker(&d->cyclicFramesGuard);
+        if (!d->offloadedCyclicFrames.contains(id))
+            return d->cyclicFrames.update(id, frame);
+    }
+    return d->hooks && d->hooks->updateCyclicTransmission(id, frame);
+}
+
+/*!
+    \since 6.4
+
+    Stops writing the cyclic frame with \a id. Returns \c false if there is
+    no cyclic frame with \a id.
+
+    This function must be called from the thread of the device.
+
+    \sa addCyclicFrame()
+*/
+bool QCanBusDevice::removeCyclicFrame(int id)
+{
+    Q_D(QCanBusDevice);
+
+    bool removed;
+    bool offloaded;
+    {
+        QMutexLocker locker(&d->cyclicFramesGuard);
+        offloaded = d->offloadedCyclicFrames.remove(id);
+        removed = !offloaded && d->cyclicFrames.remove(id);
+    }
+    if (offloaded && d->hooks)
+        d->hooks->stopCyclicTransmission(id);
+    else if (removed)
+        d->startCyclicTimer(QDeadlineTimer::current().deadlineNSecs());
+    return offloaded || removed;
+}
+
+/*!
+    \since 6.4
+
+    Monitors the frames with \a frameId, in extended frame format if
+    \a extendedFrameFormat is \c true, in the CAN plugin. Returns \c true
+    on success.
+
+    Instead of every received frame, only frames that differ from the
+    previous frame with the same identifier in the bits set in
+    \a contentMask, or in their length, are delivered as received frames.
+    If \a contentMask is empty, all frames with \a frameId are delivered
+    and only the timeout is monitored. If \a timeout is positive and no frame with
+    \a frameId is received for \a timeout milliseconds, receiveTimeout()
+    is emitted. Adding a monitor for a \a frameId that is already monitored
+    replaces the monitor.
+
+    Unlike \l ChangedFramesOnlyKey, a monitor is applied before the frames
+    reach the application, so that unchanged frames do not cause any work in
+    the process.
+
+    \note This function may not be implemented in all CAN plugins.
+    Please refer to the plugins help pages for more information.
+    Plugins without receive monitors set a QCanBusDevice::ConfigurationError
+    and return \c false.
+
+    \sa removeReceiveMonitor()
+*/
+bool QCanBusDevice::addReceiveMonitor(QCanBusFrame::FrameId frameId,
+                                      const QByteArray &contentMask, int timeout,
+                                      bool extendedFrameFormat)
+{
+    Q_D(QCanBusDevice);
+
+    if (d->hooks)
+        return d->hooks->startReceiveMonitor(frameId, contentMask, timeout, extendedFrameFormat);
+    return d->rejectReceiveMonitor();
+}
+
+/*!
+    \since 6.4
+
+    Removes the monitor of the frames with \a frameId, in extended frame
+    format if \a extendedFrameFormat is \c true. Afterwards, all frames
+    with \a frameId are received again. Returns \c false if there is no
+    such monitor.
+
+    \sa addReceiveMonitor()
+*/
+bool QCanBusDevice::removeReceiveMonitor(QCanBusFrame::FrameId frameId,
+                                         bool extendedFrameFormat)
+{
+    Q_D(QCanBusDevice);
+
+    return d->hooks && d->hooks->stopReceiveMonitor(frameId, extendedFrameFormat);
+}
+
+/*!
+    For buffered devices, this function returns the number of frames waiting to be written.
+    For unbuffered devices, this function always returns zero.
+
+    \note There may be additional buffering in the CAN driver and CAN hardware layer.
+    Therefore, if this function returns zero, that does not mean all CAN frames are
+    already written to the CAN bus.
+
+    \sa clear(), writeFrame()
+*/
+qint64 QCanBusDevice::framesToWrite() const
+{
+    Q_D(const QCanBusDevice);
+
+    return d->pendingOutgoingFrames() + d->transmitShaper.size();
+}
+
+/*!
+    \since 5.14
+
+    Performs a CAN controller reset to release the CAN controller from
+    bus off state, if possible.
+
+    \note CAN controller resets disturb the running communication and
+    may take up to one second to complete. Only call this function to
+    recover from bus errors.
+
+    \note This function may not be implemented in all CAN plugins.
+    Please refer to the plugins help pages for more information.
+
+    \sa busStatus()
+*/
+void QCanBusDevice::resetController()
+{
+    const char error[] = QT_TRANSLATE_NOOP("QCanBusDevice",
+            "This CAN bus plugin does not support hardware controller reset.");
+    qCWarning(QT_CANBUS, error);
+    setError(tr(error), QCanBusDevice::CanBusError::ConfigurationError);
+}
+
+/*!
+    \since 5.14
+
+    Return true, if the CAN plugin supports requesting the CAN bus status.
+
+    \sa busStatus()
+ */
+bool QCanBusDevice::hasBusStatus() const
+{
+    return false;
+}
+
+/*!
+    \since 5.14
+    \enum QCanBusDevice::CanBusStatus
+
+    This enum describes possible CAN bus status values.
+
+    \value Unknown  The CAN bus status is unknown
+                    (e.g. not supported by the CAN plugin).
+    \value Good     The CAN controller is fully operational
+    \value Warning  The CAN controller is in warning status
+    \value Error    The CAN controller is in error status
+                    (no longer sending CAN frames)
+    \value BusOff   The CAN controller is in bus off status
+                    (disconnected from the CAN bus)
+*/
+
+/*!
+    \since 5.14
+
+    Returns the current CAN bus status. If the status cannot be requested,
+    QCanBusDevice::UnknownStatus is returned.
+
+    \note This function may not be implemented in all CAN plugins.
+    Please refer to the plugins help pages for more information.
+    The function hasBusStatus() can be used at runtime to check if
+    the used CAN plugin has support for requesting the CAN bus status.
+
+    \sa hasBusStatus(), resetController()
+*/
+QCanBusDevice::CanBusStatus QCanBusDevice::busStatus()
+{
+    return QCanBusDevice::CanBusStatus::Unknown;
+}
+
+/*!
+    \since 5.12
+    \enum QCanBusDevice::Direction
+
+    This enum describes possible data transmission directions.
+
+    \value Input            Input direction.
     \value Output           Output direction.
     \value AllDirections    Both directions, input and output.
 */
@@ -575,13 +1575,14 @@ void QCanBusDevice::clear(QCanBusDevice::Directions direction)
 
     clearError();
 
-    if (direction & Direction::Input) {
-        QMutexLocker locker(&d->incomingFramesGuard);
+    if (direction & Direction::Input)
         d->incomingFrames.clear();
-    }
 
-    if (direction & Direction::Output)
+    if (direction & Direction::Output) {
         d->outgoingFrames.clear();
+        d->transmitShaper.clear();
+        d->releaseShapedFrames();
+    }
 }
 
 /*!
@@ -775,12 +1776,10 @@ QCanBusFrame QCanBusDevice::readFrame()
 
     clearError();
 
-    QMutexLocker locker(&d->incomingFramesGuard);
-
-    if (Q_UNLIKELY(d->incomingFrames.isEmpty()))
-        return QCanBusFrame(QCanBusFrame::InvalidFrame);
-
-    return d->incomingFrames.takeFirst();
+    QCanBusFrame frame(QCanBusFrame::InvalidFrame);
+    if (d->incomingFrames.dequeue(&frame))
+        d->recordReadLatency(&frame, 1);
+    return frame;
 }
 
 /*!
@@ -805,74 +1804,269 @@ QList<QCanBusFrame> QCanBusDevice::readAllFrames()
 
     clearError();
 
-    QMutexLocker locker(&d->incomingFramesGuard);
-
-    QList<QCanBusFrame> result;
-    result.swap(d->incomingFrames);
+    QList<QCanBusFrame> result(d->incomingFrames.size());
+    result.resize(d->incomingFrames.dequeue(result.data(), result.size()));
+    d->recordReadLatency(result.constData(), result.size());
     return result;
 }
 
 /*!
-    \fn void QCanBusDevice::framesWritten(qint64 framesCount)
-
-    This signal is emitted every time a payload of frames has been
-    written to the CAN bus. The \a framesCount argument is set to
-    the number of frames that were written in this payload.
-*/
-
-/*!
-    \fn bool QCanBusDevice::writeFrame(const QCanBusFrame &frame)
+    \since 6.4
+    Moves up to \a maxFrames \l{QCanBusFrame}s from the queue to the
+    array \a frames and returns the number of frames stored there.
+    The frames are removed from the queue.
 
-    Writes \a frame to the CAN bus and returns \c true on success;
-    otherwise \c false.
+    Unlike readAllFrames(), this function does not allocate memory, so
+    \a frames can be reused for every call:
 
-    On some platforms, the frame may be put into a queue and the return
-    value may only indicate a successful insertion into the queue.
-    The actual frame will be send later on. Therefore the \l framesWritten()
-    signal is the final confirmation that the frame has been handed off to
-    the transport layer. If an error occurs the \l errorOccurred() is emitted.
+    \code
+        QCanBusFrame frames[64];
+        qint64 count;
+        while ((count = device->readFrames(frames, 64)) > 0) {
+            for (qint64 i = 0; i < count; ++i)
+                process(frames[i]);
+        }
+    \endcode
 
-    As per CAN bus specification, frames of type
-    \l {QCanBusFrame::RemoteRequestFrame} {remote transfer request (RTR)}
-    do not have a payload, but a length from 0 to 8 (including). This length
-    indicates the expected response payload length from the remote party.
-    Therefore when sending a RTR frame using this function it may still
-    be required to set an arbitrary payload on \a frame. The length of
-    the arbitrary payload is what is set as size expectation for the RTR frame.
+    The queue operates according to the FIFO principle.
 
-    \sa QCanBusFrame::setPayload()
+    \sa clear(), framesAvailable(), readFrame(), readAllFrames()
 */
+qint64 QCanBusDevice::readFrames(QCanBusFrame *frames, qint64 maxFrames)
+{
+    Q_D(QCanBusDevice);
 
-/*!
-    \fn QString QCanBusDevice::interpretErrorFrame(const QCanBusFrame &frame)
+    if (Q_UNLIKELY(d->state != ConnectedState)) {
+        const QString error = tr("Cannot read frame as device is not connected.");
+        qCWarning(QT_CANBUS, "%ls", qUtf16Printable(error));
+        setError(error, CanBusError::OperationError);
+        return 0;
+    }
 
-    Interprets \a frame as error frame and returns a human readable
-    description of the error.
+    clearError();
 
-    If \a frame is not an error frame, the returned string is empty.
-*/
+    if (Q_UNLIKELY(!frames))
+        return 0;
+
+    const qsizetype count = d->incomingFrames.dequeue(frames, qsizetype(maxFrames));
+    d->recordReadLatency(frames, count);
+    return count;
+}
 
 /*!
-    Connects the device to the CAN bus. Returns \c true on success;
-    otherwise \c false.
+    \since 6.4
+    \overload
 
-    This function calls \l open() as part of its implementation.
+    Moves up to \a maxFrames \l{QCanBusFrame}s from the queue to the end of
+    \a batch and returns the number of frames appended. If \a maxFrames is
+    negative, all available frames are moved.
 
-    \sa disconnectDevice()
+    \sa QCanBusFrameBatch
 */
-bool QCanBusDevice::connectDevice()
+qint64 QCanBusDevice::readFrames(QCanBusFrameBatch &batch, qint64 maxFrames)
 {
     Q_D(QCanBusDevice);
 
-    if (Q_UNLIKELY(d->state != QCanBusDevice::UnconnectedState)) {
-        const char error[] = QT_TRANSLATE_NOOP("QCanBusDevice",
-                                "Can not connect an already connected device.");
-        qCWarning(QT_CANBUS, error);
-        setError(tr(error), QCanBusDevice::ConnectionError);
+    if (Q_UNLIKELY(d->state != ConnectedState)) {
+        const QString error = tr("Cannot read frame as device is not connected.");
+        qCWarning(QT_CANBUS, "%ls", qUtf16Printable(error));
+        setError(error, CanBusError::OperationError);
+        return 0;
+    }
+
+    clearError();
+
+    if (maxFrames < 0)
+        maxFrames = std::numeric_limits<qint64>::max();
+
+    // frames are converted in chunks, so the queue is not copied as a whole
+    constexpr qsizetype ChunkSize = 64;
+    QCanBusFrame chunk[ChunkSize];
+    qint64 total = 0;
+    while (total < maxFrames) {
+        const qsizetype count = d->incomingFrames.dequeue(
+                    chunk, qsizetype(qMin(maxFrames - total, qint64(ChunkSize))));
+        if (count == 0)
+            break;
+
+        d->recordReadLatency(chunk, count);
+        batch.append(chunk, count);
+        total += count;
+    }
+
+    return total;
+}
+
+/*!
+    \fn void QCanBusDevice::framesWritten(qint64 framesCount)
+
+    This signal is emitted every time a payload of frames has been
+    written to the CAN bus. The \a framesCount argument is set to
+    the number of frames that were written in this payload.
+*/
+
+/*!
+    \fn void QCanBusDevice::framesDropped(qint64 framesCount)
+    \since 6.4
+
+    This signal is emitted when received frames were lost. The \a framesCount
+    argument is set to the number of frames lost since the signal was last
+    emitted. Frames are lost when the receive queue of the device overflows,
+    see \l overflowPolicy(), or when the CAN plugin detects that a buffer of
+    the operating system overflowed.
+
+    The signal may be emitted from the I/O thread of the CAN plugin.
+
+    \sa statistics(), droppedFramesCount()
+*/
+
+/*!
+    \fn void QCanBusDevice::frameConfirmed(const QCanBusFrame &frame)
+    \since 6.4
+
+    This signal is emitted for every written frame that was sent on the CAN
+    bus, if \l TransmitConfirmationKey is enabled. The \a frame argument is
+    the frame as it was sent, marked with QCanBusFrame::hasLocalEcho(). Its
+    timestamp is the time the CAN plugin received the confirmation, which
+    follows the transmission with a driver dependent delay. The SocketCAN
+    plugin uses the receive timestamp of the echo of the frame.
+
+    The signal may be emitted from the I/O thread of the CAN plugin.
+
+    \sa framesWritten(), QCanBusDeviceStatistics::transmitLatencyHistogram()
+*/
+
+/*!
+    \fn void QCanBusDevice::receiveTimeout(QCanBusFrame::FrameId frameId, bool extendedFrameFormat)
+    \since 6.4
+
+    This signal is emitted when no frame with \a frameId, in extended frame
+    format if \a extendedFrameFormat is \c true, was received within the
+    timeout of its receive monitor. The signal is emitted again after the
+    next timeout, once frames with \a frameId were received in between.
+
+    \sa addReceiveMonitor()
+*/
+
+/*!
+    \fn bool QCanBusDevice::writeFrame(const QCanBusFrame &frame)
+
+    Writes \a frame to the CAN bus and returns \c true on success;
+    otherwise \c false.
+
+    On some platforms, the frame may be put into a queue and the return
+    value may only indicate a successful insertion into the queue.
+    The actual frame will be send later on. Therefore the \l framesWritten()
+    signal is the final confirmation that the frame has been handed off to
+    the transport layer. If an error occurs the \l errorOccurred() is emitted.
+
+    As per CAN bus specification, frames of type
+    \l {QCanBusFrame::RemoteRequestFrame} {remote transfer request (RTR)}
+    do not have a payload, but a length from 0 to 8 (including). This length
+    indicates the expected response payload length from the remote party.
+    Therefore when sending a RTR frame using this function it may still
+    be required to set an arbitrary payload on \a frame. The length of
+    the arbitrary payload is what is set as size expectation for the RTR frame.
+
+    \sa QCanBusFrame::setPayload(), writeFrames()
+*/
+
+/*!
+    \since 6.4
+
+    Writes \a frame to the CAN bus with \l writeFrame() and returns \c true
+    on success; otherwise \c false. If the frame is buffered by the device
+    and still waits to be written when \a deadline expires, it is dropped
+    instead of being sent late. Dropped frames are counted in
+    QCanBusDeviceStatistics::expiredFrames().
+
+    Deadlines only apply to frames buffered in the device, see
+    framesToWrite(). Frames handed to the driver or the operating system are
+    always sent. In particular, the \c virtualcan plugin writes every frame
+    at once and ignores \a deadline, and the \c socketcan plugin only buffers
+    frames while the socket cannot take more, so \a deadline has no effect
+    on frames the kernel accepts right away. CAN plugins that are not part
+    of Qt Serial Bus write the frame like writeFrame() and ignore
+    \a deadline.
+
+    \sa WriteQueuePriorityKey
+*/
+bool QCanBusDevice::writeFrameWithDeadline(const QCanBusFrame &frame, QDeadlineTimer deadline)
+{
+    Q_D(QCanBusDevice);
+
+    if (!d->hooks)
+        return writeFrame(frame);
+
+    return d->hooks->writeExpiringFrame(
+                frame,
+                deadline.isForever() ? QCanBusOutgoingQueue::NoDeadline : deadline.deadlineNSecs());
+}
+
+/*!
+    \since 6.4
+
+    Writes all \a frames to the CAN bus in the given order and returns the
+    number of frames that were accepted for transmission.
+
+    Writing stops at the first frame that cannot be written. In that case the
+    returned value is smaller than the size of \a frames, and the
+    \l errorOccurred() signal has been emitted for the rejected frame. The
+    remaining frames are not written.
+
+    The frames are handed to the transport layer at once if the plugin
+    supports it, currently the \c socketcan and \c virtualcan plugins.
+    Other plugins get one \l writeFrame() call per frame. In both cases,
+    \l framesWritten() is emitted once for the frames that were written
+    before this function returns; frames that the plugin buffers are
+    reported when they are written.
+
+    \sa writeFrame(), framesWritten()
+*/
+qint64 QCanBusDevice::writeFrames(const QList<QCanBusFrame> &frames)
+{
+    Q_D(QCanBusDevice);
+
+    if (d->hooks) {
+        const qint64 written = d->hooks->writeFrameBatch(frames);
+        if (written >= 0)
+            return written;
+    }
+
+    return d->writeFramesOneByOne(frames);
+}
+
+/*!
+    \fn QString QCanBusDevice::interpretErrorFrame(const QCanBusFrame &frame)
+
+    Interprets \a frame as error frame and returns a human readable
+    description of the error.
+
+    If \a frame is not an error frame, the returned string is empty.
+*/
+
+/*!
+    Connects the device to the CAN bus. Returns \c true on success;
+    otherwise \c false.
+
+    This function calls \l open() as part of its implementation.
+
+    \sa disconnectDevice()
+*/
+bool QCanBusDevice::connectDevice()
+{
+    Q_D(QCanBusDevice);
+
+    if (Q_UNLIKELY(d->state != QCanBusDevice::UnconnectedState)) {
+        const char error[] = QT_TRANSLATE_NOOP("QCanBusDevice",
+                                "Can not connect an already connected device.");
+        qCWarning(QT_CANBUS, error);
+        setError(tr(error), QCanBusDevice::ConnectionError);
         return false;
     }
 
     setState(ConnectingState);
+    d->incomingFrames.setWaitsInterrupted(false);
 
     if (!open()) {
         setState(UnconnectedState);
@@ -907,6 +2101,7 @@ void QCanBusDevice::disconnectDevice()
     }
 
     setState(QCanBusDevice::ClosingState);
+    d->incomingFrames.setWaitsInterrupted(true);
 
     //Unconnected is set by backend -> might be delayed by event loop
     close();
@@ -943,6 +2138,8 @@ void QCanBusDevice::setState(QCanBusDevice::CanBusDeviceState newState)
         return;
 
     d->state = newState;
+    if (newState == ConnectedState)
+        d->offloadCyclicFrames();
     emit stateChanged(newState);
 }
 
@@ -1000,4 +2197,665 @@ QCanBusDeviceInfo QCanBusDevice::deviceInfo() const
     return QCanBusDeviceInfo(*(new QCanBusDeviceInfoPrivate));
 }
 
+/*
+    Removes the frames from \a frames that do not pass the filters set
+    with QCanBusDevice::RawFilterKey. Returns \c false if no frame is left.
+
+    The guard is released before the frames are enqueued, as enqueuing may
+    block until the application has read frames.
+*/
+bool QCanBusDevicePrivate::filterReceivedFrames(QList<QCanBusFrame> &frames)
+{
+    {
+        QMutexLocker locker(&frameFilterGuard);
+        const qsizetype removed = frames.removeIf([this](const QCanBusFrame &frame) {
+            return !frameFilter.accepts(frame);
+        });
+        statistics.filteredFrames.fetch_add(removed, std::memory_order_relaxed);
+    }
+    return !frames.isEmpty();
+}
+
+/*
+    Writes \a frames with QCanBusDevice::writeFrame() for plugins that cannot
+    write a batch. Such plugins may emit framesWritten() for every frame, so
+    the signals of the device are blocked meanwhile: the frames that did not
+    stay in the outgoing queue are announced once afterwards, together with
+    the other signals of the base class that were swallowed. Signals are not
+    blocked while the I/O thread runs, as it could emit them concurrently.
+*/
+qint64 QCanBusDevicePrivate::writeFramesOneByOne(const QList<QCanBusFrame> &frames)
+{
+    Q_Q(QCanBusDevice);
+
+    const auto writeAll = [q, &frames]() {
+        qint64 written = 0;
+        for (const QCanBusFrame &frame : frames) {
+            if (!q->writeFrame(frame))
+                break;
+            ++written;
+        }
+        return written;
+    };
+
+    if (q->signalsBlocked() || (ioThread && ioThread->isRunning()))
+        return writeAll();
+
+    const QCanBusDevice::CanBusDeviceState stateBefore = state;
+    const quint64 errorsBefore = errorCount;
+    const quint64 notificationsBefore = receivedNotifications;
+    const qsizetype queuedBefore = outgoingFrames.size() + transmitShaper.size();
+
+    qint64 written = 0;
+    {
+        const QSignalBlocker blocker(q);
+        deferFramesDropped = true;
+        written = writeAll();
+        deferFramesDropped = false;
+    }
+
+    if (state != stateBefore)
+        emit q->stateChanged(state);
+    // also flushes losses another thread reported meanwhile, its queued call finds none
+    emitFramesDropped();
+    if (receivedNotifications != notificationsBefore)
+        emit q->framesReceived();
+
+    const qsizetype queued = outgoingFrames.size() + transmitShaper.size() - queuedBefore;
+    if (written > queued)
+        emit q->framesWritten(written - queued);
+    if (errorCount != errorsBefore)
+        emit q->errorOccurred(lastError);
+
+    return written;
+}
+
+bool QCanBusDevicePrivate::rejectReceiveMonitor()
+{
+    Q_Q(QCanBusDevice);
+
+    const char error[] = QT_TRANSLATE_NOOP("QCanBusDevice",
+            "This CAN bus plugin does not support receive monitors.");
+    qCWarning(QT_CANBUS, error);
+    q->setError(QCanBusDevice::tr(error), QCanBusDevice::CanBusError::ConfigurationError);
+    return false;
+}
+
+// Returns true for the keys QCanBusDevice applies without the help of the
+// plugin; they are not passed to QCanBusDeviceHooks.
+bool QCanBusDevicePrivate::isDeviceConfigurationKey(QCanBusDevice::ConfigurationKey key)
+{
+    switch (key) {
+    case QCanBusDevice::NotificationFrameCountKey:
+    case QCanBusDevice::NotificationIntervalKey:
+    case QCanBusDevice::LastValueCacheKey:
+    case QCanBusDevice::ChangedFramesOnlyKey:
+    case QCanBusDevice::ChangeHeartbeatIntervalKey:
+    case QCanBusDevice::WriteQueuePriorityKey:
+    case QCanBusDevice::TransmitShapingKey:
+    case QCanBusDevice::TransmitBusLoadLimitKey:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void QCanBusDevicePrivate::enqueueOutgoingFrame(const QCanBusFrame &frame, qint64 deadline)
+{
+    if (Q_UNLIKELY(transmitShaper.isActive())) {
+        transmitShaper.enqueue(frame, deadline);
+        releaseShapedFrames();
+        return;
+    }
+
+    dropExpiredOutgoingFrames();
+    outgoingFrames.enqueue(frame, deadline);
+}
+
+void QCanBusDevicePrivate::dropExpiredOutgoingFrames()
+{
+    if (outgoingFrames.hasDeadlines())
+        outgoingFrames.dropExpired(QDeadlineTimer::current().deadlineNSecs());
+}
+
+// Returns the number of outgoing frames whose deadline has not passed.
+qsizetype QCanBusDevicePrivate::pendingOutgoingFrames() const
+{
+    if (!outgoingFrames.hasDeadlines())
+        return outgoingFrames.size();
+
+    return outgoingFrames.size()
+            - outgoingFrames.expiredSize(QDeadlineTimer::current().deadlineNSecs());
+}
+
+void QCanBusDevicePrivate::addFrameObserver(const void *owner, FrameObserver observer)
+{
+    QMutexLocker locker(&frameObserversGuard);
+    frameObservers.append({owner, std::move(observer)});
+    hasFrameObservers.store(true, std::memory_order_release);
+}
+
+/*
+    Once this function returns, the observers of \a owner are not running
+    and are not called again.
+*/
+void QCanBusDevicePrivate::removeFrameObserver(const void *owner)
+{
+    QMutexLocker locker(&frameObserversGuard);
+    frameObservers.removeIf([owner](const QPair<const void *, FrameObserver> &entry) {
+        return entry.first == owner;
+    });
+    hasFrameObservers.store(!frameObservers.isEmpty(), std::memory_order_release);
+}
+
+void QCanBusDevicePrivate::notifyFrameObservers(const QList<QCanBusFrame> &frames)
+{
+    QMutexLocker locker(&frameObserversGuard);
+    for (const auto &entry : std::as_const(frameObservers))
+        entry.second(frames);
+}
+
+bool QCanBusDevicePrivate::dropUnchangedFrames(QList<QCanBusFrame> &frames)
+{
+    using namespace std::chrono;
+    const qint64 now = duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+
+    {
+        QMutexLocker locker(&changeFilterGuard);
+        const qsizetype removed = frames.removeIf([this, now](const QCanBusFrame &frame) {
+            return !changeFilter.accepts(frame, now);
+        });
+        statistics.filteredFrames.fetch_add(removed, std::memory_order_relaxed);
+    }
+    return !frames.isEmpty();
+}
+
+/*
+    Announces \a frames new frames according to the notification policy set
+    with QCanBusDevice::NotificationFrameCountKey and
+    QCanBusDevice::NotificationIntervalKey. Frames enqueued by another thread
+    are checked with one queued call in the thread of the device, no matter
+    how many batches arrive until the event loop handles it.
+*/
+void QCanBusDevicePrivate::notifyFramesReceived(qsizetype frames)
+{
+    Q_Q(QCanBusDevice);
+
+    unnotifiedFrames.fetch_add(frames, std::memory_order_relaxed);
+
+    if (QThread::currentThread() == q->thread()) {
+        checkFramesReceived();
+        return;
+    }
+
+    if (framesReceivedPending.exchange(true, std::memory_order_acq_rel))
+        return;
+
+    QMetaObject::invokeMethod(q, [this]() {
+        framesReceivedPending.store(false, std::memory_order_release);
+        checkFramesReceived();
+    }, Qt::QueuedConnection);
+}
+
+void QCanBusDevicePrivate::checkFramesReceived()
+{
+    Q_Q(QCanBusDevice);
+
+    const qint64 pending = unnotifiedFrames.load(std::memory_order_relaxed);
+    if (pending <= 0)
+        return;
+
+    const int interval = notificationInterval.load(std::memory_order_relaxed);
+    if (interval <= 0 || pending >= notificationFrameCount.load(std::memory_order_relaxed)) {
+        emitFramesReceived();
+        return;
+    }
+
+    if (!notificationTimer) {
+        notificationTimer = new QTimer(q);
+        notificationTimer->setSingleShot(true);
+        notificationTimer->setTimerType(Qt::PreciseTimer);
+        QObject::connect(notificationTimer, &QTimer::timeout, q, [this]() {
+            if (unnotifiedFrames.load(std::memory_order_relaxed) > 0)
+                emitFramesReceived();
+        });
+    }
+
+    // the interval starts with the first frame that was not announced yet
+    if (!notificationTimer->isActive())
+        notificationTimer->start((interval + 999) / 1000);
+}
+
+void QCanBusDevicePrivate::emitFramesReceived()
+{
+    Q_Q(QCanBusDevice);
+
+    unnotifiedFrames.store(0, std::memory_order_relaxed);
+    if (notificationTimer)
+        notificationTimer->stop();
+
+    ++receivedNotifications;
+    emit q->framesReceived();
+}
+
+void QCanBusDevicePrivate::updateNotificationPolicy()
+{
+    Q_Q(QCanBusDevice);
+
+    const int frameCount
+            = q->configurationParameter(QCanBusDevice::NotificationFrameCountKey).toInt();
+    const int interval
+            = q->configurationParameter(QCanBusDevice::NotificationIntervalKey).toInt();
+    notificationFrameCount.store(qMax(frameCount, 1), std::memory_order_relaxed);
+    notificationInterval.store(qMax(interval, 0), std::memory_order_relaxed);
+
+    // frames waiting for a notification must not wait for the new interval
+    checkFramesReceived();
+}
+
+void QCanBusDevicePrivate::updateLastValues(const QList<QCanBusFrame> &frames)
+{
+    QCanBusLastValueCache *cache = lastValueCache.load(std::memory_order_acquire);
+    if (!cache)
+        return;
+
+    for (const QCanBusFrame &frame : frames)
+        cache->update(frame);
+}
+
+/*
+    The table is never freed before the device, because the receiving thread
+    and readers in other threads may still use it. Disabling the cache hides
+    it and schedules clearing it, so that enabling it again starts empty.
+*/
+void QCanBusDevicePrivate::updateLastValueCache()
+{
+    Q_Q(QCanBusDevice);
+
+    const bool enabled = q->configurationParameter(QCanBusDevice::LastValueCacheKey).toBool();
+    if (enabled == (lastValueCache.load(std::memory_order_relaxed) != nullptr))
+        return;
+
+    if (!enabled) {
+        lastValueCacheStorage->scheduleClear();
+        lastValueCache.store(nullptr, std::memory_order_release);
+        return;
+    }
+
+    if (!lastValueCacheStorage)
+        lastValueCacheStorage = std::make_unique<QCanBusLastValueCache>();
+    lastValueCache.store(lastValueCacheStorage.get(), std::memory_order_release);
+}
+
+void QCanBusDevicePrivate::countReceivedFrames(const QList<QCanBusFrame> &frames)
+{
+    qint64 bytes = 0;
+    for (const QCanBusFrame &frame : frames)
+        bytes += frame.payloadView().size();
+
+    statistics.receivedFrames.fetch_add(frames.size(), std::memory_order_relaxed);
+    statistics.receivedBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+/*
+    Announces \a frames received frames that were lost, either in the
+    receive queue of the device or, as reported by the plugin, before they
+    reached it. Losses reported by another thread are collected and
+    announced with one queued call in the thread of the device, like
+    notifyFramesReceived() does.
+*/
+void QCanBusDevicePrivate::reportDroppedFrames(qint64 frames)
+{
+    Q_Q(QCanBusDevice);
+
+    unreportedDroppedFrames.fetch_add(frames, std::memory_order_relaxed);
+
+    if (QThread::currentThread() == q->thread()) {
+        if (!deferFramesDropped)
+            emitFramesDropped();
+        return;
+    }
+
+    if (framesDroppedPending.exchange(true, std::memory_order_acq_rel))
+        return;
+
+    QMetaObject::invokeMethod(q, [this]() {
+        framesDroppedPending.store(false, std::memory_order_release);
+        emitFramesDropped();
+    }, Qt::QueuedConnection);
+}
+
+void QCanBusDevicePrivate::emitFramesDropped()
+{
+    Q_Q(QCanBusDevice);
+
+    const qint64 dropped = unreportedDroppedFrames.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+        emit q->framesDropped(dropped);
+}
+
+/*
+    Adds the time between the timestamps of \a count \a frames and now to
+    the read latency histogram. Only timestamps based on the system clock
+    give a plausible latency, all others are skipped.
+*/
+void QCanBusDevicePrivate::recordReadLatency(const QCanBusFrame *frames, qsizetype count)
+{
+    if (count <= 0)
+        return;
+
+    using namespace std::chrono;
+    const qint64 now = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+
+    for (qsizetype i = 0; i < count; ++i) {
+        const QCanBusFrame::TimeStamp timeStamp = frames[i].timeStamp();
+        const qint64 received = timeStamp.seconds() * 1000000 + timeStamp.microSeconds();
+        if (received > 0)
+            recordLatency(&statistics.readLatency, now - received);
+    }
+}
+
+/*
+    Counts \a latency in microseconds in the logarithmic \a histogram.
+    Negative latencies and latencies beyond the last bucket are skipped.
+*/
+void QCanBusDevicePrivate::recordLatency(LatencyHistogram *histogram, qint64 latency)
+{
+    constexpr qint64 maximumLatency = Q_INT64_C(1) << QCanBusDeviceStatistics::ReadLatencyBuckets;
+    if (latency < 0 || latency >= maximumLatency)
+        return;
+
+    const int bucket = latency < 2 ? 0 : 63 - qCountLeadingZeroBits(quint64(latency));
+    (*histogram)[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void QCanBusDevicePrivate::updateChangeFilter()
+{
+    Q_Q(QCanBusDevice);
+
+    const bool enabled = q->configurationParameter(QCanBusDevice::ChangedFramesOnlyKey).toBool();
+    const int heartbeat = q->configurationParameter(QCanBusDevice::ChangeHeartbeatIntervalKey).toInt();
+
+    QMutexLocker locker(&changeFilterGuard);
+    changeFilter.clear();
+    changeFilter.setHeartbeatInterval(qMax(heartbeat, 0));
+    changeFilterActive.store(enabled, std::memory_order_relaxed);
+}
+
+/*
+    Rules and the bus budget are only replaced for their own keys, so that
+    changing the bit rate does not refill the buckets.
+*/
+void QCanBusDevicePrivate::updateTransmitShaper(QCanBusDevice::ConfigurationKey key)
+{
+    Q_Q(QCanBusDevice);
+
+    const qint64 now = QDeadlineTimer::current().deadlineNSecs();
+    if (key == QCanBusDevice::TransmitShapingKey) {
+        const QVariant value = q->configurationParameter(QCanBusDevice::TransmitShapingKey);
+        QList<QCanBusDevice::ShapingRule> rules = value.value<QList<QCanBusDevice::ShapingRule>>();
+        const qsizetype invalid = rules.removeIf([](const QCanBusDevice::ShapingRule &rule) {
+            return rule.rate <= 0;
+        });
+        if (Q_UNLIKELY(invalid > 0)) {
+            qCWarning(QT_CANBUS, "Ignoring %lld transmit shaping rules without a positive rate.",
+                      qlonglong(invalid));
+        }
+        transmitShaper.setRules(rules, now);
+    } else {
+        const int busLoad = q->configurationParameter(QCanBusDevice::TransmitBusLoadLimitKey).toInt();
+        const int bitRate = q->configurationParameter(QCanBusDevice::BitRateKey).toInt();
+        const int dataBitRate = q->configurationParameter(QCanBusDevice::DataBitRateKey).toInt();
+        if (Q_UNLIKELY(key == QCanBusDevice::TransmitBusLoadLimitKey && busLoad > 0
+                       && bitRate <= 0)) {
+            qCWarning(QT_CANBUS, "The transmit bus load limit has no effect without a bit rate.");
+        }
+        transmitShaper.setBusBudget(busLoad, bitRate, dataBitRate, now);
+    }
+
+    if (releaseShapedFrames() > 0)
+        triggerWrite();
+}
+
+/*
+    Moves the frames the transmit shaper allows to the outgoing queue and
+    arms one timer for the next frame it holds back. Returns the number of
+    moved frames.
+*/
+qsizetype QCanBusDevicePrivate::releaseShapedFrames()
+{
+    Q_Q(QCanBusDevice);
+
+    if (transmitShaper.isEmpty()) {
+        if (shapingTimer)
+            shapingTimer->stop();
+        return 0;
+    }
+
+    const qint64 now = QDeadlineTimer::current().deadlineNSecs();
+    const qsizetype released = transmitShaper.release(now, &outgoingFrames);
+
+    const qint64 next = transmitShaper.nextRelease();
+    if (next == QCanBusOutgoingQueue::NoDeadline) {
+        if (shapingTimer)
+            shapingTimer->stop();
+        return released;
+    }
+
+    if (!shapingTimer) {
+        shapingTimer = new QTimer(q);
+        shapingTimer->setSingleShot(true);
+        shapingTimer->setTimerType(Qt::PreciseTimer);
+        QObject::connect(shapingTimer, &QTimer::timeout, q, [this]() {
+            if (releaseShapedFrames() > 0)
+                triggerWrite();
+        });
+    }
+
+    // round up, the timer then never fires before a frame may be released
+    const qint64 wait = (qMax(next - now, Q_INT64_C(0)) + 999999) / 1000000;
+    shapingTimer->start(int(qMin(wait, qint64(std::numeric_limits<int>::max()))));
+    return released;
+}
+
+void QCanBusDevicePrivate::triggerWrite()
+{
+    if (hooks && state == QCanBusDevice::ConnectedState)
+        hooks->writeOutgoingFrames();
+}
+
+quint64 QCanBusDevicePrivate::cyclicTick(qint64 now) const
+{
+    return quint64(qMax(now - cyclicEpoch, Q_INT64_C(0)) / 1000000);
+}
+
+/*
+    Writes the cyclic frames that are due and records how far their
+    transmission deviates from the schedule. The frames are written without
+    holding the lock, so that slots connected to the signals of the device
+    may change the cyclic frames.
+*/
+void QCanBusDevicePrivate::writeCyclicFrames()
+{
+    Q_Q(QCanBusDevice);
+
+    const qint64 now = QDeadlineTimer::current().deadlineNSecs();
+    QList<QCanBusCyclicScheduler::Due> due;
+    {
+        QMutexLocker locker(&cyclicFramesGuard);
+        due = cyclicFrames.advance(cyclicTick(now));
+    }
+
+    for (const QCanBusCyclicScheduler::Due &entry : std::as_const(due)) {
+        const qint64 scheduled = cyclicEpoch + qint64(entry.tick) * 1000000;
+        recordLatency(&statistics.cyclicJitter, qAbs(now - scheduled) / 1000);
+        if (state == QCanBusDevice::ConnectedState)
+            q->writeFrame(entry.frame);
+    }
+
+    startCyclicTimer(now);
+}
+
+/*
+    Offers the cyclic frames that were added while the device was not
+    connected to the plugin, keeping their schedule. Frames updated while the
+    plugin starts the transmission are passed on, removed frames are stopped.
+*/
+void QCanBusDevicePrivate::offloadCyclicFrames()
+{
+    if (!hooks || !cyclicTimer)
+        return;
+
+    QList<QCanBusCyclicScheduler::Schedule> schedules;
+    {
+        QMutexLocker locker(&cyclicFramesGuard);
+        schedules = cyclicFrames.schedules();
+    }
+    if (schedules.isEmpty())
+        return;
+
+    const qint64 now = QDeadlineTimer::current().deadlineNSecs();
+    const quint64 tick = cyclicTick(now);
+    for (const QCanBusCyclicScheduler::Schedule &schedule : std::as_const(schedules)) {
+        const quint64 phase = schedule.nextTick > tick ? schedule.nextTick - tick : 0;
+        if (schedule.period > quint64(std::numeric_limits<int>::max())
+                || !hooks->startCyclicTransmission(schedule.id, schedule.frame,
+                                                   int(schedule.period),
+                                                   int(qMin(phase, schedule.period)))) {
+            continue;
+        }
+
+        QCanBusCyclicScheduler::Schedule current;
+        bool taken;
+        {
+            QMutexLocker locker(&cyclicFramesGuard);
+            taken = cyclicFrames.take(schedule.id, &current);
+            if (taken)
+                offloadedCyclicFrames.insert(schedule.id);
+        }
+        if (!taken)
+            hooks->stopCyclicTransmission(schedule.id);
+        else if (current.revision != schedule.revision)
+            hooks->updateCyclicTransmission(schedule.id, current.frame);
+    }
+
+    startCyclicTimer(now);
+}
+
+void QCanBusDevicePrivate::startCyclicTimer(qint64 now)
+{
+    quint64 next;
+    {
+        QMutexLocker locker(&cyclicFramesGuard);
+        next = cyclicFrames.nextExpiry();
+    }
+
+    if (next == QCanBusCyclicScheduler::NoExpiry) {
+        cyclicTimer->stop();
+        return;
+    }
+
+    // round up, the timer then never fires before the tick begins
+    const qint64 wait = cyclicEpoch + qint64(next) * 1000000 - now;
+    cyclicTimer->start(int(qBound(Q_INT64_C(0), (wait + 999999) / 1000000,
+                                  qint64(std::numeric_limits<int>::max()))));
+}
+
+void QCanBusDevicePrivate::updateFrameFilter()
+{
+    Q_Q(QCanBusDevice);
+
+    QMutexLocker locker(&frameFilterGuard);
+    if (hardwareFiltering) {
+        frameFilter.clear();
+    } else {
+        const QVariant filters = q->configurationParameter(QCanBusDevice::RawFilterKey);
+        frameFilter.setFilters(filters.value<QList<QCanBusDevice::Filter>>());
+    }
+    frameFilterActive.store(!frameFilter.isEmpty(), std::memory_order_relaxed);
+}
+
+/*
+    Registers the capabilities of \a device, which must inherit this class.
+*/
+QCanBusDeviceHooks::QCanBusDeviceHooks(QCanBusDevice *device)
+    : m_device(device)
+{
+    QCanBusDevicePrivate::get(device)->hooks = this;
+}
+
+QCanBusDeviceHooks::~QCanBusDeviceHooks()
+{
+    QCanBusDevicePrivate::get(m_device)->hooks = nullptr;
+}
+
+qint64 QCanBusDeviceHooks::writeFrameBatch(const QList<QCanBusFrame> &)
+{
+    return -1;
+}
+
+bool QCanBusDeviceHooks::startCyclicTransmission(int, const QCanBusFrame &, int, int)
+{
+    return false;
+}
+
+bool QCanBusDeviceHooks::updateCyclicTransmission(int, const QCanBusFrame &)
+{
+    return false;
+}
+
+void QCanBusDeviceHooks::stopCyclicTransmission(int)
+{
+}
+
+bool QCanBusDeviceHooks::startReceiveMonitor(QCanBusFrame::FrameId, const QByteArray &, int,
+                                             bool)
+{
+    return QCanBusDevicePrivate::get(m_device)->rejectReceiveMonitor();
+}
+
+bool QCanBusDeviceHooks::stopReceiveMonitor(QCanBusFrame::FrameId, bool)
+{
+    return false;
+}
+
+bool QCanBusDeviceHooks::writeExpiringFrame(const QCanBusFrame &frame, qint64)
+{
+    return m_device->writeFrame(frame);
+}
+
+void QCanBusDeviceHooks::writeOutgoingFrames()
+{
+}
+
+bool QCanBusDeviceHooks::setPluginConfigurationParameter(QCanBusDevice::ConfigurationKey,
+                                                         const QVariant &)
+{
+    return true;
+}
+
+QList<QCanBusDevice::ConfigurationKey> QCanBusDeviceHooks::pluginConfigurationKeys() const
+{
+    QList<QCanBusDevice::ConfigurationKey> keys = m_device->configurationKeys();
+    keys.removeIf(&QCanBusDevicePrivate::isDeviceConfigurationKey);
+    return keys;
+}
+
+void QCanBusDeviceHooks::enqueueExpiringFrame(const QCanBusFrame &frame, qint64 deadline)
+{
+    QCanBusDevicePrivate::get(m_device)->enqueueOutgoingFrame(frame, deadline);
+}
+
+void QCanBusDeviceHooks::dropExpiredFrames()
+{
+    QCanBusDevicePrivate::get(m_device)->dropExpiredOutgoingFrames();
+}
+
+void QCanBusDeviceHooks::removeOutgoingFrames(qint64 count)
+{
+    QCanBusOutgoingQueue &frames = QCanBusDevicePrivate::get(m_device)->outgoingFrames;
+    for (; count > 0 && !frames.isEmpty(); --count)
+        frames.dequeue();
+}
+
 QT_END_NAMESPACE
@@ -41,15 +41,19 @@
 #ifndef QCANBUSDEVICE_H
 #define QCANBUSDEVICE_H
 
+#include <QtCore/qdeadlinetimer.h>
 #include <QtCore/qobject.h>
 #include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qcanbusframebatch.h>
 #include <QtSerialBus/qcanbusdeviceinfo.h>
+#include <QtSerialBus/qcanbusdevicestatistics.h>
 
 #include <functional>
 
 QT_BEGIN_NAMESPACE
 
 class QCanBusDevicePrivate;
+class QThread;
 
 class Q_SERIALBUS_EXPORT QCanBusDevice : public QObject
 {
@@ -96,10 +100,40 @@ public:
         CanFdKey,
         DataBitRateKey,
         ProtocolKey,
+        ReceiveBatchSizeKey,
+        TimeStampSourceKey,
+        CompiledFilterKey,
+        IoThreadKey,
+        IoThreadAffinityKey,
+        IoThreadPriorityKey,
+        NotificationFrameCountKey,
+        NotificationIntervalKey,
+        ReceiveBufferSizeKey,
+        LastValueCacheKey,
+        ChangedFramesOnlyKey,
+        ChangeHeartbeatIntervalKey,
+        TransmitConfirmationKey,
+        WriteQueuePriorityKey,
+        TransmitShapingKey,
+        TransmitBusLoadLimitKey,
         UserKey = 30
     };
     Q_ENUM(ConfigurationKey)
 
+    enum class OverflowPolicy {
+        DropOldest,
+        DropNewest,
+        Block
+    };
+    Q_ENUM(OverflowPolicy)
+
+    enum class TimeStampSource {
+        Software,
+        Hardware,
+        RawHardware
+    };
+    Q_ENUM(TimeStampSource)
+
     struct Filter
     {
         friend constexpr bool operator==(const Filter &a, const Filter &b) noexcept
@@ -126,6 +160,25 @@ public:
         FormatFilter format = MatchBaseAndExtendedFormat;
     };
 
+    struct ShapingRule
+    {
+        friend constexpr bool operator==(const ShapingRule &a, const ShapingRule &b) noexcept
+        {
+            return a.frameId == b.frameId && a.frameIdMask == b.frameIdMask
+                    && a.rate == b.rate && a.burst == b.burst;
+        }
+
+        friend constexpr bool operator!=(const ShapingRule &a, const ShapingRule &b) noexcept
+        {
+            return !operator==(a, b);
+        }
+
+        QCanBusFrame::FrameId frameId = 0;
+        QCanBusFrame::FrameId frameIdMask = 0;
+        int rate = 0;
+        int burst = 1;
+    };
+
     explicit QCanBusDevice(QObject *parent = nullptr);
 
     virtual void setConfigurationParameter(ConfigurationKey key, const QVariant &value);
@@ -133,11 +186,39 @@ public:
     QList<ConfigurationKey> configurationKeys() const;
 
     virtual bool writeFrame(const QCanBusFrame &frame) = 0;
+    bool writeFrameWithDeadline(const QCanBusFrame &frame, QDeadlineTimer deadline);
+    qint64 writeFrames(const QList<QCanBusFrame> &frames);
     QCanBusFrame readFrame();
     QList<QCanBusFrame> readAllFrames();
+    qint64 readFrames(QCanBusFrame *frames, qint64 maxFrames);
+    qint64 readFrames(QCanBusFrameBatch &batch, qint64 maxFrames = -1);
     qint64 framesAvailable() const;
     qint64 framesToWrite() const;
 
+    void setReceiveQueueCapacity(qint64 capacity);
+    qint64 receiveQueueCapacity() const;
+    void setOverflowPolicy(OverflowPolicy policy);
+    OverflowPolicy overflowPolicy() const;
+    qint64 droppedFramesCount() const;
+    qint64 receiveQueueHighWaterMark() const;
+
+    QCanBusDeviceStatistics statistics() const;
+    void resetStatistics();
+
+    QCanBusFrame lastFrame(QCanBusFrame::FrameId frameId, bool extendedFrameFormat = false,
+                           quint64 *updateCount = nullptr) const;
+    quint64 lastFrameUpdateCount(QCanBusFrame::FrameId frameId,
+                                 bool extendedFrameFormat = false) const;
+    QList<QCanBusFrame> lastFrames() const;
+
+    int addCyclicFrame(const QCanBusFrame &frame, int period, int phase = -1);
+    bool updateCyclicFrame(int id, const QCanBusFrame &frame);
+    bool removeCyclicFrame(int id);
+
+    bool addReceiveMonitor(QCanBusFrame::FrameId frameId, const QByteArray &contentMask,
+                           int timeout, bool extendedFrameFormat = false);
+    bool removeReceiveMonitor(QCanBusFrame::FrameId frameId, bool extendedFrameFormat = false);
+
     virtual void resetController();
     virtual bool hasBusStatus() const;
     virtual CanBusStatus busStatus();
@@ -168,6 +249,9 @@ Q_SIGNALS:
     void errorOccurred(QCanBusDevice::CanBusError);
     void framesReceived();
     void framesWritten(qint64 framesCount);
+    void framesDropped(qint64 framesCount);
+    void frameConfirmed(const QCanBusFrame &frame);
+    void receiveTimeout(QCanBusFrame::FrameId frameId, bool extendedFrameFormat);
     void stateChanged(QCanBusDevice::CanBusDeviceState state);
 
 protected:
@@ -176,11 +260,21 @@ protected:
     void clearError();
 
     void enqueueReceivedFrames(const QList<QCanBusFrame> &newFrames);
+    void enqueueReceivedFrames(QList<QCanBusFrame> &&newFrames);
 
     void enqueueOutgoingFrame(const QCanBusFrame &newFrame);
     QCanBusFrame dequeueOutgoingFrame();
+    QCanBusFrame peekOutgoingFrame(qint64 index = 0) const;
+    qint64 outgoingFrameCount() const;
     bool hasOutgoingFrames() const;
 
+    void setHardwareFiltering(bool enabled);
+    void setPluginCounter(const QString &name, qint64 value);
+    void confirmFrame(const QCanBusFrame &frame, qint64 latency = -1);
+
+    QThread *ioThread();
+    void stopIoThread();
+
     virtual bool open() = 0;
     virtual void close() = 0;
 
@@ -201,8 +295,11 @@ protected:
 Q_DECLARE_TYPEINFO(QCanBusDevice::CanBusError, Q_PRIMITIVE_TYPE);
 Q_DECLARE_TYPEINFO(QCanBusDevice::CanBusDeviceState, Q_PRIMITIVE_TYPE);
 Q_DECLARE_TYPEINFO(QCanBusDevice::ConfigurationKey, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(QCanBusDevice::OverflowPolicy, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(QCanBusDevice::TimeStampSource, Q_PRIMITIVE_TYPE);
 Q_DECLARE_TYPEINFO(QCanBusDevice::Filter, Q_PRIMITIVE_TYPE);
 Q_DECLARE_TYPEINFO(QCanBusDevice::Filter::FormatFilter, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(QCanBusDevice::ShapingRule, Q_PRIMITIVE_TYPE);
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(QCanBusDevice::Filter::FormatFilters)
 Q_DECLARE_OPERATORS_FOR_FLAGS(QCanBusDevice::Directions)
@@ -211,5 +308,6 @@ QT_END_NAMESPACE
 
 Q_DECLARE_METATYPE(QCanBusDevice::Filter::FormatFilter)
 Q_DECLARE_METATYPE(QList<QCanBusDevice::Filter>)
+Q_DECLARE_METATYPE(QList<QCanBusDevice::ShapingRule>)
 
 #endif // QCANBUSDEVICE_H
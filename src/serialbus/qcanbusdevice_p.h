@@ -40,11 +40,28 @@
 #ifndef QCANBUSDEVICE_P_H
 #define QCANBUSDEVICE_P_H
 
-#include <QtCore/qmutex.h>
 #include <QtSerialBus/qcanbusdevice.h>
 
+#include "qcanbuschangefilter_p.h"
+#include "qcanbuscyclicscheduler_p.h"
+#include "qcanbusdevicehooks_p.h"
+#include "qcanbusdevicestatistics_p.h"
+#include "qcanbusframefilter_p.h"
+#include "qcanbusframequeue_p.h"
+#include "qcanbuslastvaluecache_p.h"
+#include "qcanbusoutgoingqueue_p.h"
+#include "qcanbustransmitshaper_p.h"
+
+#include <QtCore/qmutex.h>
+#include <QtCore/qset.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qtimer.h>
+
 #include <private/qobject_p.h>
 
+#include <array>
+#include <functional>
+
 //
 //  W A R N I N G
 //  -------------
@@ -65,16 +82,133 @@ class QCanBusDevicePrivate : public QObjectPrivate
     Q_DECLARE_PUBLIC(QCanBusDevice)
 public:
     QCanBusDevicePrivate() {}
+    ~QCanBusDevicePrivate() override
+    {
+        if (ioThread) {
+            incomingFrames.setWaitsInterrupted(true);
+            ioThread->quit();
+            ioThread->wait();
+        }
+    }
+
+    static QCanBusDevicePrivate *get(QCanBusDevice *device) { return device->d_func(); }
+
+    void notifyFramesReceived(qsizetype frames);
+    void checkFramesReceived();
+    void emitFramesReceived();
+    void updateNotificationPolicy();
 
     QCanBusDevice::CanBusError lastError = QCanBusDevice::CanBusError::NoError;
     QCanBusDevice::CanBusDeviceState state = QCanBusDevice::UnconnectedState;
     QString errorText;
+    quint64 errorCount = 0;
+    quint64 receivedNotifications = 0;
+
+    // set by plugins that implement QCanBusDeviceHooks
+    QCanBusDeviceHooks *hooks = nullptr;
+    static bool isDeviceConfigurationKey(QCanBusDevice::ConfigurationKey key);
+    qint64 writeFramesOneByOne(const QList<QCanBusFrame> &frames);
+    bool rejectReceiveMonitor();
+
+    bool filterReceivedFrames(QList<QCanBusFrame> &frames);
+    void countReceivedFrames(const QList<QCanBusFrame> &frames);
+    // counts bytes of frames a plugin reported with framesWritten()
+    void countWrittenBytes(qint64 bytes)
+    { statistics.writtenBytes.fetch_add(bytes, std::memory_order_relaxed); }
+    // the only place frames lost on the receive path are announced
+    void reportDroppedFrames(qint64 frames);
+    void emitFramesDropped();
+    void recordReadLatency(const QCanBusFrame *frames, qsizetype count);
+    using LatencyHistogram =
+            std::array<std::atomic<qint64>, QCanBusDeviceStatistics::ReadLatencyBuckets>;
+    static void recordLatency(LatencyHistogram *histogram, qint64 latency);
+    void updateFrameFilter();
+    void updateLastValues(const QList<QCanBusFrame> &frames);
+    void updateLastValueCache();
+    bool dropUnchangedFrames(QList<QCanBusFrame> &frames);
+    void updateChangeFilter();
+
+    QCanBusFrameQueue incomingFrames{QCanBusFrameQueue::Unbounded};
+    // expired frames are dropped when frames are enqueued or dequeued
+    QCanBusOutgoingQueue outgoingFrames;
+    void enqueueOutgoingFrame(const QCanBusFrame &frame, qint64 deadline);
+    void dropExpiredOutgoingFrames();
+    qsizetype pendingOutgoingFrames() const;
 
-    QList<QCanBusFrame> incomingFrames;
-    QMutex incomingFramesGuard;
-    QList<QCanBusFrame> outgoingFrames;
+    // frames held back by TransmitShapingKey and TransmitBusLoadLimitKey
+    void updateTransmitShaper(QCanBusDevice::ConfigurationKey key);
+    qsizetype releaseShapedFrames();
+    void triggerWrite();
+
+    QCanBusTransmitShaper transmitShaper;
+    QTimer *shapingTimer = nullptr;
+
+    // frames written periodically, see addCyclicFrame(); one tick per millisecond
+    quint64 cyclicTick(qint64 now) const;
+    void writeCyclicFrames();
+    void startCyclicTimer(qint64 now);
+    void offloadCyclicFrames();
+
+    QCanBusCyclicScheduler cyclicFrames;
+    QSet<int> offloadedCyclicFrames; // written by the plugin
+    QMutex cyclicFramesGuard;
+    QTimer *cyclicTimer = nullptr;
+    qint64 cyclicEpoch = 0;
+    int nextCyclicFrameId = 1;
     QList<ConfigEntry> configOptions;
 
+    QCanBusFrameFilter frameFilter;
+    mutable QMutex frameFilterGuard;
+    std::atomic<bool> frameFilterActive = false;
+    bool hardwareFiltering = false;
+
+    // components that look at received frames without reading them, the
+    // callbacks run in the thread that enqueues the frames
+    using FrameObserver = std::function<void(const QList<QCanBusFrame> &)>;
+    void addFrameObserver(const void *owner, FrameObserver observer);
+    void removeFrameObserver(const void *owner);
+    void notifyFrameObservers(const QList<QCanBusFrame> &frames);
+
+    QMutex frameObserversGuard;
+    QList<QPair<const void *, FrameObserver>> frameObservers;
+    std::atomic<bool> hasFrameObservers = false;
+
+    QCanBusChangeFilter changeFilter;
+    QMutex changeFilterGuard;
+    std::atomic<bool> changeFilterActive = false;
+
+    // kept until destruction once created, readers may still use it
+    std::unique_ptr<QCanBusLastValueCache> lastValueCacheStorage;
+    std::atomic<QCanBusLastValueCache *> lastValueCache = nullptr;
+
+    std::unique_ptr<QThread> ioThread;
+    QList<int> ioThreadCpus;
+    int ioThreadPriority = 0;
+    std::atomic<bool> framesReceivedPending = false;
+    std::atomic<qint64> unnotifiedFrames = 0;
+    std::atomic<bool> framesDroppedPending = false;
+    std::atomic<qint64> unreportedDroppedFrames = 0;
+    bool deferFramesDropped = false; // only used in the thread of the device
+    std::atomic<int> notificationFrameCount = 1;
+    std::atomic<int> notificationInterval = 0; // microseconds, 0 means immediate
+    QTimer *notificationTimer = nullptr;
+
+    // updated with relaxed atomics from any thread
+    struct Statistics {
+        std::atomic<qint64> receivedFrames{0};
+        std::atomic<qint64> receivedBytes{0};
+        std::atomic<qint64> filteredFrames{0};
+        std::atomic<qint64> writtenFrames{0};
+        std::atomic<qint64> writtenBytes{0};
+        std::atomic<qint64> writeErrors{0};
+        LatencyHistogram readLatency{};
+        LatencyHistogram transmitLatency{};
+        LatencyHistogram cyclicJitter{};
+    };
+    Statistics statistics;
+    mutable QMutex pluginCountersGuard;
+    QHash<QString, qint64> pluginCounters;
+
     bool waitForReceivedEntered = false;
     bool waitForWrittenEntered = false;
 
@@ -0,0 +1,147 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSDEVICEHOOKS_P_H
+#define QCANBUSDEVICEHOOKS_P_H
+
+#include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+#include <QtCore/qlist.h>
+#include <QtCore/qvariant.h>
+
+#include <limits>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Optional capabilities of the CAN plugins shipped with Qt Serial Bus.
+
+    QCanBusDevice has no virtual functions for these, so that they can be
+    extended without breaking the binary compatibility of the public class.
+    A plugin inherits this class in addition to QCanBusDevice and passes its
+    device to the constructor; QCanBusDevice then calls the reimplemented
+    functions instead of its fallback. The default implementations report
+    that the capability is not supported.
+*/
+class Q_SERIALBUS_EXPORT QCanBusDeviceHooks
+{
+public:
+    explicit QCanBusDeviceHooks(QCanBusDevice *device);
+    virtual ~QCanBusDeviceHooks();
+
+    // Writes all frames at once, emits QCanBusDevice::framesWritten() once
+    // and returns the number of frames written, or -1 if the frames must be
+    // written one by one.
+    virtual qint64 writeFrameBatch(const QList<QCanBusFrame> &frames);
+
+    // Writes the frame every period milliseconds without the help of
+    // QCanBusDevice, for example in the kernel or in the firmware of the
+    // adapter, starting phase milliseconds from now. The transmission is
+    // kept over reconnects until it is stopped.
+    virtual bool startCyclicTransmission(int id, const QCanBusFrame &frame, int period,
+                                         int phase);
+    virtual bool updateCyclicTransmission(int id, const QCanBusFrame &frame);
+    virtual void stopCyclicTransmission(int id);
+
+    // See QCanBusDevice::addReceiveMonitor(). The default implementation
+    // sets a QCanBusDevice::ConfigurationError.
+    virtual bool startReceiveMonitor(QCanBusFrame::FrameId frameId,
+                                     const QByteArray &contentMask, int timeout,
+                                     bool extendedFrameFormat);
+    virtual bool stopReceiveMonitor(QCanBusFrame::FrameId frameId, bool extendedFrameFormat);
+
+    // Writes the frame like QCanBusDevice::writeFrame(). If the frame is
+    // buffered, it is queued with enqueueExpiringFrame() and dropped when it
+    // is still buffered at the deadline, in nanoseconds of QDeadlineTimer.
+    // The default implementation calls QCanBusDevice::writeFrame().
+    virtual bool writeExpiringFrame(const QCanBusFrame &frame, qint64 deadline);
+
+    static constexpr qint64 NoDeadline = std::numeric_limits<qint64>::max();
+
+    // Writes the list of outgoing frames. Called while the device is connected
+    // when frames that QCanBusDevice::TransmitShapingKey or
+    // QCanBusDevice::TransmitBusLoadLimitKey held back were appended to it.
+    // The default implementation does nothing, the frames then wait for the
+    // next write.
+    virtual void writeOutgoingFrames();
+
+    // Called by QCanBusDevice::setConfigurationParameter() before the value
+    // is stored, for all keys except the ones QCanBusDevice applies on its
+    // own. Returns false to reject the value. The default implementation
+    // accepts all values.
+    virtual bool setPluginConfigurationParameter(QCanBusDevice::ConfigurationKey key,
+                                                 const QVariant &value);
+
+protected:
+    // The stored configuration keys setPluginConfigurationParameter() is
+    // called for, for applying them when the plugin connects.
+    QList<QCanBusDevice::ConfigurationKey> pluginConfigurationKeys() const;
+
+    void enqueueExpiringFrame(const QCanBusFrame &frame, qint64 deadline);
+
+    // For plugins that write frames returned by peekOutgoingFrame(): drops
+    // the expired frames before the frames are peeked, and removes the
+    // peeked frames once they are handled. Unlike dequeueOutgoingFrame(),
+    // removeOutgoingFrames() also removes frames that expired meanwhile,
+    // so that it removes exactly the frames that were peeked.
+    void dropExpiredFrames();
+    void removeOutgoingFrames(qint64 count);
+
+private:
+    Q_DISABLE_COPY_MOVE(QCanBusDeviceHooks)
+
+    QCanBusDevice *m_device;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSDEVICEHOOKS_P_H
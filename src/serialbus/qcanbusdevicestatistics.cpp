@@ -0,0 +1,259 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcanbusdevicestatistics.h"
+#include "qcanbusdevicestatistics_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QCanBusDeviceStatistics
+    \inmodule QtSerialBus
+    \since 6.4
+
+    \brief The QCanBusDeviceStatistics class holds the runtime statistics of
+    a CAN bus device.
+
+    A QCanBusDeviceStatistics object is a snapshot of the counters of a
+    QCanBusDevice, taken with QCanBusDevice::statistics(). The counters are
+    maintained with relaxed atomic operations, so that they can stay enabled
+    on busy buses. Counters that are updated concurrently by another thread
+    may be slightly out of step with each other.
+
+    \sa QCanBusDevice::resetStatistics()
+*/
+
+/*!
+    \enum QCanBusDeviceStatistics::anonymous
+
+    \value ReadLatencyBuckets   The number of buckets of the
+                                \l readLatencyHistogram(), the
+                                \l transmitLatencyHistogram() and the
+                                \l cyclicJitterHistogram().
+*/
+
+/*!
+    Constructs statistics with all counters set to zero.
+*/
+QCanBusDeviceStatistics::QCanBusDeviceStatistics() :
+    d_ptr(new QCanBusDeviceStatisticsPrivate)
+{
+    d_ptr->readLatencyHistogram.resize(ReadLatencyBuckets);
+    d_ptr->transmitLatencyHistogram.resize(ReadLatencyBuckets);
+    d_ptr->cyclicJitterHistogram.resize(ReadLatencyBuckets);
+}
+
+/*!
+    Constructs a copy of \a other.
+*/
+QCanBusDeviceStatistics::QCanBusDeviceStatistics(const QCanBusDeviceStatistics &) = default;
+
+/*!
+    Constructs CAN bus device statistics from QCanBusDeviceStatisticsPrivate \a dd.
+    \internal
+*/
+QCanBusDeviceStatistics::QCanBusDeviceStatistics(QCanBusDeviceStatisticsPrivate &dd) :
+    d_ptr(&dd)
+{
+}
+
+/*!
+    Destroys the CAN bus device statistics.
+*/
+QCanBusDeviceStatistics::~QCanBusDeviceStatistics() = default;
+
+/*!
+    \fn void QCanBusDeviceStatistics::swap(QCanBusDeviceStatistics &other)
+    Swaps these CAN bus device statistics with \a other. This operation is
+    very fast and never fails.
+*/
+
+/*!
+    \fn QCanBusDeviceStatistics &QCanBusDeviceStatistics::operator=(QCanBusDeviceStatistics &&other)
+
+    Move-assigns \a other to this QCanBusDeviceStatistics instance.
+*/
+
+/*!
+    Assigns \a other to these CAN bus device statistics and returns a
+    reference to them.
+*/
+QCanBusDeviceStatistics &QCanBusDeviceStatistics::operator=(const QCanBusDeviceStatistics &) = default;
+
+/*!
+    Returns the number of frames the CAN plugin received, including the
+    frames that were filtered or dropped afterwards.
+*/
+qint64 QCanBusDeviceStatistics::receivedFrames() const
+{
+    return d_ptr->receivedFrames;
+}
+
+/*!
+    Returns the number of payload bytes of the frames the CAN plugin received.
+*/
+qint64 QCanBusDeviceStatistics::receivedBytes() const
+{
+    return d_ptr->receivedBytes;
+}
+
+/*!
+    Returns the number of received frames that were discarded because they
+    did not match the filters set with QCanBusDevice::RawFilterKey. Frames
+    that the CAN plugin filters in hardware are not counted.
+*/
+qint64 QCanBusDeviceStatistics::filteredFrames() const
+{
+    return d_ptr->filteredFrames;
+}
+
+/*!
+    Returns the number of received frames that were discarded because the
+    receive queue was full.
+
+    \sa QCanBusDevice::droppedFramesCount()
+*/
+qint64 QCanBusDeviceStatistics::droppedFrames() const
+{
+    return d_ptr->droppedFrames;
+}
+
+/*!
+    Returns the largest number of frames that were waiting in the receive
+    queue at the same time.
+
+    \sa QCanBusDevice::receiveQueueHighWaterMark()
+*/
+qint64 QCanBusDeviceStatistics::receiveQueueHighWaterMark() const
+{
+    return d_ptr->receiveQueueHighWaterMark;
+}
+
+/*!
+    Returns the number of frames the CAN plugin reported as written with
+    QCanBusDevice::framesWritten().
+*/
+qint64 QCanBusDeviceStatistics::writtenFrames() const
+{
+    return d_ptr->writtenFrames;
+}
+
+/*!
+    Returns the number of payload bytes of the frames the CAN plugin reported
+    as written with QCanBusDevice::framesWritten(). Frames that were taken
+    from the write buffer but could not be written are not included.
+*/
+qint64 QCanBusDeviceStatistics::writtenBytes() const
+{
+    return d_ptr->writtenBytes;
+}
+
+/*!
+    Returns the number of times a QCanBusDevice::WriteError occurred.
+*/
+qint64 QCanBusDeviceStatistics::writeErrors() const
+{
+    return d_ptr->writeErrors;
+}
+
+/*!
+    Returns the number of buffered frames that were dropped because their
+    deadline expired before they could be written.
+
+    \sa QCanBusDevice::writeFrameWithDeadline()
+*/
+qint64 QCanBusDeviceStatistics::expiredFrames() const
+{
+    return d_ptr->expiredFrames;
+}
+
+/*!
+    Returns the histogram of the time between the timestamp of a received
+    frame and the moment the application read it with one of the read
+    functions of QCanBusDevice.
+
+    The list has \l ReadLatencyBuckets entries. Entry \c 0 counts the frames
+    read within 2 microseconds; every other entry \c n counts the frames read
+    after at least 2\sup{n} and less than 2\sup{n+1} microseconds.
+
+    Only frames with a timestamp based on the system clock are taken into
+    account, such as the software timestamps of the SocketCAN plugin. Frames
+    without timestamp, with a timestamp in the future, or with a latency
+    beyond the last bucket are ignored.
+*/
+QList<qint64> QCanBusDeviceStatistics::readLatencyHistogram() const
+{
+    return d_ptr->readLatencyHistogram;
+}
+
+/*!
+    Returns the histogram of the time between handing a written frame to the
+    operating system or the driver and the confirmation of its transmission
+    on the CAN bus, see QCanBusDevice::frameConfirmed(). The buckets are
+    divided like those of \l readLatencyHistogram().
+
+    Transmissions are only measured if QCanBusDevice::TransmitConfirmationKey
+    is enabled and the CAN plugin supports it.
+*/
+QList<qint64> QCanBusDeviceStatistics::transmitLatencyHistogram() const
+{
+    return d_ptr->transmitLatencyHistogram;
+}
+
+/*!
+    Returns the histogram of the time between the scheduled and the actual
+    transmission of the frames added with QCanBusDevice::addCyclicFrame().
+    The buckets are divided like those of \l readLatencyHistogram().
+*/
+QList<qint64> QCanBusDeviceStatistics::cyclicJitterHistogram() const
+{
+    return d_ptr->cyclicJitterHistogram;
+}
+
+/*!
+    Returns the counters that are maintained by the CAN plugin, for example
+    the number of frames dropped by the operating system. The available
+    counters depend on the plugin.
+*/
+QHash<QString, qint64> QCanBusDeviceStatistics::pluginCounters() const
+{
+    return d_ptr->pluginCounters;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,104 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSDEVICESTATISTICS_H
+#define QCANBUSDEVICESTATISTICS_H
+
+#include <QtCore/qhash.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qshareddata.h>
+#include <QtCore/qstring.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+class QCanBusDeviceStatisticsPrivate;
+
+class Q_SERIALBUS_EXPORT QCanBusDeviceStatistics
+{
+public:
+    enum {
+        ReadLatencyBuckets = 32
+    };
+
+    QCanBusDeviceStatistics();
+    QCanBusDeviceStatistics(const QCanBusDeviceStatistics &other);
+    ~QCanBusDeviceStatistics();
+
+    void swap(QCanBusDeviceStatistics &other) noexcept
+    {
+        qSwap(d_ptr, other.d_ptr);
+    }
+
+    QCanBusDeviceStatistics &operator=(const QCanBusDeviceStatistics &other);
+    QCanBusDeviceStatistics &operator=(QCanBusDeviceStatistics &&other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    qint64 receivedFrames() const;
+    qint64 receivedBytes() const;
+    qint64 filteredFrames() const;
+    qint64 droppedFrames() const;
+    qint64 receiveQueueHighWaterMark() const;
+
+    qint64 writtenFrames() const;
+    qint64 writtenBytes() const;
+    qint64 writeErrors() const;
+    qint64 expiredFrames() const;
+
+    QList<qint64> readLatencyHistogram() const;
+    QList<qint64> transmitLatencyHistogram() const;
+    QList<qint64> cyclicJitterHistogram() const;
+    QHash<QString, qint64> pluginCounters() const;
+
+private:
+    friend class QCanBusDevice;
+
+    explicit QCanBusDeviceStatistics(QCanBusDeviceStatisticsPrivate &dd);
+
+    QSharedDataPointer<QCanBusDeviceStatisticsPrivate> d_ptr;
+};
+
+Q_DECLARE_SHARED(QCanBusDeviceStatistics)
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSDEVICESTATISTICS_H
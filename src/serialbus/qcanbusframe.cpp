@@ -228,7 +228,21 @@ QT_BEGIN_NAMESPACE
 
     Returns the data payload of the frame.
 
-    \sa setPayload()
+    \sa setPayload(), payloadView()
+*/
+
+/*!
+    \fn QByteArrayView QCanBusFrame::payloadView() const
+    \since 6.4
+
+    Returns a view on the data payload of the frame. Unlike \l payload(),
+    this function does not touch the reference count of the payload, which
+    makes it suitable for code that only inspects the data.
+
+    The view remains valid as long as the frame exists and its payload
+    is not changed.
+
+    \sa payload(), setPayload()
 */
 
 /*!
@@ -40,6 +40,7 @@
 #ifndef QCANBUSFRAME_H
 #define QCANBUSFRAME_H
 
+#include <QtCore/qbytearrayview.h>
 #include <QtCore/qmetatype.h>
 #include <QtCore/qobject.h>
 #include <QtSerialBus/qtserialbusglobal.h>
@@ -212,6 +213,7 @@ public:
     constexpr void setTimeStamp(TimeStamp ts) noexcept { stamp = ts; }
 
     QByteArray payload() const { return load; }
+    QByteArrayView payloadView() const noexcept { return QByteArrayView(load); }
     constexpr TimeStamp timeStamp() const noexcept { return stamp; }
 
     constexpr FrameErrors error() const noexcept
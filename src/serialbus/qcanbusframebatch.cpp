@@ -0,0 +1,387 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcanbusframebatch.h"
+#include "qcanbusframebatch_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QCanBusFrameBatch
+    \inmodule QtSerialBus
+    \since 6.4
+
+    \brief QCanBusFrameBatch stores a sequence of CAN frames column by column.
+
+    A QList<QCanBusFrame> keeps all properties of a frame together. Code that
+    scans many frames for a single property, for example all frame
+    identifiers, touches much more memory than it needs. QCanBusFrameBatch
+    instead stores the identifiers, frame types, flags, timestamps, payload
+    lengths and payload bytes of its frames in separate contiguous arrays,
+    which can be processed in tight, vectorizable loops:
+
+    \code
+        QCanBusFrameBatch batch;
+        device->readFrames(batch);
+
+        const QCanBusFrame::FrameId *ids = batch.frameIds();
+        qsizetype engineFrames = 0;
+        for (qsizetype i = 0; i < batch.size(); ++i)
+            engineFrames += (ids[i] & 0x7F0) == 0x100;
+    \endcode
+
+    The payload bytes of frame \c i start at \c{payloads() + i * payloadStride()}.
+    The stride is 8 bytes as long as all frames carry classic CAN payloads and
+    grows to 64 bytes when the first frame with a larger payload is appended.
+    Unused bytes of a payload slot are zero.
+
+    For error frames, the identifier column holds the
+    \l{QCanBusFrame::error()}{error flags} of the frame.
+
+    \sa QCanBusDevice::readFrames()
+*/
+
+/*!
+    \enum QCanBusFrameBatch::FrameFlag
+
+    This enum describes the bits stored in the \l frameFlags() column.
+
+    \value ExtendedFrameFormat      The frame uses a 29-bit identifier,
+                                    see QCanBusFrame::hasExtendedFrameFormat().
+    \value FlexibleDataRateFormat   The frame is a CAN FD frame,
+                                    see QCanBusFrame::hasFlexibleDataRateFormat().
+    \value BitrateSwitch            See QCanBusFrame::hasBitrateSwitch().
+    \value ErrorStateIndicator      See QCanBusFrame::hasErrorStateIndicator().
+    \value LocalEcho                See QCanBusFrame::hasLocalEcho().
+*/
+
+/*!
+    Constructs an empty batch.
+*/
+QCanBusFrameBatch::QCanBusFrameBatch() :
+    d_ptr(new QCanBusFrameBatchPrivate)
+{
+}
+
+/*!
+    Constructs a batch that contains the frames of \a frames.
+*/
+QCanBusFrameBatch::QCanBusFrameBatch(const QList<QCanBusFrame> &frames) :
+    d_ptr(new QCanBusFrameBatchPrivate)
+{
+    append(frames);
+}
+
+/*!
+    Constructs a copy of \a other.
+
+    The columns are implicitly shared; they are copied when one of the
+    batches is modified.
+*/
+QCanBusFrameBatch::QCanBusFrameBatch(const QCanBusFrameBatch &) = default;
+
+/*!
+    Destroys the batch.
+*/
+QCanBusFrameBatch::~QCanBusFrameBatch() = default;
+
+/*!
+    \fn void QCanBusFrameBatch::swap(QCanBusFrameBatch &other)
+    Swaps this batch with \a other. This operation is very fast and never
+    fails.
+*/
+
+/*!
+    \fn QCanBusFrameBatch &QCanBusFrameBatch::operator=(QCanBusFrameBatch &&other)
+
+    Move-assigns \a other to this QCanBusFrameBatch instance.
+*/
+
+/*!
+    Assigns \a other to this batch and returns a reference to this batch.
+*/
+QCanBusFrameBatch &QCanBusFrameBatch::operator=(const QCanBusFrameBatch &) = default;
+
+/*!
+    Returns the number of frames in the batch.
+*/
+qsizetype QCanBusFrameBatch::size() const noexcept
+{
+    return d_ptr->frameIds.size();
+}
+
+/*!
+    \fn bool QCanBusFrameBatch::isEmpty() const
+
+    Returns \c true if the batch contains no frames; otherwise returns \c false.
+*/
+
+/*!
+    Allocates memory for at least \a size frames with classic CAN payloads.
+*/
+void QCanBusFrameBatch::reserve(qsizetype size)
+{
+    d_ptr->frameIds.reserve(size);
+    d_ptr->frameTypes.reserve(size);
+    d_ptr->frameFlags.reserve(size);
+    d_ptr->timeStamps.reserve(size);
+    d_ptr->payloadLengths.reserve(size);
+    d_ptr->payloads.reserve(size * d_ptr->payloadStride);
+}
+
+/*!
+    Removes all frames from the batch. The payload stride is reset to
+    8 bytes.
+*/
+void QCanBusFrameBatch::clear()
+{
+    d_ptr->frameIds.clear();
+    d_ptr->frameTypes.clear();
+    d_ptr->frameFlags.clear();
+    d_ptr->timeStamps.clear();
+    d_ptr->payloadLengths.clear();
+    d_ptr->payloads.clear();
+    d_ptr->payloadStride = ClassicPayloadStride;
+}
+
+/*!
+    Appends \a frame to the batch.
+*/
+void QCanBusFrameBatch::append(const QCanBusFrame &frame)
+{
+    QCanBusFrameBatchPrivate *d = d_ptr.data();
+    const QByteArrayView data = frame.payloadView();
+    if (Q_UNLIKELY(data.size() > d->payloadStride))
+        d->widenPayloadStride();
+
+    const QCanBusFrame::FrameType type = frame.frameType();
+    d->frameIds.append(type == QCanBusFrame::ErrorFrame
+                       ? QCanBusFrame::FrameId(frame.error().toInt()) : frame.frameId());
+    d->frameTypes.append(quint8(type));
+
+    quint8 flags = 0;
+    if (frame.hasExtendedFrameFormat())
+        flags |= ExtendedFrameFormat;
+    if (frame.hasFlexibleDataRateFormat())
+        flags |= FlexibleDataRateFormat;
+    if (frame.hasBitrateSwitch())
+        flags |= BitrateSwitch;
+    if (frame.hasErrorStateIndicator())
+        flags |= ErrorStateIndicator;
+    if (frame.hasLocalEcho())
+        flags |= LocalEcho;
+    d->frameFlags.append(flags);
+
+    const QCanBusFrame::TimeStamp stamp = frame.timeStamp();
+    d->timeStamps.append(stamp.seconds() * 1000000 + stamp.microSeconds());
+
+    d->payloadLengths.append(quint8(data.size()));
+    d->payloads.append(data.data(), data.size());
+    d->payloads.append(d->payloadStride - data.size(), '\0');
+}
+
+/*!
+    \overload
+
+    Appends the \a count frames of the array \a frames to the batch.
+*/
+void QCanBusFrameBatch::append(const QCanBusFrame *frames, qsizetype count)
+{
+    for (qsizetype i = 0; i < count; ++i)
+        append(frames[i]);
+}
+
+/*!
+    \fn void QCanBusFrameBatch::append(const QList<QCanBusFrame> &frames)
+    \overload
+
+    Appends \a frames to the batch.
+*/
+
+/*!
+    Returns the frame at position \a index as QCanBusFrame. \a index must be
+    a valid index position in the batch.
+*/
+QCanBusFrame QCanBusFrameBatch::frameAt(qsizetype index) const
+{
+    const QCanBusFrame::FrameType type = frameType(index);
+    const quint8 flags = d_ptr->frameFlags.at(index);
+
+    QCanBusFrame frame(type);
+    if (type == QCanBusFrame::ErrorFrame)
+        frame.setError(QCanBusFrame::FrameErrors::fromInt(int(frameId(index))));
+    else
+        frame.setFrameId(frameId(index));
+    frame.setExtendedFrameFormat(flags & ExtendedFrameFormat);
+    frame.setPayload(payload(index).toByteArray());
+    frame.setFlexibleDataRateFormat(flags & FlexibleDataRateFormat);
+    frame.setBitrateSwitch(flags & BitrateSwitch);
+    frame.setErrorStateIndicator(flags & ErrorStateIndicator);
+    frame.setLocalEcho(flags & LocalEcho);
+    frame.setTimeStamp(timeStamp(index));
+    return frame;
+}
+
+/*!
+    Returns all frames of the batch as list.
+*/
+QList<QCanBusFrame> QCanBusFrameBatch::toFrameList() const
+{
+    QList<QCanBusFrame> frames;
+    frames.reserve(size());
+    for (qsizetype i = 0; i < size(); ++i)
+        frames.append(frameAt(i));
+    return frames;
+}
+
+/*!
+    Returns the identifier column of the batch. For error frames, the column
+    holds the error flags of the frame.
+*/
+const QCanBusFrame::FrameId *QCanBusFrameBatch::frameIds() const noexcept
+{
+    return d_ptr->frameIds.constData();
+}
+
+/*!
+    Returns the column of \l{QCanBusFrame::FrameType}{frame types}.
+*/
+const quint8 *QCanBusFrameBatch::frameTypes() const noexcept
+{
+    return d_ptr->frameTypes.constData();
+}
+
+/*!
+    Returns the column of frame flags, a combination of
+    \l{QCanBusFrameBatch::FrameFlag} values per frame.
+*/
+const quint8 *QCanBusFrameBatch::frameFlags() const noexcept
+{
+    return d_ptr->frameFlags.constData();
+}
+
+/*!
+    Returns the column of timestamps in microseconds.
+*/
+const qint64 *QCanBusFrameBatch::timeStamps() const noexcept
+{
+    return d_ptr->timeStamps.constData();
+}
+
+/*!
+    Returns the column of payload lengths in bytes.
+*/
+const quint8 *QCanBusFrameBatch::payloadLengths() const noexcept
+{
+    return d_ptr->payloadLengths.constData();
+}
+
+/*!
+    Returns the payload bytes of all frames. The payload of each frame
+    occupies \l payloadStride() bytes.
+*/
+const char *QCanBusFrameBatch::payloads() const noexcept
+{
+    return d_ptr->payloads.constData();
+}
+
+/*!
+    Returns the distance in bytes between the payloads of two consecutive
+    frames in \l payloads(). The stride is 8 unless the batch contains a
+    frame with a payload of more than 8 bytes, then it is 64.
+*/
+qsizetype QCanBusFrameBatch::payloadStride() const noexcept
+{
+    return d_ptr->payloadStride;
+}
+
+/*!
+    Returns the identifier of the frame at position \a index.
+*/
+QCanBusFrame::FrameId QCanBusFrameBatch::frameId(qsizetype index) const
+{
+    return d_ptr->frameIds.at(index);
+}
+
+/*!
+    Returns the type of the frame at position \a index.
+*/
+QCanBusFrame::FrameType QCanBusFrameBatch::frameType(qsizetype index) const
+{
+    return QCanBusFrame::FrameType(d_ptr->frameTypes.at(index));
+}
+
+/*!
+    Returns \c true if \a flag is set for the frame at position \a index.
+*/
+bool QCanBusFrameBatch::testFrameFlag(qsizetype index, FrameFlag flag) const
+{
+    return d_ptr->frameFlags.at(index) & flag;
+}
+
+/*!
+    Returns the timestamp of the frame at position \a index.
+*/
+QCanBusFrame::TimeStamp QCanBusFrameBatch::timeStamp(qsizetype index) const
+{
+    return QCanBusFrame::TimeStamp::fromMicroSeconds(d_ptr->timeStamps.at(index));
+}
+
+/*!
+    Returns the payload of the frame at position \a index.
+*/
+QByteArrayView QCanBusFrameBatch::payload(qsizetype index) const
+{
+    return QByteArrayView(d_ptr->payloads.constData() + index * d_ptr->payloadStride,
+                          d_ptr->payloadLengths.at(index));
+}
+
+void QCanBusFrameBatchPrivate::widenPayloadStride()
+{
+    const qsizetype count = frameIds.size();
+    QByteArray widened(count * QCanBusFrameBatch::FlexibleDataRatePayloadStride, '\0');
+    for (qsizetype i = 0; i < count; ++i) {
+        ::memcpy(widened.data() + i * QCanBusFrameBatch::FlexibleDataRatePayloadStride,
+                 payloads.constData() + i * payloadStride, payloadLengths.at(i));
+    }
+    payloads = std::move(widened);
+    payloadStride = QCanBusFrameBatch::FlexibleDataRatePayloadStride;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,120 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSFRAMEBATCH_H
+#define QCANBUSFRAMEBATCH_H
+
+#include <QtCore/qbytearrayview.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qshareddata.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+class QCanBusFrameBatchPrivate;
+
+class Q_SERIALBUS_EXPORT QCanBusFrameBatch
+{
+public:
+    enum FrameFlag : quint8 {
+        ExtendedFrameFormat = 0x01,
+        FlexibleDataRateFormat = 0x02,
+        BitrateSwitch = 0x04,
+        ErrorStateIndicator = 0x08,
+        LocalEcho = 0x10
+    };
+
+    enum {
+        ClassicPayloadStride = 8,
+        FlexibleDataRatePayloadStride = 64
+    };
+
+    QCanBusFrameBatch();
+    explicit QCanBusFrameBatch(const QList<QCanBusFrame> &frames);
+    QCanBusFrameBatch(const QCanBusFrameBatch &other);
+    ~QCanBusFrameBatch();
+
+    void swap(QCanBusFrameBatch &other) noexcept
+    {
+        qSwap(d_ptr, other.d_ptr);
+    }
+
+    QCanBusFrameBatch &operator=(const QCanBusFrameBatch &other);
+    QCanBusFrameBatch &operator=(QCanBusFrameBatch &&other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    qsizetype size() const noexcept;
+    bool isEmpty() const noexcept { return size() == 0; }
+    void reserve(qsizetype size);
+    void clear();
+
+    void append(const QCanBusFrame &frame);
+    void append(const QCanBusFrame *frames, qsizetype count);
+    void append(const QList<QCanBusFrame> &frames) { append(frames.constData(), frames.size()); }
+
+    QCanBusFrame frameAt(qsizetype index) const;
+    QList<QCanBusFrame> toFrameList() const;
+
+    const QCanBusFrame::FrameId *frameIds() const noexcept;
+    const quint8 *frameTypes() const noexcept;
+    const quint8 *frameFlags() const noexcept;
+    const qint64 *timeStamps() const noexcept;
+    const quint8 *payloadLengths() const noexcept;
+    const char *payloads() const noexcept;
+    qsizetype payloadStride() const noexcept;
+
+    QCanBusFrame::FrameId frameId(qsizetype index) const;
+    QCanBusFrame::FrameType frameType(qsizetype index) const;
+    bool testFrameFlag(qsizetype index, FrameFlag flag) const;
+    QCanBusFrame::TimeStamp timeStamp(qsizetype index) const;
+    QByteArrayView payload(qsizetype index) const;
+
+private:
+    QSharedDataPointer<QCanBusFrameBatchPrivate> d_ptr;
+};
+
+Q_DECLARE_SHARED(QCanBusFrameBatch)
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSFRAMEBATCH_H
@@ -0,0 +1,148 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcanbusframefilter_p.h"
+
+#include <algorithm>
+#include <cstring>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+constexpr QCanBusFrame::FrameId ExtendedIdMask = 0x1FFFFFFFU;
+constexpr QCanBusFrame::FrameId BaseIdMask = 0x7FFU;
+
+} // namespace
+
+void QCanBusFrameFilter::clear()
+{
+    m_active = false;
+    ::memset(m_baseIds, 0, sizeof(m_baseIds));
+    m_extendedGroups.clear();
+}
+
+void QCanBusFrameFilter::setFilters(const QList<QCanBusDevice::Filter> &filters)
+{
+    clear();
+
+    if (filters.isEmpty())
+        return;
+
+    m_active = true;
+
+    struct ExtendedFilter {
+        QCanBusFrame::FrameId mask;
+        QCanBusFrame::FrameId id;
+        quint8 types;
+    };
+    QList<ExtendedFilter> extended;
+
+    for (const QCanBusDevice::Filter &filter : filters) {
+        quint8 types = 0;
+        if (filter.type == QCanBusFrame::InvalidFrame) {
+            // InvalidFrame matches frames of any type
+            for (int type = 0; type < TypeCount; ++type)
+                types |= typeBit(QCanBusFrame::FrameType(type));
+        } else if (int(filter.type) < TypeCount) {
+            types = typeBit(filter.type);
+        }
+        types &= ~typeBit(QCanBusFrame::ErrorFrame);
+        if (!types)
+            continue;
+
+        const QCanBusFrame::FrameId mask = filter.frameIdMask & ExtendedIdMask;
+        const QCanBusFrame::FrameId id = filter.frameId & mask;
+
+        if (filter.format & QCanBusDevice::Filter::MatchExtendedFormat)
+            extended.append({mask, id, types});
+
+        // a base frame id never has bits above the eleventh set
+        if (!(filter.format & QCanBusDevice::Filter::MatchBaseFormat) || (id & ~BaseIdMask))
+            continue;
+
+        const QCanBusFrame::FrameId baseMask = mask & BaseIdMask;
+        const auto setBaseId = [this, types](QCanBusFrame::FrameId baseId) {
+            for (int type = 0; type < TypeCount; ++type) {
+                if (types & typeBit(QCanBusFrame::FrameType(type)))
+                    m_baseIds[type][baseId / 64] |= Q_UINT64_C(1) << (baseId % 64);
+            }
+        };
+        if (baseMask == BaseIdMask) {
+            setBaseId(id);
+        } else {
+            for (QCanBusFrame::FrameId baseId = 0; baseId < BaseIdCount; ++baseId) {
+                if ((baseId & baseMask) == id)
+                    setBaseId(baseId);
+            }
+        }
+    }
+
+    std::sort(extended.begin(), extended.end(),
+              [](const ExtendedFilter &a, const ExtendedFilter &b) {
+        return a.mask != b.mask ? a.mask < b.mask : a.id < b.id;
+    });
+
+    for (const ExtendedFilter &filter : std::as_const(extended)) {
+        if (m_extendedGroups.isEmpty() || m_extendedGroups.constLast().mask != filter.mask)
+            m_extendedGroups.append({filter.mask, {}});
+
+        QList<Entry> &entries = m_extendedGroups.last().entries;
+        if (!entries.isEmpty() && entries.constLast().id == filter.id)
+            entries.last().types |= filter.types;
+        else
+            entries.append({filter.id, filter.types});
+    }
+}
+
+bool QCanBusFrameFilter::acceptsExtended(QCanBusFrame::FrameId id, quint8 types) const noexcept
+{
+    for (const MaskGroup &group : m_extendedGroups) {
+        const QCanBusFrame::FrameId maskedId = id & group.mask;
+        const auto it = std::lower_bound(group.entries.cbegin(), group.entries.cend(), maskedId,
+                                         [](const Entry &entry, QCanBusFrame::FrameId value) {
+            return entry.id < value;
+        });
+        if (it != group.entries.cend() && it->id == maskedId && (it->types & types))
+            return true;
+    }
+    return false;
+}
+
+QT_END_NAMESPACE
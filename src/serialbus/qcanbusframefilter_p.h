@@ -0,0 +1,128 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef QCANBUSFRAMEFILTER_P_H
+#define QCANBUSFRAMEFILTER_P_H
+
+#include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/qcanbusframe.h>
+
+#include <QtCore/qlist.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Compiled form of a QCanBusDevice::Filter list, used to drop unwanted
+    frames before they enter the receive queue.
+
+    Frames in base format are looked up in one 2048 bit table per frame
+    type. Filters for the extended format are grouped by mask, and every
+    group holds the sorted masked ids, so a lookup costs one binary search
+    per distinct mask.
+
+    Error frames always pass; they are selected with ErrorFilterKey.
+*/
+class QCanBusFrameFilter
+{
+public:
+    void setFilters(const QList<QCanBusDevice::Filter> &filters);
+    void clear();
+
+    bool isEmpty() const noexcept { return !m_active; }
+
+    bool accepts(const QCanBusFrame &frame) const noexcept
+    {
+        if (!m_active)
+            return true;
+
+        const QCanBusFrame::FrameType type = frame.frameType();
+        if (type == QCanBusFrame::ErrorFrame)
+            return true;
+
+        const QCanBusFrame::FrameId id = frame.frameId();
+        if (!frame.hasExtendedFrameFormat()) {
+            if (Q_UNLIKELY(id >= BaseIdCount))
+                return false;
+            return m_baseIds[type][id / 64] & (Q_UINT64_C(1) << (id % 64));
+        }
+
+        return acceptsExtended(id, typeBit(type));
+    }
+
+private:
+    enum {
+        BaseIdCount = 2048,
+        TypeCount = QCanBusFrame::InvalidFrame + 1
+    };
+
+    static constexpr quint8 typeBit(QCanBusFrame::FrameType type) noexcept
+    {
+        return quint8(1U << type);
+    }
+
+    bool acceptsExtended(QCanBusFrame::FrameId id, quint8 types) const noexcept;
+
+    struct Entry {
+        QCanBusFrame::FrameId id;
+        quint8 types;
+    };
+
+    struct MaskGroup {
+        QCanBusFrame::FrameId mask;
+        QList<Entry> entries; // sorted by id
+    };
+
+    bool m_active = false;
+    quint64 m_baseIds[TypeCount][BaseIdCount / 64] = {};
+    QList<MaskGroup> m_extendedGroups;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSFRAMEFILTER_P_H
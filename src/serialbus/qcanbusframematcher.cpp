@@ -0,0 +1,525 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcanbusframematcher.h"
+#include "qcanbusframematcher_p.h"
+
+#include <QtCore/qalgorithms.h>
+#include <QtCore/private/qsimd_p.h>
+
+#include <atomic>
+#include <cstring>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QCanBusFrameMatcher
+    \inmodule QtSerialBus
+    \since 6.4
+
+    \brief QCanBusFrameMatcher selects the frames of a frame sequence that
+    match a set of filters.
+
+    Applications that route or filter received frames themselves usually
+    compare every frame with every filter. QCanBusFrameMatcher does the same
+    comparison for many frames at once. It uses SSE2 or AVX2 instructions
+    when the processor supports them and falls back to a portable
+    implementation otherwise.
+
+    The matcher is set up from \l{QCanBusDevice::Filter} entries, optionally
+    combined with a mask for the first eight payload bytes. A frame matches
+    if it matches at least one of the entries:
+
+    \code
+        QCanBusDevice::Filter filter;
+        filter.frameId = 0x100;
+        filter.frameIdMask = 0x7F0;
+        filter.type = QCanBusFrame::DataFrame;
+        filter.format = QCanBusDevice::Filter::MatchBaseFormat;
+
+        QCanBusFrameMatcher matcher;
+        matcher.addFilter(filter);
+
+        const QList<QCanBusFrame> frames = device->readAllFrames();
+        for (qsizetype index : matcher.matchingIndexes(frames))
+            process(frames.at(index));
+    \endcode
+
+    Unlike the filters set with QCanBusDevice::RawFilterKey, the matcher
+    treats error frames like all other frames. Their frame identifier is 0.
+    Filters for QCanBusFrame::UnknownFrame also match frames of type
+    QCanBusFrame::InvalidFrame.
+
+    An empty matcher does not match any frame.
+
+    \sa QCanBusFrameBatch
+*/
+
+namespace {
+
+enum {
+    BlockSize = 64
+};
+
+constexpr quint32 IdMask = 0x1FFFFFFFU;
+constexpr quint32 ExtendedFormatBit = 1U << 29;
+constexpr int TypeShift = 30;
+constexpr quint32 TypeMask = 3U << TypeShift;
+
+// DataFrame, ErrorFrame and RemoteRequestFrame keep their enum values as
+// two bit type code, the remaining types share the code 0.
+constexpr quint32 typeCode(QCanBusFrame::FrameType type) noexcept
+{
+    return (type >= QCanBusFrame::DataFrame && type <= QCanBusFrame::RemoteRequestFrame)
+            ? quint32(type) : 0;
+}
+
+constexpr quint32 frameKey(QCanBusFrame::FrameId id, bool extended,
+                           QCanBusFrame::FrameType type) noexcept
+{
+    if (type == QCanBusFrame::ErrorFrame)
+        id = 0;
+    return (id & IdMask) | (extended ? ExtendedFormatBit : 0) | (typeCode(type) << TypeShift);
+}
+
+quint64 payloadWord(QByteArrayView data) noexcept
+{
+    quint64 word = 0;
+    ::memcpy(&word, data.data(), size_t(qMin(data.size(), qsizetype(sizeof(word)))));
+    return word;
+}
+
+struct Rules
+{
+    const quint32 *keyValues;
+    const quint32 *keyMasks;
+    const quint64 *payloadValues;
+    const quint64 *payloadMasks;
+    qsizetype count;
+    bool matchesPayload;
+};
+
+// Each kernel matches BlockSize keys and payload words and returns one bit
+// per key.
+using BlockMatcher = quint64 (*)(const quint32 *keys, const quint64 *payloads,
+                                 const Rules &rules);
+
+quint64 matchBlockScalar(const quint32 *keys, const quint64 *payloads, const Rules &rules)
+{
+    quint64 result = 0;
+    for (int i = 0; i < BlockSize; ++i) {
+        for (qsizetype r = 0; r < rules.count; ++r) {
+            if ((keys[i] & rules.keyMasks[r]) == rules.keyValues[r]
+                    && (payloads[i] & rules.payloadMasks[r]) == rules.payloadValues[r]) {
+                result |= Q_UINT64_C(1) << i;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+#if defined(__SSE2__)
+quint64 matchBlockSse2(const quint32 *keys, const quint64 *payloads, const Rules &rules)
+{
+    quint64 result = 0;
+    for (int i = 0; i < BlockSize; i += 4) {
+        const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+        __m128i payloadLow = _mm_setzero_si128();
+        __m128i payloadHigh = _mm_setzero_si128();
+        if (rules.matchesPayload) {
+            payloadLow = _mm_loadu_si128(reinterpret_cast<const __m128i *>(payloads + i));
+            payloadHigh = _mm_loadu_si128(reinterpret_cast<const __m128i *>(payloads + i + 2));
+        }
+
+        __m128i matched = _mm_setzero_si128();
+        for (qsizetype r = 0; r < rules.count; ++r) {
+            __m128i equal = _mm_cmpeq_epi32(
+                        _mm_and_si128(key, _mm_set1_epi32(int(rules.keyMasks[r]))),
+                        _mm_set1_epi32(int(rules.keyValues[r])));
+
+            if (rules.matchesPayload) {
+                const __m128i mask = _mm_set1_epi64x(qint64(rules.payloadMasks[r]));
+                const __m128i value = _mm_set1_epi64x(qint64(rules.payloadValues[r]));
+                __m128i low = _mm_cmpeq_epi32(_mm_and_si128(payloadLow, mask), value);
+                __m128i high = _mm_cmpeq_epi32(_mm_and_si128(payloadHigh, mask), value);
+                // SSE2 has no 64 bit compare, both halves of a word must be equal
+                low = _mm_and_si128(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(2, 3, 0, 1)));
+                high = _mm_and_si128(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(2, 3, 0, 1)));
+                // narrow the four 64 bit results to the 32 bit lanes of the keys
+                const __m128 narrowed = _mm_shuffle_ps(_mm_castsi128_ps(low),
+                                                       _mm_castsi128_ps(high),
+                                                       _MM_SHUFFLE(2, 0, 2, 0));
+                equal = _mm_and_si128(equal, _mm_castps_si128(narrowed));
+            }
+
+            matched = _mm_or_si128(matched, equal);
+        }
+
+        result |= quint64(_mm_movemask_ps(_mm_castsi128_ps(matched))) << i;
+    }
+    return result;
+}
+#endif
+
+#if QT_COMPILER_SUPPORTS_HERE(AVX2)
+QT_FUNCTION_TARGET(AVX2)
+quint64 matchBlockAvx2(const quint32 *keys, const quint64 *payloads, const Rules &rules)
+{
+    quint64 result = 0;
+    for (int i = 0; i < BlockSize; i += 8) {
+        const __m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+        __m256i payloadLow = _mm256_setzero_si256();
+        __m256i payloadHigh = _mm256_setzero_si256();
+        if (rules.matchesPayload) {
+            payloadLow = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(payloads + i));
+            payloadHigh = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(payloads + i + 4));
+        }
+
+        __m256i matched = _mm256_setzero_si256();
+        for (qsizetype r = 0; r < rules.count; ++r) {
+            __m256i equal = _mm256_cmpeq_epi32(
+                        _mm256_and_si256(key, _mm256_set1_epi32(int(rules.keyMasks[r]))),
+                        _mm256_set1_epi32(int(rules.keyValues[r])));
+
+            if (rules.matchesPayload) {
+                const __m256i mask = _mm256_set1_epi64x(qint64(rules.payloadMasks[r]));
+                const __m256i value = _mm256_set1_epi64x(qint64(rules.payloadValues[r]));
+                const __m256i low = _mm256_cmpeq_epi64(_mm256_and_si256(payloadLow, mask), value);
+                const __m256i high = _mm256_cmpeq_epi64(_mm256_and_si256(payloadHigh, mask), value);
+                // the shuffle works within 128 bit lanes and yields the frame
+                // order 0 1 4 5 2 3 6 7, the permutation restores 0 to 7
+                const __m256 narrowed = _mm256_shuffle_ps(_mm256_castsi256_ps(low),
+                                                          _mm256_castsi256_ps(high),
+                                                          _MM_SHUFFLE(2, 0, 2, 0));
+                const __m256i ordered = _mm256_permute4x64_epi64(_mm256_castps_si256(narrowed),
+                                                                 _MM_SHUFFLE(3, 1, 2, 0));
+                equal = _mm256_and_si256(equal, ordered);
+            }
+
+            matched = _mm256_or_si256(matched, equal);
+        }
+
+        result |= quint64(_mm256_movemask_ps(_mm256_castsi256_ps(matched))) << i;
+    }
+    return result;
+}
+#endif
+
+std::atomic<QCanBusFrameMatcherKernel::Kernel> selectedKernel{QCanBusFrameMatcherKernel::Automatic};
+
+QCanBusFrameMatcherKernel::Kernel fastestKernel()
+{
+    if (QCanBusFrameMatcherKernel::isSupported(QCanBusFrameMatcherKernel::Avx2))
+        return QCanBusFrameMatcherKernel::Avx2;
+    if (QCanBusFrameMatcherKernel::isSupported(QCanBusFrameMatcherKernel::Sse2))
+        return QCanBusFrameMatcherKernel::Sse2;
+    return QCanBusFrameMatcherKernel::Scalar;
+}
+
+BlockMatcher blockMatcher()
+{
+    QCanBusFrameMatcherKernel::Kernel kernel = selectedKernel.load(std::memory_order_relaxed);
+    if (kernel == QCanBusFrameMatcherKernel::Automatic)
+        kernel = fastestKernel();
+
+    switch (kernel) {
+#if QT_COMPILER_SUPPORTS_HERE(AVX2)
+    case QCanBusFrameMatcherKernel::Avx2:
+        return matchBlockAvx2;
+#endif
+#if defined(__SSE2__)
+    case QCanBusFrameMatcherKernel::Sse2:
+        return matchBlockSse2;
+#endif
+    default:
+        return matchBlockScalar;
+    }
+}
+
+constexpr quint64 validBits(qsizetype count) noexcept
+{
+    return count >= BlockSize ? ~Q_UINT64_C(0) : (Q_UINT64_C(1) << count) - 1;
+}
+
+// Splits count frames into blocks, lets fill() write the keys and payload
+// words of each block and collects the results of the kernel.
+template <typename Fill>
+QList<quint64> matchBlocks(qsizetype count, const Rules &rules, Fill fill)
+{
+    QList<quint64> bitmap((count + BlockSize - 1) / BlockSize, 0);
+    if (rules.count == 0)
+        return bitmap;
+
+    const BlockMatcher match = blockMatcher();
+    quint32 keys[BlockSize];
+    quint64 payloads[BlockSize];
+    for (qsizetype start = 0; start < count; start += BlockSize) {
+        const qsizetype blockCount = qMin(count - start, qsizetype(BlockSize));
+        ::memset(keys, 0, sizeof(keys));
+        ::memset(payloads, 0, sizeof(payloads));
+        fill(start, blockCount, keys, payloads);
+        bitmap[start / BlockSize] = match(keys, payloads, rules) & validBits(blockCount);
+    }
+    return bitmap;
+}
+
+QList<qsizetype> indexesFromBitmap(const QList<quint64> &bitmap)
+{
+    QList<qsizetype> indexes;
+    for (qsizetype word = 0; word < bitmap.size(); ++word) {
+        quint64 bits = bitmap.at(word);
+        while (bits) {
+            indexes.append(word * BlockSize + qCountTrailingZeroBits(bits));
+            bits &= bits - 1;
+        }
+    }
+    return indexes;
+}
+
+} // namespace
+
+/*
+    Returns \c true if \a kernel is built in and supported by the processor.
+*/
+bool QCanBusFrameMatcherKernel::isSupported(Kernel kernel)
+{
+    switch (kernel) {
+    case Automatic:
+    case Scalar:
+        return true;
+    case Sse2:
+#if defined(__SSE2__)
+        return true;
+#else
+        return false;
+#endif
+    case Avx2:
+#if QT_COMPILER_SUPPORTS_HERE(AVX2)
+        return qCpuHasFeature(AVX2);
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+/*
+    Makes all matchers use \a kernel. Returns \c false and keeps the current
+    kernel if \a kernel is not supported.
+*/
+bool QCanBusFrameMatcherKernel::select(Kernel kernel)
+{
+    if (!isSupported(kernel))
+        return false;
+
+    selectedKernel.store(kernel, std::memory_order_relaxed);
+    return true;
+}
+
+/*
+    Returns the kernel set with select(), Automatic by default.
+*/
+QCanBusFrameMatcherKernel::Kernel QCanBusFrameMatcherKernel::selected()
+{
+    return selectedKernel.load(std::memory_order_relaxed);
+}
+
+/*!
+    \fn QCanBusFrameMatcher::QCanBusFrameMatcher()
+
+    Constructs an empty matcher.
+*/
+
+/*!
+    Constructs a matcher that matches the frames accepted by one of
+    \a filters.
+*/
+QCanBusFrameMatcher::QCanBusFrameMatcher(const QList<QCanBusDevice::Filter> &filters)
+{
+    for (const QCanBusDevice::Filter &filter : filters)
+        addFilter(filter);
+}
+
+/*!
+    Adds \a filter to the matcher.
+*/
+void QCanBusFrameMatcher::addFilter(const QCanBusDevice::Filter &filter)
+{
+    addFilter(filter, QByteArrayView(), QByteArrayView());
+}
+
+/*!
+    \overload
+
+    Adds \a filter to the matcher. Frames matching \a filter must also carry
+    \a payload in the bits selected by \a payloadMask. Only the first eight
+    bytes of \a payload and \a payloadMask are used, bytes missing in
+    \a payloadMask are not compared. Bytes beyond the payload of a shorter
+    frame compare as zero.
+*/
+void QCanBusFrameMatcher::addFilter(const QCanBusDevice::Filter &filter,
+                                    QByteArrayView payload, QByteArrayView payloadMask)
+{
+    const bool matchesBase = filter.format & QCanBusDevice::Filter::MatchBaseFormat;
+    const bool matchesExtended = filter.format & QCanBusDevice::Filter::MatchExtendedFormat;
+    if (!matchesBase && !matchesExtended)
+        return;
+
+    quint32 mask = filter.frameIdMask & IdMask;
+    quint32 value = filter.frameId & mask;
+    if (!matchesBase || !matchesExtended) {
+        mask |= ExtendedFormatBit;
+        if (matchesExtended)
+            value |= ExtendedFormatBit;
+    }
+    // InvalidFrame matches frames of any type
+    if (filter.type != QCanBusFrame::InvalidFrame) {
+        mask |= TypeMask;
+        value |= typeCode(filter.type) << TypeShift;
+    }
+
+    const quint64 payloadBits = payloadWord(payloadMask);
+
+    m_keyValues.append(value);
+    m_keyMasks.append(mask);
+    m_payloadValues.append(payloadWord(payload) & payloadBits);
+    m_payloadMasks.append(payloadBits);
+    m_matchesPayload |= payloadBits != 0;
+}
+
+/*!
+    Removes all filters from the matcher.
+*/
+void QCanBusFrameMatcher::clear()
+{
+    m_keyValues.clear();
+    m_keyMasks.clear();
+    m_payloadValues.clear();
+    m_payloadMasks.clear();
+    m_matchesPayload = false;
+}
+
+/*!
+    \fn qsizetype QCanBusFrameMatcher::size() const
+
+    Returns the number of filters of the matcher.
+*/
+
+/*!
+    \fn bool QCanBusFrameMatcher::isEmpty() const
+
+    Returns \c true if the matcher has no filters; otherwise returns \c false.
+*/
+
+/*!
+    Matches \a frames and returns a bitmap with one bit per frame. Bit
+    \c{i % 64} of word \c{i / 64} is set if the frame at index \c i matches.
+*/
+QList<quint64> QCanBusFrameMatcher::matchBitmap(const QList<QCanBusFrame> &frames) const
+{
+    const Rules rules = {m_keyValues.constData(), m_keyMasks.constData(),
+                         m_payloadValues.constData(), m_payloadMasks.constData(),
+                         m_keyValues.size(), m_matchesPayload};
+    const QCanBusFrame *data = frames.constData();
+    return matchBlocks(frames.size(), rules,
+                       [data, this](qsizetype start, qsizetype count,
+                                    quint32 *keys, quint64 *payloads) {
+        for (qsizetype i = 0; i < count; ++i) {
+            const QCanBusFrame &frame = data[start + i];
+            keys[i] = frameKey(frame.frameId(), frame.hasExtendedFrameFormat(),
+                               frame.frameType());
+        }
+        if (m_matchesPayload) {
+            for (qsizetype i = 0; i < count; ++i)
+                payloads[i] = payloadWord(data[start + i].payloadView());
+        }
+    });
+}
+
+/*!
+    \overload
+
+    Matches the frames of \a batch.
+*/
+QList<quint64> QCanBusFrameMatcher::matchBitmap(const QCanBusFrameBatch &batch) const
+{
+    const Rules rules = {m_keyValues.constData(), m_keyMasks.constData(),
+                         m_payloadValues.constData(), m_payloadMasks.constData(),
+                         m_keyValues.size(), m_matchesPayload};
+    return matchBlocks(batch.size(), rules,
+                       [&batch, this](qsizetype start, qsizetype count,
+                                      quint32 *keys, quint64 *payloads) {
+        const QCanBusFrame::FrameId *ids = batch.frameIds() + start;
+        const quint8 *types = batch.frameTypes() + start;
+        const quint8 *flags = batch.frameFlags() + start;
+        for (qsizetype i = 0; i < count; ++i) {
+            keys[i] = frameKey(ids[i], flags[i] & QCanBusFrameBatch::ExtendedFrameFormat,
+                               QCanBusFrame::FrameType(types[i]));
+        }
+        if (m_matchesPayload) {
+            // every payload slot holds at least eight bytes, unused ones are zero
+            const qsizetype stride = batch.payloadStride();
+            const char *data = batch.payloads() + start * stride;
+            for (qsizetype i = 0; i < count; ++i)
+                ::memcpy(payloads + i, data + i * stride, sizeof(quint64));
+        }
+    });
+}
+
+/*!
+    Matches \a frames and returns the indexes of the matching frames in
+    ascending order.
+*/
+QList<qsizetype> QCanBusFrameMatcher::matchingIndexes(const QList<QCanBusFrame> &frames) const
+{
+    return indexesFromBitmap(matchBitmap(frames));
+}
+
+/*!
+    \overload
+
+    Matches the frames of \a batch.
+*/
+QList<qsizetype> QCanBusFrameMatcher::matchingIndexes(const QCanBusFrameBatch &batch) const
+{
+    return indexesFromBitmap(matchBitmap(batch));
+}
+
+QT_END_NAMESPACE
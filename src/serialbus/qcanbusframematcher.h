@@ -0,0 +1,83 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSFRAMEMATCHER_H
+#define QCANBUSFRAMEMATCHER_H
+
+#include <QtCore/qbytearrayview.h>
+#include <QtCore/qlist.h>
+#include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qcanbusframebatch.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+class Q_SERIALBUS_EXPORT QCanBusFrameMatcher
+{
+public:
+    QCanBusFrameMatcher() = default;
+    explicit QCanBusFrameMatcher(const QList<QCanBusDevice::Filter> &filters);
+
+    void addFilter(const QCanBusDevice::Filter &filter);
+    void addFilter(const QCanBusDevice::Filter &filter,
+                   QByteArrayView payload, QByteArrayView payloadMask);
+    void clear();
+
+    qsizetype size() const noexcept { return m_keyValues.size(); }
+    bool isEmpty() const noexcept { return m_keyValues.isEmpty(); }
+
+    QList<quint64> matchBitmap(const QList<QCanBusFrame> &frames) const;
+    QList<quint64> matchBitmap(const QCanBusFrameBatch &batch) const;
+    QList<qsizetype> matchingIndexes(const QList<QCanBusFrame> &frames) const;
+    QList<qsizetype> matchingIndexes(const QCanBusFrameBatch &batch) const;
+
+private:
+    // every frame is reduced to a 32 bit key (identifier, format and type)
+    // and the first eight payload bytes, each rule is a masked compare of both
+    QList<quint32> m_keyValues;
+    QList<quint32> m_keyMasks;
+    QList<quint64> m_payloadValues;
+    QList<quint64> m_payloadMasks;
+    bool m_matchesPayload = false;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSFRAMEMATCHER_H
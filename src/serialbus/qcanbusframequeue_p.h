@@ -0,0 +1,438 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSFRAMEQUEUE_P_H
+#define QCANBUSFRAMEQUEUE_P_H
+
+#include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/qcanbusframe.h>
+
+#include <QtCore/qdeadlinetimer.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qmath.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qwaitcondition.h>
+#include <QtCore/private/qglobal_p.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Bounded lock-free FIFO of QCanBusFrame objects.
+
+    The queue is designed for one producer (the CAN backend, possibly running
+    on a worker thread) and one consumer (the application reading frames).
+    Every slot carries a sequence number (Vyukov-style), which makes it safe
+    for the producer to remove the oldest frame when the queue is full
+    (DropOldest policy) without taking a lock. The only lock is used by the
+    Block policy to park a producer that runs out of space.
+
+    An unbounded queue never drops frames. Frames that do not fit into the
+    ring are appended to an overflow list guarded by a mutex, and so are all
+    later frames until the consumer emptied the list, which keeps the FIFO
+    order. The lock is only taken while the ring is full.
+*/
+class QCanBusFrameQueue
+{
+    Q_DISABLE_COPY_MOVE(QCanBusFrameQueue)
+
+public:
+    using OverflowPolicy = QCanBusDevice::OverflowPolicy;
+
+    enum {
+        DefaultCapacity = 4096,
+        MinimumCapacity = 2,
+        Unbounded = -1,
+        BlockingWaitInterval = 10 // ms
+    };
+
+    explicit QCanBusFrameQueue(qsizetype capacity = DefaultCapacity)
+    {
+        resize(capacity);
+    }
+
+    // For an unbounded queue, this is the capacity of the ring only.
+    qsizetype capacity() const noexcept { return qsizetype(m_mask + 1); }
+    bool isBounded() const noexcept { return m_bounded; }
+
+    // Not thread-safe: neither producer nor consumer may be active.
+    // Frames already in the queue are kept as far as the new capacity permits.
+    // A negative capacity (Unbounded) makes the queue unbounded.
+    void resize(qsizetype newCapacity)
+    {
+        const bool bounded = newCapacity >= 0;
+        const quint64 slotCount = qNextPowerOfTwo(
+                quint64(qMax<qsizetype>(bounded ? newCapacity : DefaultCapacity,
+                                        MinimumCapacity)) - 1);
+
+        std::unique_ptr<Slot[]> slots(new Slot[slotCount]);
+        QList<QCanBusFrame> overflow;
+        quint64 count = 0;
+        if (m_slots) {
+            QCanBusFrame frame;
+            while (dequeue(&frame)) {
+                if (count < slotCount) {
+                    slots[count].frame = std::move(frame);
+                    ++count;
+                } else if (!bounded) {
+                    overflow.append(std::move(frame));
+                } else {
+                    m_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        for (quint64 i = 0; i < slotCount; ++i)
+            slots[i].sequence.store(i < count ? i + 1 : i, std::memory_order_relaxed);
+
+        m_slots = std::move(slots);
+        m_mask = slotCount - 1;
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(count, std::memory_order_release);
+
+        m_bounded = bounded;
+        m_overflow = std::move(overflow);
+        m_overflowSize.store(m_overflow.size(), std::memory_order_release);
+    }
+
+    qsizetype size() const noexcept
+    {
+        const quint64 head = m_head.load(std::memory_order_acquire);
+        const quint64 tail = m_tail.load(std::memory_order_acquire);
+        return qsizetype(qMin(tail - head, m_mask + 1))
+                + m_overflowSize.load(std::memory_order_acquire);
+    }
+
+    bool isEmpty() const noexcept { return size() == 0; }
+
+    OverflowPolicy overflowPolicy() const noexcept
+    {
+        return m_policy.load(std::memory_order_relaxed);
+    }
+
+    void setOverflowPolicy(OverflowPolicy policy) noexcept
+    {
+        m_policy.store(policy, std::memory_order_relaxed);
+        if (policy != OverflowPolicy::Block)
+            wakeProducers();
+    }
+
+    qint64 droppedFrames() const noexcept
+    {
+        return qint64(m_droppedFrames.load(std::memory_order_relaxed));
+    }
+
+    qsizetype highWaterMark() const noexcept
+    {
+        return qsizetype(m_highWaterMark.load(std::memory_order_relaxed));
+    }
+
+    void resetStatistics() noexcept
+    {
+        m_droppedFrames.store(0, std::memory_order_relaxed);
+        m_highWaterMark.store(quint64(size()), std::memory_order_relaxed);
+    }
+
+    // A producer that is allowed to block waits until space becomes available
+    // or until the waits get interrupted. Producers running on the consumer's
+    // thread must never block, as nobody could ever make room for them.
+    template <typename Frame>
+    bool enqueue(Frame &&frame, bool mayBlock = false)
+    {
+        if (!m_bounded) {
+            enqueueUnbounded(frame);
+            return true;
+        }
+
+        if (Q_LIKELY(tryEnqueue(frame)))
+            return true;
+
+        switch (overflowPolicy()) {
+        case OverflowPolicy::DropOldest:
+            if (dequeue(nullptr)) {
+                m_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+                if (tryEnqueue(frame))
+                    return true;
+            }
+            break;
+        case OverflowPolicy::Block:
+            if (mayBlock && waitAndEnqueue(frame))
+                return true;
+            break;
+        case OverflowPolicy::DropNewest:
+            break;
+        }
+
+        m_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Removes the oldest frame and moves it to \a frame, unless \a frame is
+    // nullptr. Returns false if the queue is empty.
+    bool dequeue(QCanBusFrame *frame)
+    {
+        const bool overflow = hasOverflow();
+        if (Q_LIKELY(tryDequeue(frame)))
+            return true;
+        return Q_UNLIKELY(overflow) && takeOverflow(frame, 1) == 1;
+    }
+
+    // Moves up to \a maxFrames of the oldest frames to \a frames and
+    // returns their number. The frames in the ring are claimed with one
+    // atomic operation.
+    qsizetype dequeue(QCanBusFrame *frames, qsizetype maxFrames)
+    {
+        if (Q_UNLIKELY(maxFrames <= 0))
+            return 0;
+
+        const bool overflow = hasOverflow();
+        qsizetype count = tryDequeue(frames, maxFrames);
+        if (Q_UNLIKELY(overflow && count < maxFrames))
+            count += takeOverflow(frames + count, maxFrames - count);
+        return count;
+    }
+
+    void clear()
+    {
+        while (dequeue(nullptr))
+            ;
+    }
+
+    // While interrupted, blocking producers give up and drop their frame.
+    void setWaitsInterrupted(bool interrupted)
+    {
+        m_waitsInterrupted.store(interrupted, std::memory_order_release);
+        if (interrupted)
+            wakeProducers();
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<quint64> sequence{0};
+        QCanBusFrame frame;
+    };
+
+    bool tryDequeue(QCanBusFrame *frame)
+    {
+        quint64 pos = m_head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = m_slots[pos & m_mask];
+            const quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+            const qint64 diff = qint64(sequence - (pos + 1));
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    if (frame)
+                        *frame = std::move(slot.frame);
+                    else
+                        slot.frame = QCanBusFrame();
+                    slot.sequence.store(pos + m_mask + 1, std::memory_order_release);
+                    if (Q_UNLIKELY(m_waitingProducers.load(std::memory_order_acquire)))
+                        wakeProducers();
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    qsizetype tryDequeue(QCanBusFrame *frames, qsizetype maxFrames)
+    {
+        quint64 pos = m_head.load(std::memory_order_relaxed);
+        for (;;) {
+            quint64 count = 0;
+            for (; count < quint64(maxFrames); ++count) {
+                const Slot &slot = m_slots[(pos + count) & m_mask];
+                if (slot.sequence.load(std::memory_order_acquire) != pos + count + 1)
+                    break;
+            }
+
+            if (count == 0) {
+                const Slot &slot = m_slots[pos & m_mask];
+                const qint64 diff =
+                        qint64(slot.sequence.load(std::memory_order_acquire) - (pos + 1));
+                if (diff < 0)
+                    return 0;
+                pos = m_head.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (m_head.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                for (quint64 i = 0; i < count; ++i) {
+                    Slot &slot = m_slots[(pos + i) & m_mask];
+                    frames[i] = std::move(slot.frame);
+                    slot.sequence.store(pos + i + m_mask + 1, std::memory_order_release);
+                }
+                if (Q_UNLIKELY(m_waitingProducers.load(std::memory_order_acquire)))
+                    wakeProducers();
+                return qsizetype(count);
+            }
+        }
+    }
+
+    // The ring is only used while the overflow list is empty, so all frames
+    // in the list are newer than the ones in the ring. The consumer checks
+    // the list before the ring: if the list was not empty, no frame can have
+    // entered the ring since, and an empty ring means that the list holds the
+    // oldest frames. Checking afterwards would miss a ring refilled meanwhile.
+    bool hasOverflow() const noexcept
+    {
+        return m_overflowSize.load(std::memory_order_acquire) != 0;
+    }
+
+    template <typename Frame>
+    void enqueueUnbounded(Frame &frame)
+    {
+        if (Q_LIKELY(!hasOverflow()) && tryEnqueue(frame))
+            return;
+
+        QMutexLocker locker(&m_overflowGuard);
+        m_overflow.append(std::forward<Frame>(frame));
+        m_overflowSize.store(m_overflow.size(), std::memory_order_release);
+        locker.unlock();
+        updateHighWaterMark(quint64(size()));
+    }
+
+    qsizetype takeOverflow(QCanBusFrame *frames, qsizetype maxFrames)
+    {
+        QMutexLocker locker(&m_overflowGuard);
+        const qsizetype count = qMin(maxFrames, m_overflow.size());
+        if (frames)
+            std::move(m_overflow.begin(), m_overflow.begin() + count, frames);
+        m_overflow.remove(0, count);
+        m_overflowSize.store(m_overflow.size(), std::memory_order_release);
+        return count;
+    }
+
+    template <typename Frame>
+    bool tryEnqueue(Frame &frame)
+    {
+        quint64 pos = m_tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = m_slots[pos & m_mask];
+            const quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+            const qint64 diff = qint64(sequence - pos);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.frame = std::forward<Frame>(frame);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    updateHighWaterMark(pos + 1 - m_head.load(std::memory_order_relaxed));
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    template <typename Frame>
+    bool waitAndEnqueue(Frame &frame)
+    {
+        QMutexLocker locker(&m_waitGuard);
+        m_waitingProducers.fetch_add(1, std::memory_order_acq_rel);
+        bool success = false;
+        while (overflowPolicy() == OverflowPolicy::Block
+               && !m_waitsInterrupted.load(std::memory_order_acquire)) {
+            if ((success = tryEnqueue(frame)))
+                break;
+            m_notFull.wait(&m_waitGuard, QDeadlineTimer(BlockingWaitInterval));
+        }
+        m_waitingProducers.fetch_sub(1, std::memory_order_acq_rel);
+        return success;
+    }
+
+    void wakeProducers()
+    {
+        QMutexLocker locker(&m_waitGuard);
+        m_notFull.wakeAll();
+    }
+
+    void updateHighWaterMark(quint64 used) noexcept
+    {
+        quint64 mark = m_highWaterMark.load(std::memory_order_relaxed);
+        while (used > mark
+               && !m_highWaterMark.compare_exchange_weak(mark, used, std::memory_order_relaxed)) {
+        }
+    }
+
+    enum { CacheLineSize = 64 };
+
+    std::unique_ptr<Slot[]> m_slots;
+    quint64 m_mask = 0;
+    bool m_bounded = true;
+
+    alignas(CacheLineSize) std::atomic<quint64> m_head{0};
+    alignas(CacheLineSize) std::atomic<quint64> m_tail{0};
+
+    alignas(CacheLineSize) std::atomic<quint64> m_droppedFrames{0};
+    std::atomic<quint64> m_highWaterMark{0};
+    std::atomic<OverflowPolicy> m_policy{OverflowPolicy::DropNewest};
+
+    std::atomic<int> m_waitingProducers{0};
+    std::atomic<bool> m_waitsInterrupted{false};
+    QMutex m_waitGuard;
+    QWaitCondition m_notFull;
+
+    std::atomic<qsizetype> m_overflowSize{0};
+    QMutex m_overflowGuard;
+    QList<QCanBusFrame> m_overflow;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSFRAMEQUEUE_P_H
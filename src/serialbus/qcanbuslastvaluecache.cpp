@@ -0,0 +1,293 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcanbuslastvaluecache_p.h"
+
+#include <QtCore/qthread.h>
+
+#include <algorithm>
+#include <cstring>
+
+QT_BEGIN_NAMESPACE
+
+QCanBusLastValueCache::QCanBusLastValueCache()
+    : m_baseSlots(std::make_unique<Slot[]>(BaseIdCount)),
+      m_extendedSlots(std::make_unique<Slot[]>(ExtendedIdCapacity)),
+      m_extendedKeys(std::make_unique<std::atomic<quint32>[]>(ExtendedIdCapacity))
+{
+}
+
+/*
+    Stores \a frame if it is a data frame. Must only be called by one thread
+    at a time.
+*/
+void QCanBusLastValueCache::update(const QCanBusFrame &frame) noexcept
+{
+    if (frame.frameType() != QCanBusFrame::DataFrame
+            || Q_UNLIKELY(frame.payloadView().size() > MaximumPayloadSize)) {
+        return;
+    }
+
+    if (Q_UNLIKELY(isClearPending()))
+        clear();
+
+    const QCanBusFrame::FrameId frameId = frame.frameId();
+    Slot *slot = nullptr;
+    if (frame.hasExtendedFrameFormat())
+        slot = insertExtended(frameId);
+    else if (Q_LIKELY(frameId < BaseIdCount))
+        slot = &m_baseSlots[frameId];
+
+    if (Q_LIKELY(slot))
+        write(slot, frame);
+}
+
+/*
+    Copies the last frame with \a frameId in the given format to \a frame
+    and its number of updates to \a updateCount. Returns \c false if no such
+    frame was received. May be called from any thread.
+*/
+bool QCanBusLastValueCache::read(QCanBusFrame::FrameId frameId, bool extended,
+                                 QCanBusFrame *frame, quint64 *updateCount) const
+{
+    const Slot *slot = findSlot(frameId, extended);
+    const quint64 count = slot ? read(slot, frame) : 0;
+    if (updateCount)
+        *updateCount = count;
+    return count != 0;
+}
+
+quint64 QCanBusLastValueCache::updateCount(QCanBusFrame::FrameId frameId,
+                                           bool extended) const noexcept
+{
+    const Slot *slot = findSlot(frameId, extended);
+    return slot ? slot->updateCount.load(std::memory_order_acquire) : 0;
+}
+
+/*
+    Returns the last frame of every identifier, base frames first, each in
+    ascending order of identifiers.
+*/
+QList<QCanBusFrame> QCanBusLastValueCache::frames() const
+{
+    QList<QCanBusFrame> result;
+    if (Q_UNLIKELY(isClearPending()))
+        return result;
+
+    QCanBusFrame frame;
+    for (int frameId = 0; frameId < BaseIdCount; ++frameId) {
+        const Slot &slot = m_baseSlots[frameId];
+        if (slot.updateCount.load(std::memory_order_acquire) && read(&slot, &frame))
+            result.append(frame);
+    }
+
+    const qsizetype baseCount = result.size();
+    for (int index = 0; index < ExtendedIdCapacity; ++index) {
+        if (!(m_extendedKeys[index].load(std::memory_order_acquire) & OccupiedKey))
+            continue;
+        if (read(&m_extendedSlots[index], &frame))
+            result.append(frame);
+    }
+    std::sort(result.begin() + baseCount, result.end(),
+              [](const QCanBusFrame &a, const QCanBusFrame &b) {
+        return a.frameId() < b.frameId();
+    });
+
+    return result;
+}
+
+// Empties all slots after scheduleClear(), called by the writer.
+void QCanBusLastValueCache::clear() noexcept
+{
+    for (int frameId = 0; frameId < BaseIdCount; ++frameId) {
+        if (m_baseSlots[frameId].updateCount.load(std::memory_order_relaxed))
+            reset(&m_baseSlots[frameId]);
+    }
+
+    for (int index = 0; index < ExtendedIdCapacity; ++index) {
+        if (!m_extendedKeys[index].load(std::memory_order_relaxed))
+            continue;
+        reset(&m_extendedSlots[index]);
+        m_extendedKeys[index].store(0, std::memory_order_release);
+    }
+    m_extendedCount = 0;
+
+    m_clearPending.store(false, std::memory_order_release);
+}
+
+// A slot without updates reads as never written.
+void QCanBusLastValueCache::reset(Slot *slot) noexcept
+{
+    const quint32 sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->updateCount.store(0, std::memory_order_relaxed);
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void QCanBusLastValueCache::write(Slot *slot, const QCanBusFrame &frame) noexcept
+{
+    Record record = {};
+    record.frameId = frame.frameId();
+    if (frame.hasExtendedFrameFormat())
+        record.flags |= Record::ExtendedFrameFormat;
+    if (frame.hasFlexibleDataRateFormat())
+        record.flags |= Record::FlexibleDataRate;
+    if (frame.hasBitrateSwitch())
+        record.flags |= Record::BitrateSwitch;
+    if (frame.hasErrorStateIndicator())
+        record.flags |= Record::ErrorStateIndicator;
+    if (frame.hasLocalEcho())
+        record.flags |= Record::LocalEcho;
+    const QByteArrayView payload = frame.payloadView();
+    record.length = quint8(payload.size());
+    if (record.length)
+        ::memcpy(record.payload, payload.data(), record.length);
+    record.seconds = frame.timeStamp().seconds();
+    record.microSeconds = frame.timeStamp().microSeconds();
+
+    quint64 words[FrameWords];
+    ::memcpy(words, &record, sizeof(words));
+
+    const quint32 sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (int i = 0; i < FrameWords; ++i)
+        slot->frame[i].store(words[i], std::memory_order_relaxed);
+    slot->updateCount.store(slot->updateCount.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// Returns the update count read together with the frame, 0 if the slot was
+// never written.
+quint64 QCanBusLastValueCache::read(const Slot *slot, QCanBusFrame *frame)
+{
+    quint64 words[FrameWords];
+    quint64 count;
+    for (;;) {
+        const quint32 before = slot->sequence.load(std::memory_order_acquire);
+        if (Q_UNLIKELY(before & 1)) {
+            QThread::yieldCurrentThread();
+            continue;
+        }
+
+        for (int i = 0; i < FrameWords; ++i)
+            words[i] = slot->frame[i].load(std::memory_order_relaxed);
+        count = slot->updateCount.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) == before)
+            break;
+    }
+
+    if (count && frame) {
+        Record record;
+        ::memcpy(&record, words, sizeof(record));
+
+        *frame = QCanBusFrame(record.frameId, QByteArray(record.payload, record.length));
+        frame->setExtendedFrameFormat(record.flags & Record::ExtendedFrameFormat);
+        frame->setFlexibleDataRateFormat(record.flags & Record::FlexibleDataRate);
+        frame->setBitrateSwitch(record.flags & Record::BitrateSwitch);
+        frame->setErrorStateIndicator(record.flags & Record::ErrorStateIndicator);
+        frame->setLocalEcho(record.flags & Record::LocalEcho);
+        frame->setTimeStamp(QCanBusFrame::TimeStamp(record.seconds, record.microSeconds));
+    }
+    return count;
+}
+
+qsizetype QCanBusLastValueCache::hash(QCanBusFrame::FrameId frameId) noexcept
+{
+    // Fibonacci hashing spreads the dense identifier ranges of real buses
+    constexpr int HashBits = 12;
+    static_assert((1 << HashBits) == ExtendedIdCapacity);
+    return qsizetype((frameId * 0x9E3779B1U) >> (32 - HashBits));
+}
+
+// Returns nullptr while a clear is pending, the cache then reads as empty.
+const QCanBusLastValueCache::Slot *
+QCanBusLastValueCache::findSlot(QCanBusFrame::FrameId frameId, bool extended) const noexcept
+{
+    if (Q_UNLIKELY(isClearPending()))
+        return nullptr;
+    if (extended)
+        return findExtended(frameId);
+    return frameId < BaseIdCount ? &m_baseSlots[frameId] : nullptr;
+}
+
+const QCanBusLastValueCache::Slot *
+QCanBusLastValueCache::findExtended(QCanBusFrame::FrameId frameId) const noexcept
+{
+    const quint32 key = frameId | OccupiedKey;
+    for (qsizetype index = hash(frameId);; index = (index + 1) % ExtendedIdCapacity) {
+        const quint32 stored = m_extendedKeys[index].load(std::memory_order_acquire);
+        if (stored == key)
+            return &m_extendedSlots[index];
+        if (stored == 0)
+            return nullptr;
+    }
+}
+
+QCanBusLastValueCache::Slot *
+QCanBusLastValueCache::insertExtended(QCanBusFrame::FrameId frameId) noexcept
+{
+    const quint32 key = frameId | OccupiedKey;
+    for (qsizetype index = hash(frameId);; index = (index + 1) % ExtendedIdCapacity) {
+        const quint32 stored = m_extendedKeys[index].load(std::memory_order_relaxed);
+        if (stored == key)
+            return &m_extendedSlots[index];
+        if (stored != 0)
+            continue;
+
+        // keep the table sparse, so that probe sequences stay short
+        if (m_extendedCount >= MaximumExtendedIds)
+            return nullptr;
+        ++m_extendedCount;
+
+        // a reader that finds the key before the first write sees no updates
+        m_extendedKeys[index].store(key, std::memory_order_release);
+        return &m_extendedSlots[index];
+    }
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,158 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSLASTVALUECACHE_P_H
+#define QCANBUSLASTVALUECACHE_P_H
+
+#include <QtSerialBus/qcanbusframe.h>
+
+#include <QtCore/qlist.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Most recent data frame per frame identifier, see
+    QCanBusDevice::LastValueCacheKey.
+
+    Base frame identifiers index a table directly. Extended identifiers are
+    kept in an open addressing hash table of fixed size, so that readers
+    never see the table move.
+
+    There is a single writer, the thread that enqueues received frames.
+    Every slot is protected by a sequence lock: the writer makes the
+    sequence odd while it copies a frame, readers retry until they read the
+    same even sequence before and after the copy. The frame is flattened
+    into a plain record and stored as atomic words, so concurrent reads are
+    not data races.
+
+    scheduleClear() may be called from any thread. Readers find the cache
+    empty from then on, the writer empties the slots before it stores the
+    next frame.
+*/
+class QCanBusLastValueCache
+{
+public:
+    enum {
+        BaseIdCount = 2048,
+        ExtendedIdCapacity = 4096,
+        MaximumExtendedIds = ExtendedIdCapacity / 4 * 3,
+        MaximumPayloadSize = 64
+    };
+
+    QCanBusLastValueCache();
+
+    void update(const QCanBusFrame &frame) noexcept;
+    void scheduleClear() noexcept { m_clearPending.store(true, std::memory_order_release); }
+
+    bool read(QCanBusFrame::FrameId frameId, bool extended,
+              QCanBusFrame *frame, quint64 *updateCount) const;
+    quint64 updateCount(QCanBusFrame::FrameId frameId, bool extended) const noexcept;
+    QList<QCanBusFrame> frames() const;
+
+private:
+    // QCanBusFrame holds its payload in a QByteArray, which a racing reader
+    // must not copy, so the slots keep the frame in this plain form.
+    struct Record
+    {
+        enum Flag : quint8 {
+            ExtendedFrameFormat = 0x01,
+            FlexibleDataRate = 0x02,
+            BitrateSwitch = 0x04,
+            ErrorStateIndicator = 0x08,
+            LocalEcho = 0x10
+        };
+
+        QCanBusFrame::FrameId frameId;
+        quint8 flags;
+        quint8 length;
+        quint8 reserved[2];
+        char payload[MaximumPayloadSize];
+        qint64 seconds;
+        qint64 microSeconds;
+    };
+    static_assert(sizeof(Record) % sizeof(quint64) == 0);
+
+    enum {
+        FrameWords = sizeof(Record) / sizeof(quint64)
+    };
+
+    static constexpr quint32 OccupiedKey = 0x80000000U;
+
+    struct Slot {
+        std::atomic<quint32> sequence{0};
+        std::atomic<quint64> updateCount{0};
+        std::array<std::atomic<quint64>, FrameWords> frame{};
+    };
+
+    bool isClearPending() const noexcept { return m_clearPending.load(std::memory_order_acquire); }
+    void clear() noexcept;
+    static void reset(Slot *slot) noexcept;
+    static void write(Slot *slot, const QCanBusFrame &frame) noexcept;
+    static quint64 read(const Slot *slot, QCanBusFrame *frame);
+
+    static qsizetype hash(QCanBusFrame::FrameId frameId) noexcept;
+    const Slot *findSlot(QCanBusFrame::FrameId frameId, bool extended) const noexcept;
+    const Slot *findExtended(QCanBusFrame::FrameId frameId) const noexcept;
+    Slot *insertExtended(QCanBusFrame::FrameId frameId) noexcept;
+
+    std::unique_ptr<Slot[]> m_baseSlots;
+    std::unique_ptr<Slot[]> m_extendedSlots;
+    std::unique_ptr<std::atomic<quint32>[]> m_extendedKeys;
+    int m_extendedCount = 0; // only used by the writer
+    std::atomic<bool> m_clearPending{false};
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSLASTVALUECACHE_P_H
@@ -0,0 +1,691 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcanbusloadestimator.h"
+#include "qcanbusloadestimator_p.h"
+#include "qcanbusdevice.h"
+#include "qcanbusdevice_p.h"
+
+#include <QtCore/qloggingcategory.h>
+#include <QtCore/qtimer.h>
+
+#include <chrono>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(QT_CANBUS)
+
+/*!
+    \class QCanBusLoadEstimator
+    \inmodule QtSerialBus
+    \since 6.4
+
+    \brief QCanBusLoadEstimator measures the utilization of a CAN bus.
+
+    QCanBusLoadEstimator computes the exact number of bits each received
+    frame occupied on the bus: start of frame, arbitration and control
+    fields, payload, CRC, the stuff bits inserted by the transmitter,
+    acknowledge, end of frame and interframe space. For CAN FD frames with
+    bit rate switch, the bits of the data phase are timed with the data
+    bit rate.
+
+    The bus time of the frames is summed up over a sliding window of
+    \l windowDuration() milliseconds, and \l busLoad() returns it as a
+    percentage of the window. The window is placed by the
+    \l{QCanBusFrame::timeStamp()}{timestamps} of the frames; frames
+    without timestamp are placed at the current time of the system clock,
+    which is the clock QCanBusFrame::TimeStamp refers to. While no frames
+    are added, the window moves on with the system clock, so the bus load
+    of an idle bus decays to \c 0. The window moves in steps of 1/64 of
+    its duration.
+
+    Instead of polling \l busLoad(), the estimate can be received with the
+    \l busLoadUpdated() signal, which is emitted every
+    \l updateInterval() milliseconds.
+
+    The estimator can be fed with frames by \l addFrames(), or attached to
+    a device with \l setDevice(), which also takes over the bit rates
+    configured on the device:
+
+    \code
+        auto estimator = new QCanBusLoadEstimator(device);
+        estimator->setDevice(device);
+        estimator->setUpdateInterval(500);
+        connect(estimator, &QCanBusLoadEstimator::busLoadUpdated, [](double busLoad) {
+            qDebug() << "bus load" << busLoad << "%";
+        });
+    \endcode
+
+    An attached estimator only sees the frames the device receives. Frames
+    sent by the device itself are included only if
+    QCanBusDevice::ReceiveOwnKey is enabled, and frames removed by
+    QCanBusDevice::RawFilterKey are not included.
+
+    All functions may be called from any thread. The \l busLoadUpdated()
+    signal is emitted in the thread the estimator lives in.
+*/
+
+/*!
+    \fn void QCanBusLoadEstimator::busLoadUpdated(double busLoad)
+
+    This signal is emitted every \l updateInterval() milliseconds with the
+    current \a busLoad in percent, see \l busLoad().
+*/
+
+namespace {
+
+// The stuffing state is the value of the last bit on the wire and the
+// number of equal bits in a row. A stuff bit is inserted lazily when the
+// next bit arrives, so a stuff condition at the end of a field stays
+// visible in the state.
+constexpr int StuffStates = 12;
+
+constexpr int stuffState(int lastBit, int count) { return lastBit * 6 + count; }
+
+constexpr int stuffStep(int state, int bit, int *stuffed)
+{
+    int lastBit = state / 6;
+    int count = state % 6;
+    if (count == 5) {
+        ++*stuffed;
+        lastBit = !lastBit;
+        count = 1;
+    }
+    if (count > 0 && bit == lastBit)
+        return stuffState(lastBit, count + 1);
+    return stuffState(bit, 1);
+}
+
+// for every state and byte: the number of stuff bits in the high nibble,
+// the following state in the low nibble
+struct StuffTable
+{
+    quint8 entries[StuffStates][256] = {};
+};
+
+constexpr StuffTable makeStuffTable()
+{
+    StuffTable table;
+    for (int state = 0; state < StuffStates; ++state) {
+        for (int byte = 0; byte < 256; ++byte) {
+            int next = state;
+            int stuffed = 0;
+            for (int bit = 7; bit >= 0; --bit)
+                next = stuffStep(next, (byte >> bit) & 1, &stuffed);
+            table.entries[state][byte] = quint8((stuffed << 4) | next);
+        }
+    }
+    return table;
+}
+
+constexpr StuffTable stuffTable = makeStuffTable();
+
+// CRC-15 of classic CAN frames
+constexpr quint16 Crc15Polynomial = 0x4599;
+
+struct Crc15Table
+{
+    quint16 entries[256] = {};
+};
+
+constexpr Crc15Table makeCrc15Table()
+{
+    Crc15Table table;
+    for (int byte = 0; byte < 256; ++byte) {
+        quint16 crc = quint16(byte << 7);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x4000) ? quint16(((crc << 1) ^ Crc15Polynomial) & 0x7FFF)
+                                 : quint16((crc << 1) & 0x7FFF);
+        }
+        table.entries[byte] = crc;
+    }
+    return table;
+}
+
+constexpr Crc15Table crc15Table = makeCrc15Table();
+
+// Follows the stuffing state and, for classic CAN, the CRC over the bits
+// of a frame. Whole bytes go through the tables, only the remaining bits
+// of a field are handled one by one.
+struct BitStream
+{
+    void appendBit(int bit)
+    {
+        state = stuffStep(state, bit, &stuffBits);
+        if (computeCrc) {
+            const bool crcNext = bit ^ ((crc >> 14) & 1);
+            crc = quint16((crc << 1) & 0x7FFF);
+            if (crcNext)
+                crc ^= Crc15Polynomial;
+        }
+    }
+
+    void appendByte(quint8 byte)
+    {
+        const quint8 entry = stuffTable.entries[state][byte];
+        stuffBits += entry >> 4;
+        state = entry & 0x0F;
+        if (computeCrc)
+            crc = quint16(((crc << 8) ^ crc15Table.entries[((crc >> 7) ^ byte) & 0xFF]) & 0x7FFF);
+    }
+
+    // appends the lowest count bits of value, most significant bit first
+    void appendBits(quint64 value, int count)
+    {
+        for (; count >= 8; count -= 8)
+            appendByte(quint8(value >> (count - 8)));
+        for (int bit = count - 1; bit >= 0; --bit)
+            appendBit(int((value >> bit) & 1));
+    }
+
+    bool stuffBitPending() const { return state % 6 == 5; }
+
+    int state = stuffState(0, 0);
+    int stuffBits = 0;
+    quint16 crc = 0;
+    bool computeCrc = false;
+};
+
+constexpr int TrailerBits = 1 + 1 + 1 + 7 + 3; // CRC delimiter, ACK, ACK delimiter, EOF, IFS
+
+int flexibleDataRateDlc(int length)
+{
+    if (length <= 8)
+        return length;
+    if (length <= 24)
+        return 6 + (length + 3) / 4;
+    if (length <= 32)
+        return 13;
+    return length <= 48 ? 14 : 15;
+}
+
+int flexibleDataRateLength(int dlc)
+{
+    static constexpr int lengths[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+    return lengths[dlc];
+}
+
+qint64 currentTime()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+} // unnamed namespace
+
+QCanBusLoadEstimatorPrivate::FrameBits
+QCanBusLoadEstimatorPrivate::frameBits(const QCanBusFrame &frame)
+{
+    FrameBits result;
+    if (!frame.isValid())
+        return result;
+    const QCanBusFrame::FrameType type = frame.frameType();
+    if (type != QCanBusFrame::DataFrame && type != QCanBusFrame::RemoteRequestFrame)
+        return result;
+
+    const QCanBusFrame::FrameId id = frame.frameId();
+    const bool extended = frame.hasExtendedFrameFormat();
+    const QByteArray payload = frame.payload();
+    BitStream stream;
+
+    // the fields in front of the payload are collected first, at most 39 bits
+    quint64 header = 0;
+    int headerBits = 0;
+    const auto appendField = [&header, &headerBits](quint64 value, int bits) {
+        header = (header << bits) | value;
+        headerBits += bits;
+    };
+
+    if (!frame.hasFlexibleDataRateFormat()) {
+        const bool remote = type == QCanBusFrame::RemoteRequestFrame;
+        const int length = int(qMin<qsizetype>(payload.size(), 8));
+
+        // SOF, identifier, RTR (SRR and IDE for extended frames), IDE or r1, r0, DLC
+        appendField(0, 1);
+        if (extended) {
+            appendField(id >> 18, 11);
+            appendField(3, 2);
+            appendField(id & 0x3FFFF, 18);
+        } else {
+            appendField(id, 11);
+        }
+        appendField(remote, 1);
+        appendField(0, 2);
+        appendField(quint64(length), 4);
+
+        stream.computeCrc = true;
+        stream.appendBits(header, headerBits);
+        if (!remote) {
+            for (int i = 0; i < length; ++i)
+                stream.appendByte(quint8(payload.at(i)));
+        }
+        const quint16 crc = stream.crc;
+        stream.computeCrc = false;
+        stream.appendBits(crc, 15);
+        if (stream.stuffBitPending()) // stuffing includes the last CRC bit
+            ++stream.stuffBits;
+
+        result.arbitrationBits = headerBits + (remote ? 0 : 8 * length) + 15
+                + stream.stuffBits + TrailerBits;
+        return result;
+    }
+
+    // SOF, identifier, RRS (SRR and IDE for extended frames), IDE, FDF, res, BRS
+    appendField(0, 1);
+    if (extended) {
+        appendField(id >> 18, 11);
+        appendField(3, 2);
+        appendField(id & 0x3FFFF, 18);
+        appendField(0, 1);
+    } else {
+        appendField(id, 11);
+        appendField(0, 2);
+    }
+    appendField(1, 1);
+    appendField(0, 1);
+    appendField(frame.hasBitrateSwitch(), 1);
+
+    stream.appendBits(header, headerBits);
+    // a stuff bit due after BRS is already sent in the data phase
+    const int arbitrationStuffBits = stream.stuffBits;
+
+    // ESI, DLC, payload padded to the DLC
+    const int dlc = flexibleDataRateDlc(int(payload.size()));
+    const int length = flexibleDataRateLength(dlc);
+    stream.appendBits((quint64(frame.hasErrorStateIndicator()) << 4) | quint64(dlc), 5);
+    for (int i = 0; i < length; ++i)
+        stream.appendByte(i < payload.size() ? quint8(payload.at(i)) : quint8(0));
+    // A stuff condition at the end of the data field is covered by the fixed
+    // stuff bit in front of the CRC field, so a pending stuff bit is not counted.
+
+    // stuff count, CRC and fixed stuff bits
+    const int crcFieldBits = length <= 16 ? 4 + 17 + 6 : 4 + 21 + 7;
+    const int dataPhaseBits = 5 + 8 * length + (stream.stuffBits - arbitrationStuffBits)
+            + crcFieldBits;
+
+    result.arbitrationBits = headerBits + arbitrationStuffBits + TrailerBits;
+    if (frame.hasBitrateSwitch())
+        result.dataBits = dataPhaseBits;
+    else
+        result.arbitrationBits += dataPhaseBits;
+    return result;
+}
+
+qint64 QCanBusLoadEstimatorPrivate::duration(const FrameBits &bits, int bitRate, int dataBitRate)
+{
+    if (bitRate <= 0)
+        return 0;
+    if (dataBitRate <= 0)
+        dataBitRate = bitRate;
+
+    return qint64(bits.arbitrationBits) * 1000000000 / bitRate
+            + qint64(bits.dataBits) * 1000000000 / dataBitRate;
+}
+
+void QCanBusLoadEstimatorPrivate::addFrames(const QList<QCanBusFrame> &frames)
+{
+    QMutexLocker locker(&guard);
+
+    if (bitRate <= 0)
+        return;
+
+    const qint64 now = currentTime();
+    advance(now);
+    for (const QCanBusFrame &frame : frames) {
+        const qint64 busTime = duration(frameBits(frame), bitRate, dataBitRate);
+        if (busTime == 0)
+            continue;
+
+        const QCanBusFrame::TimeStamp stamp = frame.timeStamp();
+        qint64 timeStamp = stamp.seconds() * 1000000 + stamp.microSeconds();
+        if (timeStamp <= 0)
+            timeStamp = now;
+
+        const qint64 bucket = timeStamp / bucketDuration;
+        if (currentBucket < 0) {
+            currentBucket = bucket;
+            currentBucketEntered = now;
+        } else if (bucket > currentBucket) {
+            // the window moves on, forget the buckets it leaves behind
+            const qint64 expired = qMin<qint64>(bucket - currentBucket, BucketCount);
+            for (qint64 i = 1; i <= expired; ++i)
+                buckets[(currentBucket + i) % BucketCount] = 0;
+            currentBucket = bucket;
+            currentBucketEntered = now;
+        } else if (bucket <= currentBucket - BucketCount) {
+            continue; // older than the window
+        }
+        buckets[bucket % BucketCount] += busTime;
+    }
+}
+
+// Moves the window on by the system time passed since the current bucket
+// was entered. This also works for devices whose timestamps are not based
+// on the system clock.
+void QCanBusLoadEstimatorPrivate::advance(qint64 now)
+{
+    if (currentBucket < 0)
+        return;
+
+    const qint64 passed = (now - currentBucketEntered) / bucketDuration;
+    if (passed <= 0)
+        return;
+
+    const qint64 expired = qMin<qint64>(passed, BucketCount);
+    for (qint64 i = 1; i <= expired; ++i)
+        buckets[(currentBucket + i) % BucketCount] = 0;
+    currentBucket += passed;
+    currentBucketEntered += passed * bucketDuration;
+}
+
+// Returns the bus time in the window ending at the system time now,
+// without moving the window.
+qint64 QCanBusLoadEstimatorPrivate::busTime(qint64 now) const
+{
+    qint64 passed = 0;
+    if (currentBucket >= 0)
+        passed = qMax<qint64>((now - currentBucketEntered) / bucketDuration, 0);
+
+    qint64 result = 0;
+    for (qint64 i = passed; i < BucketCount; ++i)
+        result += buckets[(currentBucket - i + BucketCount * 2) % BucketCount];
+    return result;
+}
+
+void QCanBusLoadEstimatorPrivate::clearBuckets()
+{
+    buckets.fill(0);
+    currentBucket = -1;
+}
+
+void QCanBusLoadEstimatorPrivate::publishBusLoad()
+{
+    Q_Q(QCanBusLoadEstimator);
+
+    emit q->busLoadUpdated(q->busLoad());
+}
+
+void QCanBusLoadEstimatorPrivate::detach()
+{
+    if (device)
+        QCanBusDevicePrivate::get(device)->removeFrameObserver(this);
+    device.clear();
+}
+
+/*!
+    Constructs an estimator with the given \a parent.
+*/
+QCanBusLoadEstimator::QCanBusLoadEstimator(QObject *parent)
+    : QObject(*new QCanBusLoadEstimatorPrivate, parent)
+{
+}
+
+/*!
+    Detaches the estimator from its device and destroys it.
+*/
+QCanBusLoadEstimator::~QCanBusLoadEstimator()
+{
+    Q_D(QCanBusLoadEstimator);
+
+    d->detach();
+}
+
+/*!
+    Attaches the estimator to \a device. From now on, all frames \a device
+    receives are added to the bus load. Passing \c nullptr detaches the
+    estimator from its current device.
+
+    If \a device has QCanBusDevice::BitRateKey or
+    QCanBusDevice::DataBitRateKey configured, the values are used as
+    \l bitRate() and \l dataBitRate(). Later changes of the configuration
+    are not followed.
+*/
+void QCanBusLoadEstimator::setDevice(QCanBusDevice *device)
+{
+    Q_D(QCanBusLoadEstimator);
+
+    if (d->device == device)
+        return;
+
+    d->detach();
+    d->device = device;
+    if (!device)
+        return;
+
+    bool ok = false;
+    const int bitRate = device->configurationParameter(QCanBusDevice::BitRateKey).toInt(&ok);
+    if (ok && bitRate > 0)
+        setBitRate(bitRate);
+    const int dataBitRate =
+            device->configurationParameter(QCanBusDevice::DataBitRateKey).toInt(&ok);
+    if (ok && dataBitRate > 0)
+        setDataBitRate(dataBitRate);
+
+    QCanBusDevicePrivate::get(device)->addFrameObserver(
+                d, [d](const QList<QCanBusFrame> &frames) { d->addFrames(frames); });
+}
+
+/*!
+    Returns the device the estimator is attached to, or \c nullptr.
+*/
+QCanBusDevice *QCanBusLoadEstimator::device() const
+{
+    Q_D(const QCanBusLoadEstimator);
+
+    return d->device;
+}
+
+/*!
+    Sets the nominal bit rate of the bus to \a bitRate bits per second. The
+    nominal bit rate is used for classic CAN frames and for the arbitration
+    phase of CAN FD frames.
+
+    As long as the bit rate is \c 0, the default, no frames are taken into
+    account.
+*/
+void QCanBusLoadEstimator::setBitRate(int bitRate)
+{
+    Q_D(QCanBusLoadEstimator);
+
+    QMutexLocker locker(&d->guard);
+    d->bitRate = qMax(bitRate, 0);
+}
+
+/*!
+    Returns the nominal bit rate in bits per second.
+*/
+int QCanBusLoadEstimator::bitRate() const
+{
+    Q_D(const QCanBusLoadEstimator);
+
+    QMutexLocker locker(&d->guard);
+    return d->bitRate;
+}
+
+/*!
+    Sets the bit rate of the CAN FD data phase to \a bitRate bits per
+    second. It is used for the data phase of CAN FD frames with bit rate
+    switch. If it is \c 0, the default, the nominal bit rate is used.
+*/
+void QCanBusLoadEstimator::setDataBitRate(int bitRate)
+{
+    Q_D(QCanBusLoadEstimator);
+
+    QMutexLocker locker(&d->guard);
+    d->dataBitRate = qMax(bitRate, 0);
+}
+
+/*!
+    Returns the bit rate of the CAN FD data phase in bits per second.
+*/
+int QCanBusLoadEstimator::dataBitRate() const
+{
+    Q_D(const QCanBusLoadEstimator);
+
+    QMutexLocker locker(&d->guard);
+    return d->dataBitRate;
+}
+
+/*!
+    Sets the duration of the sliding window to \a msecs milliseconds. The
+    default is 1000 milliseconds. Changing the duration clears the bus load
+    measured so far.
+*/
+void QCanBusLoadEstimator::setWindowDuration(int msecs)
+{
+    Q_D(QCanBusLoadEstimator);
+
+    if (msecs <= 0) {
+        qCWarning(QT_CANBUS, "Cannot set a window duration of %d ms.", msecs);
+        return;
+    }
+
+    QMutexLocker locker(&d->guard);
+    d->windowDuration = msecs;
+    d->bucketDuration = qMax<qint64>(qint64(msecs) * 1000 / d->BucketCount, 1);
+    d->clearBuckets();
+}
+
+/*!
+    Returns the duration of the sliding window in milliseconds.
+*/
+int QCanBusLoadEstimator::windowDuration() const
+{
+    Q_D(const QCanBusLoadEstimator);
+
+    QMutexLocker locker(&d->guard);
+    return d->windowDuration;
+}
+
+/*!
+    Adds \a frames to the bus load. Data and remote request frames are
+    taken into account, other and invalid frames are ignored.
+*/
+void QCanBusLoadEstimator::addFrames(const QList<QCanBusFrame> &frames)
+{
+    Q_D(QCanBusLoadEstimator);
+
+    d->addFrames(frames);
+}
+
+/*!
+    Sets the interval of the \l busLoadUpdated() signal to \a msecs
+    milliseconds. The default is \c 0, which does not emit the signal.
+*/
+void QCanBusLoadEstimator::setUpdateInterval(int msecs)
+{
+    Q_D(QCanBusLoadEstimator);
+
+    if (msecs <= 0) {
+        if (d->updateTimer)
+            d->updateTimer->stop();
+        return;
+    }
+
+    if (!d->updateTimer) {
+        d->updateTimer = new QTimer(this);
+        connect(d->updateTimer, &QTimer::timeout, this, [d]() { d->publishBusLoad(); });
+    }
+    d->updateTimer->start(msecs);
+}
+
+/*!
+    Returns the interval of the \l busLoadUpdated() signal in
+    milliseconds, or \c 0 if the signal is not emitted.
+*/
+int QCanBusLoadEstimator::updateInterval() const
+{
+    Q_D(const QCanBusLoadEstimator);
+
+    return d->updateTimer && d->updateTimer->isActive() ? d->updateTimer->interval() : 0;
+}
+
+/*!
+    Returns the bus load as percentage of the window ending now. Error
+    frames are not included, so on a disturbed bus the value is lower than
+    the real bus load.
+*/
+double QCanBusLoadEstimator::busLoad() const
+{
+    Q_D(const QCanBusLoadEstimator);
+
+    QMutexLocker locker(&d->guard);
+    const qint64 busTime = d->busTime(currentTime());
+    return 100.0 * double(busTime) / (double(d->windowDuration) * 1000000.0);
+}
+
+/*!
+    Clears the bus load measured so far.
+*/
+void QCanBusLoadEstimator::reset()
+{
+    Q_D(QCanBusLoadEstimator);
+
+    QMutexLocker locker(&d->guard);
+    d->clearBuckets();
+}
+
+/*!
+    Returns the number of bits \a frame occupies on the bus, including stuff
+    bits and interframe space. Returns \c 0 for invalid frames and for
+    frames that are neither data nor remote request frames.
+
+    The number of stuff bits depends on the frame identifier and the
+    payload, so frames with equal payload length may differ by several bits.
+*/
+int QCanBusLoadEstimator::frameBitCount(const QCanBusFrame &frame)
+{
+    const QCanBusLoadEstimatorPrivate::FrameBits bits =
+            QCanBusLoadEstimatorPrivate::frameBits(frame);
+    return bits.arbitrationBits + bits.dataBits;
+}
+
+/*!
+    Returns the time in nanoseconds \a frame occupies the bus at the nominal
+    bit rate \a bitRate. For CAN FD frames with bit rate switch, the data
+    phase is timed with \a dataBitRate. If \a dataBitRate is \c 0,
+    \a bitRate is used for the whole frame.
+*/
+qint64 QCanBusLoadEstimator::frameDuration(const QCanBusFrame &frame, int bitRate, int dataBitRate)
+{
+    return QCanBusLoadEstimatorPrivate::duration(QCanBusLoadEstimatorPrivate::frameBits(frame),
+                                                 bitRate, dataBitRate);
+}
+
+QT_END_NAMESPACE
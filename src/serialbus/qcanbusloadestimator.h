@@ -0,0 +1,93 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSLOADESTIMATOR_H
+#define QCANBUSLOADESTIMATOR_H
+
+#include <QtCore/qlist.h>
+#include <QtCore/qobject.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+class QCanBusDevice;
+class QCanBusLoadEstimatorPrivate;
+
+class Q_SERIALBUS_EXPORT QCanBusLoadEstimator : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(QCanBusLoadEstimator)
+
+public:
+    explicit QCanBusLoadEstimator(QObject *parent = nullptr);
+    ~QCanBusLoadEstimator() override;
+
+    void setDevice(QCanBusDevice *device);
+    QCanBusDevice *device() const;
+
+    void setBitRate(int bitRate);
+    int bitRate() const;
+    void setDataBitRate(int bitRate);
+    int dataBitRate() const;
+
+    void setWindowDuration(int msecs);
+    int windowDuration() const;
+
+    void addFrames(const QList<QCanBusFrame> &frames);
+
+    void setUpdateInterval(int msecs);
+    int updateInterval() const;
+
+    double busLoad() const;
+    void reset();
+
+    static int frameBitCount(const QCanBusFrame &frame);
+    static qint64 frameDuration(const QCanBusFrame &frame, int bitRate, int dataBitRate = 0);
+
+Q_SIGNALS:
+    void busLoadUpdated(double busLoad);
+
+private:
+    Q_DISABLE_COPY(QCanBusLoadEstimator)
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSLOADESTIMATOR_H
@@ -0,0 +1,106 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSLOADESTIMATOR_P_H
+#define QCANBUSLOADESTIMATOR_P_H
+
+#include <QtSerialBus/qcanbusloadestimator.h>
+
+#include <QtCore/qmutex.h>
+#include <QtCore/qpointer.h>
+
+#include <private/qobject_p.h>
+
+#include <array>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QTimer;
+
+class QCanBusLoadEstimatorPrivate : public QObjectPrivate
+{
+    Q_DECLARE_PUBLIC(QCanBusLoadEstimator)
+public:
+    // on-wire length of a frame, split by the bit rate the bits are sent with
+    struct FrameBits {
+        int arbitrationBits = 0;
+        int dataBits = 0;
+    };
+    static FrameBits frameBits(const QCanBusFrame &frame);
+    static qint64 duration(const FrameBits &bits, int bitRate, int dataBitRate);
+
+    void addFrames(const QList<QCanBusFrame> &frames);
+    void advance(qint64 now);
+    qint64 busTime(qint64 now) const;
+    void clearBuckets();
+    void detach();
+    void publishBusLoad();
+
+    // the window is divided into buckets holding the bus time in
+    // nanoseconds of the frames that started in them
+    static constexpr int BucketCount = 64;
+
+    mutable QMutex guard;
+    std::array<qint64, BucketCount> buckets = {};
+    qint64 currentBucket = -1;
+    // system time in microseconds the current bucket was entered at, it
+    // moves the window on while no frames are added
+    qint64 currentBucketEntered = 0;
+    qint64 bucketDuration = 1000000 / BucketCount; // microseconds
+    int windowDuration = 1000;
+    int bitRate = 0;
+    int dataBitRate = 0;
+    QPointer<QCanBusDevice> device;
+    QTimer *updateTimer = nullptr;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSLOADESTIMATOR_P_H
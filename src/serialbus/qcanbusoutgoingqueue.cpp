@@ -0,0 +1,187 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcanbusoutgoingqueue_p.h"
+
+#include <utility>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Returns the key that orders \a frame like the bus arbitration does, the
+    lowest key wins. The key follows the bits of the arbitration field: the
+    base identifier, RTR or SRR, IDE, the identifier extension and RTR. A
+    base format frame therefore wins against an extended format frame with
+    the same base identifier, and a data frame against a remote request.
+*/
+quint32 QCanBusOutgoingQueue::arbitrationKey(const QCanBusFrame &frame)
+{
+    const quint32 id = frame.frameId();
+    const quint32 remote = frame.frameType() == QCanBusFrame::RemoteRequestFrame ? 1 : 0;
+
+    if (!frame.hasExtendedFrameFormat())
+        return ((id & 0x7FFU) << 21) | (remote << 20);
+
+    return (((id >> 18) & 0x7FFU) << 21) | (1U << 20) | (1U << 19)
+            | ((id & 0x3FFFFU) << 1) | remote;
+}
+
+void QCanBusOutgoingQueue::setPriorityOrder(bool enabled)
+{
+    if (m_priorityOrder == enabled)
+        return;
+
+    m_priorityOrder = enabled;
+
+    // requeue in the current order, so equal keys keep their order
+    const QMap<quint32, QList<Entry>> queues = std::exchange(m_queues, {});
+    for (const QList<Entry> &queue : queues) {
+        for (const Entry &entry : queue) {
+            Entry copy = entry;
+            m_queues[m_priorityOrder ? arbitrationKey(copy.frame) : 0].append(std::move(copy));
+        }
+    }
+}
+
+void QCanBusOutgoingQueue::enqueue(const QCanBusFrame &frame, qint64 deadline)
+{
+    append({frame, deadline});
+}
+
+void QCanBusOutgoingQueue::append(Entry &&entry)
+{
+    if (entry.deadline != NoDeadline) {
+        ++m_deadlines;
+        m_earliestDeadline = qMin(m_earliestDeadline, entry.deadline);
+    }
+
+    const quint32 key = m_priorityOrder ? arbitrationKey(entry.frame) : 0;
+    m_queues[key].append(std::move(entry));
+    ++m_size;
+}
+
+QCanBusFrame QCanBusOutgoingQueue::dequeue()
+{
+    if (m_queues.isEmpty())
+        return QCanBusFrame(QCanBusFrame::InvalidFrame);
+
+    auto queue = m_queues.begin();
+    Entry entry = queue->takeFirst();
+    if (queue->isEmpty())
+        m_queues.erase(queue);
+    --m_size;
+
+    if (entry.deadline != NoDeadline && --m_deadlines == 0)
+        m_earliestDeadline = NoDeadline;
+
+    return std::move(entry.frame);
+}
+
+/*
+    Returns the frame that dequeue() would return after \a index calls, or
+    \c nullptr if there are fewer frames.
+*/
+const QCanBusFrame *QCanBusOutgoingQueue::peek(qsizetype index) const
+{
+    if (index < 0 || index >= m_size)
+        return nullptr;
+
+    for (const QList<Entry> &queue : m_queues) {
+        if (index < queue.size())
+            return &queue.at(index).frame;
+        index -= queue.size();
+    }
+    return nullptr;
+}
+
+void QCanBusOutgoingQueue::clear()
+{
+    m_queues.clear();
+    m_size = 0;
+    m_deadlines = 0;
+    m_earliestDeadline = NoDeadline;
+}
+
+/*
+    Removes all frames whose deadline is before \a now and counts them as
+    expired. The earliest deadline is only a lower bound after frames were
+    dequeued; it is recomputed here.
+*/
+void QCanBusOutgoingQueue::dropExpired(qint64 now)
+{
+    if (!mayHaveExpired(now))
+        return;
+
+    qsizetype expired = 0;
+    m_earliestDeadline = NoDeadline;
+    for (auto queue = m_queues.begin(); queue != m_queues.end(); ) {
+        expired += queue->removeIf([now](const Entry &entry) { return now >= entry.deadline; });
+        for (const Entry &entry : std::as_const(*queue))
+            m_earliestDeadline = qMin(m_earliestDeadline, entry.deadline);
+
+        if (queue->isEmpty())
+            queue = m_queues.erase(queue);
+        else
+            ++queue;
+    }
+
+    m_size -= expired;
+    m_deadlines -= expired;
+    if (m_earliestDeadline == NoDeadline)
+        m_deadlines = 0;
+    m_expiredFrames.fetch_add(expired, std::memory_order_relaxed);
+}
+
+/*
+    Returns the number of frames whose deadline is before \a now.
+*/
+qsizetype QCanBusOutgoingQueue::expiredSize(qint64 now) const
+{
+    if (!mayHaveExpired(now))
+        return 0;
+
+    qsizetype expired = 0;
+    for (const QList<Entry> &queue : m_queues) {
+        for (const Entry &entry : queue)
+            expired += now >= entry.deadline;
+    }
+    return expired;
+}
+
+QT_END_NAMESPACE
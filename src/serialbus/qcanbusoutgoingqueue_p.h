@@ -0,0 +1,120 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSOUTGOINGQUEUE_P_H
+#define QCANBUSOUTGOINGQUEUE_P_H
+
+#include <QtSerialBus/qcanbusframe.h>
+
+#include <QtCore/qlist.h>
+#include <QtCore/qmap.h>
+
+#include <atomic>
+#include <limits>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+/*
+    The queue of frames waiting to be written by a buffered CAN plugin.
+
+    Frames are kept in one FIFO per arbitration key. By default, all frames
+    share one key, so the queue keeps the order of the writes. With priority
+    order, see QCanBusDevice::WriteQueuePriorityKey, the frame that would win
+    the bus arbitration is written first; frames with the same identifier
+    keep their order.
+
+    Frames may carry a deadline in nanoseconds of QDeadlineTimer. Expired
+    frames are only removed by dropExpired(), so that indexes returned by
+    peek() stay valid until the frames are dequeued. expiredSize() counts
+    them without removing them.
+*/
+class QCanBusOutgoingQueue
+{
+public:
+    static constexpr qint64 NoDeadline = std::numeric_limits<qint64>::max();
+
+    void setPriorityOrder(bool enabled);
+
+    void enqueue(const QCanBusFrame &frame, qint64 deadline = NoDeadline);
+    QCanBusFrame dequeue();
+    const QCanBusFrame *peek(qsizetype index) const;
+    void clear();
+
+    qsizetype size() const noexcept { return m_size; }
+    bool isEmpty() const noexcept { return m_size == 0; }
+
+    bool hasDeadlines() const noexcept { return m_deadlines > 0; }
+    bool mayHaveExpired(qint64 now) const noexcept { return now >= m_earliestDeadline; }
+    void dropExpired(qint64 now);
+    qsizetype expiredSize(qint64 now) const;
+    qint64 expiredFrames() const noexcept { return m_expiredFrames.load(std::memory_order_relaxed); }
+    void resetExpiredFrames() noexcept { m_expiredFrames.store(0, std::memory_order_relaxed); }
+
+    static quint32 arbitrationKey(const QCanBusFrame &frame);
+
+private:
+    struct Entry {
+        QCanBusFrame frame;
+        qint64 deadline;
+    };
+
+    void append(Entry &&entry);
+
+    QMap<quint32, QList<Entry>> m_queues;
+    qsizetype m_size = 0;
+    qsizetype m_deadlines = 0;
+    qint64 m_earliestDeadline = NoDeadline;
+    std::atomic<qint64> m_expiredFrames = 0;
+    bool m_priorityOrder = false;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSOUTGOINGQUEUE_P_H
@@ -0,0 +1,246 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcanbustransmitshaper_p.h"
+#include "qcanbusloadestimator.h"
+
+#include <algorithm>
+#include <utility>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Replaces the buckets with one full bucket per rule in \a rules. Frames that
+    are held back are sorted into the new buckets.
+*/
+void QCanBusTransmitShaper::setRules(const QList<QCanBusDevice::ShapingRule> &rules, qint64 now)
+{
+    refill(now);
+    const QList<Entry> held = takeAll();
+
+    m_buckets.clear();
+    m_buckets.reserve(rules.size() + 1);
+    for (const QCanBusDevice::ShapingRule &rule : rules) {
+        Bucket bucket;
+        bucket.frameId = rule.frameId;
+        bucket.frameIdMask = rule.frameIdMask;
+        bucket.rate = qMax(rule.rate, 1);
+        bucket.capacity = qMax(rule.burst, 1) * FrameTokens;
+        bucket.tokens = bucket.capacity;
+        m_buckets.append(std::move(bucket));
+    }
+    m_buckets.append(Bucket());
+
+    for (const Entry &entry : held)
+        bucketFor(entry.frame.frameId()).frames.append(entry);
+    m_size = held.size();
+}
+
+/*
+    Limits the bus time used by written frames to \a percent of the time. The
+    bus time of a frame is calculated from \a bitRate and \a dataBitRate. A
+    \a percent or \a bitRate of \c 0 removes the limit.
+*/
+void QCanBusTransmitShaper::setBusBudget(int percent, int bitRate, int dataBitRate, qint64 now)
+{
+    refill(now);
+
+    const bool wasActive = m_busRate > 0;
+    m_bitRate = bitRate;
+    m_dataBitRate = dataBitRate;
+    if (percent <= 0 || bitRate <= 0) {
+        m_busRate = 0;
+        m_busCapacity = 0;
+        m_busTokens = 0;
+        return;
+    }
+
+    m_busRate = qMin(percent, 100);
+    m_busCapacity = BusBudgetWindow * m_busRate;
+    m_busTokens = wasActive ? qMin(m_busTokens, m_busCapacity) : m_busCapacity;
+}
+
+void QCanBusTransmitShaper::enqueue(const QCanBusFrame &frame, qint64 deadline)
+{
+    bucketFor(frame.frameId()).frames.append({frame, deadline, m_sequence++});
+    ++m_size;
+}
+
+/*
+    Moves all frames that may be written at \a now to \a queue and returns
+    their number. Among the bucket heads that have a token, the frame written
+    first goes first. If the bus budget does not allow it, no other frame may
+    pass it. Expired frames are moved without using tokens, \a queue drops and
+    counts them.
+*/
+qsizetype QCanBusTransmitShaper::release(qint64 now, QCanBusOutgoingQueue *queue)
+{
+    refill(now);
+
+    qsizetype released = 0;
+    while (m_size > 0) {
+        Bucket *next = nullptr;
+        for (Bucket &bucket : m_buckets) {
+            if (bucket.frames.isEmpty())
+                continue;
+
+            const Entry &head = bucket.frames.first();
+            const bool eligible = bucket.rate == 0 || bucket.tokens >= FrameTokens
+                    || head.deadline <= now;
+            if (eligible && (!next || head.sequence < next->frames.first().sequence))
+                next = &bucket;
+        }
+        if (!next)
+            break;
+
+        const Entry &head = next->frames.first();
+        if (head.deadline > now) {
+            const qint64 cost = busCost(head.frame);
+            if (m_busTokens < cost)
+                break;
+            m_busTokens -= cost;
+            if (next->rate > 0)
+                next->tokens -= FrameTokens;
+        }
+
+        queue->enqueue(head.frame, head.deadline);
+        next->frames.removeFirst();
+        --m_size;
+        ++released;
+    }
+    return released;
+}
+
+/*
+    Returns the time at which the next frame may be released, or
+    QCanBusOutgoingQueue::NoDeadline if no frame is held back. The time may be
+    in the past.
+*/
+qint64 QCanBusTransmitShaper::nextRelease() const
+{
+    qint64 next = QCanBusOutgoingQueue::NoDeadline;
+    for (const Bucket &bucket : m_buckets) {
+        if (bucket.frames.isEmpty())
+            continue;
+
+        const Entry &head = bucket.frames.first();
+        qint64 wait = 0;
+        if (bucket.rate > 0 && bucket.tokens < FrameTokens)
+            wait = (FrameTokens - bucket.tokens + bucket.rate - 1) / bucket.rate;
+        if (m_busRate > 0) {
+            const qint64 missing = busCost(head.frame)
+                    - qMin(m_busTokens + wait * m_busRate, m_busCapacity);
+            if (missing > 0)
+                wait += (missing + m_busRate - 1) / m_busRate;
+        }
+
+        next = qMin(next, qMin(m_lastRefill + wait, head.deadline));
+    }
+    return next;
+}
+
+void QCanBusTransmitShaper::clear()
+{
+    for (Bucket &bucket : m_buckets)
+        bucket.frames.clear();
+    m_size = 0;
+}
+
+void QCanBusTransmitShaper::refill(qint64 now)
+{
+    const qint64 elapsed = now - m_lastRefill;
+    m_lastRefill = now;
+    if (elapsed <= 0)
+        return;
+
+    // compare before multiplying, elapsed may be very large after idle times
+    const auto fill = [elapsed](qint64 &tokens, qint64 capacity, qint64 rate) {
+        const qint64 missing = capacity - tokens;
+        if (elapsed >= (missing + rate - 1) / rate)
+            tokens = capacity;
+        else
+            tokens += elapsed * rate;
+    };
+
+    for (Bucket &bucket : m_buckets) {
+        if (bucket.rate > 0)
+            fill(bucket.tokens, bucket.capacity, bucket.rate);
+    }
+    if (m_busRate > 0)
+        fill(m_busTokens, m_busCapacity, m_busRate);
+}
+
+QCanBusTransmitShaper::Bucket &QCanBusTransmitShaper::bucketFor(QCanBusFrame::FrameId id)
+{
+    const auto matches = [id](const Bucket &bucket) {
+        return bucket.rate == 0
+                || (id & bucket.frameIdMask) == (bucket.frameId & bucket.frameIdMask);
+    };
+    return *std::find_if(m_buckets.begin(), m_buckets.end(), matches);
+}
+
+/*
+    Returns the budget tokens of \a frame, one nanosecond of bus time costs
+    100 tokens. A frame never costs more than a full budget, so that it
+    cannot block forever.
+*/
+qint64 QCanBusTransmitShaper::busCost(const QCanBusFrame &frame) const
+{
+    if (m_busRate == 0)
+        return 0;
+
+    const qint64 duration = QCanBusLoadEstimator::frameDuration(frame, m_bitRate, m_dataBitRate);
+    return qMin(duration * 100, m_busCapacity);
+}
+
+QList<QCanBusTransmitShaper::Entry> QCanBusTransmitShaper::takeAll()
+{
+    QList<Entry> entries;
+    entries.reserve(m_size);
+    for (Bucket &bucket : m_buckets)
+        entries.append(std::exchange(bucket.frames, {}));
+    m_size = 0;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.sequence < b.sequence;
+    });
+    return entries;
+}
+
+QT_END_NAMESPACE
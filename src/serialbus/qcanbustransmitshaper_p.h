@@ -0,0 +1,130 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANBUSTRANSMITSHAPER_P_H
+#define QCANBUSTRANSMITSHAPER_P_H
+
+#include <QtSerialBus/qcanbusdevice.h>
+
+#include "qcanbusoutgoingqueue_p.h"
+
+#include <QtCore/qlist.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Holds outgoing frames back until the token buckets configured with
+    QCanBusDevice::TransmitShapingKey and QCanBusDevice::TransmitBusLoadLimitKey
+    allow them to be written.
+
+    Every shaping rule has one bucket, a frame uses the bucket of the first
+    rule that matches its identifier. Frames that match no rule share a bucket
+    without rate limit. The bus budget is a bucket of bus time that every frame
+    has to pass in addition. Released frames keep the order of the writes as
+    far as the buckets allow.
+
+    All times are nanoseconds of QDeadlineTimer. The shaper has no timer of its
+    own, QCanBusDevice calls release() at the time returned by nextRelease().
+*/
+class QCanBusTransmitShaper
+{
+public:
+    // tokens of one frame, a bucket gains rate tokens per nanosecond
+    static constexpr qint64 FrameTokens = 1000000000;
+    // bus time in nanoseconds that may be sent at once at the bus load limit
+    static constexpr qint64 BusBudgetWindow = 10000000;
+
+    void setRules(const QList<QCanBusDevice::ShapingRule> &rules, qint64 now);
+    void setBusBudget(int percent, int bitRate, int dataBitRate, qint64 now);
+    bool isActive() const noexcept { return m_buckets.size() > 1 || m_busRate > 0; }
+
+    void enqueue(const QCanBusFrame &frame, qint64 deadline);
+    qsizetype release(qint64 now, QCanBusOutgoingQueue *queue);
+    qint64 nextRelease() const;
+    void clear();
+
+    qsizetype size() const noexcept { return m_size; }
+    bool isEmpty() const noexcept { return m_size == 0; }
+
+private:
+    struct Entry {
+        QCanBusFrame frame;
+        qint64 deadline;
+        quint64 sequence;
+    };
+
+    struct Bucket {
+        QCanBusFrame::FrameId frameId = 0;
+        QCanBusFrame::FrameId frameIdMask = 0;
+        qint64 rate = 0; // 0 means unlimited
+        qint64 capacity = 0;
+        qint64 tokens = 0;
+        QList<Entry> frames;
+    };
+
+    void refill(qint64 now);
+    Bucket &bucketFor(QCanBusFrame::FrameId id);
+    qint64 busCost(const QCanBusFrame &frame) const;
+    QList<Entry> takeAll();
+
+    QList<Bucket> m_buckets = { Bucket() }; // the last bucket takes unmatched frames
+    qint64 m_busRate = 0;
+    qint64 m_busCapacity = 0;
+    qint64 m_busTokens = 0;
+    int m_bitRate = 0;
+    int m_dataBitRate = 0;
+    qint64 m_lastRefill = 0;
+    quint64 m_sequence = 0;
+    qsizetype m_size = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANBUSTRANSMITSHAPER_P_H
@@ -0,0 +1,975 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcanisotpchannel.h"
+#include "qcanisotpchannel_p.h"
+#include "qcanbusdevice.h"
+#include "qcanbusdevice_p.h"
+
+#include <QtCore/qendian.h>
+#include <QtCore/qtimer.h>
+
+#include <cstring>
+#include <utility>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QCanIsoTpChannel
+    \inmodule QtSerialBus
+    \since 6.4
+
+    \brief QCanIsoTpChannel transfers messages of up to 4 GiB over a CAN
+    bus with the transport protocol of ISO 15765-2 (ISO-TP).
+
+    Diagnostic protocols such as UDS exchange messages that do not fit into
+    a single CAN frame. ISO-TP segments such a message into a first frame
+    and consecutive frames, and the receiver controls the pace with flow
+    control frames. QCanIsoTpChannel implements both sides of the protocol
+    with normal addressing on top of any QCanBusDevice:
+
+    \code
+        auto channel = new QCanIsoTpChannel(device);
+        channel->setTransmitFrameId(0x7E0);
+        channel->setReceiveFrameId(0x7E8);
+        channel->setDevice(device);
+        connect(channel, &QCanIsoTpChannel::messageReceived, this, &Tester::handleResponse);
+        channel->sendMessage(QByteArray::fromHex("22f190"));
+    \endcode
+
+    Messages are sent in the order of sendMessage(), one at a time. The
+    consecutive frames of a block are written with
+    QCanBusDevice::writeFrames() in batches, while at most a few frames
+    wait in the write buffer of the device, so that the bus is kept busy
+    without buffering the whole message in the device. If the receiver
+    requests a separation time, the frames are written one by one with a
+    precise timer. Timers have a resolution of one millisecond, so
+    separation times below one millisecond are rounded up.
+
+    A received message is reassembled in place into a buffer of the size
+    announced by its first frame. Messages longer than maximumMessageSize()
+    are refused with a flow control frame that reports an overflow.
+
+    With \l setFlexibleDataRateFormat(), the channel writes CAN FD frames
+    with 64 byte payload and the single frame and first frame formats of
+    ISO 15765-2:2016. Received frames are accepted in both formats.
+
+    The channel sees every frame the device receives, without taking frames
+    from the receive queue of the device, see
+    QCanBusCycleTimeAnalyzer::setDevice(). The frames of the channel are
+    still delivered by QCanBusDevice::readFrame(), so the receive queue of
+    the device must be drained, for example with
+    QCanBusDevice::readAllFrames() in a slot connected to
+    QCanBusDevice::framesReceived(). A long message otherwise leaves
+    thousands of frames in the queue. If the application does not read
+    frames at all, bound the queue with
+    QCanBusDevice::setReceiveQueueCapacity() and the overflow policy
+    QCanBusDevice::OverflowPolicy::DropOldest.
+
+    The channel must be used in the thread of its device.
+*/
+
+/*!
+    \enum QCanIsoTpChannel::ChannelError
+
+    This enum describes the errors of a channel.
+
+    \value NoError          No error occurred.
+    \value WriteError       The device did not accept a frame, or is not connected.
+    \value TimeoutError     The other side did not send a flow control frame or
+                            the next consecutive frame within timeout().
+    \value SequenceError    A consecutive frame was lost.
+    \value OverflowError    The message is longer than the receiver accepts.
+    \value ProtocolError    An unexpected or invalid frame was received.
+*/
+
+/*!
+    \fn void QCanIsoTpChannel::messageReceived(const QByteArray &message)
+
+    This signal is emitted when \a message was received completely.
+*/
+
+/*!
+    \fn void QCanIsoTpChannel::messageSent(qint64 size)
+
+    This signal is emitted when the last frame of a message of \a size
+    bytes was handed to the device.
+*/
+
+/*!
+    \fn void QCanIsoTpChannel::errorOccurred(QCanIsoTpChannel::ChannelError error)
+
+    This signal is emitted when \a error occurred while a message was sent
+    or received. The message is given up; sending continues with the next
+    message.
+
+    \sa errorString()
+*/
+
+/*!
+    Constructs a channel with the given \a parent.
+*/
+QCanIsoTpChannel::QCanIsoTpChannel(QObject *parent)
+    : QObject(*new QCanIsoTpChannelPrivate, parent)
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->updateReceiveKey();
+
+    d->flowControlTimer = new QTimer(this);
+    d->flowControlTimer->setSingleShot(true);
+    connect(d->flowControlTimer, &QTimer::timeout, this, [d]() {
+        d->abortTransmission(TimeoutError, tr("No flow control frame was received."));
+    });
+
+    d->separationTimer = new QTimer(this);
+    d->separationTimer->setSingleShot(true);
+    d->separationTimer->setTimerType(Qt::PreciseTimer);
+    connect(d->separationTimer, &QTimer::timeout, this, [d]() { d->writeConsecutiveFrames(); });
+
+    d->receiveTimer = new QTimer(this);
+    d->receiveTimer->setSingleShot(true);
+    connect(d->receiveTimer, &QTimer::timeout, this, [d]() {
+        d->abortReception(TimeoutError, tr("No consecutive frame was received."));
+    });
+}
+
+/*!
+    Detaches the channel from its device and destroys it.
+*/
+QCanIsoTpChannel::~QCanIsoTpChannel()
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->detach();
+}
+
+/*!
+    Attaches the channel to \a device. Messages in transfer are given up.
+    Passing \c nullptr detaches the channel from its current device.
+*/
+void QCanIsoTpChannel::setDevice(QCanBusDevice *device)
+{
+    Q_D(QCanIsoTpChannel);
+
+    if (d->device == device)
+        return;
+
+    abort();
+    d->detach();
+    d->device = device;
+    if (!device)
+        return;
+
+    // only the frames of the channel are passed to its thread
+    QCanBusDevicePrivate::get(device)->addFrameObserver(
+                d, [d](const QList<QCanBusFrame> &frames) {
+        const quint32 receiveKey = d->receiveKey.load(std::memory_order_relaxed);
+        QList<QCanBusFrame> channelFrames;
+        for (const QCanBusFrame &frame : frames) {
+            if (frame.frameType() == QCanBusFrame::DataFrame && !frame.hasLocalEcho()
+                    && QCanIsoTpChannelPrivate::key(frame.frameId(),
+                                                    frame.hasExtendedFrameFormat()) == receiveKey) {
+                channelFrames.append(frame);
+            }
+        }
+        if (!channelFrames.isEmpty()) {
+            QMetaObject::invokeMethod(d->q_func(), [d, channelFrames]() {
+                d->processFrames(channelFrames);
+            }, Qt::QueuedConnection);
+        }
+    });
+
+    d->framesWrittenConnection = connect(device, &QCanBusDevice::framesWritten, this, [d]() {
+        if (d->transmitState == QCanIsoTpChannelPrivate::SendingConsecutiveFrames
+                && d->transmitSeparationTime == 0) {
+            d->scheduleWrite();
+        }
+    });
+}
+
+/*!
+    Returns the device the channel is attached to, or \c nullptr.
+*/
+QCanBusDevice *QCanIsoTpChannel::device() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->device;
+}
+
+/*!
+    Sets the identifier of the frames the channel writes to \a frameId.
+    The default is \c 0x7E0.
+*/
+void QCanIsoTpChannel::setTransmitFrameId(QCanBusFrame::FrameId frameId)
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->transmitId = frameId;
+}
+
+/*!
+    Returns the identifier of the frames the channel writes.
+*/
+QCanBusFrame::FrameId QCanIsoTpChannel::transmitFrameId() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->transmitId;
+}
+
+/*!
+    Sets the identifier of the frames the channel receives, including the
+    flow control frames for its own messages, to \a frameId. The default
+    is \c 0x7E8.
+*/
+void QCanIsoTpChannel::setReceiveFrameId(QCanBusFrame::FrameId frameId)
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->receiveId = frameId;
+    d->updateReceiveKey();
+}
+
+/*!
+    Returns the identifier of the frames the channel receives.
+*/
+QCanBusFrame::FrameId QCanIsoTpChannel::receiveFrameId() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->receiveId;
+}
+
+/*!
+    Sets whether the frame identifiers of the channel are in extended frame
+    format to \a isExtended. The default is \c false.
+*/
+void QCanIsoTpChannel::setExtendedFrameFormat(bool isExtended)
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->extendedFrameFormat = isExtended;
+    d->updateReceiveKey();
+}
+
+/*!
+    Returns \c true if the frame identifiers of the channel are in extended
+    frame format.
+*/
+bool QCanIsoTpChannel::hasExtendedFrameFormat() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->extendedFrameFormat;
+}
+
+/*!
+    Sets whether the channel writes CAN FD frames to \a isFlexibleData.
+    CAN FD frames carry up to 64 bytes of the message. The device must have
+    QCanBusDevice::CanFdKey enabled. The setting applies from the next
+    message on. The default is \c false.
+*/
+void QCanIsoTpChannel::setFlexibleDataRateFormat(bool isFlexibleData)
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->flexibleDataRate = isFlexibleData;
+}
+
+/*!
+    Returns \c true if the channel writes CAN FD frames.
+*/
+bool QCanIsoTpChannel::hasFlexibleDataRateFormat() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->flexibleDataRate;
+}
+
+/*!
+    Sets whether the CAN FD frames of the channel are sent with the data
+    bit rate to \a bitrateSwitch. The default is \c false.
+*/
+void QCanIsoTpChannel::setBitrateSwitch(bool bitrateSwitch)
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->bitrateSwitch = bitrateSwitch;
+}
+
+/*!
+    Returns \c true if the CAN FD frames of the channel are sent with the
+    data bit rate.
+*/
+bool QCanIsoTpChannel::hasBitrateSwitch() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->bitrateSwitch;
+}
+
+/*!
+    Sets whether short frames are filled up to 8 bytes with paddingByte()
+    to \a enabled. CAN FD frames longer than 8 bytes are always filled up
+    to the next valid CAN FD length. The default is \c true.
+*/
+void QCanIsoTpChannel::setPaddingEnabled(bool enabled)
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->padding = enabled;
+}
+
+/*!
+    Returns \c true if short frames are filled up to 8 bytes.
+*/
+bool QCanIsoTpChannel::isPaddingEnabled() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->padding;
+}
+
+/*!
+    Sets the byte the frames are filled up with to \a value. The default
+    is \c 0xCC.
+*/
+void QCanIsoTpChannel::setPaddingByte(quint8 value)
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->paddingByte = value;
+}
+
+/*!
+    Returns the byte the frames are filled up with.
+*/
+quint8 QCanIsoTpChannel::paddingByte() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->paddingByte;
+}
+
+/*!
+    Sets the number of consecutive frames the sender may send before it
+    waits for the next flow control frame of the channel to \a blockSize,
+    which is limited to 0..255. The default 0 lets the sender send the
+    whole message at once.
+*/
+void QCanIsoTpChannel::setBlockSize(int blockSize)
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->blockSize = qBound(0, blockSize, 255);
+}
+
+/*!
+    Returns the block size the channel requests from senders.
+*/
+int QCanIsoTpChannel::blockSize() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->blockSize;
+}
+
+/*!
+    Sets the minimum time between the consecutive frames of a sender to
+    \a microseconds. The protocol transports times from 100 to 900
+    microseconds in steps of 100 microseconds, and from 1 to 127
+    milliseconds in steps of one millisecond; other times are rounded up.
+    The default is 0.
+*/
+void QCanIsoTpChannel::setSeparationTime(int microseconds)
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->separationTime = QCanIsoTpChannelPrivate::decodeSeparationTime(
+                QCanIsoTpChannelPrivate::encodeSeparationTime(microseconds));
+}
+
+/*!
+    Returns the minimum time between consecutive frames the channel
+    requests from senders, in microseconds.
+*/
+int QCanIsoTpChannel::separationTime() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->separationTime;
+}
+
+/*!
+    Sets the time the channel waits for a flow control frame or the next
+    consecutive frame to \a msecs. The default is 1000 milliseconds.
+*/
+void QCanIsoTpChannel::setTimeout(int msecs)
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->timeout = qMax(msecs, 1);
+}
+
+/*!
+    Returns the time the channel waits for a flow control frame or the next
+    consecutive frame in milliseconds.
+*/
+int QCanIsoTpChannel::timeout() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->timeout;
+}
+
+/*!
+    Sets the size of the longest message the channel receives to \a size.
+    As the buffer of a message is allocated when its first frame is
+    received, the size limits the memory the other side can claim. The
+    default is 16 MiB.
+*/
+void QCanIsoTpChannel::setMaximumMessageSize(qint64 size)
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->maximumMessageSize = qBound(Q_INT64_C(0), size,
+                                   qint64(QCanIsoTpChannelPrivate::MaximumMessageLength));
+}
+
+/*!
+    Returns the size of the longest message the channel receives.
+*/
+qint64 QCanIsoTpChannel::maximumMessageSize() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->maximumMessageSize;
+}
+
+/*!
+    Queues \a message for transmission and returns \c true. Returns
+    \c false if \a message is empty or longer than 4294967295 bytes, or if
+    the device is not connected.
+
+    \sa messageSent(), messagesToSend()
+*/
+bool QCanIsoTpChannel::sendMessage(const QByteArray &message)
+{
+    Q_D(QCanIsoTpChannel);
+
+    if (Q_UNLIKELY(message.isEmpty()
+                   || message.size() > qsizetype(QCanIsoTpChannelPrivate::MaximumMessageLength))) {
+        d->setError(WriteError, tr("Cannot send an empty message or a message "
+                                   "longer than 4294967295 bytes."));
+        return false;
+    }
+    if (Q_UNLIKELY(!d->device || d->device->state() != QCanBusDevice::ConnectedState)) {
+        d->setError(WriteError, tr("Cannot send a message without a connected device."));
+        return false;
+    }
+
+    d->pendingMessages.append(message);
+    if (d->transmitState == QCanIsoTpChannelPrivate::Idle)
+        d->startTransmission();
+    return true;
+}
+
+/*!
+    Returns the number of messages that are not sent completely yet.
+*/
+qsizetype QCanIsoTpChannel::messagesToSend() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->pendingMessages.size();
+}
+
+/*!
+    Gives up all messages in transfer, and the messages waiting to be sent.
+*/
+void QCanIsoTpChannel::abort()
+{
+    Q_D(QCanIsoTpChannel);
+
+    d->flowControlTimer->stop();
+    d->separationTimer->stop();
+    d->receiveTimer->stop();
+    d->pendingMessages.clear();
+    d->transmitState = QCanIsoTpChannelPrivate::Idle;
+    d->receiveBuffer = QByteArray();
+}
+
+/*!
+    Returns the last error.
+
+    \sa errorString(), errorOccurred()
+*/
+QCanIsoTpChannel::ChannelError QCanIsoTpChannel::error() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->lastError;
+}
+
+/*!
+    Returns a human-readable description of the last error.
+
+    \sa error()
+*/
+QString QCanIsoTpChannel::errorString() const
+{
+    Q_D(const QCanIsoTpChannel);
+
+    return d->errorText;
+}
+
+// the smallest valid CAN FD payload length that holds length bytes
+qsizetype QCanIsoTpChannelPrivate::flexibleDataRateLength(qsizetype length)
+{
+    static constexpr qsizetype lengths[] = {8, 12, 16, 20, 24, 32, 48, 64};
+
+    if (length <= ClassicDataLength)
+        return length;
+    for (qsizetype valid : lengths) {
+        if (valid >= length)
+            return valid;
+    }
+    return FlexibleDataLength;
+}
+
+// STmin: 0x00..0x7F milliseconds, 0xF1..0xF9 100..900 microseconds
+quint8 QCanIsoTpChannelPrivate::encodeSeparationTime(int microseconds)
+{
+    if (microseconds <= 0)
+        return 0;
+    if (microseconds <= 900)
+        return quint8(0xF0 + (microseconds + 99) / 100);
+    return quint8(qMin((microseconds + 999) / 1000, 0x7F));
+}
+
+int QCanIsoTpChannelPrivate::decodeSeparationTime(quint8 value)
+{
+    if (value <= 0x7F)
+        return value * 1000;
+    if (value >= 0xF1 && value <= 0xF9)
+        return (value - 0xF0) * 100;
+    return 0x7F * 1000; // reserved values are treated as the longest time
+}
+
+void QCanIsoTpChannelPrivate::updateReceiveKey()
+{
+    receiveKey.store(key(receiveId, extendedFrameFormat), std::memory_order_relaxed);
+}
+
+QCanBusFrame QCanIsoTpChannelPrivate::makeFrame(QByteArray &&payload) const
+{
+    qsizetype length = payload.size();
+    if (padding)
+        length = qMax(length, qsizetype(ClassicDataLength));
+    if (flexibleDataRate)
+        length = flexibleDataRateLength(length);
+    if (payload.size() < length)
+        payload.append(length - payload.size(), char(paddingByte));
+
+    QCanBusFrame frame(transmitId, payload);
+    frame.setExtendedFrameFormat(extendedFrameFormat);
+    if (flexibleDataRate) {
+        frame.setFlexibleDataRateFormat(true);
+        frame.setBitrateSwitch(bitrateSwitch);
+    }
+    return frame;
+}
+
+bool QCanIsoTpChannelPrivate::writeFrames(const QList<QCanBusFrame> &frames)
+{
+    if (Q_UNLIKELY(!device || device->writeFrames(frames) != frames.size())) {
+        abortTransmission(QCanIsoTpChannel::WriteError,
+                          QCanIsoTpChannel::tr("Cannot write the frames of the message: %1")
+                          .arg(device ? device->errorString() : QString()));
+        return false;
+    }
+    return true;
+}
+
+void QCanIsoTpChannelPrivate::setError(QCanIsoTpChannel::ChannelError error,
+                                       const QString &errorText)
+{
+    Q_Q(QCanIsoTpChannel);
+
+    lastError = error;
+    this->errorText = errorText;
+    emit q->errorOccurred(error);
+}
+
+void QCanIsoTpChannelPrivate::detach()
+{
+    if (device) {
+        QCanBusDevicePrivate::get(device)->removeFrameObserver(this);
+        QObject::disconnect(framesWrittenConnection);
+    }
+    device.clear();
+}
+
+void QCanIsoTpChannelPrivate::processFrames(const QList<QCanBusFrame> &frames)
+{
+    for (const QCanBusFrame &frame : frames) {
+        const QByteArray payload = frame.payload();
+        if (payload.isEmpty())
+            continue;
+
+        switch (quint8(payload.at(0)) >> 4) {
+        case SingleFrame:
+            receiveSingleFrame(payload);
+            break;
+        case FirstFrame:
+            receiveFirstFrame(payload);
+            break;
+        case ConsecutiveFrame:
+            receiveConsecutiveFrame(payload);
+            break;
+        case FlowControlFrame:
+            receiveFlowControl(payload);
+            break;
+        default:
+            break; // ignored, see ISO 15765-2
+        }
+    }
+}
+
+void QCanIsoTpChannelPrivate::receiveSingleFrame(const QByteArray &payload)
+{
+    Q_Q(QCanIsoTpChannel);
+
+    // CAN FD frames longer than 8 bytes have the length in the second byte
+    qsizetype length = payload.at(0) & 0x0F;
+    qsizetype offset = 1;
+    if (length == 0 && payload.size() > ClassicDataLength) {
+        length = quint8(payload.at(1));
+        offset = 2;
+    }
+    if (length == 0 || offset + length > payload.size())
+        return;
+
+    if (isReceiving()) {
+        abortReception(QCanIsoTpChannel::ProtocolError,
+                       QCanIsoTpChannel::tr("The message was interrupted by a new message."));
+    }
+    emit q->messageReceived(payload.mid(offset, length));
+}
+
+void QCanIsoTpChannelPrivate::receiveFirstFrame(const QByteArray &payload)
+{
+    Q_Q(QCanIsoTpChannel);
+
+    if (payload.size() < ClassicDataLength)
+        return;
+
+    // messages longer than 4095 bytes have a 32 bit length
+    qint64 length = ((payload.at(0) & 0x0F) << 8) | quint8(payload.at(1));
+    qsizetype offset = 2;
+    if (length == 0) {
+        length = qFromBigEndian<quint32>(payload.constData() + 2);
+        offset = 6;
+    }
+    if (length < ClassicDataLength)
+        return;
+
+    if (isReceiving()) {
+        abortReception(QCanIsoTpChannel::ProtocolError,
+                       QCanIsoTpChannel::tr("The message was interrupted by a new message."));
+    }
+    if (length > maximumMessageSize) {
+        sendFlowControl(Overflow);
+        setError(QCanIsoTpChannel::OverflowError,
+                 QCanIsoTpChannel::tr("Cannot receive a message of %1 bytes.").arg(length));
+        return;
+    }
+
+    receiveBuffer = QByteArray(qsizetype(length), Qt::Uninitialized);
+    receivedBytes = qMin(qsizetype(length), payload.size() - offset);
+    ::memcpy(receiveBuffer.data(), payload.constData() + offset, size_t(receivedBytes));
+    receiveSequence = 1;
+    receiveBlockCount = 0;
+
+    if (receivedBytes == receiveBuffer.size()) {
+        emit q->messageReceived(std::exchange(receiveBuffer, QByteArray()));
+        return;
+    }
+
+    sendFlowControl(ContinueToSend);
+    receiveTimer->start(timeout);
+}
+
+void QCanIsoTpChannelPrivate::receiveConsecutiveFrame(const QByteArray &payload)
+{
+    Q_Q(QCanIsoTpChannel);
+
+    if (!isReceiving())
+        return;
+
+    const quint8 sequence = payload.at(0) & 0x0F;
+    if (sequence != receiveSequence) {
+        abortReception(QCanIsoTpChannel::SequenceError,
+                       QCanIsoTpChannel::tr("Received consecutive frame %1 instead of %2.")
+                       .arg(int(sequence)).arg(int(receiveSequence)));
+        return;
+    }
+    receiveSequence = (receiveSequence + 1) & 0x0F;
+
+    const qsizetype length = qMin(receiveBuffer.size() - receivedBytes, payload.size() - 1);
+    ::memcpy(receiveBuffer.data() + receivedBytes, payload.constData() + 1, size_t(length));
+    receivedBytes += length;
+
+    if (receivedBytes == receiveBuffer.size()) {
+        receiveTimer->stop();
+        emit q->messageReceived(std::exchange(receiveBuffer, QByteArray()));
+        return;
+    }
+
+    if (blockSize > 0 && ++receiveBlockCount == blockSize) {
+        receiveBlockCount = 0;
+        sendFlowControl(ContinueToSend);
+    }
+    receiveTimer->start(timeout);
+}
+
+void QCanIsoTpChannelPrivate::receiveFlowControl(const QByteArray &payload)
+{
+    if (transmitState != WaitForFlowControl || payload.size() < 3)
+        return;
+
+    switch (payload.at(0) & 0x0F) {
+    case ContinueToSend:
+        flowControlTimer->stop();
+        transmitBlockSize = quint8(payload.at(1));
+        transmitBlockRemaining = transmitBlockSize;
+        transmitSeparationTime = decodeSeparationTime(quint8(payload.at(2)));
+        transmitState = SendingConsecutiveFrames;
+        writeConsecutiveFrames();
+        break;
+    case Wait:
+        flowControlTimer->start(timeout);
+        break;
+    case Overflow:
+        abortTransmission(QCanIsoTpChannel::OverflowError,
+                          QCanIsoTpChannel::tr("The receiver cannot take a message of %1 bytes.")
+                          .arg(pendingMessages.constFirst().size()));
+        break;
+    default:
+        abortTransmission(QCanIsoTpChannel::ProtocolError,
+                          QCanIsoTpChannel::tr("Received a flow control frame with the "
+                                               "invalid flow status %1.")
+                          .arg(payload.at(0) & 0x0F));
+        break;
+    }
+}
+
+void QCanIsoTpChannelPrivate::sendFlowControl(FlowStatus status)
+{
+    QByteArray payload(3, Qt::Uninitialized);
+    payload[0] = char((FlowControlFrame << 4) | status);
+    payload[1] = char(blockSize);
+    payload[2] = char(encodeSeparationTime(separationTime));
+
+    if (Q_UNLIKELY(!device || !device->writeFrame(makeFrame(std::move(payload))))) {
+        abortReception(QCanIsoTpChannel::WriteError,
+                       QCanIsoTpChannel::tr("Cannot write the flow control frame: %1")
+                       .arg(device ? device->errorString() : QString()));
+    }
+}
+
+void QCanIsoTpChannelPrivate::abortReception(QCanIsoTpChannel::ChannelError error,
+                                             const QString &errorText)
+{
+    receiveTimer->stop();
+    receiveBuffer = QByteArray();
+    setError(error, errorText);
+}
+
+void QCanIsoTpChannelPrivate::startTransmission()
+{
+    const QByteArray &message = pendingMessages.constFirst();
+    const qsizetype dataLength = transmitDataLength();
+
+    // CAN FD frames longer than 8 bytes have the length in the second byte
+    const qsizetype singleFrameLength = dataLength > ClassicDataLength ? dataLength - 2 : 7;
+    if (message.size() <= singleFrameLength) {
+        QByteArray payload;
+        payload.reserve(message.size() + 2);
+        if (message.size() <= 7) {
+            payload.append(char((SingleFrame << 4) | message.size()));
+        } else {
+            payload.append(char(SingleFrame << 4));
+            payload.append(char(message.size()));
+        }
+        payload.append(message);
+        if (writeFrames({makeFrame(std::move(payload))}))
+            finishTransmission();
+        return;
+    }
+
+    QByteArray payload;
+    payload.reserve(dataLength);
+    if (message.size() <= MaximumShortLength) {
+        payload.append(char((FirstFrame << 4) | (message.size() >> 8)));
+        payload.append(char(message.size()));
+    } else {
+        payload.append(char(FirstFrame << 4));
+        payload.append(char(0));
+        payload.resize(6);
+        qToBigEndian<quint32>(quint32(message.size()), payload.data() + 2);
+    }
+    transmitOffset = dataLength - payload.size();
+    payload.append(message.constData(), transmitOffset);
+    transmitSequence = 1;
+
+    transmitState = WaitForFlowControl;
+    if (writeFrames({makeFrame(std::move(payload))}))
+        flowControlTimer->start(timeout);
+}
+
+QCanBusFrame QCanIsoTpChannelPrivate::takeConsecutiveFrame()
+{
+    const QByteArray &message = pendingMessages.constFirst();
+    const qsizetype length = qMin(transmitDataLength() - 1, message.size() - transmitOffset);
+
+    QByteArray payload;
+    payload.reserve(length + 1);
+    payload.append(char((ConsecutiveFrame << 4) | transmitSequence));
+    payload.append(message.constData() + transmitOffset, length);
+
+    transmitOffset += length;
+    transmitSequence = (transmitSequence + 1) & 0x0F;
+    if (transmitBlockSize > 0)
+        --transmitBlockRemaining;
+    return makeFrame(std::move(payload));
+}
+
+/*
+    Writes the consecutive frames of the current block. Without separation
+    time, the frames are written in batches while the write buffer of the
+    device is not filled up to PipelineDepth, and the event loop runs between
+    the batches. With separation time, one frame is written per expiry of
+    the separation timer.
+*/
+void QCanIsoTpChannelPrivate::writeConsecutiveFrames()
+{
+    if (transmitState != SendingConsecutiveFrames || !device)
+        return;
+
+    const bool paced = transmitSeparationTime > 0;
+    if (!paced && device->framesToWrite() >= PipelineDepth)
+        return; // continued by QCanBusDevice::framesWritten()
+
+    const qsizetype messageSize = pendingMessages.constFirst().size();
+    const qsizetype batchSize = paced ? 1 : WriteBatchSize;
+    QList<QCanBusFrame> batch;
+    batch.reserve(batchSize);
+    while (batch.size() < batchSize && transmitOffset < messageSize
+           && (transmitBlockSize == 0 || transmitBlockRemaining > 0)) {
+        batch.append(takeConsecutiveFrame());
+    }
+    if (!writeFrames(batch))
+        return;
+
+    if (transmitOffset == messageSize) {
+        finishTransmission();
+    } else if (transmitBlockSize > 0 && transmitBlockRemaining == 0) {
+        transmitState = WaitForFlowControl;
+        flowControlTimer->start(timeout);
+    } else if (paced) {
+        separationTimer->start((transmitSeparationTime + 999) / 1000);
+    } else {
+        scheduleWrite();
+    }
+}
+
+void QCanIsoTpChannelPrivate::scheduleWrite()
+{
+    Q_Q(QCanIsoTpChannel);
+
+    if (writeScheduled)
+        return;
+
+    writeScheduled = true;
+    QMetaObject::invokeMethod(q, [this]() {
+        writeScheduled = false;
+        writeConsecutiveFrames();
+    }, Qt::QueuedConnection);
+}
+
+void QCanIsoTpChannelPrivate::finishTransmission()
+{
+    Q_Q(QCanIsoTpChannel);
+
+    const qint64 size = pendingMessages.takeFirst().size();
+    transmitState = Idle;
+    emit q->messageSent(size);
+    scheduleNextTransmission();
+}
+
+void QCanIsoTpChannelPrivate::abortTransmission(QCanIsoTpChannel::ChannelError error,
+                                                const QString &errorText)
+{
+    flowControlTimer->stop();
+    separationTimer->stop();
+    if (!pendingMessages.isEmpty())
+        pendingMessages.removeFirst();
+    transmitState = Idle;
+    setError(error, errorText);
+    scheduleNextTransmission();
+}
+
+// Messages sent from slots of messageSent() are started directly by sendMessage().
+void QCanIsoTpChannelPrivate::scheduleNextTransmission()
+{
+    Q_Q(QCanIsoTpChannel);
+
+    if (pendingMessages.isEmpty())
+        return;
+
+    QMetaObject::invokeMethod(q, [this]() {
+        if (transmitState == Idle && !pendingMessages.isEmpty())
+            startTransmission();
+    }, Qt::QueuedConnection);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,118 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANISOTPCHANNEL_H
+#define QCANISOTPCHANNEL_H
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qobject.h>
+#include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qtserialbusglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+class QCanBusDevice;
+class QCanIsoTpChannelPrivate;
+
+class Q_SERIALBUS_EXPORT QCanIsoTpChannel : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(QCanIsoTpChannel)
+
+public:
+    enum ChannelError {
+        NoError,
+        WriteError,
+        TimeoutError,
+        SequenceError,
+        OverflowError,
+        ProtocolError
+    };
+    Q_ENUM(ChannelError)
+
+    explicit QCanIsoTpChannel(QObject *parent = nullptr);
+    ~QCanIsoTpChannel() override;
+
+    void setDevice(QCanBusDevice *device);
+    QCanBusDevice *device() const;
+
+    void setTransmitFrameId(QCanBusFrame::FrameId frameId);
+    QCanBusFrame::FrameId transmitFrameId() const;
+    void setReceiveFrameId(QCanBusFrame::FrameId frameId);
+    QCanBusFrame::FrameId receiveFrameId() const;
+    void setExtendedFrameFormat(bool isExtended);
+    bool hasExtendedFrameFormat() const;
+
+    void setFlexibleDataRateFormat(bool isFlexibleData);
+    bool hasFlexibleDataRateFormat() const;
+    void setBitrateSwitch(bool bitrateSwitch);
+    bool hasBitrateSwitch() const;
+    void setPaddingEnabled(bool enabled);
+    bool isPaddingEnabled() const;
+    void setPaddingByte(quint8 value);
+    quint8 paddingByte() const;
+
+    void setBlockSize(int blockSize);
+    int blockSize() const;
+    void setSeparationTime(int microseconds);
+    int separationTime() const;
+    void setTimeout(int msecs);
+    int timeout() const;
+    void setMaximumMessageSize(qint64 size);
+    qint64 maximumMessageSize() const;
+
+    bool sendMessage(const QByteArray &message);
+    qsizetype messagesToSend() const;
+    void abort();
+
+    ChannelError error() const;
+    QString errorString() const;
+
+Q_SIGNALS:
+    void messageReceived(const QByteArray &message);
+    void messageSent(qint64 size);
+    void errorOccurred(QCanIsoTpChannel::ChannelError error);
+
+private:
+    Q_DISABLE_COPY(QCanIsoTpChannel)
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANISOTPCHANNEL_H
@@ -0,0 +1,177 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCANISOTPCHANNEL_P_H
+#define QCANISOTPCHANNEL_P_H
+
+#include <QtSerialBus/qcanisotpchannel.h>
+
+#include <QtCore/qlist.h>
+#include <QtCore/qpointer.h>
+
+#include <private/qobject_p.h>
+
+#include <atomic>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QTimer;
+
+class QCanIsoTpChannelPrivate : public QObjectPrivate
+{
+    Q_DECLARE_PUBLIC(QCanIsoTpChannel)
+public:
+    // the upper nibble of the first payload byte, the protocol control information
+    enum FrameType : quint8 {
+        SingleFrame = 0x0,
+        FirstFrame = 0x1,
+        ConsecutiveFrame = 0x2,
+        FlowControlFrame = 0x3
+    };
+    enum FlowStatus : quint8 {
+        ContinueToSend = 0x0,
+        Wait = 0x1,
+        Overflow = 0x2
+    };
+    enum TransmitState {
+        Idle,
+        WaitForFlowControl,
+        SendingConsecutiveFrames
+    };
+
+    enum : qint64 {
+        ClassicDataLength = 8,
+        FlexibleDataLength = 64,
+        MaximumShortLength = 0xFFF, // longer messages use the 32 bit length of the first frame
+        MaximumMessageLength = 0xFFFFFFFF,
+        DefaultMaximumMessageSize = 16 * 1024 * 1024,
+        DefaultTimeout = 1000, // ms, N_Bs and N_Cr of ISO 15765-2
+        WriteBatchSize = 64,
+        PipelineDepth = 128 // frames in the write buffer of the device
+    };
+
+    static quint32 key(QCanBusFrame::FrameId frameId, bool extendedFrameFormat)
+    {
+        return frameId | (extendedFrameFormat ? 0x80000000U : 0U);
+    }
+    static qsizetype flexibleDataRateLength(qsizetype length);
+    static quint8 encodeSeparationTime(int microseconds);
+    static int decodeSeparationTime(quint8 value);
+
+    qsizetype transmitDataLength() const
+    {
+        return flexibleDataRate ? FlexibleDataLength : ClassicDataLength;
+    }
+    void updateReceiveKey();
+    QCanBusFrame makeFrame(QByteArray &&payload) const;
+    bool writeFrames(const QList<QCanBusFrame> &frames);
+    void setError(QCanIsoTpChannel::ChannelError error, const QString &errorText);
+    void detach();
+
+    void processFrames(const QList<QCanBusFrame> &frames);
+    void receiveSingleFrame(const QByteArray &payload);
+    void receiveFirstFrame(const QByteArray &payload);
+    void receiveConsecutiveFrame(const QByteArray &payload);
+    void receiveFlowControl(const QByteArray &payload);
+    void sendFlowControl(FlowStatus status);
+    void abortReception(QCanIsoTpChannel::ChannelError error, const QString &errorText);
+    bool isReceiving() const { return !receiveBuffer.isEmpty(); }
+
+    void startTransmission();
+    QCanBusFrame takeConsecutiveFrame();
+    void writeConsecutiveFrames();
+    void scheduleWrite();
+    void finishTransmission();
+    void abortTransmission(QCanIsoTpChannel::ChannelError error, const QString &errorText);
+    void scheduleNextTransmission();
+
+    QPointer<QCanBusDevice> device;
+    QMetaObject::Connection framesWrittenConnection;
+
+    QCanBusFrame::FrameId transmitId = 0x7E0;
+    QCanBusFrame::FrameId receiveId = 0x7E8;
+    bool extendedFrameFormat = false;
+    bool flexibleDataRate = false;
+    bool bitrateSwitch = false;
+    bool padding = true;
+    quint8 paddingByte = 0xCC;
+    int blockSize = 0;
+    int separationTime = 0; // microseconds
+    int timeout = DefaultTimeout;
+    qint64 maximumMessageSize = DefaultMaximumMessageSize;
+    // read by the frame observer, which may run in the I/O thread of the device
+    std::atomic<quint32> receiveKey = 0;
+
+    // the first of the pending messages is being sent
+    QList<QByteArray> pendingMessages;
+    TransmitState transmitState = Idle;
+    qsizetype transmitOffset = 0;
+    quint8 transmitSequence = 0;
+    int transmitBlockSize = 0; // from the flow control of the receiver, 0 for no limit
+    int transmitBlockRemaining = 0;
+    int transmitSeparationTime = 0; // microseconds, from the flow control of the receiver
+    bool writeScheduled = false;
+    QTimer *flowControlTimer = nullptr; // N_Bs
+    QTimer *separationTimer = nullptr;
+
+    // the message is reassembled in place, the buffer is allocated by the first frame
+    QByteArray receiveBuffer;
+    qsizetype receivedBytes = 0;
+    quint8 receiveSequence = 0;
+    int receiveBlockCount = 0;
+    QTimer *receiveTimer = nullptr; // N_Cr
+
+    QCanIsoTpChannel::ChannelError lastError = QCanIsoTpChannel::NoError;
+    QString errorText;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCANISOTPCHANNEL_P_H
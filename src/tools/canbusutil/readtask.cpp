@@ -65,37 +65,42 @@ void ReadTask::handleFrames() {
         return;
     }
 
-    while (canDevice->framesAvailable()) {
-        const QCanBusFrame frame = canDevice->readFrame();
+    qint64 count;
+    while ((count = canDevice->readFrames(m_frames.data(), m_frames.size())) > 0) {
+        for (qint64 i = 0; i < count; ++i)
+            printFrame(canDevice, m_frames.at(i));
+    }
+}
 
-        QString view;
+void ReadTask::printFrame(QCanBusDevice *canDevice, const QCanBusFrame &frame)
+{
+    QString view;
 
-        if (m_showTimeStamp) {
-            view = QStringLiteral("%1.%2  ")
-                    .arg(frame.timeStamp().seconds(), 10, 10, QLatin1Char(' '))
-                    .arg(frame.timeStamp().microSeconds() / 100, 4, 10, QLatin1Char('0'));
-        }
+    if (m_showTimeStamp) {
+        view = QStringLiteral("%1.%2  ")
+                .arg(frame.timeStamp().seconds(), 10, 10, QLatin1Char(' '))
+                .arg(frame.timeStamp().microSeconds() / 100, 4, 10, QLatin1Char('0'));
+    }
 
-        if (m_showFlags) {
-            QLatin1String flags("- - -  ");
+    if (m_showFlags) {
+        QLatin1String flags("- - -  ");
 
-            if (frame.hasBitrateSwitch())
-                flags[0] = QLatin1Char('B');
-            if (frame.hasErrorStateIndicator())
-                flags[2] = QLatin1Char('E');
-            if (frame.hasLocalEcho())
-                flags[4] = QLatin1Char('L');
+        if (frame.hasBitrateSwitch())
+            flags[0] = QLatin1Char('B');
+        if (frame.hasErrorStateIndicator())
+            flags[2] = QLatin1Char('E');
+        if (frame.hasLocalEcho())
+            flags[4] = QLatin1Char('L');
 
-            view += flags;
-        }
+        view += flags;
+    }
 
-        if (frame.frameType() == QCanBusFrame::ErrorFrame)
-            view += canDevice->interpretErrorFrame(frame);
-        else
-            view += frame.toString();
+    if (frame.frameType() == QCanBusFrame::ErrorFrame)
+        view += canDevice->interpretErrorFrame(frame);
+    else
+        view += frame.toString();
 
-        m_output << view << Qt::endl;
-    }
+    m_output << view << Qt::endl;
 }
 
 void ReadTask::handleError(QCanBusDevice::CanBusError /*error*/)
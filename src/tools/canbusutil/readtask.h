@@ -58,7 +58,12 @@ public slots:
     void handleError(QCanBusDevice::CanBusError /*error*/);
 
 private:
+    void printFrame(QCanBusDevice *canDevice, const QCanBusFrame &frame);
+
+    enum { ReadBatchSize = 64 };
+
     QTextStream &m_output;
+    QList<QCanBusFrame> m_frames = QList<QCanBusFrame>(ReadBatchSize);
     bool m_showTimeStamp = false;
     bool m_showFlags = false;
 };
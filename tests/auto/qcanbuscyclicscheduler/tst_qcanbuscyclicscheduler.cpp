@@ -0,0 +1,203 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <private/qcanbuscyclicscheduler_p.h>
+
+#include <QtTest/QtTest>
+
+static QList<quint64> dueTicks(const QList<QCanBusCyclicScheduler::Due> &due)
+{
+    QList<quint64> ticks;
+    for (const QCanBusCyclicScheduler::Due &entry : due)
+        ticks.append(entry.tick);
+    return ticks;
+}
+
+class tst_QCanBusCyclicScheduler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void periods();
+    void nextExpiry();
+    void longPeriods();
+    void missedCycles();
+    void updateAndRemove();
+    void takeSchedule();
+    void spreadFirstTick();
+};
+
+void tst_QCanBusCyclicScheduler::periods()
+{
+    QCanBusCyclicScheduler scheduler;
+    QVERIFY(scheduler.isEmpty());
+    scheduler.add(1, QCanBusFrame(0x100, "a"), 10, 0);
+    scheduler.add(2, QCanBusFrame(0x200, "b"), 25, 5);
+    QCOMPARE(scheduler.size(), qsizetype(2));
+
+    QList<quint64> ticks;
+    for (quint64 tick = 0; tick <= 60; ++tick)
+        ticks += dueTicks(scheduler.advance(tick));
+    QCOMPARE(ticks, (QList<quint64>{0, 5, 10, 20, 30, 30, 40, 50, 55, 60}));
+    QCOMPARE(scheduler.currentTick(), quint64(61));
+}
+
+void tst_QCanBusCyclicScheduler::nextExpiry()
+{
+    QCanBusCyclicScheduler scheduler;
+    QCOMPARE(scheduler.nextExpiry(), QCanBusCyclicScheduler::NoExpiry);
+
+    scheduler.add(1, QCanBusFrame(0x100, "a"), 10, 3);
+    QCOMPARE(scheduler.nextExpiry(), quint64(3));
+    QCOMPARE(scheduler.advance(3).size(), qsizetype(1));
+    QCOMPARE(scheduler.nextExpiry(), quint64(13));
+
+    // frames due in a later block wake the scheduler at the beginning of the block
+    QCanBusCyclicScheduler later;
+    later.add(1, QCanBusFrame(0x100, "a"), 1000, 300);
+    QCOMPARE(later.nextExpiry(), quint64(256));
+    QVERIFY(later.advance(256).isEmpty());
+    QCOMPARE(later.nextExpiry(), quint64(300));
+    QCOMPARE(dueTicks(later.advance(300)), (QList<quint64>{300}));
+    QCOMPARE(later.nextExpiry(), quint64(1280));
+}
+
+void tst_QCanBusCyclicScheduler::longPeriods()
+{
+    QCanBusCyclicScheduler scheduler;
+    scheduler.add(1, QCanBusFrame(0x100, "a"), 100000, 100000);
+    scheduler.add(2, QCanBusFrame(0x200, "b"), 2000000, 2000000);
+
+    QVERIFY(scheduler.advance(99999).isEmpty());
+    QCOMPARE(dueTicks(scheduler.advance(100000)), (QList<quint64>{100000}));
+    QVERIFY(scheduler.advance(199999).isEmpty());
+    QCOMPARE(dueTicks(scheduler.advance(200000)), (QList<quint64>{200000}));
+
+    QList<quint64> ticks;
+    for (quint64 tick = 300000; tick <= 2000000; tick += 100000)
+        ticks += dueTicks(scheduler.advance(tick));
+    QCOMPARE(ticks.size(), qsizetype(19));
+    QCOMPARE(ticks.constLast(), quint64(2000000));
+    QCOMPARE(ticks.count(quint64(2000000)), qsizetype(2));
+}
+
+void tst_QCanBusCyclicScheduler::missedCycles()
+{
+    QCanBusCyclicScheduler scheduler;
+    scheduler.add(1, QCanBusFrame(0x100, "a"), 10, 0);
+    QCOMPARE(dueTicks(scheduler.advance(0)), (QList<quint64>{0}));
+
+    // a late call sends the frame once and keeps the schedule
+    QCOMPARE(dueTicks(scheduler.advance(95)), (QList<quint64>{10}));
+    QCOMPARE(scheduler.nextExpiry(), quint64(100));
+}
+
+void tst_QCanBusCyclicScheduler::updateAndRemove()
+{
+    QCanBusCyclicScheduler scheduler;
+    const int first = 1;
+    const int second = 2;
+    scheduler.add(first, QCanBusFrame(0x100, "old"), 10, 0);
+    scheduler.add(second, QCanBusFrame(0x200, "b"), 10, 0);
+
+    QVERIFY(scheduler.update(first, QCanBusFrame(0x101, "new")));
+    QVERIFY(!scheduler.update(second + 1, QCanBusFrame(0x101, "new")));
+    QList<QCanBusCyclicScheduler::Due> due = scheduler.advance(0);
+    QCOMPARE(due.size(), qsizetype(2));
+    QCOMPARE(due.at(0).frame.frameId(), 0x101u);
+    QCOMPARE(due.at(0).frame.payload(), QByteArray("new"));
+
+    QVERIFY(scheduler.remove(second));
+    QVERIFY(!scheduler.remove(second));
+    due = scheduler.advance(10);
+    QCOMPARE(due.size(), qsizetype(1));
+    QCOMPARE(due.at(0).frame.frameId(), 0x101u);
+
+    scheduler.clear();
+    QVERIFY(scheduler.isEmpty());
+    QVERIFY(scheduler.advance(100).isEmpty());
+    QCOMPARE(scheduler.nextExpiry(), QCanBusCyclicScheduler::NoExpiry);
+}
+
+void tst_QCanBusCyclicScheduler::takeSchedule()
+{
+    QCanBusCyclicScheduler scheduler;
+    scheduler.add(1, QCanBusFrame(0x100, "a"), 10, 3);
+    scheduler.add(2, QCanBusFrame(0x200, "b"), 20, 0);
+    QCOMPARE(dueTicks(scheduler.advance(5)), (QList<quint64>{0, 3}));
+
+    const QList<QCanBusCyclicScheduler::Schedule> schedules = scheduler.schedules();
+    QCOMPARE(schedules.size(), qsizetype(2));
+    const auto first = std::find_if(schedules.cbegin(), schedules.cend(),
+                                    [](const auto &schedule) { return schedule.id == 1; });
+    QVERIFY(first != schedules.cend());
+    QCOMPARE(first->period, quint64(10));
+    QCOMPARE(first->nextTick, quint64(13));
+
+    QVERIFY(scheduler.update(1, QCanBusFrame(0x100, "c")));
+    QCanBusCyclicScheduler::Schedule taken;
+    QVERIFY(scheduler.take(1, &taken));
+    QCOMPARE(taken.frame.payload(), QByteArray("c"));
+    QCOMPARE(taken.nextTick, quint64(13));
+    QVERIFY(taken.revision != first->revision);
+    QVERIFY(!scheduler.take(1, &taken));
+
+    // the taken frame is not due anymore
+    QCOMPARE(dueTicks(scheduler.advance(20)), (QList<quint64>{20}));
+}
+
+void tst_QCanBusCyclicScheduler::spreadFirstTick()
+{
+    QCanBusCyclicScheduler scheduler;
+    QCOMPARE(scheduler.spreadFirstTick(10, 0), quint64(0));
+
+    scheduler.add(1, QCanBusFrame(0x100, "a"), 10, 0);
+    QCOMPARE(scheduler.spreadFirstTick(10, 0), quint64(1));
+
+    // ticks 0 and 1 coincide with one of the frames every 20 ticks
+    scheduler.add(2, QCanBusFrame(0x200, "b"), 20, 1);
+    QCOMPARE(scheduler.spreadFirstTick(10, 0), quint64(2));
+
+    // coprime periods always coincide at some point
+    QCOMPARE(scheduler.spreadFirstTick(7, 0), quint64(0));
+}
+
+QTEST_MAIN(tst_QCanBusCyclicScheduler)
+
+#include "tst_qcanbuscyclicscheduler.moc"
@@ -37,23 +37,33 @@
 **
 ****************************************************************************/
 
+#include <QtSerialBus/qcanbuscycletimeanalyzer.h>
 #include <QtSerialBus/qcanbusdevice.h>
 #include <QtSerialBus/qcanbusframe.h>
+#include <QtSerialBus/qcanbusloadestimator.h>
+#include <QtSerialBus/private/qcanbusdevice_p.h>
+#include <QtSerialBus/private/qcanbusdevicehooks_p.h>
 
+#include <QtCore/qdatetime.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qthread.h>
 #include <QtCore/qtimer.h>
 #include <QtCore/QtPlugin>
 #include <QtTest/qsignalspy.h>
 #include <QtTest/qtest.h>
 
+#include <atomic>
 #include <memory>
+#include <numeric>
 
 Q_DECLARE_METATYPE(QCanBusDevice::Filter)
 
-class tst_Backend : public QCanBusDevice
+class tst_Backend : public QCanBusDevice, private QCanBusDeviceHooks
 {
     Q_OBJECT
 public:
     tst_Backend()
+        : QCanBusDeviceHooks(this)
     {
         referenceFrame.setFrameId(5);
         referenceFrame.setPayload(QByteArray("FOOBAR"));
@@ -72,6 +82,21 @@ public:
         return true;
     }
 
+    void receiveFrames(const QList<QCanBusFrame> &frames)
+    {
+        enqueueReceivedFrames(frames);
+    }
+
+    void emulateHardwareFiltering(bool enabled)
+    {
+        setHardwareFiltering(enabled);
+    }
+
+    using QCanBusDevice::confirmFrame;
+    using QCanBusDevice::dequeueOutgoingFrame;
+    using QCanBusDevice::ioThread;
+    using QCanBusDevice::stopIoThread;
+
     bool open() override
     {
         if (firstOpen) {
@@ -87,7 +112,18 @@ public:
         setState(QCanBusDevice::UnconnectedState);
     }
 
+    bool offloadCyclicFrames = false;
+    QHash<int, QCanBusFrame> cyclicTransmissions;
+    // keys passed to the plugin, ProtocolKey emulates a rejected key
+    QList<QCanBusDevice::ConfigurationKey> pluginKeys;
+    int writeTriggers = 0;
+
     bool writeFrame(const QCanBusFrame &data) override
+    {
+        return writeExpiringFrame(data, NoDeadline);
+    }
+
+    bool writeExpiringFrame(const QCanBusFrame &data, qint64 deadline) override
     {
         if (state() != QCanBusDevice::ConnectedState) {
             setError(QStringLiteral("Cannot write frame as device is not connected"),
@@ -96,9 +132,10 @@ public:
         }
 
         if (writeBufferUsed) {
-            enqueueOutgoingFrame(data);
+            enqueueExpiringFrame(data, deadline);
             QTimer::singleShot(2000, this, [this](){ triggerDelayedWrites(); });
         } else {
+            QCanBusDevicePrivate::get(this)->countWrittenBytes(data.payloadView().size());
             emit framesWritten(1);
         }
         return true;
@@ -141,7 +178,8 @@ public slots:
         if (framesToWrite() == 0)
             return;
 
-        dequeueOutgoingFrame();
+        const QCanBusFrame frame = dequeueOutgoingFrame();
+        QCanBusDevicePrivate::get(this)->countWrittenBytes(frame.payloadView().size());
         emit framesWritten(1);
 
         if (framesToWrite() > 0)
@@ -149,6 +187,40 @@ public slots:
     }
 
 private:
+    bool setPluginConfigurationParameter(ConfigurationKey key, const QVariant &) override
+    {
+        pluginKeys.append(key);
+        return key != QCanBusDevice::ProtocolKey;
+    }
+
+    // emulates a plugin that writes cyclic frames itself
+    bool startCyclicTransmission(int id, const QCanBusFrame &frame, int /*period*/,
+                                 int /*phase*/) override
+    {
+        if (!offloadCyclicFrames)
+            return false;
+        cyclicTransmissions.insert(id, frame);
+        return true;
+    }
+
+    bool updateCyclicTransmission(int id, const QCanBusFrame &frame) override
+    {
+        if (!cyclicTransmissions.contains(id))
+            return false;
+        cyclicTransmissions.insert(id, frame);
+        return true;
+    }
+
+    void stopCyclicTransmission(int id) override
+    {
+        cyclicTransmissions.remove(id);
+    }
+
+    void writeOutgoingFrames() override
+    {
+        ++writeTriggers;
+    }
+
     QCanBusFrame referenceFrame;
     bool firstOpen = true;
     bool writeBufferUsed = true;
@@ -164,8 +236,10 @@ private slots:
     void initTestCase();
     void conf();
     void write();
+    void writeFrames();
     void read();
     void readAll();
+    void readFrames();
     void clearInputBuffer();
     void clearOutputBuffer();
     void error();
@@ -179,6 +253,22 @@ private slots:
     void tst_waitForFramesWritten();
 
     void tst_deviceInfo();
+    void tst_receiveQueueOverflow();
+    void tst_receiveFiltering();
+    void tst_ioThread();
+    void tst_notificationPolicy();
+    void tst_statistics();
+    void tst_lastValueCache();
+    void tst_lastValueCacheConcurrency();
+    void tst_changedFramesOnly();
+    void tst_cycleTimeAnalyzer();
+    void tst_busLoadEstimator();
+    void tst_frameConfirmed();
+    void tst_writeQueuePriority();
+    void tst_transmitShaping();
+    void tst_cyclicFrames();
+    void tst_cyclicFrameOffload();
+    void tst_receiveMonitor();
 private:
     std::unique_ptr<tst_Backend> device;
 };
@@ -238,6 +328,22 @@ void tst_QCanBusDevice::conf()
 
     device->setConfigurationParameter(QCanBusDevice::ErrorFilterKey, QVariant());
     QVERIFY(device->configurationKeys().isEmpty());
+
+    // keys applied by QCanBusDevice do not reach the plugin, rejected keys
+    // are not stored
+    device->pluginKeys.clear();
+    device->setConfigurationParameter(QCanBusDevice::NotificationFrameCountKey, 10);
+    device->setConfigurationParameter(QCanBusDevice::WriteQueuePriorityKey, true);
+    device->setConfigurationParameter(QCanBusDevice::ProtocolKey, 1);
+    QCOMPARE(device->pluginKeys,
+             QList<QCanBusDevice::ConfigurationKey>{QCanBusDevice::ProtocolKey});
+    QCOMPARE(device->configurationKeys(),
+             QList<QCanBusDevice::ConfigurationKey>({QCanBusDevice::NotificationFrameCountKey,
+                                                     QCanBusDevice::WriteQueuePriorityKey}));
+
+    device->setConfigurationParameter(QCanBusDevice::NotificationFrameCountKey, QVariant());
+    device->setConfigurationParameter(QCanBusDevice::WriteQueuePriorityKey, QVariant());
+    QVERIFY(device->configurationKeys().isEmpty());
 }
 
 void tst_QCanBusDevice::write()
@@ -279,6 +385,42 @@ void tst_QCanBusDevice::write()
     QCOMPARE(spy.count(), 1);
 }
 
+void tst_QCanBusDevice::writeFrames()
+{
+    device->setWriteBuffered(false);
+    device->resetStatistics();
+
+    QSignalSpy spy(device.get(), &QCanBusDevice::framesWritten);
+    QSignalSpy errorSpy(device.get(), &QCanBusDevice::errorOccurred);
+
+    const QList<QCanBusFrame> frames = {
+        QCanBusFrame(0x100, QByteArray("abc")),
+        QCanBusFrame(0x101, QByteArray("def")),
+        QCanBusFrame(0x102, QByteArray("ghi"))
+    };
+
+    device->disconnectDevice();
+    QTRY_VERIFY_WITH_TIMEOUT(device->state() == QCanBusDevice::UnconnectedState, 5000);
+
+    QCOMPARE(device->writeFrames(frames), 0);
+    QCOMPARE(device->error(), QCanBusDevice::OperationError);
+    QCOMPARE(errorSpy.count(), 1);
+    QCOMPARE(spy.count(), 0);
+
+    device->connectDevice();
+    QTRY_VERIFY_WITH_TIMEOUT(device->state() == QCanBusDevice::ConnectedState, 5000);
+
+    // the backend emits framesWritten() for every frame it is given
+    QCOMPARE(device->writeFrames(frames), qint64(frames.size()));
+    QCOMPARE(device->error(), QCanBusDevice::NoError);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toLongLong(), qint64(frames.size()));
+    QCOMPARE(device->statistics().writtenFrames(), qint64(frames.size()));
+
+    QCOMPARE(device->writeFrames({}), 0);
+    QCOMPARE(spy.count(), 1);
+}
+
 void tst_QCanBusDevice::read()
 {
     QSignalSpy stateSpy(device.get(), &QCanBusDevice::stateChanged);
@@ -329,6 +471,53 @@ void tst_QCanBusDevice::readAll()
     QVERIFY(!device->framesAvailable());
 }
 
+void tst_QCanBusDevice::readFrames()
+{
+    enum { FrameNumber = 10, BufferSize = 4 };
+    device->disconnectDevice();
+    QTRY_VERIFY_WITH_TIMEOUT(device->state() == QCanBusDevice::UnconnectedState, 5000);
+
+    QCanBusFrame buffer[BufferSize];
+    QCOMPARE(device->readFrames(buffer, BufferSize), 0);
+    QCOMPARE(device->error(), QCanBusDevice::OperationError);
+
+    QVERIFY(device->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(device->state() == QCanBusDevice::ConnectedState, 5000);
+
+    QCOMPARE(device->readFrames(buffer, BufferSize), 0);
+    QCOMPARE(device->error(), QCanBusDevice::NoError);
+
+    for (int i = 0; i < FrameNumber; ++i)
+        device->triggerNewFrame();
+
+    qint64 total = 0;
+    qint64 count;
+    while ((count = device->readFrames(buffer, BufferSize)) > 0) {
+        QVERIFY(count <= BufferSize);
+        for (qint64 i = 0; i < count; ++i) {
+            QVERIFY(buffer[i].isValid());
+            QCOMPARE(buffer[i].payload(), QByteArray("FOOBAR"));
+        }
+        total += count;
+    }
+    QCOMPARE(device->error(), QCanBusDevice::NoError);
+    QCOMPARE(total, FrameNumber);
+    QVERIFY(!device->framesAvailable());
+
+    // more frames than fit into one internal chunk
+    for (int i = 0; i < 100; ++i)
+        device->triggerNewFrame();
+
+    QCanBusFrameBatch batch;
+    QCOMPARE(device->readFrames(batch, BufferSize), BufferSize);
+    QCOMPARE(device->readFrames(batch), 100 - BufferSize);
+    QCOMPARE(batch.size(), 100);
+    QCOMPARE(batch.frameId(99), 5u);
+    QCOMPARE(batch.payload(99).toByteArray(), QByteArray("FOOBAR"));
+    QVERIFY(batch.testFrameFlag(99, QCanBusFrameBatch::ExtendedFrameFormat));
+    QVERIFY(!device->framesAvailable());
+}
+
 void tst_QCanBusDevice::clearInputBuffer()
 {
     device->disconnectDevice();
@@ -749,6 +938,851 @@ void tst_QCanBusDevice::tst_deviceInfo()
     QCOMPARE(info.isVirtual(), true);
 }
 
+void tst_QCanBusDevice::tst_receiveQueueOverflow()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QCOMPARE(canDevice->overflowPolicy(), QCanBusDevice::OverflowPolicy::DropNewest);
+    QCOMPARE(canDevice->receiveQueueCapacity(), 0);
+
+    canDevice->setReceiveQueueCapacity(3);
+    QCOMPARE(canDevice->receiveQueueCapacity(), 4);
+
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+
+    canDevice->setReceiveQueueCapacity(16);
+    QCOMPARE(canDevice->error(), QCanBusDevice::OperationError);
+    QCOMPARE(canDevice->receiveQueueCapacity(), 4);
+
+    QSignalSpy spy(canDevice.get(), &QCanBusDevice::framesReceived);
+    QSignalSpy droppedSpy(canDevice.get(), &QCanBusDevice::framesDropped);
+    for (int i = 0; i < 6; ++i)
+        canDevice->triggerNewFrame();
+    QCOMPARE(spy.count(), 4);
+    QCOMPARE(canDevice->framesAvailable(), 4);
+    QCOMPARE(canDevice->droppedFramesCount(), 2);
+    QCOMPARE(canDevice->receiveQueueHighWaterMark(), 4);
+    QCOMPARE(droppedSpy.count(), 2);
+    QCOMPARE(droppedSpy.at(0).at(0).toLongLong(), 1);
+
+    canDevice->setOverflowPolicy(QCanBusDevice::OverflowPolicy::DropOldest);
+    QCOMPARE(canDevice->overflowPolicy(), QCanBusDevice::OverflowPolicy::DropOldest);
+    canDevice->receiveFrames({QCanBusFrame(0x123, QByteArray("a")),
+                              QCanBusFrame(0x124, QByteArray("b"))});
+    QCOMPARE(canDevice->framesAvailable(), 4);
+    QCOMPARE(canDevice->droppedFramesCount(), 4);
+    QCOMPARE(droppedSpy.count(), 3);
+    QCOMPARE(droppedSpy.at(2).at(0).toLongLong(), 2);
+
+    // blocking is impossible on the device's thread, the new frame is dropped
+    canDevice->setOverflowPolicy(QCanBusDevice::OverflowPolicy::Block);
+    canDevice->triggerNewFrame();
+    QCOMPARE(canDevice->framesAvailable(), 4);
+    QCOMPARE(canDevice->droppedFramesCount(), 5);
+
+    QCOMPARE(canDevice->readAllFrames().size(), 4);
+    QVERIFY(!canDevice->framesAvailable());
+
+    // losses on another thread are announced in the thread of the device
+    canDevice->setOverflowPolicy(QCanBusDevice::OverflowPolicy::DropOldest);
+    std::unique_ptr<QThread> receiver(QThread::create([&canDevice]() {
+        for (int i = 0; i < 6; ++i)
+            canDevice->receiveFrames({QCanBusFrame(0x125, QByteArray("c"))});
+    }));
+    receiver->start();
+    QVERIFY(receiver->wait(5000));
+    QCOMPARE(canDevice->droppedFramesCount(), 7);
+    QCOMPARE(droppedSpy.count(), 3);
+    QTRY_COMPARE(droppedSpy.count(), 4);
+    QCOMPARE(droppedSpy.at(3).at(0).toLongLong(), 2);
+}
+
+void tst_QCanBusDevice::tst_receiveFiltering()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+
+    QCanBusDevice::Filter baseFilter;
+    baseFilter.frameId = 0x100;
+    baseFilter.frameIdMask = 0x700;
+    baseFilter.type = QCanBusFrame::DataFrame;
+    baseFilter.format = QCanBusDevice::Filter::MatchBaseFormat;
+
+    QCanBusDevice::Filter extendedFilter;
+    extendedFilter.frameId = 0x18FEF100;
+    extendedFilter.frameIdMask = 0x1FFFFFFF;
+    extendedFilter.format = QCanBusDevice::Filter::MatchExtendedFormat;
+
+    canDevice->setConfigurationParameter(QCanBusDevice::RawFilterKey,
+                                         QVariant::fromValue(QList<QCanBusDevice::Filter>
+                                                             {baseFilter, extendedFilter}));
+
+    const auto extendedFrame = [](QCanBusFrame::FrameId id) {
+        QCanBusFrame frame(id, QByteArray("ext"));
+        frame.setExtendedFrameFormat(true);
+        return frame;
+    };
+    QCanBusFrame remoteFrame(0x101, QByteArray());
+    remoteFrame.setFrameType(QCanBusFrame::RemoteRequestFrame);
+    QCanBusFrame errorFrame(QCanBusFrame::ErrorFrame);
+    errorFrame.setError(QCanBusFrame::BusError);
+
+    const QList<QCanBusFrame> frames = {
+        QCanBusFrame(0x123, QByteArray("a")),   // accepted
+        QCanBusFrame(0x223, QByteArray("b")),   // wrong id
+        remoteFrame,                            // wrong type
+        extendedFrame(0x18FEF100),              // accepted
+        extendedFrame(0x100),                   // wrong format
+        extendedFrame(0x18FEF101),              // wrong id
+        errorFrame                              // error frames always pass
+    };
+
+    QSignalSpy spy(canDevice.get(), &QCanBusDevice::framesReceived);
+    canDevice->receiveFrames(frames);
+    QCOMPARE(spy.count(), 1);
+
+    QList<QCanBusFrame> received = canDevice->readAllFrames();
+    QCOMPARE(received.size(), 3);
+    QCOMPARE(received.at(0).frameId(), 0x123u);
+    QCOMPARE(received.at(1).frameId(), 0x18FEF100u);
+    QCOMPARE(received.at(2).frameType(), QCanBusFrame::ErrorFrame);
+
+    // all frames rejected, no signal
+    canDevice->receiveFrames({QCanBusFrame(0x223, QByteArray("b"))});
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(!canDevice->framesAvailable());
+
+    // filtering is left to the plugin, all frames pass
+    canDevice->emulateHardwareFiltering(true);
+    canDevice->receiveFrames(frames);
+    QCOMPARE(canDevice->readAllFrames().size(), frames.size());
+
+    canDevice->emulateHardwareFiltering(false);
+    canDevice->setConfigurationParameter(QCanBusDevice::RawFilterKey, QVariant());
+    canDevice->receiveFrames(frames);
+    QCOMPARE(canDevice->readAllFrames().size(), frames.size());
+}
+
+void tst_QCanBusDevice::tst_ioThread()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->ioThread());
+
+    canDevice->setConfigurationParameter(QCanBusDevice::IoThreadKey, true);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+
+    QThread *thread = canDevice->ioThread();
+    QVERIFY(thread);
+    QVERIFY(thread->isRunning());
+    QVERIFY(thread != QThread::currentThread());
+    QCOMPARE(canDevice->ioThread(), thread);
+
+    // frames enqueued in the I/O thread are announced once in the device's thread
+    QSignalSpy spy(canDevice.get(), &QCanBusDevice::framesReceived);
+    QObject reader;
+    reader.moveToThread(thread);
+    QMetaObject::invokeMethod(&reader, [&canDevice]() {
+        for (int i = 0; i < 100; ++i)
+            canDevice->receiveFrames({QCanBusFrame(0x123, QByteArray("io"))});
+    }, Qt::BlockingQueuedConnection);
+
+    QCOMPARE(spy.count(), 0);
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(canDevice->framesAvailable(), 100);
+
+    canDevice->stopIoThread();
+    QVERIFY(!thread->isRunning());
+    canDevice->disconnectDevice();
+}
+
+void tst_QCanBusDevice::tst_notificationPolicy()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+
+    const QCanBusFrame frame(0x123, QByteArray("abc"));
+    QSignalSpy spy(canDevice.get(), &QCanBusDevice::framesReceived);
+
+    // immediate by default
+    canDevice->receiveFrames({frame});
+    QCOMPARE(spy.count(), 1);
+
+    canDevice->setConfigurationParameter(QCanBusDevice::NotificationFrameCountKey, 3);
+    canDevice->setConfigurationParameter(QCanBusDevice::NotificationIntervalKey, 200000);
+
+    // the frame count is reached first
+    canDevice->receiveFrames({frame});
+    QCOMPARE(spy.count(), 1);
+    canDevice->receiveFrames({frame, frame});
+    QCOMPARE(spy.count(), 2);
+
+    // the interval passes first
+    QElapsedTimer elapsed;
+    elapsed.start();
+    canDevice->receiveFrames({frame});
+    QCOMPARE(spy.count(), 2);
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 3, 5000);
+    QVERIFY(elapsed.elapsed() >= 150);
+
+    // switching back to immediate notification announces waiting frames
+    canDevice->receiveFrames({frame});
+    QCOMPARE(spy.count(), 3);
+    canDevice->setConfigurationParameter(QCanBusDevice::NotificationIntervalKey, QVariant());
+    QCOMPARE(spy.count(), 4);
+
+    QCOMPARE(canDevice->readAllFrames().size(), 7);
+}
+
+void tst_QCanBusDevice::tst_statistics()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+
+    QCanBusDeviceStatistics statistics = canDevice->statistics();
+    QCOMPARE(statistics.receivedFrames(), 0);
+    QCOMPARE(statistics.readLatencyHistogram().size(),
+             int(QCanBusDeviceStatistics::ReadLatencyBuckets));
+
+    QCanBusDevice::Filter filter;
+    filter.frameId = 0x123;
+    filter.frameIdMask = 0x7FF;
+    canDevice->setConfigurationParameter(QCanBusDevice::RawFilterKey,
+                                         QVariant::fromValue(QList<QCanBusDevice::Filter>{filter}));
+
+    // received one second ago, the latency falls into [2^19, 2^20) µs
+    QCanBusFrame frame(0x123, QByteArray("abc"));
+    frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(
+                           QDateTime::currentMSecsSinceEpoch() * 1000 - 1000000));
+    canDevice->receiveFrames({frame, QCanBusFrame(0x124, QByteArray("de")),
+                              QCanBusFrame(0x123, QByteArray("fgh"))});
+    QCOMPARE(canDevice->readAllFrames().size(), 2);
+
+    canDevice->setWriteBuffered(false);
+    QVERIFY(canDevice->writeFrame(frame));
+    canDevice->setWriteBuffered(true);
+    QVERIFY(canDevice->writeFrame(frame));
+    canDevice->triggerDelayedWrites();
+    canDevice->emulateError(QStringLiteral("TriggerWriteError"), QCanBusDevice::WriteError);
+
+    statistics = canDevice->statistics();
+    QCOMPARE(statistics.receivedFrames(), 3);
+    QCOMPARE(statistics.receivedBytes(), 8);
+    QCOMPARE(statistics.filteredFrames(), 1);
+    QCOMPARE(statistics.droppedFrames(), 0);
+    QCOMPARE(statistics.receiveQueueHighWaterMark(), 2);
+    QCOMPARE(statistics.writtenFrames(), 2);
+    QCOMPARE(statistics.writtenBytes(), 6);
+    QCOMPARE(statistics.writeErrors(), 1);
+
+    const QList<qint64> histogram = statistics.readLatencyHistogram();
+    QCOMPARE(std::accumulate(histogram.cbegin(), histogram.cend(), qint64(0)), 1);
+    QCOMPARE(histogram.at(19), 1);
+
+    // snapshots are independent of the device
+    canDevice->resetStatistics();
+    QCOMPARE(statistics.receivedFrames(), 3);
+    const QCanBusDeviceStatistics cleared = canDevice->statistics();
+    QCOMPARE(cleared.receivedFrames(), 0);
+    QCOMPARE(cleared.writtenFrames(), 0);
+    QCOMPARE(cleared.writeErrors(), 0);
+    QCOMPARE(cleared.readLatencyHistogram().at(19), 0);
+    QVERIFY(cleared.pluginCounters().isEmpty());
+}
+
+void tst_QCanBusDevice::tst_lastValueCache()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+
+    const auto extendedFrame = [](QCanBusFrame::FrameId id, const QByteArray &payload) {
+        QCanBusFrame frame(id, payload);
+        frame.setExtendedFrameFormat(true);
+        return frame;
+    };
+
+    // disabled by default
+    canDevice->receiveFrames({QCanBusFrame(0x123, QByteArray("a"))});
+    QVERIFY(!canDevice->lastFrame(0x123).isValid());
+    QVERIFY(canDevice->lastFrames().isEmpty());
+
+    canDevice->setConfigurationParameter(QCanBusDevice::LastValueCacheKey, true);
+    QCanBusFrame remoteFrame(QCanBusFrame::RemoteRequestFrame);
+    remoteFrame.setFrameId(0x123);
+    canDevice->receiveFrames({QCanBusFrame(0x123, QByteArray("b")),
+                              QCanBusFrame(0x123, QByteArray("c")),
+                              remoteFrame,
+                              extendedFrame(0x123, QByteArray("d")),
+                              extendedFrame(0x18FEF100, QByteArray("e"))});
+
+    quint64 updates = 0;
+    QCanBusFrame frame = canDevice->lastFrame(0x123, false, &updates);
+    QVERIFY(frame.isValid());
+    QCOMPARE(frame.payload(), QByteArray("c"));
+    QCOMPARE(updates, quint64(2));
+    QCOMPARE(canDevice->lastFrame(0x123, true).payload(), QByteArray("d"));
+    QCOMPARE(canDevice->lastFrame(0x18FEF100, true).payload(), QByteArray("e"));
+    QCOMPARE(canDevice->lastFrameUpdateCount(0x18FEF100, true), quint64(1));
+    QVERIFY(!canDevice->lastFrame(0x124).isValid());
+    QCOMPARE(canDevice->lastFrameUpdateCount(0x124), quint64(0));
+
+    const QList<QCanBusFrame> frames = canDevice->lastFrames();
+    QCOMPARE(frames.size(), 3);
+    QCOMPARE(frames.at(0).payload(), QByteArray("c"));
+    QCOMPARE(frames.at(1).frameId(), 0x123u);
+    QCOMPARE(frames.at(2).frameId(), 0x18FEF100u);
+
+    // the cache does not depend on the receive queue
+    QCOMPARE(canDevice->readAllFrames().size(), 6);
+    QCOMPARE(canDevice->lastFrame(0x123).payload(), QByteArray("c"));
+
+    // frames dropped by the filter are not recorded
+    QCanBusDevice::Filter filter;
+    filter.frameId = 0x200;
+    filter.frameIdMask = 0x7FF;
+    canDevice->setConfigurationParameter(QCanBusDevice::RawFilterKey,
+                                         QVariant::fromValue(QList<QCanBusDevice::Filter>{filter}));
+    canDevice->receiveFrames({QCanBusFrame(0x123, QByteArray("f")),
+                              QCanBusFrame(0x200, QByteArray("g"))});
+    QCOMPARE(canDevice->lastFrame(0x123).payload(), QByteArray("c"));
+    QCOMPARE(canDevice->lastFrame(0x200).payload(), QByteArray("g"));
+
+    // readers in other threads
+    QThread reader;
+    reader.start();
+    QObject context;
+    context.moveToThread(&reader);
+    QMetaObject::invokeMethod(&context, [&canDevice, &updates]() {
+        canDevice->lastFrame(0x200, false, &updates);
+    }, Qt::BlockingQueuedConnection);
+    QCOMPARE(updates, quint64(1));
+    reader.quit();
+    reader.wait();
+
+    canDevice->setConfigurationParameter(QCanBusDevice::LastValueCacheKey, false);
+    QVERIFY(!canDevice->lastFrame(0x200).isValid());
+
+    // disabling discards the recorded frames
+    canDevice->setConfigurationParameter(QCanBusDevice::LastValueCacheKey, true);
+    QVERIFY(!canDevice->lastFrame(0x200).isValid());
+    QCOMPARE(canDevice->lastFrameUpdateCount(0x200), quint64(0));
+    QCOMPARE(canDevice->lastFrameUpdateCount(0x18FEF100, true), quint64(0));
+    QVERIFY(canDevice->lastFrames().isEmpty());
+
+    canDevice->receiveFrames({QCanBusFrame(0x200, QByteArray("h"))});
+    QCOMPARE(canDevice->lastFrame(0x200, false, &updates).payload(), QByteArray("h"));
+    QCOMPARE(updates, quint64(1));
+    QVERIFY(!canDevice->lastFrame(0x18FEF100, true).isValid());
+    QCOMPARE(canDevice->lastFrames().size(), 1);
+}
+
+void tst_QCanBusDevice::tst_lastValueCacheConcurrency()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+
+    canDevice->setConfigurationParameter(QCanBusDevice::LastValueCacheKey, true);
+    // only the cache matters, keep the receive queue small
+    canDevice->setReceiveQueueCapacity(16);
+    canDevice->setOverflowPolicy(QCanBusDevice::OverflowPolicy::DropOldest);
+
+    // Every frame carries its sequence number in each payload byte and in
+    // its time stamp, and is the sequence number + 1st update of its
+    // identifier. A torn read mixes two frames and breaks one of these.
+    constexpr int Updates = 200000;
+    const auto makeFrame = [](QCanBusFrame::FrameId id, bool extended, int sequence) {
+        QCanBusFrame frame(id, QByteArray(8, char(sequence)));
+        frame.setExtendedFrameFormat(extended);
+        frame.setTimeStamp(QCanBusFrame::TimeStamp(sequence, 0));
+        return frame;
+    };
+
+    std::atomic<bool> done = false;
+    std::unique_ptr<QThread> writer(QThread::create([&]() {
+        for (int i = 0; i < Updates; ++i) {
+            canDevice->receiveFrames({makeFrame(0x100, false, i),
+                                      makeFrame(0x18FEF100, true, i)});
+        }
+        done.store(true, std::memory_order_release);
+    }));
+    writer->start();
+
+    int reads = 0;
+    int tornReads = 0;
+    quint64 lastUpdates[2] = {};
+    bool goneBackwards = false;
+    while (!done.load(std::memory_order_acquire) || reads < 1000) {
+        const bool extended = reads % 2;
+        quint64 updates = 0;
+        const QCanBusFrame frame = canDevice->lastFrame(extended ? 0x18FEF100 : 0x100,
+                                                        extended, &updates);
+        ++reads;
+        if (updates == 0) {
+            tornReads += frame.isValid();
+            continue;
+        }
+
+        const QByteArray payload = frame.payload();
+        const qint64 sequence = frame.timeStamp().seconds();
+        if (payload.size() != 8 || frame.hasExtendedFrameFormat() != extended
+                || quint64(sequence) + 1 != updates
+                || payload.count(char(sequence)) != payload.size()) {
+            ++tornReads;
+        }
+        goneBackwards |= updates < lastUpdates[extended];
+        lastUpdates[extended] = updates;
+    }
+    QVERIFY(writer->wait(30000));
+
+    QCOMPARE(tornReads, 0);
+    QVERIFY(!goneBackwards);
+    QCOMPARE(canDevice->lastFrameUpdateCount(0x100), quint64(Updates));
+    QCOMPARE(canDevice->lastFrameUpdateCount(0x18FEF100, true), quint64(Updates));
+}
+
+void tst_QCanBusDevice::tst_changedFramesOnly()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+
+    canDevice->setConfigurationParameter(QCanBusDevice::ChangedFramesOnlyKey, true);
+
+    QCanBusFrame remoteFrame(QCanBusFrame::RemoteRequestFrame);
+    remoteFrame.setFrameId(0x100);
+    QCanBusFrame fdFrame(0x101, QByteArray(12, 'x'));
+
+    canDevice->receiveFrames({QCanBusFrame(0x100, QByteArray("a")),
+                              QCanBusFrame(0x100, QByteArray("a")),   // unchanged
+                              QCanBusFrame(0x100, QByteArray("b")),
+                              QCanBusFrame(0x100, QByteArray("bc")),  // length changed
+                              remoteFrame,                            // always delivered
+                              fdFrame,
+                              fdFrame});                              // unchanged
+    QList<QCanBusFrame> received = canDevice->readAllFrames();
+    QCOMPARE(received.size(), 5);
+    QCOMPARE(received.at(2).payload(), QByteArray("bc"));
+    QCOMPARE(received.at(3).frameType(), QCanBusFrame::RemoteRequestFrame);
+    QCOMPARE(canDevice->statistics().filteredFrames(), 2);
+
+    // the same identifier in extended format has its own state
+    QCanBusFrame extendedFrame(0x100, QByteArray("bc"));
+    extendedFrame.setExtendedFrameFormat(true);
+    canDevice->receiveFrames({QCanBusFrame(0x100, QByteArray("bc")), extendedFrame});
+    received = canDevice->readAllFrames();
+    QCOMPARE(received.size(), 1);
+    QVERIFY(received.at(0).hasExtendedFrameFormat());
+
+    // a changed bitrate switch or CAN FD flag counts as a change
+    QCanBusFrame switchedFrame = fdFrame;
+    switchedFrame.setBitrateSwitch(true);
+    QCanBusFrame classicFrame(0x102, QByteArray("abc"));
+    QCanBusFrame shortFdFrame = classicFrame;
+    shortFdFrame.setFlexibleDataRateFormat(true);
+    canDevice->receiveFrames({switchedFrame, switchedFrame, classicFrame, shortFdFrame});
+    QCOMPARE(canDevice->readAllFrames().size(), 3);
+
+    // base frames with an out of range identifier are not tracked and do not
+    // share the state of the extended identifier
+    QCanBusFrame outOfRangeFrame(0x900, QByteArray("a"));
+    outOfRangeFrame.setExtendedFrameFormat(false);
+    QCanBusFrame extendedNeighbour(0x900, QByteArray("a"));
+    extendedNeighbour.setExtendedFrameFormat(true);
+    canDevice->receiveFrames({extendedNeighbour, outOfRangeFrame, outOfRangeFrame,
+                              extendedNeighbour});
+    received = canDevice->readAllFrames();
+    QCOMPARE(received.size(), 3);
+    QVERIFY(received.at(0).hasExtendedFrameFormat());
+    QVERIFY(!received.at(1).hasExtendedFrameFormat());
+    QVERIFY(!received.at(2).hasExtendedFrameFormat());
+
+    // unchanged frames are delivered again after the heartbeat interval
+    canDevice->setConfigurationParameter(QCanBusDevice::ChangeHeartbeatIntervalKey, 100);
+    canDevice->receiveFrames({QCanBusFrame(0x200, QByteArray("a"))});
+    canDevice->receiveFrames({QCanBusFrame(0x200, QByteArray("a"))});
+    QCOMPARE(canDevice->readAllFrames().size(), 1);
+    QTest::qWait(150);
+    canDevice->receiveFrames({QCanBusFrame(0x200, QByteArray("a"))});
+    QCOMPARE(canDevice->readAllFrames().size(), 1);
+
+    canDevice->setConfigurationParameter(QCanBusDevice::ChangedFramesOnlyKey, false);
+    canDevice->receiveFrames({QCanBusFrame(0x200, QByteArray("a")),
+                              QCanBusFrame(0x200, QByteArray("a"))});
+    QCOMPARE(canDevice->readAllFrames().size(), 2);
+}
+
+void tst_QCanBusDevice::tst_cycleTimeAnalyzer()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+
+    const auto frameAt = [](QCanBusFrame::FrameId id, qint64 usec) {
+        QCanBusFrame frame(id, QByteArray("x"));
+        frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(usec));
+        return frame;
+    };
+
+    QCanBusCycleTimeAnalyzer analyzer;
+    analyzer.setDevice(canDevice.get());
+    QCOMPARE(analyzer.device(), canDevice.get());
+
+    canDevice->receiveFrames({frameAt(0x100, 1000000), frameAt(0x200, 1000500),
+                              frameAt(0x100, 1010000)});
+    canDevice->receiveFrames({frameAt(0x100, 1020000), frameAt(0x100, 1032000)});
+
+    // the analyzer does not consume frames
+    QCOMPARE(canDevice->readAllFrames().size(), 5);
+
+    QCanBusCycleTimeAnalyzer::Statistics entry = analyzer.statistics(0x100);
+    QCOMPARE(entry.frameId, 0x100u);
+    QVERIFY(!entry.extendedFrameFormat);
+    QCOMPARE(entry.frameCount, Q_INT64_C(4));
+    QCOMPARE(entry.periodCount, Q_INT64_C(3));
+    QCOMPARE(entry.minimumPeriod, Q_INT64_C(10000));
+    QCOMPARE(entry.maximumPeriod, Q_INT64_C(12000));
+    QVERIFY(qAbs(entry.meanPeriod - 32000.0 / 3) < 0.01);
+    QVERIFY(qAbs(entry.jitter - 1154.70) < 0.01);
+    QCOMPARE(entry.lastSeen.seconds(), Q_INT64_C(1));
+    QCOMPARE(entry.lastSeen.microSeconds(), Q_INT64_C(32000));
+
+    entry = analyzer.statistics(0x200);
+    QCOMPARE(entry.frameCount, Q_INT64_C(1));
+    QCOMPARE(entry.periodCount, Q_INT64_C(0));
+    QCOMPARE(entry.jitter, 0.0);
+
+    QCOMPARE(analyzer.statistics(0x300).frameCount, Q_INT64_C(0));
+
+    // frames can be added directly, extended identifiers have their own entry
+    QCanBusFrame extendedFrame = frameAt(0x100, 2000000);
+    extendedFrame.setExtendedFrameFormat(true);
+    analyzer.addFrames({extendedFrame});
+    const QList<QCanBusCycleTimeAnalyzer::Statistics> entries = analyzer.snapshot();
+    QCOMPARE(entries.size(), 3);
+    QCOMPARE(entries.at(0).frameId, 0x100u);
+    QCOMPARE(entries.at(1).frameId, 0x200u);
+    QVERIFY(entries.at(2).extendedFrameFormat);
+    QCOMPARE(entries.at(2).frameCount, Q_INT64_C(1));
+
+    analyzer.reset();
+    QVERIFY(analyzer.snapshot().isEmpty());
+
+    // a frame older than the last one is counted, but gives no period
+    analyzer.addFrames({frameAt(0x300, 5000000), frameAt(0x300, 4990000),
+                        frameAt(0x300, 5010000)});
+    entry = analyzer.statistics(0x300);
+    QCOMPARE(entry.frameCount, Q_INT64_C(3));
+    QCOMPARE(entry.periodCount, Q_INT64_C(1));
+    QCOMPARE(entry.minimumPeriod, Q_INT64_C(10000));
+    QCOMPARE(entry.maximumPeriod, Q_INT64_C(10000));
+    QCOMPARE(entry.lastSeen.seconds(), Q_INT64_C(5));
+    QCOMPARE(entry.lastSeen.microSeconds(), Q_INT64_C(10000));
+
+    analyzer.addFrames({frameAt(0x300, 4000000)});
+    entry = analyzer.statistics(0x300);
+    QCOMPARE(entry.periodCount, Q_INT64_C(1));
+    QCOMPARE(entry.lastSeen.seconds(), Q_INT64_C(5));
+
+    analyzer.reset();
+    analyzer.setDevice(nullptr);
+    canDevice->receiveFrames({frameAt(0x100, 3000000)});
+    QVERIFY(analyzer.snapshot().isEmpty());
+}
+
+void tst_QCanBusDevice::tst_busLoadEstimator()
+{
+    // bit counts include stuff bits, CRC, ACK, EOF and interframe space
+    const QCanBusFrame baseFrame(0x123, QByteArray::fromHex("0102030405060708"));
+    QCOMPARE(QCanBusLoadEstimator::frameBitCount(baseFrame), 119);
+    QCanBusFrame extendedFrame(0x12345678, QByteArray::fromHex("1122"));
+    extendedFrame.setExtendedFrameFormat(true);
+    QCOMPARE(QCanBusLoadEstimator::frameBitCount(extendedFrame), 84);
+    QCanBusFrame remoteFrame(QCanBusFrame::RemoteRequestFrame);
+    remoteFrame.setFrameId(0x100);
+    remoteFrame.setPayload(QByteArray(4, 0));
+    QCOMPARE(QCanBusLoadEstimator::frameBitCount(remoteFrame), 49);
+    QCOMPARE(QCanBusLoadEstimator::frameBitCount(QCanBusFrame(QCanBusFrame::ErrorFrame)), 0);
+
+    QCanBusFrame fdFrame(0x123, QByteArray(64, 0x55));
+    fdFrame.setFlexibleDataRateFormat(true);
+    QCOMPARE(QCanBusLoadEstimator::frameBitCount(fdFrame), 579);
+    QCOMPARE(QCanBusLoadEstimator::frameDuration(fdFrame, 500000, 2000000), Q_INT64_C(1158000));
+    fdFrame.setBitrateSwitch(true);
+    QCOMPARE(QCanBusLoadEstimator::frameBitCount(fdFrame), 579);
+    // 30 bits at the nominal bit rate, 549 bits at the data bit rate
+    QCOMPARE(QCanBusLoadEstimator::frameDuration(fdFrame, 500000, 2000000), Q_INT64_C(334500));
+    QCOMPARE(QCanBusLoadEstimator::frameDuration(fdFrame, 500000), Q_INT64_C(1158000));
+
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+    canDevice->setConfigurationParameter(QCanBusDevice::BitRateKey, 500000);
+
+    QCanBusLoadEstimator estimator;
+    QCOMPARE(estimator.windowDuration(), 1000);
+    estimator.setDevice(canDevice.get());
+    QCOMPARE(estimator.device(), canDevice.get());
+    QCOMPARE(estimator.bitRate(), 500000);
+    QCOMPARE(estimator.dataBitRate(), 0);
+
+    // one 119 bit frame per millisecond at 500 kbit/s, the window of 10 s
+    // moves in steps of 156 ms while no frames are added
+    estimator.setWindowDuration(10000);
+    QList<QCanBusFrame> frames;
+    for (int i = 0; i < 10000; ++i) {
+        QCanBusFrame frame = baseFrame;
+        frame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(1000000 + i * 1000));
+        frames.append(frame);
+    }
+    canDevice->receiveFrames(frames);
+    QCOMPARE(canDevice->readAllFrames().size(), 10000);
+    QVERIFY(qAbs(estimator.busLoad() - 23.8) < 0.001);
+
+    // the window moves with the timestamps
+    QCanBusFrame lateFrame = baseFrame;
+    lateFrame.setTimeStamp(QCanBusFrame::TimeStamp::fromMicroSeconds(30000000));
+    estimator.addFrames({lateFrame});
+    QVERIFY(qAbs(estimator.busLoad() - 0.00238) < 0.000001);
+
+    estimator.reset();
+    QCOMPARE(estimator.busLoad(), 0.0);
+
+    QTest::ignoreMessage(QtWarningMsg, "Cannot set a window duration of 0 ms.");
+    estimator.setWindowDuration(0);
+    QCOMPARE(estimator.windowDuration(), 10000);
+
+    // the bus load of an idle bus decays, frames without timestamp are
+    // placed at the current time
+    estimator.setWindowDuration(100);
+    QSignalSpy updatedSpy(&estimator, &QCanBusLoadEstimator::busLoadUpdated);
+    QCOMPARE(estimator.updateInterval(), 0);
+    estimator.addFrames({baseFrame});
+    QVERIFY(estimator.busLoad() > 0.0);
+    estimator.setUpdateInterval(10);
+    QCOMPARE(estimator.updateInterval(), 10);
+    QTRY_VERIFY(!updatedSpy.isEmpty() && updatedSpy.last().at(0).toDouble() == 0.0);
+    QCOMPARE(estimator.busLoad(), 0.0);
+    estimator.setUpdateInterval(0);
+    QCOMPARE(estimator.updateInterval(), 0);
+
+    estimator.setDevice(nullptr);
+    canDevice->receiveFrames(frames);
+    QCOMPARE(estimator.busLoad(), 0.0);
+}
+
+void tst_QCanBusDevice::tst_frameConfirmed()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+
+    QSignalSpy confirmedSpy(canDevice.get(), &QCanBusDevice::frameConfirmed);
+    QCOMPARE(canDevice->statistics().transmitLatencyHistogram().size(),
+             int(QCanBusDeviceStatistics::ReadLatencyBuckets));
+
+    QCanBusFrame frame(0x123, QByteArray("abc"));
+    frame.setLocalEcho(true);
+    canDevice->confirmFrame(frame, 1000); // falls into [2^9, 2^10) µs
+    canDevice->confirmFrame(frame);       // unknown latency
+
+    QCOMPARE(confirmedSpy.count(), 2);
+    const QCanBusFrame confirmed = confirmedSpy.at(0).at(0).value<QCanBusFrame>();
+    QCOMPARE(confirmed.frameId(), frame.frameId());
+    QVERIFY(confirmed.hasLocalEcho());
+
+    const QList<qint64> histogram = canDevice->statistics().transmitLatencyHistogram();
+    QCOMPARE(std::accumulate(histogram.cbegin(), histogram.cend(), qint64(0)), 1);
+    QCOMPARE(histogram.at(9), 1);
+    // confirmations do not count as received frames
+    QCOMPARE(canDevice->statistics().receivedFrames(), 0);
+    QCOMPARE(canDevice->framesAvailable(), 0);
+
+    canDevice->resetStatistics();
+    QCOMPARE(canDevice->statistics().transmitLatencyHistogram().at(9), 0);
+}
+
+void tst_QCanBusDevice::tst_writeQueuePriority()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+    QVERIFY(canDevice->isWriteBuffered());
+
+    canDevice->setConfigurationParameter(QCanBusDevice::WriteQueuePriorityKey, true);
+    QVERIFY(canDevice->writeFrame(QCanBusFrame(0x700, QByteArray("bulk"))));
+    QVERIFY(canDevice->writeFrame(QCanBusFrame(0x010, QByteArray("urgent"))));
+    // expires before it is written
+    QVERIFY(canDevice->writeFrameWithDeadline(QCanBusFrame(0x008, QByteArray("stale")),
+                                              QDeadlineTimer(0)));
+    QVERIFY(canDevice->writeFrameWithDeadline(QCanBusFrame(0x020, QByteArray("later")),
+                                              QDeadlineTimer(60000)));
+
+    QCOMPARE(canDevice->framesToWrite(), 3);
+    QCOMPARE(canDevice->statistics().expiredFrames(), 1);
+    QCOMPARE(canDevice->dequeueOutgoingFrame().payload(), QByteArray("urgent"));
+    QCOMPARE(canDevice->dequeueOutgoingFrame().payload(), QByteArray("later"));
+    QCOMPARE(canDevice->dequeueOutgoingFrame().payload(), QByteArray("bulk"));
+    QCOMPARE(canDevice->framesToWrite(), 0);
+
+    // the order of the writes is kept by default
+    canDevice->setConfigurationParameter(QCanBusDevice::WriteQueuePriorityKey, QVariant());
+    QVERIFY(canDevice->writeFrame(QCanBusFrame(0x700, QByteArray("bulk"))));
+    QVERIFY(canDevice->writeFrame(QCanBusFrame(0x010, QByteArray("urgent"))));
+    QCOMPARE(canDevice->dequeueOutgoingFrame().payload(), QByteArray("bulk"));
+    QCOMPARE(canDevice->dequeueOutgoingFrame().payload(), QByteArray("urgent"));
+
+    canDevice->resetStatistics();
+    QCOMPARE(canDevice->statistics().expiredFrames(), 0);
+}
+
+void tst_QCanBusDevice::tst_transmitShaping()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+
+    QCanBusDevice::ShapingRule rule;
+    rule.frameId = 0x100;
+    rule.frameIdMask = 0x7FF;
+    rule.rate = 20;
+    canDevice->setConfigurationParameter(QCanBusDevice::TransmitShapingKey,
+                                         QVariant::fromValue(QList{rule}));
+
+    QVERIFY(canDevice->writeFrame(QCanBusFrame(0x100, QByteArray("first"))));
+    QVERIFY(canDevice->writeFrame(QCanBusFrame(0x100, QByteArray("second"))));
+    QVERIFY(canDevice->writeFrame(QCanBusFrame(0x200, QByteArray("other"))));
+
+    // held frames count as frames to write
+    QCOMPARE(canDevice->framesToWrite(), 3);
+    QCOMPARE(canDevice->dequeueOutgoingFrame().payload(), QByteArray("first"));
+    QCOMPARE(canDevice->dequeueOutgoingFrame().payload(), QByteArray("other"));
+    QCOMPARE(canDevice->dequeueOutgoingFrame().frameType(), QCanBusFrame::InvalidFrame);
+    QCOMPARE(canDevice->writeTriggers, 0);
+
+    // released after 50 ms
+    QTRY_COMPARE_WITH_TIMEOUT(canDevice->writeTriggers, 1, 1000);
+    QCOMPARE(canDevice->dequeueOutgoingFrame().payload(), QByteArray("second"));
+    QCOMPARE(canDevice->framesToWrite(), 0);
+
+    // new rules start with full buckets, removing them releases held frames at once
+    rule.rate = 1;
+    canDevice->setConfigurationParameter(QCanBusDevice::TransmitShapingKey,
+                                         QVariant::fromValue(QList{rule}));
+    QVERIFY(canDevice->writeFrame(QCanBusFrame(0x100, QByteArray("third"))));
+    QVERIFY(canDevice->writeFrame(QCanBusFrame(0x100, QByteArray("fourth"))));
+    QCOMPARE(canDevice->framesToWrite(), 2);
+    canDevice->setConfigurationParameter(QCanBusDevice::TransmitShapingKey, QVariant());
+    QCOMPARE(canDevice->writeTriggers, 2);
+    QCOMPARE(canDevice->dequeueOutgoingFrame().payload(), QByteArray("third"));
+    QCOMPARE(canDevice->dequeueOutgoingFrame().payload(), QByteArray("fourth"));
+}
+
+void tst_QCanBusDevice::tst_cyclicFrames()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+    QVERIFY(canDevice->isWriteBuffered());
+
+    QCOMPARE(canDevice->addCyclicFrame(QCanBusFrame(QCanBusFrame::InvalidFrame), 10), -1);
+    QCOMPARE(canDevice->error(), QCanBusDevice::OperationError);
+    QCOMPARE(canDevice->addCyclicFrame(QCanBusFrame(0x100, QByteArray("x")), 0), -1);
+
+    const int id = canDevice->addCyclicFrame(QCanBusFrame(0x100, QByteArray("old")), 10, 0);
+    QVERIFY(id >= 0);
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->framesToWrite() >= 2, 1000);
+
+    // the next transmission sends the new frame
+    QVERIFY(canDevice->updateCyclicFrame(id, QCanBusFrame(0x100, QByteArray("new"))));
+    QVERIFY(!canDevice->updateCyclicFrame(id + 1, QCanBusFrame(0x100, QByteArray("new"))));
+    while (canDevice->framesToWrite() > 0)
+        QCOMPARE(canDevice->dequeueOutgoingFrame().payload(), QByteArray("old"));
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->framesToWrite() >= 1, 1000);
+    QCOMPARE(canDevice->dequeueOutgoingFrame().payload(), QByteArray("new"));
+
+    QVERIFY(canDevice->removeCyclicFrame(id));
+    QVERIFY(!canDevice->removeCyclicFrame(id));
+    canDevice->clear(QCanBusDevice::Output);
+    QTest::qWait(50);
+    QCOMPARE(canDevice->framesToWrite(), 0);
+
+    // every transmission was recorded
+    const QList<qint64> jitter = canDevice->statistics().cyclicJitterHistogram();
+    QCOMPARE(jitter.size(), qsizetype(QCanBusDeviceStatistics::ReadLatencyBuckets));
+    QVERIFY(std::accumulate(jitter.cbegin(), jitter.cend(), Q_INT64_C(0)) >= 3);
+}
+
+void tst_QCanBusDevice::tst_cyclicFrameOffload()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+    canDevice->offloadCyclicFrames = true;
+
+    // frames are handed to the plugin once it is connected
+    const int early = canDevice->addCyclicFrame(QCanBusFrame(0x100, QByteArray("a")), 10);
+    QVERIFY(early >= 0);
+    const int removed = canDevice->addCyclicFrame(QCanBusFrame(0x101, QByteArray("b")), 10);
+    QVERIFY(removed >= 0);
+    QVERIFY(canDevice->updateCyclicFrame(early, QCanBusFrame(0x100, QByteArray("c"))));
+    QVERIFY(canDevice->removeCyclicFrame(removed));
+    QVERIFY(canDevice->cyclicTransmissions.isEmpty());
+
+    QVERIFY(!canDevice->connectDevice()); // first connect triggered to fail
+    QVERIFY(canDevice->cyclicTransmissions.isEmpty());
+    QVERIFY(canDevice->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(canDevice->state() == QCanBusDevice::ConnectedState, 5000);
+    QCOMPARE(canDevice->cyclicTransmissions.size(), 1);
+    QCOMPARE(canDevice->cyclicTransmissions.value(early).payload(), QByteArray("c"));
+    QVERIFY(canDevice->removeCyclicFrame(early));
+    QVERIFY(canDevice->cyclicTransmissions.isEmpty());
+
+    const int id = canDevice->addCyclicFrame(QCanBusFrame(0x200, QByteArray("old")), 10, 0);
+    QVERIFY(id >= 0);
+    QVERIFY(id != early);
+    QCOMPARE(canDevice->cyclicTransmissions.value(id).payload(), QByteArray("old"));
+
+    QVERIFY(canDevice->updateCyclicFrame(id, QCanBusFrame(0x200, QByteArray("new"))));
+    QCOMPARE(canDevice->cyclicTransmissions.value(id).payload(), QByteArray("new"));
+
+    // the plugin writes the frame, QCanBusDevice does not
+    QTest::qWait(50);
+    QCOMPARE(canDevice->framesToWrite(), 0);
+
+    QVERIFY(canDevice->removeCyclicFrame(id));
+    QVERIFY(canDevice->cyclicTransmissions.isEmpty());
+    QVERIFY(!canDevice->removeCyclicFrame(id));
+    QVERIFY(!canDevice->updateCyclicFrame(id, QCanBusFrame(0x200, QByteArray("new"))));
+}
+
+void tst_QCanBusDevice::tst_receiveMonitor()
+{
+    std::unique_ptr<tst_Backend> canDevice(new tst_Backend);
+
+    // the test plugin does not support receive monitors
+    QTest::ignoreMessage(QtWarningMsg, "This CAN bus plugin does not support receive monitors.");
+    QVERIFY(!canDevice->addReceiveMonitor(0x100, QByteArray::fromHex("ff"), 100));
+    QCOMPARE(canDevice->error(), QCanBusDevice::ConfigurationError);
+    QVERIFY(!canDevice->removeReceiveMonitor(0x100));
+}
+
 QTEST_MAIN(tst_QCanBusDevice)
 Q_IMPORT_PLUGIN(TestCanBusPlugin)
 
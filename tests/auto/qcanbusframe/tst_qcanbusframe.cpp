@@ -165,6 +165,11 @@ void tst_QCanBusFrame::payload()
     frame.setPayload("test");
     QCOMPARE(frame.payload().data(), "test");
     QVERIFY(frame.hasFlexibleDataRateFormat());
+
+    // the view refers to the payload stored in the frame
+    QCOMPARE(frame.payloadView(), QByteArrayView("test"));
+    frame.setPayload(QByteArray());
+    QVERIFY(frame.payloadView().isEmpty());
 }
 
 void tst_QCanBusFrame::timeStamp()
@@ -0,0 +1,200 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtSerialBus/qcanbusframebatch.h>
+
+#include <QtTest/qtest.h>
+
+class tst_QCanBusFrameBatch : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_QCanBusFrameBatch();
+
+private slots:
+    void construct();
+    void columns();
+    void roundTrip();
+    void payloadStride();
+    void implicitSharing();
+};
+
+tst_QCanBusFrameBatch::tst_QCanBusFrameBatch()
+{
+}
+
+static QList<QCanBusFrame> testFrames()
+{
+    QCanBusFrame dataFrame(0x123, QByteArray("\x01\x02\x03", 3));
+    dataFrame.setTimeStamp({12, 345});
+
+    QCanBusFrame extendedFrame(0x18FEF100, QByteArray("abcdefgh"));
+    extendedFrame.setLocalEcho(true);
+    extendedFrame.setTimeStamp({13, 0});
+
+    QCanBusFrame remoteFrame(QCanBusFrame::RemoteRequestFrame);
+    remoteFrame.setFrameId(0x7FF);
+
+    QCanBusFrame errorFrame(QCanBusFrame::ErrorFrame);
+    errorFrame.setError(QCanBusFrame::BusOffError | QCanBusFrame::ControllerError);
+
+    return {dataFrame, extendedFrame, remoteFrame, errorFrame};
+}
+
+static void compareFrames(const QCanBusFrame &actual, const QCanBusFrame &expected)
+{
+    QCOMPARE(actual.frameType(), expected.frameType());
+    QCOMPARE(actual.frameId(), expected.frameId());
+    QCOMPARE(actual.error(), expected.error());
+    QCOMPARE(actual.hasExtendedFrameFormat(), expected.hasExtendedFrameFormat());
+    QCOMPARE(actual.hasFlexibleDataRateFormat(), expected.hasFlexibleDataRateFormat());
+    QCOMPARE(actual.hasBitrateSwitch(), expected.hasBitrateSwitch());
+    QCOMPARE(actual.hasErrorStateIndicator(), expected.hasErrorStateIndicator());
+    QCOMPARE(actual.hasLocalEcho(), expected.hasLocalEcho());
+    QCOMPARE(actual.payload(), expected.payload());
+    QCOMPARE(actual.timeStamp().seconds(), expected.timeStamp().seconds());
+    QCOMPARE(actual.timeStamp().microSeconds(), expected.timeStamp().microSeconds());
+    QCOMPARE(actual.isValid(), expected.isValid());
+}
+
+void tst_QCanBusFrameBatch::construct()
+{
+    QCanBusFrameBatch batch;
+    QVERIFY(batch.isEmpty());
+    QCOMPARE(batch.size(), 0);
+    QCOMPARE(batch.payloadStride(), 8);
+
+    batch = QCanBusFrameBatch(testFrames());
+    QCOMPARE(batch.size(), 4);
+
+    batch.clear();
+    QVERIFY(batch.isEmpty());
+    QVERIFY(batch.toFrameList().isEmpty());
+}
+
+void tst_QCanBusFrameBatch::columns()
+{
+    const QCanBusFrameBatch batch(testFrames());
+
+    const QCanBusFrame::FrameId *ids = batch.frameIds();
+    QCOMPARE(ids[0], 0x123u);
+    QCOMPARE(ids[1], 0x18FEF100u);
+    QCOMPARE(ids[2], 0x7FFu);
+    QCOMPARE(ids[3], quint32(QCanBusFrame::BusOffError | QCanBusFrame::ControllerError));
+
+    QCOMPARE(batch.frameTypes()[2], quint8(QCanBusFrame::RemoteRequestFrame));
+    QCOMPARE(batch.frameType(3), QCanBusFrame::ErrorFrame);
+
+    QCOMPARE(batch.frameFlags()[0], quint8(0));
+    QCOMPARE(batch.frameFlags()[1],
+             quint8(QCanBusFrameBatch::ExtendedFrameFormat | QCanBusFrameBatch::LocalEcho));
+    QVERIFY(batch.testFrameFlag(1, QCanBusFrameBatch::LocalEcho));
+
+    QCOMPARE(batch.timeStamps()[0], Q_INT64_C(12000345));
+    QCOMPARE(batch.timeStamp(1).seconds(), 13);
+
+    QCOMPARE(batch.payloadLengths()[0], quint8(3));
+    QCOMPARE(batch.payloadLengths()[1], quint8(8));
+    QCOMPARE(batch.payloadLengths()[2], quint8(0));
+    QCOMPARE(QByteArray(batch.payloads() + 8, 8), QByteArray("abcdefgh"));
+    QCOMPARE(batch.payload(0).toByteArray(), QByteArray("\x01\x02\x03", 3));
+
+    // unused bytes of a payload slot are zero
+    QCOMPARE(batch.payloads()[3], '\0');
+    QCOMPARE(batch.payloads()[7], '\0');
+}
+
+void tst_QCanBusFrameBatch::roundTrip()
+{
+    const QList<QCanBusFrame> frames = testFrames();
+    const QCanBusFrameBatch batch(frames);
+
+    const QList<QCanBusFrame> converted = batch.toFrameList();
+    QCOMPARE(converted.size(), frames.size());
+    for (qsizetype i = 0; i < frames.size(); ++i)
+        compareFrames(converted.at(i), frames.at(i));
+}
+
+void tst_QCanBusFrameBatch::payloadStride()
+{
+    QCanBusFrameBatch batch(testFrames());
+    QCOMPARE(batch.payloadStride(), 8);
+
+    QCanBusFrame fdFrame(0x456, QByteArray(24, 'x'));
+    fdFrame.setBitrateSwitch(true);
+    batch.append(fdFrame);
+    QCOMPARE(batch.payloadStride(), 64);
+    QCOMPARE(batch.size(), 5);
+
+    // payloads stored before the stride grew are moved to their new slots
+    QCOMPARE(batch.payload(0).toByteArray(), QByteArray("\x01\x02\x03", 3));
+    QCOMPARE(batch.payload(1).toByteArray(), QByteArray("abcdefgh"));
+    QCOMPARE(QByteArray(batch.payloads() + 4 * 64, 24), QByteArray(24, 'x'));
+    compareFrames(batch.frameAt(4), fdFrame);
+
+    const QList<QCanBusFrame> frames = testFrames();
+    for (qsizetype i = 0; i < frames.size(); ++i)
+        compareFrames(batch.frameAt(i), frames.at(i));
+}
+
+void tst_QCanBusFrameBatch::implicitSharing()
+{
+    QCanBusFrameBatch batch(testFrames());
+    QCanBusFrameBatch copy = batch;
+    QCOMPARE(copy.frameIds(), batch.frameIds());
+
+    copy.append(QCanBusFrame(0x456, QByteArray(24, 'x')));
+    QCOMPARE(copy.size(), 5);
+    QCOMPARE(copy.payloadStride(), 64);
+    QCOMPARE(batch.size(), 4);
+    QCOMPARE(batch.payloadStride(), 8);
+    QCOMPARE(batch.payload(1).toByteArray(), QByteArray("abcdefgh"));
+
+    copy.clear();
+    QVERIFY(copy.isEmpty());
+    QCOMPARE(batch.size(), 4);
+
+    QCanBusFrameBatch moved = std::move(batch);
+    QCOMPARE(moved.size(), 4);
+    compareFrames(moved.frameAt(0), testFrames().at(0));
+}
+
+QTEST_MAIN(tst_QCanBusFrameBatch)
+
+#include "tst_qcanbusframebatch.moc"
@@ -0,0 +1,245 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtSerialBus/qcanbusframematcher.h>
+#include <QtSerialBus/private/qcanbusframematcher_p.h>
+
+#include <QtCore/qrandom.h>
+#include <QtTest/qtest.h>
+
+class tst_QCanBusFrameMatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit tst_QCanBusFrameMatcher();
+
+private slots:
+    void initTestCase_data();
+    void init();
+    void cleanup();
+
+    void empty();
+    void filters();
+    void payloadMasks();
+    void randomFrames();
+};
+
+tst_QCanBusFrameMatcher::tst_QCanBusFrameMatcher()
+{
+}
+
+// every test runs with each kernel, the ones the processor lacks are skipped
+void tst_QCanBusFrameMatcher::initTestCase_data()
+{
+    QTest::addColumn<QCanBusFrameMatcherKernel::Kernel>("kernel");
+
+    QTest::newRow("scalar") << QCanBusFrameMatcherKernel::Scalar;
+    QTest::newRow("sse2") << QCanBusFrameMatcherKernel::Sse2;
+    QTest::newRow("avx2") << QCanBusFrameMatcherKernel::Avx2;
+}
+
+void tst_QCanBusFrameMatcher::init()
+{
+    QFETCH_GLOBAL(QCanBusFrameMatcherKernel::Kernel, kernel);
+    if (!QCanBusFrameMatcherKernel::select(kernel))
+        QSKIP("The kernel is not supported on this processor or by this build");
+    QCOMPARE(QCanBusFrameMatcherKernel::selected(), kernel);
+}
+
+void tst_QCanBusFrameMatcher::cleanup()
+{
+    QVERIFY(QCanBusFrameMatcherKernel::select(QCanBusFrameMatcherKernel::Automatic));
+}
+
+static QCanBusDevice::Filter makeFilter(QCanBusFrame::FrameId id, QCanBusFrame::FrameId mask,
+                                        QCanBusFrame::FrameType type = QCanBusFrame::InvalidFrame,
+                                        QCanBusDevice::Filter::FormatFilter format
+                                            = QCanBusDevice::Filter::MatchBaseAndExtendedFormat)
+{
+    QCanBusDevice::Filter filter;
+    filter.frameId = id;
+    filter.frameIdMask = mask;
+    filter.type = type;
+    filter.format = format;
+    return filter;
+}
+
+static QCanBusFrame extendedFrame(QCanBusFrame::FrameId id, const QByteArray &payload)
+{
+    QCanBusFrame frame(id, payload);
+    frame.setExtendedFrameFormat(true);
+    return frame;
+}
+
+// the straightforward per frame comparison the matcher replaces
+static bool matchesReference(const QCanBusFrame &frame, const QCanBusDevice::Filter &filter)
+{
+    if (filter.type != QCanBusFrame::InvalidFrame) {
+        const bool knownType = frame.frameType() == QCanBusFrame::DataFrame
+                || frame.frameType() == QCanBusFrame::ErrorFrame
+                || frame.frameType() == QCanBusFrame::RemoteRequestFrame;
+        if (filter.type == QCanBusFrame::UnknownFrame ? knownType : frame.frameType() != filter.type)
+            return false;
+    }
+    if (frame.hasExtendedFrameFormat()
+            ? !(filter.format & QCanBusDevice::Filter::MatchExtendedFormat)
+            : !(filter.format & QCanBusDevice::Filter::MatchBaseFormat)) {
+        return false;
+    }
+    return (frame.frameId() & filter.frameIdMask) == (filter.frameId & filter.frameIdMask);
+}
+
+void tst_QCanBusFrameMatcher::empty()
+{
+    const QCanBusFrameMatcher matcher;
+    QVERIFY(matcher.isEmpty());
+
+    const QList<QCanBusFrame> frames(100, QCanBusFrame(0x123, QByteArray("a")));
+    const QList<quint64> bitmap = matcher.matchBitmap(frames);
+    QCOMPARE(bitmap.size(), 2);
+    QCOMPARE(bitmap.at(0), Q_UINT64_C(0));
+    QCOMPARE(bitmap.at(1), Q_UINT64_C(0));
+    QVERIFY(matcher.matchingIndexes(frames).isEmpty());
+    QVERIFY(matcher.matchBitmap(QList<QCanBusFrame>()).isEmpty());
+}
+
+void tst_QCanBusFrameMatcher::filters()
+{
+    QCanBusFrame remoteFrame(QCanBusFrame::RemoteRequestFrame);
+    remoteFrame.setFrameId(0x101);
+    QCanBusFrame errorFrame(QCanBusFrame::ErrorFrame);
+    errorFrame.setError(QCanBusFrame::BusError);
+
+    const QList<QCanBusFrame> frames = {
+        QCanBusFrame(0x100, QByteArray("a")),
+        QCanBusFrame(0x10F, QByteArray("b")),
+        QCanBusFrame(0x110, QByteArray("c")),
+        remoteFrame,
+        extendedFrame(0x100, QByteArray("d")),
+        extendedFrame(0x18FEF100, QByteArray("e")),
+        errorFrame
+    };
+
+    QCanBusFrameMatcher matcher({
+        makeFilter(0x100, 0x7F0, QCanBusFrame::DataFrame, QCanBusDevice::Filter::MatchBaseFormat),
+        makeFilter(0x18FEF100, 0x1FFFFFFF, QCanBusFrame::InvalidFrame,
+                   QCanBusDevice::Filter::MatchExtendedFormat)
+    });
+    QCOMPARE(matcher.size(), 2);
+    QCOMPARE(matcher.matchingIndexes(frames), QList<qsizetype>({0, 1, 5}));
+    QCOMPARE(matcher.matchBitmap(frames), QList<quint64>({0b100011}));
+
+    matcher.clear();
+    QVERIFY(matcher.isEmpty());
+    matcher.addFilter(makeFilter(0, 0, QCanBusFrame::ErrorFrame));
+    matcher.addFilter(makeFilter(0x101, 0x7FF, QCanBusFrame::RemoteRequestFrame));
+    QCOMPARE(matcher.matchingIndexes(frames), QList<qsizetype>({3, 6}));
+
+    const QCanBusFrameBatch batch(frames);
+    QCOMPARE(matcher.matchingIndexes(batch), QList<qsizetype>({3, 6}));
+}
+
+void tst_QCanBusFrameMatcher::payloadMasks()
+{
+    QCanBusFrame fdFrame(0x200, QByteArray("\x01\x22\x33", 3) + QByteArray(20, '\0'));
+    const QList<QCanBusFrame> frames = {
+        QCanBusFrame(0x200, QByteArray("\x01\x02\x03", 3)),
+        QCanBusFrame(0x200, QByteArray("\x02\x02\x03", 3)),
+        QCanBusFrame(0x201, QByteArray("\x01\x02\x03", 3)),
+        QCanBusFrame(0x200, QByteArray("\x01", 1)),
+        fdFrame
+    };
+
+    QCanBusFrameMatcher matcher;
+    // first byte equals 1 and the upper nibble of the second byte is zero
+    matcher.addFilter(makeFilter(0x200, 0x7FF), QByteArray("\x01\x00", 2),
+                      QByteArray("\xFF\xF0", 2));
+    QCOMPARE(matcher.matchingIndexes(frames), QList<qsizetype>({0, 3}));
+    QCOMPARE(matcher.matchingIndexes(QCanBusFrameBatch(frames)), QList<qsizetype>({0, 3}));
+
+    // an identifier only filter adds frames regardless of their payload
+    matcher.addFilter(makeFilter(0x201, 0x7FF));
+    QCOMPARE(matcher.matchingIndexes(frames), QList<qsizetype>({0, 2, 3}));
+    QCOMPARE(matcher.matchingIndexes(QCanBusFrameBatch(frames)), QList<qsizetype>({0, 2, 3}));
+}
+
+void tst_QCanBusFrameMatcher::randomFrames()
+{
+    QRandomGenerator random(1234);
+
+    QList<QCanBusFrame> frames;
+    for (int i = 0; i < 1000; ++i) {
+        const bool extended = random.bounded(4) == 0;
+        QCanBusFrame frame(QCanBusFrame::FrameType(random.bounded(1, 4)));
+        if (frame.frameType() == QCanBusFrame::ErrorFrame) {
+            frame.setError(QCanBusFrame::FrameErrors::fromInt(random.bounded(1, 0x200)));
+        } else {
+            frame.setFrameId(extended ? random.bounded(0x20000000) : random.bounded(0x800));
+            frame.setExtendedFrameFormat(extended);
+        }
+        frames.append(frame);
+    }
+
+    QList<QCanBusDevice::Filter> filters;
+    for (int i = 0; i < 40; ++i) {
+        const QCanBusFrame::FrameId mask = random.bounded(0x800) | 0x700;
+        filters.append(makeFilter(frames.at(random.bounded(frames.size())).frameId(), mask,
+                                  QCanBusFrame::FrameType(random.bounded(5)),
+                                  QCanBusDevice::Filter::FormatFilter(random.bounded(1, 4))));
+    }
+
+    QList<qsizetype> expected;
+    for (qsizetype i = 0; i < frames.size(); ++i) {
+        for (const QCanBusDevice::Filter &filter : std::as_const(filters)) {
+            if (matchesReference(frames.at(i), filter)) {
+                expected.append(i);
+                break;
+            }
+        }
+    }
+    QVERIFY(!expected.isEmpty());
+
+    const QCanBusFrameMatcher matcher(filters);
+    QCOMPARE(matcher.matchingIndexes(frames), expected);
+    QCOMPARE(matcher.matchingIndexes(QCanBusFrameBatch(frames)), expected);
+}
+
+QTEST_MAIN(tst_QCanBusFrameMatcher)
+
+#include "tst_qcanbusframematcher.moc"
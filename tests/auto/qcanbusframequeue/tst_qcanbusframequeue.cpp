@@ -0,0 +1,336 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <private/qcanbusframequeue_p.h>
+
+#include <QtCore/qthread.h>
+#include <QtTest/QtTest>
+
+using OverflowPolicy = QCanBusDevice::OverflowPolicy;
+
+static QCanBusFrame frameWithId(QCanBusFrame::FrameId id)
+{
+    return QCanBusFrame(id, QByteArray("payload"));
+}
+
+class tst_QCanBusFrameQueue : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void capacity();
+    void fifoOrder();
+    void batchDequeue();
+    void dropNewest();
+    void dropOldest();
+    void highWaterMark();
+    void resize();
+    void clear();
+    void blockingProducer();
+    void interruptedProducer();
+    void unbounded();
+    void unboundedProducer();
+};
+
+void tst_QCanBusFrameQueue::capacity()
+{
+    QCanBusFrameQueue defaultQueue;
+    QCOMPARE(defaultQueue.capacity(), qsizetype(QCanBusFrameQueue::DefaultCapacity));
+    QVERIFY(defaultQueue.isBounded());
+
+    QCanBusFrameQueue queue(5);
+    QCOMPARE(queue.capacity(), qsizetype(8));
+    QVERIFY(queue.isEmpty());
+
+    QCanBusFrameQueue tinyQueue(0);
+    QCOMPARE(tinyQueue.capacity(), qsizetype(QCanBusFrameQueue::MinimumCapacity));
+}
+
+void tst_QCanBusFrameQueue::fifoOrder()
+{
+    QCanBusFrameQueue queue(16);
+    for (quint32 i = 0; i < 10; ++i)
+        QVERIFY(queue.enqueue(frameWithId(i)));
+    QCOMPARE(queue.size(), qsizetype(10));
+
+    QCanBusFrame frame;
+    for (quint32 i = 0; i < 10; ++i) {
+        QVERIFY(queue.dequeue(&frame));
+        QCOMPARE(frame.frameId(), i);
+        QCOMPARE(frame.payload(), QByteArray("payload"));
+    }
+    QVERIFY(!queue.dequeue(&frame));
+    QVERIFY(queue.isEmpty());
+    QCOMPARE(queue.droppedFrames(), 0);
+}
+
+void tst_QCanBusFrameQueue::batchDequeue()
+{
+    QCanBusFrameQueue queue(16);
+    for (quint32 i = 0; i < 10; ++i)
+        queue.enqueue(frameWithId(i));
+
+    QCanBusFrame frames[4];
+    QCOMPARE(queue.dequeue(frames, 0), qsizetype(0));
+
+    quint32 expected = 0;
+    qsizetype count;
+    while ((count = queue.dequeue(frames, 4)) > 0) {
+        QVERIFY(count <= 4);
+        for (qsizetype i = 0; i < count; ++i)
+            QCOMPARE(frames[i].frameId(), expected++);
+    }
+    QCOMPARE(expected, 10u);
+    QVERIFY(queue.isEmpty());
+
+    // the ring wraps around
+    for (quint32 i = 0; i < 12; ++i)
+        queue.enqueue(frameWithId(i));
+    QCOMPARE(queue.dequeue(frames, 4), qsizetype(4));
+    QCOMPARE(frames[3].frameId(), 3u);
+    QCOMPARE(queue.size(), qsizetype(8));
+}
+
+void tst_QCanBusFrameQueue::dropNewest()
+{
+    QCanBusFrameQueue queue(4);
+    QCOMPARE(queue.overflowPolicy(), OverflowPolicy::DropNewest);
+
+    for (quint32 i = 0; i < 6; ++i)
+        QCOMPARE(queue.enqueue(frameWithId(i)), i < 4);
+    QCOMPARE(queue.size(), qsizetype(4));
+    QCOMPARE(queue.droppedFrames(), 2);
+
+    QCanBusFrame frame;
+    QVERIFY(queue.dequeue(&frame));
+    QCOMPARE(frame.frameId(), 0u);
+}
+
+void tst_QCanBusFrameQueue::dropOldest()
+{
+    QCanBusFrameQueue queue(4);
+    queue.setOverflowPolicy(OverflowPolicy::DropOldest);
+
+    for (quint32 i = 0; i < 6; ++i)
+        QVERIFY(queue.enqueue(frameWithId(i)));
+    QCOMPARE(queue.size(), qsizetype(4));
+    QCOMPARE(queue.droppedFrames(), 2);
+
+    QCanBusFrame frame;
+    for (quint32 i = 2; i < 6; ++i) {
+        QVERIFY(queue.dequeue(&frame));
+        QCOMPARE(frame.frameId(), i);
+    }
+    QVERIFY(queue.isEmpty());
+}
+
+void tst_QCanBusFrameQueue::highWaterMark()
+{
+    QCanBusFrameQueue queue(8);
+    QCOMPARE(queue.highWaterMark(), qsizetype(0));
+
+    for (quint32 i = 0; i < 5; ++i)
+        queue.enqueue(frameWithId(i));
+    queue.clear();
+    queue.enqueue(frameWithId(5));
+    QCOMPARE(queue.highWaterMark(), qsizetype(5));
+
+    queue.resetStatistics();
+    QCOMPARE(queue.highWaterMark(), qsizetype(1));
+    QCOMPARE(queue.droppedFrames(), 0);
+}
+
+void tst_QCanBusFrameQueue::resize()
+{
+    QCanBusFrameQueue queue(8);
+    for (quint32 i = 0; i < 6; ++i)
+        queue.enqueue(frameWithId(i));
+
+    queue.resize(4);
+    QCOMPARE(queue.capacity(), qsizetype(4));
+    QCOMPARE(queue.size(), qsizetype(4));
+    QCOMPARE(queue.droppedFrames(), 2);
+
+    queue.resize(32);
+    QCOMPARE(queue.size(), qsizetype(4));
+    QCanBusFrame frame;
+    for (quint32 i = 0; i < 4; ++i) {
+        QVERIFY(queue.dequeue(&frame));
+        QCOMPARE(frame.frameId(), i);
+    }
+}
+
+void tst_QCanBusFrameQueue::clear()
+{
+    QCanBusFrameQueue queue(8);
+    for (quint32 i = 0; i < 8; ++i)
+        queue.enqueue(frameWithId(i));
+    queue.clear();
+    QVERIFY(queue.isEmpty());
+    QCOMPARE(queue.droppedFrames(), 0);
+    QVERIFY(queue.enqueue(frameWithId(42)));
+    QCOMPARE(queue.size(), qsizetype(1));
+}
+
+void tst_QCanBusFrameQueue::blockingProducer()
+{
+    enum { FrameCount = 100000 };
+
+    QCanBusFrameQueue queue(16);
+    queue.setOverflowPolicy(OverflowPolicy::Block);
+
+    std::unique_ptr<QThread> producer(QThread::create([&queue]() {
+        for (quint32 i = 0; i < FrameCount; ++i)
+            queue.enqueue(frameWithId(i & 0x7FF), true);
+    }));
+    producer->start();
+
+    QCanBusFrame frame;
+    quint32 expected = 0;
+    QDeadlineTimer deadline(30000);
+    while (expected < FrameCount && !deadline.hasExpired()) {
+        if (!queue.dequeue(&frame))
+            continue;
+        QCOMPARE(frame.frameId(), expected & 0x7FF);
+        ++expected;
+    }
+
+    QVERIFY(producer->wait(5000));
+    QCOMPARE(expected, quint32(FrameCount));
+    QCOMPARE(queue.droppedFrames(), 0);
+    QVERIFY(queue.highWaterMark() <= queue.capacity());
+}
+
+void tst_QCanBusFrameQueue::interruptedProducer()
+{
+    QCanBusFrameQueue queue(2);
+    queue.setOverflowPolicy(OverflowPolicy::Block);
+    queue.enqueue(frameWithId(1));
+    queue.enqueue(frameWithId(2));
+
+    // a producer on the consumer thread must not block
+    QVERIFY(!queue.enqueue(frameWithId(3), false));
+    QCOMPARE(queue.droppedFrames(), 1);
+
+    bool enqueued = true;
+    std::unique_ptr<QThread> producer(QThread::create([&queue, &enqueued]() {
+        enqueued = queue.enqueue(frameWithId(4), true);
+    }));
+    producer->start();
+    QVERIFY(!producer->wait(100));
+
+    queue.setWaitsInterrupted(true);
+    QVERIFY(producer->wait(5000));
+    QVERIFY(!enqueued);
+    QCOMPARE(queue.droppedFrames(), 2);
+}
+
+void tst_QCanBusFrameQueue::unbounded()
+{
+    enum { FrameCount = QCanBusFrameQueue::DefaultCapacity + 1000 };
+
+    QCanBusFrameQueue queue(QCanBusFrameQueue::Unbounded);
+    QVERIFY(!queue.isBounded());
+    QCOMPARE(queue.capacity(), qsizetype(QCanBusFrameQueue::DefaultCapacity));
+
+    for (quint32 i = 0; i < FrameCount; ++i)
+        QVERIFY(queue.enqueue(frameWithId(i)));
+    QCOMPARE(queue.size(), qsizetype(FrameCount));
+    QCOMPARE(queue.highWaterMark(), qsizetype(FrameCount));
+    QCOMPARE(queue.droppedFrames(), 0);
+
+    // frames written while the overflow list is in use stay behind it
+    QCanBusFrame frames[16];
+    QCOMPARE(queue.dequeue(frames, 16), qsizetype(16));
+    QCOMPARE(frames[15].frameId(), 15u);
+    QVERIFY(queue.enqueue(frameWithId(FrameCount)));
+
+    // a batch continues from the ring into the overflow list
+    std::unique_ptr<QCanBusFrame[]> batch(new QCanBusFrame[FrameCount]);
+    QCOMPARE(queue.dequeue(batch.get(), FrameCount), qsizetype(FrameCount - 15));
+    for (quint32 i = 0; i < FrameCount - 15; ++i)
+        QCOMPARE(batch[i].frameId(), i + 16);
+    QVERIFY(queue.isEmpty());
+
+    // shrinking to a bounded queue drops what does not fit, growing keeps all
+    for (quint32 i = 0; i < 6; ++i)
+        queue.enqueue(frameWithId(i));
+    queue.resize(4);
+    QVERIFY(queue.isBounded());
+    QCOMPARE(queue.size(), qsizetype(4));
+    QCOMPARE(queue.droppedFrames(), 2);
+
+    queue.resize(QCanBusFrameQueue::Unbounded);
+    QVERIFY(!queue.isBounded());
+    QCOMPARE(queue.size(), qsizetype(4));
+    queue.clear();
+    QVERIFY(queue.isEmpty());
+}
+
+void tst_QCanBusFrameQueue::unboundedProducer()
+{
+    enum { FrameCount = 100000 };
+
+    QCanBusFrameQueue queue(QCanBusFrameQueue::Unbounded);
+
+    std::unique_ptr<QThread> producer(QThread::create([&queue]() {
+        for (quint32 i = 0; i < FrameCount; ++i)
+            queue.enqueue(frameWithId(i & 0x7FF));
+    }));
+    producer->start();
+
+    QCanBusFrame frames[8];
+    quint32 expected = 0;
+    QDeadlineTimer deadline(30000);
+    while (expected < FrameCount && !deadline.hasExpired()) {
+        const qsizetype count = queue.dequeue(frames, 8);
+        for (qsizetype i = 0; i < count; ++i) {
+            QCOMPARE(frames[i].frameId(), expected & 0x7FF);
+            ++expected;
+        }
+    }
+
+    QVERIFY(producer->wait(5000));
+    QCOMPARE(expected, quint32(FrameCount));
+    QCOMPARE(queue.droppedFrames(), 0);
+}
+
+QTEST_MAIN(tst_QCanBusFrameQueue)
+
+#include "tst_qcanbusframequeue.moc"
@@ -0,0 +1,221 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <private/qcanbusoutgoingqueue_p.h>
+
+#include <QtTest/QtTest>
+
+static QCanBusFrame frameWithId(QCanBusFrame::FrameId id, const QByteArray &payload = "x",
+                                bool extended = false)
+{
+    QCanBusFrame frame(id, payload);
+    frame.setExtendedFrameFormat(extended);
+    return frame;
+}
+
+class tst_QCanBusOutgoingQueue : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fifoOrder();
+    void arbitrationKey();
+    void priorityOrder();
+    void switchOrder();
+    void peek();
+    void deadlines();
+    void clear();
+};
+
+void tst_QCanBusOutgoingQueue::fifoOrder()
+{
+    QCanBusOutgoingQueue queue;
+    QVERIFY(queue.isEmpty());
+    QCOMPARE(queue.dequeue().frameType(), QCanBusFrame::InvalidFrame);
+
+    for (QCanBusFrame::FrameId id : {0x300, 0x100, 0x200})
+        queue.enqueue(frameWithId(id));
+    QCOMPARE(queue.size(), qsizetype(3));
+
+    QCOMPARE(queue.dequeue().frameId(), 0x300u);
+    QCOMPARE(queue.dequeue().frameId(), 0x100u);
+    QCOMPARE(queue.dequeue().frameId(), 0x200u);
+    QVERIFY(queue.isEmpty());
+}
+
+void tst_QCanBusOutgoingQueue::arbitrationKey()
+{
+    const auto key = [](const QCanBusFrame &frame) {
+        return QCanBusOutgoingQueue::arbitrationKey(frame);
+    };
+
+    QCanBusFrame remoteFrame(QCanBusFrame::RemoteRequestFrame);
+    remoteFrame.setFrameId(0x100);
+
+    // lower identifiers win
+    QVERIFY(key(frameWithId(0x100)) < key(frameWithId(0x101)));
+    // a data frame wins against a remote request with the same identifier
+    QVERIFY(key(frameWithId(0x100)) < key(remoteFrame));
+    // the base format wins against the extended format with the same base identifier
+    QVERIFY(key(remoteFrame) < key(frameWithId(0x100 << 18, "x", true)));
+    // the base identifier is compared first
+    QVERIFY(key(frameWithId(0x0FF << 18 | 0x3FFFF, "x", true)) < key(frameWithId(0x100)));
+    QVERIFY(key(frameWithId(0x1, "x", true)) < key(frameWithId(0x2, "x", true)));
+}
+
+void tst_QCanBusOutgoingQueue::priorityOrder()
+{
+    QCanBusOutgoingQueue queue;
+    queue.setPriorityOrder(true);
+
+    queue.enqueue(frameWithId(0x700, "bulk1"));
+    queue.enqueue(frameWithId(0x700, "bulk2"));
+    queue.enqueue(frameWithId(0x010, "urgent1"));
+    queue.enqueue(frameWithId(0x100 << 18, "extended", true));
+    queue.enqueue(frameWithId(0x010, "urgent2"));
+    queue.enqueue(frameWithId(0x100, "base"));
+
+    QCOMPARE(queue.dequeue().payload(), QByteArray("urgent1"));
+    QCOMPARE(queue.dequeue().payload(), QByteArray("urgent2"));
+    QCOMPARE(queue.dequeue().payload(), QByteArray("base"));
+    QCOMPARE(queue.dequeue().payload(), QByteArray("extended"));
+    QCOMPARE(queue.dequeue().payload(), QByteArray("bulk1"));
+    QCOMPARE(queue.dequeue().payload(), QByteArray("bulk2"));
+    QVERIFY(queue.isEmpty());
+}
+
+void tst_QCanBusOutgoingQueue::switchOrder()
+{
+    QCanBusOutgoingQueue queue;
+    queue.enqueue(frameWithId(0x200, "a"));
+    queue.enqueue(frameWithId(0x100, "b"));
+    queue.enqueue(frameWithId(0x200, "c"));
+
+    queue.setPriorityOrder(true);
+    QCOMPARE(queue.size(), qsizetype(3));
+    QCOMPARE(queue.peek(0)->payload(), QByteArray("b"));
+    QCOMPARE(queue.peek(1)->payload(), QByteArray("a"));
+    QCOMPARE(queue.peek(2)->payload(), QByteArray("c"));
+
+    // back to the order of the writes, as far as it is known
+    queue.setPriorityOrder(false);
+    queue.enqueue(frameWithId(0x050, "d"));
+    QCOMPARE(queue.dequeue().payload(), QByteArray("b"));
+    QCOMPARE(queue.dequeue().payload(), QByteArray("a"));
+    QCOMPARE(queue.dequeue().payload(), QByteArray("c"));
+    QCOMPARE(queue.dequeue().payload(), QByteArray("d"));
+}
+
+void tst_QCanBusOutgoingQueue::peek()
+{
+    QCanBusOutgoingQueue queue;
+    queue.setPriorityOrder(true);
+    for (QCanBusFrame::FrameId id : {0x300, 0x100, 0x300, 0x200})
+        queue.enqueue(frameWithId(id));
+
+    QVERIFY(!queue.peek(-1));
+    QVERIFY(!queue.peek(4));
+    QList<QCanBusFrame::FrameId> peeked;
+    for (qsizetype i = 0; i < queue.size(); ++i)
+        peeked.append(queue.peek(i)->frameId());
+    QCOMPARE(peeked, (QList<QCanBusFrame::FrameId>{0x100, 0x200, 0x300, 0x300}));
+    QCOMPARE(queue.size(), qsizetype(4));
+}
+
+void tst_QCanBusOutgoingQueue::deadlines()
+{
+    QCanBusOutgoingQueue queue;
+    queue.enqueue(frameWithId(0x1));
+    QVERIFY(!queue.hasDeadlines());
+    QVERIFY(!queue.mayHaveExpired(std::numeric_limits<qint64>::max() - 1));
+
+    queue.enqueue(frameWithId(0x2), 1000);
+    queue.enqueue(frameWithId(0x3), 3000);
+    queue.enqueue(frameWithId(0x4), 2000);
+    QVERIFY(queue.hasDeadlines());
+    QVERIFY(!queue.mayHaveExpired(999));
+    QVERIFY(queue.mayHaveExpired(1000));
+
+    QCOMPARE(queue.expiredSize(999), qsizetype(0));
+    QCOMPARE(queue.expiredSize(2000), qsizetype(2));
+    QCOMPARE(queue.size(), qsizetype(4));
+    QCOMPARE(queue.expiredFrames(), Q_INT64_C(0));
+
+    queue.dropExpired(999);
+    QCOMPARE(queue.size(), qsizetype(4));
+
+    queue.dropExpired(2000);
+    QCOMPARE(queue.size(), qsizetype(2));
+    QCOMPARE(queue.expiredFrames(), Q_INT64_C(2));
+    QVERIFY(!queue.mayHaveExpired(2999));
+    QCOMPARE(queue.peek(0)->frameId(), 0x1u);
+    QCOMPARE(queue.peek(1)->frameId(), 0x3u);
+
+    // dequeued frames do not expire
+    queue.dequeue();
+    queue.dequeue();
+    QVERIFY(!queue.hasDeadlines());
+    queue.dropExpired(5000);
+    QCOMPARE(queue.expiredFrames(), Q_INT64_C(2));
+
+    queue.resetExpiredFrames();
+    QCOMPARE(queue.expiredFrames(), Q_INT64_C(0));
+}
+
+void tst_QCanBusOutgoingQueue::clear()
+{
+    QCanBusOutgoingQueue queue;
+    queue.setPriorityOrder(true);
+    queue.enqueue(frameWithId(0x1), 1000);
+    queue.enqueue(frameWithId(0x2));
+
+    queue.clear();
+    QVERIFY(queue.isEmpty());
+    QVERIFY(!queue.hasDeadlines());
+    QVERIFY(!queue.peek(0));
+
+    // clearing keeps the order
+    queue.enqueue(frameWithId(0x2));
+    queue.enqueue(frameWithId(0x1));
+    QCOMPARE(queue.dequeue().frameId(), 0x1u);
+}
+
+QTEST_MAIN(tst_QCanBusOutgoingQueue)
+
+#include "tst_qcanbusoutgoingqueue.moc"
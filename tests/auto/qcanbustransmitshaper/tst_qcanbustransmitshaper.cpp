@@ -0,0 +1,235 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <private/qcanbustransmitshaper_p.h>
+
+#include <QtTest/QtTest>
+
+static QCanBusFrame frameWithId(QCanBusFrame::FrameId id, const QByteArray &payload = "x")
+{
+    return QCanBusFrame(id, payload);
+}
+
+static QCanBusDevice::ShapingRule rule(QCanBusFrame::FrameId id, QCanBusFrame::FrameId mask,
+                                       int rate, int burst)
+{
+    QCanBusDevice::ShapingRule result;
+    result.frameId = id;
+    result.frameIdMask = mask;
+    result.rate = rate;
+    result.burst = burst;
+    return result;
+}
+
+static QList<QByteArray> takePayloads(QCanBusOutgoingQueue *queue)
+{
+    QList<QByteArray> payloads;
+    while (!queue->isEmpty())
+        payloads.append(queue->dequeue().payload());
+    return payloads;
+}
+
+class tst_QCanBusTransmitShaper : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void inactive();
+    void rateLimit();
+    void firstRuleWins();
+    void busBudget();
+    void changeRules();
+    void deadlines();
+    void clear();
+};
+
+void tst_QCanBusTransmitShaper::inactive()
+{
+    QCanBusTransmitShaper shaper;
+    QCanBusOutgoingQueue queue;
+    QVERIFY(!shaper.isActive());
+    QCOMPARE(shaper.nextRelease(), QCanBusOutgoingQueue::NoDeadline);
+
+    shaper.enqueue(frameWithId(0x100, "a"), QCanBusOutgoingQueue::NoDeadline);
+    shaper.enqueue(frameWithId(0x100, "b"), QCanBusOutgoingQueue::NoDeadline);
+    QCOMPARE(shaper.size(), qsizetype(2));
+    QCOMPARE(shaper.release(0, &queue), qsizetype(2));
+    QVERIFY(shaper.isEmpty());
+    QCOMPARE(takePayloads(&queue), (QList<QByteArray>{"a", "b"}));
+
+    // a bus budget without bit rate has no effect
+    shaper.setBusBudget(50, 0, 0, 0);
+    QVERIFY(!shaper.isActive());
+}
+
+void tst_QCanBusTransmitShaper::rateLimit()
+{
+    QCanBusTransmitShaper shaper;
+    QCanBusOutgoingQueue queue;
+    shaper.setRules({rule(0x100, 0x7FF, 10, 2)}, 0);
+    QVERIFY(shaper.isActive());
+
+    for (const char *payload : {"a", "b", "c"})
+        shaper.enqueue(frameWithId(0x100, payload), QCanBusOutgoingQueue::NoDeadline);
+    shaper.enqueue(frameWithId(0x200, "other"), QCanBusOutgoingQueue::NoDeadline);
+    shaper.enqueue(frameWithId(0x100, "d"), QCanBusOutgoingQueue::NoDeadline);
+
+    // the burst passes, frames of other identifiers are not limited
+    QCOMPARE(shaper.release(0, &queue), qsizetype(3));
+    QCOMPARE(takePayloads(&queue), (QList<QByteArray>{"a", "b", "other"}));
+    QCOMPARE(shaper.size(), qsizetype(2));
+
+    // one token every 100 ms
+    QCOMPARE(shaper.nextRelease(), Q_INT64_C(100000000));
+    QCOMPARE(shaper.release(99999999, &queue), qsizetype(0));
+    QCOMPARE(shaper.release(100000000, &queue), qsizetype(1));
+    QCOMPARE(takePayloads(&queue), (QList<QByteArray>{"c"}));
+    QCOMPARE(shaper.nextRelease(), Q_INT64_C(200000000));
+
+    // the bucket holds no more than the burst
+    QCOMPARE(shaper.release(Q_INT64_C(1000000000000), &queue), qsizetype(1));
+    QCOMPARE(shaper.nextRelease(), QCanBusOutgoingQueue::NoDeadline);
+    for (const char *payload : {"e", "f", "g"})
+        shaper.enqueue(frameWithId(0x100, payload), QCanBusOutgoingQueue::NoDeadline);
+    QCOMPARE(shaper.release(Q_INT64_C(2000000000000), &queue), qsizetype(2));
+}
+
+void tst_QCanBusTransmitShaper::firstRuleWins()
+{
+    QCanBusTransmitShaper shaper;
+    QCanBusOutgoingQueue queue;
+    shaper.setRules({rule(0x100, 0x7FF, 1, 1), rule(0x100, 0x700, 1000, 5)}, 0);
+
+    shaper.enqueue(frameWithId(0x100), QCanBusOutgoingQueue::NoDeadline);
+    shaper.enqueue(frameWithId(0x100), QCanBusOutgoingQueue::NoDeadline);
+    for (int i = 0; i < 3; ++i)
+        shaper.enqueue(frameWithId(0x1AB), QCanBusOutgoingQueue::NoDeadline);
+
+    QCOMPARE(shaper.release(0, &queue), qsizetype(4));
+    QCOMPARE(shaper.size(), qsizetype(1));
+    QCOMPARE(shaper.nextRelease(), Q_INT64_C(1000000000));
+}
+
+void tst_QCanBusTransmitShaper::busBudget()
+{
+    QCanBusTransmitShaper shaper;
+    QCanBusOutgoingQueue queue;
+
+    // 119 bits take 238 us at 500 kbit/s, 10 ms at 50 % are 21 frames
+    const QCanBusFrame frame(0x123, QByteArray::fromHex("0102030405060708"));
+    shaper.setBusBudget(50, 500000, 0, 0);
+    QVERIFY(shaper.isActive());
+    for (int i = 0; i < 25; ++i)
+        shaper.enqueue(frame, QCanBusOutgoingQueue::NoDeadline);
+
+    QCOMPARE(shaper.release(0, &queue), qsizetype(21));
+    QCOMPARE(shaper.nextRelease(), Q_INT64_C(472000));
+    QCOMPARE(shaper.release(471999, &queue), qsizetype(0));
+    QCOMPARE(shaper.release(472000, &queue), qsizetype(1));
+    // afterwards, a frame every twice its bus time
+    QCOMPARE(shaper.nextRelease(), Q_INT64_C(948000));
+
+    // rules and the budget apply both
+    shaper.setRules({rule(0x123, 0x7FF, 1000000, 100)}, 948000);
+    QCOMPARE(shaper.release(948000, &queue), qsizetype(1));
+    QCOMPARE(shaper.size(), qsizetype(2));
+
+    shaper.setBusBudget(0, 500000, 0, 948000);
+    QCOMPARE(shaper.release(948000, &queue), qsizetype(2));
+}
+
+void tst_QCanBusTransmitShaper::changeRules()
+{
+    QCanBusTransmitShaper shaper;
+    QCanBusOutgoingQueue queue;
+    shaper.setRules({rule(0x100, 0x7FF, 1, 1)}, 0);
+
+    shaper.enqueue(frameWithId(0x100, "a"), QCanBusOutgoingQueue::NoDeadline);
+    shaper.enqueue(frameWithId(0x100, "b"), QCanBusOutgoingQueue::NoDeadline);
+    shaper.enqueue(frameWithId(0x300, "c"), QCanBusOutgoingQueue::NoDeadline);
+    shaper.enqueue(frameWithId(0x100, "d"), QCanBusOutgoingQueue::NoDeadline);
+    QCOMPARE(shaper.release(0, &queue), qsizetype(2));
+    QCOMPARE(takePayloads(&queue), (QList<QByteArray>{"a", "c"}));
+
+    // held frames keep the order of the writes
+    shaper.setRules({}, 0);
+    QVERIFY(!shaper.isActive());
+    QCOMPARE(shaper.release(0, &queue), qsizetype(2));
+    QCOMPARE(takePayloads(&queue), (QList<QByteArray>{"b", "d"}));
+}
+
+void tst_QCanBusTransmitShaper::deadlines()
+{
+    QCanBusTransmitShaper shaper;
+    QCanBusOutgoingQueue queue;
+    shaper.setRules({rule(0x100, 0x7FF, 1, 1)}, 0);
+
+    shaper.enqueue(frameWithId(0x100, "a"), QCanBusOutgoingQueue::NoDeadline);
+    shaper.enqueue(frameWithId(0x100, "b"), 500);
+    shaper.enqueue(frameWithId(0x100, "c"), QCanBusOutgoingQueue::NoDeadline);
+    QCOMPARE(shaper.release(0, &queue), qsizetype(1));
+    QCOMPARE(shaper.nextRelease(), Q_INT64_C(500));
+
+    // expired frames use no token, the queue drops them
+    QCOMPARE(shaper.release(500, &queue), qsizetype(1));
+    queue.dropExpired(500);
+    QCOMPARE(queue.expiredFrames(), Q_INT64_C(1));
+    QCOMPARE(takePayloads(&queue), (QList<QByteArray>{"a"}));
+    QCOMPARE(shaper.nextRelease(), Q_INT64_C(1000000000));
+}
+
+void tst_QCanBusTransmitShaper::clear()
+{
+    QCanBusTransmitShaper shaper;
+    QCanBusOutgoingQueue queue;
+    shaper.setRules({rule(0x100, 0x7FF, 1, 1)}, 0);
+    for (int i = 0; i < 3; ++i)
+        shaper.enqueue(frameWithId(0x100), QCanBusOutgoingQueue::NoDeadline);
+    QCOMPARE(shaper.release(0, &queue), qsizetype(1));
+
+    shaper.clear();
+    QVERIFY(shaper.isEmpty());
+    QVERIFY(shaper.isActive());
+    QCOMPARE(shaper.nextRelease(), QCanBusOutgoingQueue::NoDeadline);
+    QCOMPARE(shaper.release(Q_INT64_C(1000000000), &queue), qsizetype(0));
+}
+
+QTEST_MAIN(tst_QCanBusTransmitShaper)
+
+#include "tst_qcanbustransmitshaper.moc"
@@ -0,0 +1,377 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtSerialBus/qcanbusdevice.h>
+#include <QtSerialBus/qcanisotpchannel.h>
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtTest/qsignalspy.h>
+#include <QtTest/qtest.h>
+
+#include <memory>
+
+// writes every frame to the device of the other side
+class tst_LoopbackBackend : public QCanBusDevice
+{
+    Q_OBJECT
+public:
+    bool open() override
+    {
+        setState(QCanBusDevice::ConnectedState);
+        return true;
+    }
+
+    void close() override
+    {
+        setState(QCanBusDevice::UnconnectedState);
+    }
+
+    bool writeFrame(const QCanBusFrame &frame) override
+    {
+        if (state() != QCanBusDevice::ConnectedState)
+            return false;
+
+        writtenFrames.append(frame);
+        if (deferWrites) {
+            enqueueOutgoingFrame(frame);
+            return true;
+        }
+        if (peer && deliver)
+            peer->receiveFrames({frame});
+        emit framesWritten(1);
+        return true;
+    }
+
+    // emulates a device that writes buffered frames when the bus is free
+    void writeDeferredFrames(qint64 count)
+    {
+        QList<QCanBusFrame> frames;
+        while (frames.size() < count && hasOutgoingFrames())
+            frames.append(dequeueOutgoingFrame());
+        if (frames.isEmpty())
+            return;
+        if (peer && deliver)
+            peer->receiveFrames(frames);
+        emit framesWritten(frames.size());
+    }
+
+    QString interpretErrorFrame(const QCanBusFrame &) override
+    {
+        return QString();
+    }
+
+    void receiveFrames(const QList<QCanBusFrame> &frames)
+    {
+        enqueueReceivedFrames(frames);
+    }
+
+    tst_LoopbackBackend *peer = nullptr;
+    bool deliver = true;
+    bool deferWrites = false;
+    QList<QCanBusFrame> writtenFrames;
+};
+
+class tst_QCanIsoTpChannel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void singleFrame();
+    void segmentedMessage_data();
+    void segmentedMessage();
+    void flowControl();
+    void pipelineDepth();
+    void separationTime();
+    void sequenceError();
+    void overflow();
+    void timeout();
+
+private:
+    static QByteArray testMessage(qsizetype size);
+
+    std::unique_ptr<tst_LoopbackBackend> tester;
+    std::unique_ptr<tst_LoopbackBackend> ecu;
+    std::unique_ptr<QCanIsoTpChannel> testerChannel;
+    std::unique_ptr<QCanIsoTpChannel> ecuChannel;
+};
+
+QByteArray tst_QCanIsoTpChannel::testMessage(qsizetype size)
+{
+    QByteArray message(size, Qt::Uninitialized);
+    for (qsizetype i = 0; i < size; ++i)
+        message[i] = char(i * 7 + i / 256);
+    return message;
+}
+
+void tst_QCanIsoTpChannel::init()
+{
+    tester.reset(new tst_LoopbackBackend);
+    ecu.reset(new tst_LoopbackBackend);
+    tester->peer = ecu.get();
+    ecu->peer = tester.get();
+    QVERIFY(tester->connectDevice());
+    QVERIFY(ecu->connectDevice());
+
+    testerChannel.reset(new QCanIsoTpChannel);
+    testerChannel->setDevice(tester.get());
+    ecuChannel.reset(new QCanIsoTpChannel);
+    ecuChannel->setTransmitFrameId(0x7E8);
+    ecuChannel->setReceiveFrameId(0x7E0);
+    ecuChannel->setDevice(ecu.get());
+}
+
+void tst_QCanIsoTpChannel::cleanup()
+{
+    testerChannel.reset();
+    ecuChannel.reset();
+    tester.reset();
+    ecu.reset();
+}
+
+void tst_QCanIsoTpChannel::singleFrame()
+{
+    QSignalSpy received(ecuChannel.get(), &QCanIsoTpChannel::messageReceived);
+    QSignalSpy sent(testerChannel.get(), &QCanIsoTpChannel::messageSent);
+
+    QVERIFY(testerChannel->sendMessage(QByteArray::fromHex("22f190")));
+    QCOMPARE(sent.count(), 1);
+    QCOMPARE(sent.at(0).at(0).toLongLong(), Q_INT64_C(3));
+    QCOMPARE(tester->writtenFrames.size(), qsizetype(1));
+    QCOMPARE(tester->writtenFrames.at(0).frameId(), 0x7E0u);
+    QCOMPARE(tester->writtenFrames.at(0).payload(), QByteArray::fromHex("0322f190cccccccc"));
+
+    QTRY_COMPARE(received.count(), 1);
+    QCOMPARE(received.at(0).at(0).toByteArray(), QByteArray::fromHex("22f190"));
+
+    // without padding, the frame is as long as the message
+    testerChannel->setPaddingEnabled(false);
+    QVERIFY(testerChannel->sendMessage(QByteArray::fromHex("3e00")));
+    QCOMPARE(tester->writtenFrames.at(1).payload(), QByteArray::fromHex("023e00"));
+
+    QVERIFY(!testerChannel->sendMessage(QByteArray()));
+    QCOMPARE(testerChannel->error(), QCanIsoTpChannel::WriteError);
+}
+
+void tst_QCanIsoTpChannel::segmentedMessage_data()
+{
+    QTest::addColumn<qsizetype>("size");
+    QTest::addColumn<bool>("flexibleDataRate");
+
+    QTest::newRow("classic, 8 bytes") << qsizetype(8) << false;
+    QTest::newRow("classic, 4095 bytes") << qsizetype(4095) << false;
+    QTest::newRow("classic, 4096 bytes") << qsizetype(4096) << false;
+    QTest::newRow("classic, 1 MiB") << qsizetype(1024 * 1024) << false;
+    QTest::newRow("fd, 63 bytes") << qsizetype(63) << true;
+    QTest::newRow("fd, 4095 bytes") << qsizetype(4095) << true;
+    QTest::newRow("fd, 4 MiB") << qsizetype(4 * 1024 * 1024) << true;
+}
+
+void tst_QCanIsoTpChannel::segmentedMessage()
+{
+    QFETCH(qsizetype, size);
+    QFETCH(bool, flexibleDataRate);
+
+    testerChannel->setFlexibleDataRateFormat(flexibleDataRate);
+    QSignalSpy received(ecuChannel.get(), &QCanIsoTpChannel::messageReceived);
+    QSignalSpy sent(testerChannel.get(), &QCanIsoTpChannel::messageSent);
+    QSignalSpy errors(testerChannel.get(), &QCanIsoTpChannel::errorOccurred);
+
+    const QByteArray message = testMessage(size);
+    QVERIFY(testerChannel->sendMessage(message));
+    QCOMPARE(testerChannel->messagesToSend(), qsizetype(1));
+
+    QTRY_COMPARE_WITH_TIMEOUT(received.count(), 1, 30000);
+    QVERIFY(received.at(0).at(0).toByteArray() == message);
+    QCOMPARE(sent.count(), 1);
+    QCOMPARE(testerChannel->messagesToSend(), qsizetype(0));
+    QCOMPARE(errors.count(), 0);
+
+    // single frames fit up to 7 bytes, or 62 bytes in CAN FD frames
+    const QCanBusFrame first = tester->writtenFrames.constFirst();
+    QCOMPARE(quint8(first.payload().at(0)) >> 4, 1);
+    QCOMPARE(first.hasFlexibleDataRateFormat(), flexibleDataRate);
+    QCOMPARE(first.payload().size(), qsizetype(flexibleDataRate ? 64 : 8));
+    if (size > 4095)
+        QCOMPARE(first.payload().left(2), QByteArray::fromHex("1000"));
+
+    // the receiver sends one flow control frame without block size
+    QCOMPARE(ecu->writtenFrames.size(), qsizetype(1));
+    QCOMPARE(ecu->writtenFrames.at(0).payload(), QByteArray::fromHex("300000cccccccccc"));
+}
+
+void tst_QCanIsoTpChannel::flowControl()
+{
+    ecuChannel->setBlockSize(4);
+    QCOMPARE(ecuChannel->blockSize(), 4);
+    QSignalSpy received(ecuChannel.get(), &QCanIsoTpChannel::messageReceived);
+
+    // first frame and 17 consecutive frames in 5 blocks
+    const QByteArray message = testMessage(6 + 17 * 7);
+    QVERIFY(testerChannel->sendMessage(message));
+    QTRY_COMPARE(received.count(), 1);
+    QVERIFY(received.at(0).at(0).toByteArray() == message);
+
+    QCOMPARE(tester->writtenFrames.size(), qsizetype(18));
+    QCOMPARE(ecu->writtenFrames.size(), qsizetype(5));
+    for (const QCanBusFrame &frame : std::as_const(ecu->writtenFrames))
+        QCOMPARE(frame.payload().left(3), QByteArray::fromHex("300400"));
+
+    // the sequence number wraps after 15
+    QCOMPARE(tester->writtenFrames.at(15).payload().at(0), char(0x2F));
+    QCOMPARE(tester->writtenFrames.at(16).payload().at(0), char(0x20));
+}
+
+void tst_QCanIsoTpChannel::pipelineDepth()
+{
+    tester->deferWrites = true;
+    QSignalSpy received(ecuChannel.get(), &QCanIsoTpChannel::messageReceived);
+    QSignalSpy sent(testerChannel.get(), &QCanIsoTpChannel::messageSent);
+
+    // first frame and 1000 consecutive frames
+    const QByteArray message = testMessage(6 + 1000 * 7);
+    QVERIFY(testerChannel->sendMessage(message));
+    QTRY_COMPARE(tester->framesToWrite(), qint64(1));
+    tester->writeDeferredFrames(1);
+
+    // the channel fills the write buffer up to 128 frames and stops there
+    QTRY_COMPARE(tester->framesToWrite(), qint64(128));
+    QTest::qWait(50);
+    QCOMPARE(tester->framesToWrite(), qint64(128));
+    QCOMPARE(tester->writtenFrames.size(), qsizetype(129));
+
+    // and continues when the device reports written frames
+    tester->writeDeferredFrames(64);
+    QTRY_COMPARE(tester->framesToWrite(), qint64(128));
+    QCOMPARE(tester->writtenFrames.size(), qsizetype(193));
+    QCOMPARE(sent.count(), 0);
+
+    tester->deferWrites = false;
+    tester->writeDeferredFrames(tester->framesToWrite());
+    QTRY_COMPARE(received.count(), 1);
+    QVERIFY(received.at(0).at(0).toByteArray() == message);
+    QCOMPARE(sent.count(), 1);
+    QCOMPARE(tester->framesToWrite(), qint64(0));
+    QCOMPARE(tester->writtenFrames.size(), qsizetype(1001));
+}
+
+void tst_QCanIsoTpChannel::separationTime()
+{
+    ecuChannel->setSeparationTime(300);
+    QCOMPARE(ecuChannel->separationTime(), 300);
+    ecuChannel->setSeparationTime(1500);
+    QCOMPARE(ecuChannel->separationTime(), 2000);
+    ecuChannel->setSeparationTime(1000000);
+    QCOMPARE(ecuChannel->separationTime(), 127000);
+    ecuChannel->setSeparationTime(5000);
+
+    QSignalSpy received(ecuChannel.get(), &QCanIsoTpChannel::messageReceived);
+    QElapsedTimer timer;
+    timer.start();
+
+    const QByteArray message = testMessage(6 + 4 * 7);
+    QVERIFY(testerChannel->sendMessage(message));
+    QTRY_COMPARE(received.count(), 1);
+    QVERIFY(received.at(0).at(0).toByteArray() == message);
+    QCOMPARE(ecu->writtenFrames.at(0).payload().left(3), QByteArray::fromHex("300005"));
+
+    // 4 consecutive frames, the first one is sent at once
+    QVERIFY(timer.elapsed() >= 15);
+}
+
+void tst_QCanIsoTpChannel::sequenceError()
+{
+    QSignalSpy errors(ecuChannel.get(), &QCanIsoTpChannel::errorOccurred);
+    QSignalSpy received(ecuChannel.get(), &QCanIsoTpChannel::messageReceived);
+
+    QCanBusFrame first(0x7E0, QByteArray::fromHex("1014000102030405"));
+    QCanBusFrame second(0x7E0, QByteArray::fromHex("2206070809101112"));
+    ecu->receiveFrames({first, second});
+
+    QTRY_COMPARE(errors.count(), 1);
+    QCOMPARE(ecuChannel->error(), QCanIsoTpChannel::SequenceError);
+    QCOMPARE(received.count(), 0);
+
+    // frames of other identifiers are ignored
+    ecu->receiveFrames({QCanBusFrame(0x7E1, QByteArray::fromHex("0111"))});
+    ecu->receiveFrames({QCanBusFrame(0x7E0, QByteArray::fromHex("0122"))});
+    QTRY_COMPARE(received.count(), 1);
+    QCOMPARE(received.at(0).at(0).toByteArray(), QByteArray::fromHex("22"));
+}
+
+void tst_QCanIsoTpChannel::overflow()
+{
+    ecuChannel->setMaximumMessageSize(100);
+    QSignalSpy testerErrors(testerChannel.get(), &QCanIsoTpChannel::errorOccurred);
+    QSignalSpy ecuErrors(ecuChannel.get(), &QCanIsoTpChannel::errorOccurred);
+
+    QVERIFY(testerChannel->sendMessage(testMessage(101)));
+    QTRY_COMPARE(testerErrors.count(), 1);
+    QCOMPARE(testerChannel->error(), QCanIsoTpChannel::OverflowError);
+    QCOMPARE(ecuChannel->error(), QCanIsoTpChannel::OverflowError);
+    QCOMPARE(ecu->writtenFrames.at(0).payload().at(0), char(0x32));
+    QCOMPARE(testerChannel->messagesToSend(), qsizetype(0));
+
+    // the next message is sent
+    QSignalSpy received(ecuChannel.get(), &QCanIsoTpChannel::messageReceived);
+    QVERIFY(testerChannel->sendMessage(testMessage(100)));
+    QTRY_COMPARE(received.count(), 1);
+}
+
+void tst_QCanIsoTpChannel::timeout()
+{
+    tester->deliver = false;
+    testerChannel->setTimeout(50);
+    QSignalSpy errors(testerChannel.get(), &QCanIsoTpChannel::errorOccurred);
+
+    QVERIFY(testerChannel->sendMessage(testMessage(20)));
+    QVERIFY(testerChannel->sendMessage(testMessage(3)));
+    QTRY_COMPARE(errors.count(), 1);
+    QCOMPARE(testerChannel->error(), QCanIsoTpChannel::TimeoutError);
+
+    // the single frame is sent after the first message was given up
+    QTRY_COMPARE(testerChannel->messagesToSend(), qsizetype(0));
+    QCOMPARE(tester->writtenFrames.size(), qsizetype(2));
+}
+
+QTEST_MAIN(tst_QCanIsoTpChannel)
+
+#include "tst_qcanisotpchannel.moc"
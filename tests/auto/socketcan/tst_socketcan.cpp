@@ -0,0 +1,378 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtSerialBus/qcanbus.h>
+#include <QtSerialBus/qcanbusdevice.h>
+
+#include <QtCore/qdatetime.h>
+#include <QtCore/qscopedpointer.h>
+#include <QtTest/qsignalspy.h>
+#include <QtTest/qtest.h>
+
+#include <numeric>
+
+// Returns the frames with frameId that device received since the last call.
+// Frames written by the broadcast manager are also received by the raw socket
+// of the same device.
+static QList<QCanBusFrame> readFrames(QCanBusDevice *device, QCanBusFrame::FrameId frameId)
+{
+    QList<QCanBusFrame> frames = device->readAllFrames();
+    frames.removeIf([frameId](const QCanBusFrame &frame) {
+        return frame.frameId() != frameId;
+    });
+    return frames;
+}
+
+// Runs against a real SocketCAN interface, by default "vcan0". Set up with
+//   ip link add dev vcan0 type vcan && ip link set up vcan0
+// or point QT_SOCKETCAN_TEST_INTERFACE to another interface.
+class tst_SocketCan : public QObject
+{
+    Q_OBJECT
+public:
+    tst_SocketCan() = default;
+
+private slots:
+    void init();
+    void cleanup();
+
+    void transmitShaping();
+    void cyclicFramePhase();
+    void cyclicFrameUpdate();
+    void receiveMonitorContentMask();
+    void receiveMonitorTimeout();
+    void broadcastManagerReconnect();
+    void transmitConfirmation();
+
+private:
+    QCanBusDevice *createDevice(QString *errorString = nullptr) const;
+    QList<QCanBusFrame> peerFrames(QCanBusFrame::FrameId frameId)
+    { return readFrames(peer.data(), frameId); }
+
+    QString interfaceName;
+    QScopedPointer<QCanBusDevice> device;
+    // a second socket on the interface that sees the frames of the device
+    QScopedPointer<QCanBusDevice> peer;
+};
+
+QCanBusDevice *tst_SocketCan::createDevice(QString *errorString) const
+{
+    return QCanBus::instance()->createDevice(QStringLiteral("socketcan"), interfaceName,
+                                             errorString);
+}
+
+
+void tst_SocketCan::init()
+{
+    interfaceName = qEnvironmentVariable("QT_SOCKETCAN_TEST_INTERFACE");
+    if (interfaceName.isEmpty())
+        interfaceName = QStringLiteral("vcan0");
+
+    QString errorString;
+    device.reset(createDevice(&errorString));
+    if (!device)
+        QSKIP(qPrintable(QStringLiteral("SocketCAN plugin not available: ") + errorString));
+    if (!device->connectDevice())
+        QSKIP(qPrintable(QStringLiteral("Cannot connect to ") + interfaceName
+                         + QStringLiteral(": ") + device->errorString()));
+    QCOMPARE(device->state(), QCanBusDevice::ConnectedState);
+
+    peer.reset(createDevice());
+    QVERIFY(peer);
+    QVERIFY(peer->connectDevice());
+}
+
+void tst_SocketCan::cleanup()
+{
+    if (device)
+        device->disconnectDevice();
+    device.reset();
+    if (peer)
+        peer->disconnectDevice();
+    peer.reset();
+}
+
+void tst_SocketCan::transmitShaping()
+{
+    QCanBusDevice::ShapingRule rule;
+    rule.frameId = 0x100;
+    rule.frameIdMask = 0x7FF;
+    rule.rate = 50;
+    device->setConfigurationParameter(QCanBusDevice::TransmitShapingKey,
+                                      QVariant::fromValue(QList{rule}));
+
+    QSignalSpy errorSpy(device.data(), &QCanBusDevice::errorOccurred);
+    qint64 written = 0;
+    connect(device.data(), &QCanBusDevice::framesWritten,
+            this, [&written](qint64 count) { written += count; });
+
+    // the shaper holds back the second and third 0x100 frame, the batched
+    // socket write must only pick up frames that are actually in the queue
+    const QList<QCanBusFrame> frames = {
+        QCanBusFrame(0x100, QByteArray("1")),
+        QCanBusFrame(0x100, QByteArray("2")),
+        QCanBusFrame(0x100, QByteArray("3")),
+        QCanBusFrame(0x200, QByteArray("4")),
+        QCanBusFrame(0x200, QByteArray("5")),
+        QCanBusFrame(0x200, QByteArray("6"))
+    };
+    QCOMPARE(device->writeFrames(frames), qint64(frames.size()));
+    QVERIFY(device->framesToWrite() > 0);
+
+    QTRY_COMPARE_WITH_TIMEOUT(written, qint64(frames.size()), 2000);
+    QCOMPARE(device->framesToWrite(), 0);
+    QCOMPARE(errorSpy.count(), 0);
+    QCOMPARE(device->error(), QCanBusDevice::NoError);
+    QCOMPARE(device->statistics().writeErrors(), 0);
+}
+
+static qint64 microSeconds(const QCanBusFrame &frame)
+{
+    return frame.timeStamp().seconds() * 1000000 + frame.timeStamp().microSeconds();
+}
+
+void tst_SocketCan::cyclicFramePhase()
+{
+    // the broadcast manager sends the first frame after the phase (count=1 and
+    // ival1), then every period (ival2)
+    const qint64 added = QDateTime::currentMSecsSinceEpoch();
+    const int id = device->addCyclicFrame(QCanBusFrame(0x400, QByteArray("phase")), 100, 60);
+    QVERIFY(id > 0);
+    QCOMPARE(device->framesToWrite(), 0);
+
+    QTRY_VERIFY_WITH_TIMEOUT(peer->framesAvailable() >= 3, 2000);
+    const QList<QCanBusFrame> frames = peerFrames(0x400);
+    QVERIFY(frames.size() >= 3);
+    QCOMPARE(frames.first().payload(), QByteArray("phase"));
+
+    const qint64 first = microSeconds(frames.at(0)) / 1000;
+    QVERIFY2(first - added >= 50, qPrintable(QString::number(first - added)));
+    for (qsizetype i = 1; i < frames.size(); ++i) {
+        const qint64 interval = (microSeconds(frames.at(i)) - microSeconds(frames.at(i - 1)))
+                / 1000;
+        QVERIFY2(interval >= 80 && interval <= 130, qPrintable(QString::number(interval)));
+    }
+
+    QVERIFY(device->removeCyclicFrame(id));
+    QTest::qWait(150);
+    peer->readAllFrames();
+    QTest::qWait(250);
+    QVERIFY(peerFrames(0x400).isEmpty());
+}
+
+void tst_SocketCan::cyclicFrameUpdate()
+{
+    const int id = device->addCyclicFrame(QCanBusFrame(0x401, QByteArray("old")), 20, 0);
+    QVERIFY(id > 0);
+    QTRY_VERIFY_WITH_TIMEOUT(!peerFrames(0x401).isEmpty(), 1000);
+
+    // the payload is replaced without restarting the timer
+    QVERIFY(device->updateCyclicFrame(id, QCanBusFrame(0x401, QByteArray("new"))));
+    QTest::qWait(50);
+    peer->readAllFrames();
+    QTRY_VERIFY_WITH_TIMEOUT(peer->framesAvailable() >= 2, 1000);
+    QList<QCanBusFrame> frames = peerFrames(0x401);
+    QVERIFY(!frames.isEmpty());
+    for (const QCanBusFrame &frame : std::as_const(frames))
+        QCOMPARE(frame.payload(), QByteArray("new"));
+
+    // another identifier needs a new operation, which keeps the period
+    QVERIFY(device->updateCyclicFrame(id, QCanBusFrame(0x402, QByteArray("moved"))));
+    QTest::qWait(50);
+    peer->readAllFrames();
+    QTRY_VERIFY_WITH_TIMEOUT(peer->framesAvailable() >= 4, 1000);
+    QVERIFY(peerFrames(0x401).isEmpty());
+    QTest::qWait(100);
+    frames = peerFrames(0x402);
+    QVERIFY(frames.size() >= 3);
+    for (qsizetype i = 1; i < frames.size(); ++i) {
+        const qint64 interval = (microSeconds(frames.at(i)) - microSeconds(frames.at(i - 1)))
+                / 1000;
+        QVERIFY2(interval >= 10 && interval <= 40, qPrintable(QString::number(interval)));
+    }
+
+    QVERIFY(device->removeCyclicFrame(id));
+}
+
+void tst_SocketCan::receiveMonitorContentMask()
+{
+    QVERIFY(device->addReceiveMonitor(0x300, QByteArray::fromHex("ff00"), 0));
+
+    // only changes of the first byte or of the length are delivered
+    const QList<QCanBusFrame> frames = {
+        QCanBusFrame(0x300, QByteArray::fromHex("0100")),
+        QCanBusFrame(0x300, QByteArray::fromHex("0105")),
+        QCanBusFrame(0x300, QByteArray::fromHex("0205")),
+        QCanBusFrame(0x300, QByteArray::fromHex("0205")),
+        QCanBusFrame(0x300, QByteArray::fromHex("020500")),
+        QCanBusFrame(0x301, QByteArray::fromHex("00"))
+    };
+    const qint64 sent = QDateTime::currentMSecsSinceEpoch();
+    QCOMPARE(peer->writeFrames(frames), qint64(frames.size()));
+
+    // the raw socket drops the monitored frames, so they are not delivered twice
+    QTRY_COMPARE_WITH_TIMEOUT(device->framesAvailable(), qint64(4), 1000);
+    QTest::qWait(100);
+    QCOMPARE(device->framesAvailable(), qint64(4));
+    const QList<QCanBusFrame> received = device->readAllFrames();
+
+    // the broadcast manager and the raw socket deliver in any order
+    QList<QCanBusFrame> monitored = received;
+    monitored.removeIf([](const QCanBusFrame &frame) { return frame.frameId() != 0x300; });
+    QCOMPARE(monitored.size(), 3);
+    QCOMPARE(monitored.at(0).payload(), QByteArray::fromHex("0100"));
+    QCOMPARE(monitored.at(1).payload(), QByteArray::fromHex("0205"));
+    QCOMPARE(monitored.at(2).payload(), QByteArray::fromHex("020500"));
+
+    // the frames keep the time the kernel received them
+    for (const QCanBusFrame &frame : received) {
+        const qint64 delay = microSeconds(frame) / 1000 - sent;
+        QVERIFY2(delay >= -10 && delay < 100, qPrintable(QString::number(delay)));
+    }
+
+    QVERIFY(device->removeReceiveMonitor(0x300));
+    QVERIFY(!device->removeReceiveMonitor(0x300));
+    QCOMPARE(peer->writeFrames(frames.mid(0, 2)), qint64(2));
+    QTRY_COMPARE_WITH_TIMEOUT(readFrames(device.data(), 0x300).size(), 2, 1000);
+}
+
+void tst_SocketCan::receiveMonitorTimeout()
+{
+    QSignalSpy timeoutSpy(device.data(), &QCanBusDevice::receiveTimeout);
+    QVERIFY(device->addReceiveMonitor(0x310, QByteArray(), 100));
+
+    // without a content mask, every frame is delivered and restarts the timeout
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(peer->writeFrame(QCanBusFrame(0x310, QByteArray(1, char(i)))));
+        QTest::qWait(50);
+    }
+    QCOMPARE(timeoutSpy.count(), 0);
+    QTRY_COMPARE_WITH_TIMEOUT(device->framesAvailable(), qint64(3), 1000);
+
+    QTRY_COMPARE_WITH_TIMEOUT(timeoutSpy.count(), 1, 1000);
+    QCOMPARE(timeoutSpy.at(0).at(0).value<QCanBusFrame::FrameId>(), 0x310u);
+    QCOMPARE(timeoutSpy.at(0).at(1).toBool(), false);
+
+    // the timeout is announced again after the next frame
+    QTest::qWait(250);
+    QCOMPARE(timeoutSpy.count(), 1);
+    QVERIFY(peer->writeFrame(QCanBusFrame(0x310, QByteArray(1, 'x'))));
+    QTRY_COMPARE_WITH_TIMEOUT(timeoutSpy.count(), 2, 1000);
+}
+
+void tst_SocketCan::broadcastManagerReconnect()
+{
+    QVERIFY(device->addReceiveMonitor(0x320, QByteArray::fromHex("ff"), 0));
+    const int id = device->addCyclicFrame(QCanBusFrame(0x403, QByteArray("cycle")), 20, 0);
+    QVERIFY(id > 0);
+
+    // closing the socket deletes the operations of the broadcast manager
+    device->disconnectDevice();
+    QCOMPARE(device->state(), QCanBusDevice::UnconnectedState);
+    QTest::qWait(50);
+    peer->readAllFrames();
+    QTest::qWait(100);
+    QVERIFY(peerFrames(0x403).isEmpty());
+
+    QVERIFY(device->connectDevice());
+    QTRY_VERIFY_WITH_TIMEOUT(peerFrames(0x403).size() >= 2, 1000);
+
+    // the cyclic frames of the device reach its own raw socket as well
+    QCOMPARE(peer->writeFrames({QCanBusFrame(0x320, QByteArray::fromHex("01")),
+                                QCanBusFrame(0x320, QByteArray::fromHex("01")),
+                                QCanBusFrame(0x320, QByteArray::fromHex("02"))}), qint64(3));
+    QTest::qWait(100);
+    const QList<QCanBusFrame> received = readFrames(device.data(), 0x320);
+    QCOMPARE(received.size(), 2);
+    QCOMPARE(received.at(1).payload(), QByteArray::fromHex("02"));
+
+    QVERIFY(device->removeCyclicFrame(id));
+    QVERIFY(device->removeReceiveMonitor(0x320));
+}
+
+void tst_SocketCan::transmitConfirmation()
+{
+    device->setConfigurationParameter(QCanBusDevice::TransmitConfirmationKey, true);
+    QCOMPARE(device->error(), QCanBusDevice::NoError);
+    device->resetStatistics();
+    QSignalSpy confirmedSpy(device.data(), &QCanBusDevice::frameConfirmed);
+
+    // the kernel echoes the frames with CAN_RAW_RECV_OWN_MSGS and MSG_CONFIRM
+    const qint64 written = QDateTime::currentMSecsSinceEpoch();
+    const QList<QCanBusFrame> frames = {
+        QCanBusFrame(0x500, QByteArray("1")),
+        QCanBusFrame(0x500, QByteArray("2")),
+        QCanBusFrame(0x501, QByteArray("3"))
+    };
+    QCOMPARE(device->writeFrames(frames), qint64(frames.size()));
+    QTRY_COMPARE_WITH_TIMEOUT(confirmedSpy.count(), 3, 2000);
+
+    for (int i = 0; i < frames.size(); ++i) {
+        const QCanBusFrame confirmed = confirmedSpy.at(i).at(0).value<QCanBusFrame>();
+        QCOMPARE(confirmed.frameId(), frames.at(i).frameId());
+        QCOMPARE(confirmed.payload(), frames.at(i).payload());
+        QVERIFY(confirmed.hasLocalEcho());
+        // the timestamp is the reception of the echo
+        QVERIFY(microSeconds(confirmed) / 1000 >= written);
+    }
+
+    const QList<qint64> histogram = device->statistics().transmitLatencyHistogram();
+    QCOMPARE(std::accumulate(histogram.cbegin(), histogram.cend(), qint64(0)), qint64(3));
+
+    // without ReceiveOwnKey, the echoes are not received frames
+    QTest::qWait(50);
+    QVERIFY(readFrames(device.data(), 0x500).isEmpty());
+    QCOMPARE(peerFrames(0x500).size(), 2);
+
+    device->setConfigurationParameter(QCanBusDevice::ReceiveOwnKey, true);
+    QVERIFY(device->writeFrame(QCanBusFrame(0x500, QByteArray("4"))));
+    QTRY_COMPARE_WITH_TIMEOUT(confirmedSpy.count(), 4, 2000);
+    QTRY_VERIFY_WITH_TIMEOUT(device->framesAvailable() > 0, 2000);
+    QCOMPARE(readFrames(device.data(), 0x500).size(), 1);
+
+    device->setConfigurationParameter(QCanBusDevice::TransmitConfirmationKey, false);
+    QVERIFY(device->writeFrame(QCanBusFrame(0x500, QByteArray("5"))));
+    QTRY_VERIFY_WITH_TIMEOUT(peer->framesAvailable() >= 2, 2000);
+    QTest::qWait(50);
+    QCOMPARE(confirmedSpy.count(), 4);
+}
+
+QTEST_MAIN(tst_SocketCan)
+
+#include "tst_socketcan.moc"
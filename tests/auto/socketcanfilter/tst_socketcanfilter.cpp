@@ -0,0 +1,401 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "socketcanfilter.h"
+
+#include <QtCore/qendian.h>
+#include <QtCore/qrandom.h>
+#include <QtTest/qtest.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Runs a classic BPF program on frame, like the kernel does for a socket
+// filter. Only the instructions generated by SocketCanFilter::compile() are
+// supported. Returns false if the program is malformed.
+bool runProgram(const QList<sock_filter> &program, const can_frame &frame, quint32 *result)
+{
+    uchar packet[sizeof(can_frame)];
+    std::memcpy(packet, &frame, sizeof(frame));
+
+    quint32 a = 0;
+    quint32 x = 0;
+    for (qsizetype pc = 0; pc < program.size(); ++pc) {
+        const sock_filter &insn = program.at(pc);
+        switch (insn.code) {
+        case BPF_LD | BPF_W | BPF_ABS:
+            if (insn.k > sizeof(packet) - sizeof(quint32))
+                return false;
+            a = qFromBigEndian<quint32>(packet + insn.k);
+            break;
+        case BPF_MISC | BPF_TAX:
+            x = a;
+            break;
+        case BPF_MISC | BPF_TXA:
+            a = x;
+            break;
+        case BPF_ALU | BPF_AND | BPF_K:
+            a &= insn.k;
+            break;
+        case BPF_JMP | BPF_JA:
+            pc += insn.k;
+            break;
+        case BPF_JMP | BPF_JEQ | BPF_K:
+            pc += (a == insn.k) ? insn.jt : insn.jf;
+            break;
+        case BPF_JMP | BPF_JGE | BPF_K:
+            pc += (a >= insn.k) ? insn.jt : insn.jf;
+            break;
+        case BPF_JMP | BPF_JSET | BPF_K:
+            pc += (a & insn.k) ? insn.jt : insn.jf;
+            break;
+        case BPF_RET | BPF_K:
+            *result = insn.k;
+            return true;
+        default:
+            return false;
+        }
+    }
+    return false; // no return instruction reached
+}
+
+bool matchesAny(const QList<can_filter> &filters, canid_t id)
+{
+    return std::any_of(filters.cbegin(), filters.cend(), [id](const can_filter &filter) {
+        return (id & filter.can_mask) == (filter.can_id & filter.can_mask);
+    });
+}
+
+// The program passes all error frames, CAN_RAW_ERR_FILTER applies to them.
+bool referenceAccepts(const QList<can_filter> &filters, canid_t id)
+{
+    return (id & CAN_ERR_FLAG) || matchesAny(filters, id);
+}
+
+// Ids of this form differ in at least two bits, so optimize() cannot merge
+// filters that use them with the same mask.
+canid_t unmergeableId(quint32 index)
+{
+    return (index << 1) | (qPopulationCount(index) & 1);
+}
+
+constexpr canid_t ValidIdBits = CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG | CAN_EFF_MASK;
+
+canid_t randomId(QRandomGenerator &rng)
+{
+    switch (rng.bounded(4)) {
+    case 0:
+        return rng.bounded(0x800U);
+    case 1:
+        return rng.bounded(0x800U) | CAN_RTR_FLAG;
+    case 2:
+        return (rng.generate() & CAN_EFF_MASK) | CAN_EFF_FLAG
+                | (rng.bounded(2) ? CAN_RTR_FLAG : 0);
+    default:
+        return rng.generate() & ValidIdBits;
+    }
+}
+
+can_filter randomFilter(QRandomGenerator &rng)
+{
+    // ids from a small range make overlapping and mergeable filters likely
+    const canid_t narrowId = 0x100 + rng.bounded(0x40U);
+    const canid_t rtr = rng.bounded(2) ? CAN_RTR_FLAG : 0;
+    switch (rng.bounded(6)) {
+    case 0:
+        return can_filter{narrowId, CAN_SFF_MASK | CAN_EFF_FLAG};
+    case 1:
+        return can_filter{narrowId | rtr, CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG};
+    case 2:
+        return can_filter{(rng.generate() & CAN_EFF_MASK) | CAN_EFF_FLAG | rtr,
+                          CAN_EFF_MASK | CAN_EFF_FLAG | (rtr ? CAN_RTR_FLAG : 0)};
+    case 3:
+        return can_filter{narrowId, 0x7F0};
+    case 4:
+        return can_filter{rng.generate() & ValidIdBits & ~CAN_ERR_FLAG,
+                          rng.generate() & ValidIdBits & ~CAN_ERR_FLAG};
+    default:
+        return can_filter{narrowId | CAN_ERR_FLAG, CAN_ERR_FLAG};
+    }
+}
+
+// Ids that hit the edges of the filters: every filter id, the same id with
+// each masked bit flipped, and some random ids.
+QList<canid_t> probeIds(const QList<can_filter> &filters, QRandomGenerator &rng)
+{
+    QList<canid_t> ids;
+    for (const can_filter &filter : filters) {
+        const canid_t id = (filter.can_id & filter.can_mask)
+                | (rng.generate() & ValidIdBits & ~filter.can_mask);
+        ids.append(id);
+        ids.append(id & ~CAN_ERR_FLAG);
+        for (int bit = 0; bit < 32; ++bit) {
+            if (filter.can_mask & ValidIdBits & (1U << bit))
+                ids.append(id ^ (1U << bit));
+        }
+    }
+    for (int i = 0; i < 2000; ++i)
+        ids.append(randomId(rng));
+    return ids;
+}
+
+QList<can_filter> parseFilters(const QStringList &list)
+{
+    QList<can_filter> filters;
+    for (const QString &entry : list) {
+        const QStringList parts = entry.split(QLatin1Char('/'));
+        filters.append(can_filter{parts.at(0).toUInt(nullptr, 16), parts.at(1).toUInt(nullptr, 16)});
+    }
+    return filters;
+}
+
+QStringList toStrings(const QList<can_filter> &filters)
+{
+    QStringList list;
+    for (const can_filter &filter : filters) {
+        list.append(QString::number(filter.can_id, 16) + QLatin1Char('/')
+                    + QString::number(filter.can_mask, 16));
+    }
+    return list;
+}
+
+} // namespace
+
+class tst_SocketCanFilter : public QObject
+{
+    Q_OBJECT
+public:
+    tst_SocketCanFilter() = default;
+
+private slots:
+    void optimize_data();
+    void optimize();
+    void optimizeRandom();
+
+    void compileGroupSize_data();
+    void compileGroupSize();
+    void compileFrameFormats_data();
+    void compileFrameFormats();
+    void compileRandom();
+    void compileTooLarge();
+
+private:
+    void verifyProgram(const QList<can_filter> &filters, const QList<canid_t> &ids);
+};
+
+void tst_SocketCanFilter::verifyProgram(const QList<can_filter> &filters,
+                                        const QList<canid_t> &ids)
+{
+    QList<sock_filter> program;
+    QVERIFY(SocketCanFilter::compile(filters, &program));
+    QVERIFY(program.size() <= BPF_MAXINSNS);
+
+    for (canid_t id : ids) {
+        can_frame frame = {};
+        frame.can_id = id;
+        quint32 result = 0;
+        if (!runProgram(program, frame, &result))
+            QFAIL(qPrintable(QStringLiteral("Malformed program for id 0x%1").arg(id, 0, 16)));
+        if ((result != 0) != referenceAccepts(filters, id)) {
+            QFAIL(qPrintable(QStringLiteral("Wrong result %1 for id 0x%2")
+                             .arg(result).arg(id, 0, 16)));
+        }
+    }
+}
+
+void tst_SocketCanFilter::optimize_data()
+{
+    QTest::addColumn<QStringList>("filters");
+    QTest::addColumn<QStringList>("expected");
+
+    QTest::newRow("empty") << QStringList() << QStringList();
+    QTest::newRow("duplicate") << QStringList{"100/7ff", "100/7ff"} << QStringList{"100/7ff"};
+    QTest::newRow("unmasked id bits") << QStringList{"1ff/700"} << QStringList{"100/700"};
+    QTest::newRow("covered") << QStringList{"123/7ff", "120/7f0"} << QStringList{"120/7f0"};
+    QTest::newRow("not covered") << QStringList{"133/7ff", "120/7f0"}
+                                 << QStringList{"120/7f0", "133/7ff"};
+    QTest::newRow("merged") << QStringList{"100/7ff", "101/7ff"} << QStringList{"100/7fe"};
+    QTest::newRow("merged twice") << QStringList{"100/7ff", "101/7ff", "102/7ff", "103/7ff"}
+                                  << QStringList{"100/7fc"};
+    QTest::newRow("merged and covered") << QStringList{"100/7ff", "101/7ff", "100/7fe"}
+                                        << QStringList{"100/7fe"};
+    QTest::newRow("two bits apart") << QStringList{"100/7ff", "103/7ff"}
+                                    << QStringList{"100/7ff", "103/7ff"};
+    QTest::newRow("different masks") << QStringList{"100/7ff", "101/7fe"}
+                                     << QStringList{"100/7fe"};
+    // base and extended format, and data and remote request frames
+    QTest::newRow("format flag merged") << QStringList{"100/800007ff", "80000100/800007ff"}
+                                        << QStringList{"100/7ff"};
+    QTest::newRow("rtr flag merged") << QStringList{"100/c00007ff", "40000100/c00007ff"}
+                                     << QStringList{"100/800007ff"};
+    QTest::newRow("rtr flag covered") << QStringList{"40000100/c00007ff", "100/800007ff"}
+                                      << QStringList{"100/800007ff"};
+}
+
+void tst_SocketCanFilter::optimize()
+{
+    QFETCH(QStringList, filters);
+    QFETCH(QStringList, expected);
+
+    QCOMPARE(toStrings(SocketCanFilter::optimize(parseFilters(filters))), expected);
+}
+
+void tst_SocketCanFilter::optimizeRandom()
+{
+    QRandomGenerator rng(1);
+
+    for (int round = 0; round < 200; ++round) {
+        QList<can_filter> filters;
+        const int count = rng.bounded(1, 200);
+        for (int i = 0; i < count; ++i)
+            filters.append(randomFilter(rng));
+
+        const QList<can_filter> optimized = SocketCanFilter::optimize(filters);
+        QVERIFY(optimized.size() <= filters.size());
+
+        for (canid_t id : probeIds(filters, rng)) {
+            if (matchesAny(optimized, id) != matchesAny(filters, id))
+                QFAIL(qPrintable(QStringLiteral("Round %1, id 0x%2").arg(round).arg(id, 0, 16)));
+        }
+    }
+}
+
+void tst_SocketCanFilter::compileGroupSize_data()
+{
+    QTest::addColumn<int>("count");
+
+    // groups with up to four ids are searched linearly, larger ones are split
+    for (int count : {1, 2, 3, 4, 5, 6, 7, 8, 9, 16, 17, 100, 500})
+        QTest::addRow("%d", count) << count;
+}
+
+void tst_SocketCanFilter::compileGroupSize()
+{
+    QFETCH(int, count);
+
+    QList<can_filter> filters;
+    for (int i = 0; i < count; ++i)
+        filters.append(can_filter{unmergeableId(i), CAN_SFF_MASK | CAN_EFF_FLAG});
+    QCOMPARE(SocketCanFilter::optimize(filters).size(), qsizetype(count));
+
+    // all base format ids, as data, remote request and error frame
+    QList<canid_t> ids;
+    for (canid_t id = 0; id <= CAN_SFF_MASK; ++id) {
+        ids.append(id);
+        ids.append(id | CAN_RTR_FLAG);
+        ids.append(id | CAN_EFF_FLAG);
+        ids.append(id | CAN_ERR_FLAG);
+    }
+    verifyProgram(filters, ids);
+}
+
+void tst_SocketCanFilter::compileFrameFormats_data()
+{
+    QTest::addColumn<QStringList>("filters");
+
+    QTest::newRow("no filter") << QStringList();
+    QTest::newRow("base format only") << QStringList{"100/800007ff", "200/800007ff"};
+    QTest::newRow("extended format only")
+            << QStringList{"80000100/9fffffff", "98ff0000/9fff0000"};
+    QTest::newRow("both formats") << QStringList{"100/7ff", "200/7ff"};
+    QTest::newRow("data frames only") << QStringList{"100/400007ff", "80000100/c00007ff"};
+    QTest::newRow("remote request only") << QStringList{"40000100/400007ff", "c0000100/c00007ff"};
+    QTest::newRow("mixed") << QStringList{"100/800007ff", "80000100/9fffffff",
+                                          "40000123/c00007ff", "300/700", "c0000456/dfffffff"};
+    QTest::newRow("error filters only") << QStringList{"20000004/20000004", "20000000/20000000"};
+    QTest::newRow("error and data filters") << QStringList{"20000004/20000004", "100/800007ff"};
+    QTest::newRow("accept all") << QStringList{"123/0", "100/800007ff"};
+}
+
+void tst_SocketCanFilter::compileFrameFormats()
+{
+    QFETCH(QStringList, filters);
+
+    QRandomGenerator rng(2);
+    const QList<can_filter> parsed = parseFilters(filters);
+    verifyProgram(parsed, probeIds(parsed, rng));
+}
+
+void tst_SocketCanFilter::compileRandom()
+{
+    QRandomGenerator rng(3);
+
+    for (int round = 0; round < 200; ++round) {
+        QList<can_filter> filters;
+        const int count = rng.bounded(1, 400);
+        for (int i = 0; i < count; ++i)
+            filters.append(randomFilter(rng));
+
+        verifyProgram(filters, probeIds(filters, rng));
+        if (QTest::currentTestFailed())
+            QFAIL(qPrintable(QStringLiteral("Failed in round %1").arg(round)));
+    }
+}
+
+void tst_SocketCanFilter::compileTooLarge()
+{
+    const auto filterList = [](int count) {
+        QList<can_filter> filters;
+        for (int i = 0; i < count; ++i) {
+            filters.append(can_filter{unmergeableId(i) | CAN_EFF_FLAG,
+                                      CAN_EFF_MASK | CAN_EFF_FLAG});
+        }
+        return filters;
+    };
+
+    QList<sock_filter> program;
+    QVERIFY(SocketCanFilter::compile(filterList(1000), &program));
+    QVERIFY(program.size() <= BPF_MAXINSNS);
+
+    // too many filters: the program is left untouched, the caller falls back
+    // to CAN_RAW_FILTER
+    const QList<sock_filter> previous = program;
+    QVERIFY(!SocketCanFilter::compile(filterList(2000), &program));
+    QCOMPARE(program.size(), previous.size());
+    QVERIFY(std::equal(program.cbegin(), program.cend(), previous.cbegin(),
+                       [](const sock_filter &a, const sock_filter &b) {
+        return std::memcmp(&a, &b, sizeof(sock_filter)) == 0;
+    }));
+}
+
+QTEST_MAIN(tst_SocketCanFilter)
+
+#include "tst_socketcanfilter.moc"
@@ -0,0 +1,142 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtSerialBus module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtSerialBus/qcanbusframematcher.h>
+
+#include <QtCore/qrandom.h>
+#include <QtTest/qtest.h>
+
+class tst_bench_QCanBusFrameMatcher : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void scalar_data() { testData(); }
+    void scalar();
+    void frameList_data() { testData(); }
+    void frameList();
+    void frameBatch_data() { testData(); }
+    void frameBatch();
+
+private:
+    void testData();
+
+    QList<QCanBusFrame> frames;
+};
+
+void tst_bench_QCanBusFrameMatcher::initTestCase()
+{
+    QRandomGenerator random(42);
+    for (int i = 0; i < 100000; ++i) {
+        QCanBusFrame frame(QCanBusFrame::FrameId(random.bounded(0x800)),
+                           QByteArray::number(random.generate()).left(8));
+        frames.append(frame);
+    }
+}
+
+void tst_bench_QCanBusFrameMatcher::testData()
+{
+    QTest::addColumn<QList<QCanBusDevice::Filter>>("filters");
+
+    for (int count : {1, 4, 16, 64}) {
+        QList<QCanBusDevice::Filter> filters;
+        for (int i = 0; i < count; ++i) {
+            QCanBusDevice::Filter filter;
+            filter.frameId = QCanBusFrame::FrameId(i * 0x20);
+            filter.frameIdMask = 0x7F8;
+            filter.type = QCanBusFrame::DataFrame;
+            filter.format = QCanBusDevice::Filter::MatchBaseFormat;
+            filters.append(filter);
+        }
+        QTest::addRow("%d filters", count) << filters;
+    }
+}
+
+// the per frame, per filter loop applications use without the matcher
+void tst_bench_QCanBusFrameMatcher::scalar()
+{
+    QFETCH(QList<QCanBusDevice::Filter>, filters);
+
+    qsizetype matched = 0;
+    QBENCHMARK {
+        matched = 0;
+        for (const QCanBusFrame &frame : std::as_const(frames)) {
+            for (const QCanBusDevice::Filter &filter : std::as_const(filters)) {
+                if (frame.frameType() == filter.type && !frame.hasExtendedFrameFormat()
+                        && (frame.frameId() & filter.frameIdMask)
+                                == (filter.frameId & filter.frameIdMask)) {
+                    ++matched;
+                    break;
+                }
+            }
+        }
+    }
+
+    const QCanBusFrameMatcher matcher(filters);
+    QCOMPARE(matched, matcher.matchingIndexes(frames).size());
+}
+
+void tst_bench_QCanBusFrameMatcher::frameList()
+{
+    QFETCH(QList<QCanBusDevice::Filter>, filters);
+
+    const QCanBusFrameMatcher matcher(filters);
+    QBENCHMARK {
+        const QList<quint64> bitmap = matcher.matchBitmap(frames);
+        Q_UNUSED(bitmap);
+    }
+}
+
+void tst_bench_QCanBusFrameMatcher::frameBatch()
+{
+    QFETCH(QList<QCanBusDevice::Filter>, filters);
+
+    const QCanBusFrameMatcher matcher(filters);
+    const QCanBusFrameBatch batch(frames);
+    QBENCHMARK {
+        const QList<quint64> bitmap = matcher.matchBitmap(batch);
+        Q_UNUSED(bitmap);
+    }
+}
+
+QTEST_MAIN(tst_bench_QCanBusFrameMatcher)
+
+#include "tst_bench_qcanbusframematcher.moc"